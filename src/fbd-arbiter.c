@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#define G_LOG_DOMAIN "fbd-arbiter"
+
+#include "fbd-arbiter.h"
+#include "fbd-feedback-dummy.h"
+#include "fbd-feedback-led.h"
+#include "fbd-feedback-sound.h"
+#include "fbd-feedback-vibra.h"
+
+/**
+ * SECTION:fbd-arbiter
+ * @short_description: Arbitrates access to the feedback devices
+ * @Title: FbdArbiter
+ *
+ * The #FbdArbiter tracks which feedbacks currently claim a device
+ * (vibra motor, sound) and with which priority. Feedbacks of equal
+ * priority share the device. A claim with a higher priority suspends
+ * the active lower priority ones. Claims with a lower priority than
+ * the active ones are kept pending and get resumed once all higher
+ * priority claims are released.
+ *
+ * As feedbacks are shared between events, claims are made per event
+ * and feedback.
+ *
+ * LEDs aren't arbitrated: concurrent feedbacks on an LED are composed
+ * into a single pattern by the LED device and different colors use
+ * different LEDs.
+ */
+
+typedef struct _FbdArbiterClaim {
+  guint            event_id;
+  FbdFeedbackBase *feedback;
+  guint            priority;
+  gboolean         active;
+} FbdArbiterClaim;
+
+typedef struct _FbdArbiter {
+  GObject parent;
+
+  /* Per device list of FbdArbiterClaim */
+  GList  *claims[FBD_ARBITER_DEVICE_LAST + 1];
+} FbdArbiter;
+
+G_DEFINE_TYPE (FbdArbiter, fbd_arbiter, G_TYPE_OBJECT);
+
+static void
+fbd_arbiter_claim_free (FbdArbiterClaim *claim)
+{
+  g_object_unref (claim->feedback);
+  g_free (claim);
+}
+
+static GList *
+find_claim (GList *claims, guint event_id, FbdFeedbackBase *feedback)
+{
+  for (GList *l = claims; l; l = l->next) {
+    FbdArbiterClaim *claim = l->data;
+
+    if (claim->event_id == event_id && claim->feedback == feedback)
+      return l;
+  }
+  return NULL;
+}
+
+/* The device @feedback needs exclusive access to */
+static FbdArbiterDevice
+get_arbitrated_device (FbdFeedbackBase *feedback)
+{
+  FbdArbiterDevice device = fbd_arbiter_get_device (feedback);
+
+  /* The LED device composes concurrent feedbacks itself */
+  if (device == FBD_ARBITER_DEVICE_LEDS)
+    return FBD_ARBITER_DEVICE_NONE;
+
+  return device;
+}
+
+static void
+fbd_arbiter_dispose (GObject *object)
+{
+  FbdArbiter *self = FBD_ARBITER (object);
+
+  for (int i = 0; i <= FBD_ARBITER_DEVICE_LAST; i++)
+    g_list_free_full (g_steal_pointer (&self->claims[i]), (GDestroyNotify)fbd_arbiter_claim_free);
+
+  G_OBJECT_CLASS (fbd_arbiter_parent_class)->dispose (object);
+}
+
+static void
+fbd_arbiter_class_init (FbdArbiterClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = fbd_arbiter_dispose;
+}
+
+static void
+fbd_arbiter_init (FbdArbiter *self)
+{
+}
+
+FbdArbiter *
+fbd_arbiter_new (void)
+{
+  return FBD_ARBITER (g_object_new (FBD_TYPE_ARBITER, NULL));
+}
+
+/**
+ * fbd_arbiter_get_device:
+ * @feedback: The feedback
+ *
+ * Returns: The device the feedback needs access to or
+ * %FBD_ARBITER_DEVICE_NONE if it doesn't use any shared device.
+ */
+FbdArbiterDevice
+fbd_arbiter_get_device (FbdFeedbackBase *feedback)
+{
+  if (FBD_IS_FEEDBACK_VIBRA (feedback))
+    return FBD_ARBITER_DEVICE_VIBRA;
+  if (FBD_IS_FEEDBACK_SOUND (feedback))
+    return FBD_ARBITER_DEVICE_SOUND;
+  if (FBD_IS_FEEDBACK_LED (feedback))
+    return FBD_ARBITER_DEVICE_LEDS;
+  if (FBD_IS_FEEDBACK_DUMMY (feedback))
+    return fbd_feedback_dummy_get_device (FBD_FEEDBACK_DUMMY (feedback));
+
+  return FBD_ARBITER_DEVICE_NONE;
+}
+
+/**
+ * fbd_arbiter_claim:
+ * @self: The arbiter
+ * @event_id: The event the feedback runs for
+ * @feedback: The feedback that wants to use its device
+ * @priority: The priority of the claim
+ *
+ * Claims the device used by @feedback for the given event. Active
+ * claims with a lower priority get suspended.
+ *
+ * Returns: %TRUE if the feedback can use the device now, %FALSE if a
+ * higher priority claim is active. In that case the claim is kept
+ * pending and the feedback gets resumed once the device is available.
+ */
+gboolean
+fbd_arbiter_claim (FbdArbiter      *self,
+                   guint            event_id,
+                   FbdFeedbackBase *feedback,
+                   guint            priority)
+{
+  FbdArbiterDevice device;
+  FbdArbiterClaim *claim;
+  GSList *preempted = NULL;
+  GList *l;
+  guint max = 0;
+  gboolean have_active = FALSE;
+
+  g_return_val_if_fail (FBD_IS_ARBITER (self), TRUE);
+  g_return_val_if_fail (FBD_IS_FEEDBACK_BASE (feedback), TRUE);
+
+  device = get_arbitrated_device (feedback);
+  if (device == FBD_ARBITER_DEVICE_NONE)
+    return TRUE;
+
+  l = find_claim (self->claims[device], event_id, feedback);
+  if (l) {
+    claim = l->data;
+  } else {
+    claim = g_new0 (FbdArbiterClaim, 1);
+    claim->event_id = event_id;
+    claim->feedback = g_object_ref (feedback);
+    self->claims[device] = g_list_append (self->claims[device], claim);
+  }
+  claim->priority = priority;
+
+  for (l = self->claims[device]; l; l = l->next) {
+    FbdArbiterClaim *other = l->data;
+
+    if (other == claim || !other->active)
+      continue;
+
+    have_active = TRUE;
+    max = MAX (max, other->priority);
+  }
+
+  if (have_active && priority < max) {
+    g_debug ("Deferring %s of event %u (priority %u < %u)",
+             G_OBJECT_TYPE_NAME (feedback), event_id, priority, max);
+    claim->active = FALSE;
+    return FALSE;
+  }
+
+  claim->active = TRUE;
+  for (l = self->claims[device]; l; l = l->next) {
+    FbdArbiterClaim *other = l->data;
+
+    if (!other->active || other->priority >= priority)
+      continue;
+
+    other->active = FALSE;
+    preempted = g_slist_prepend (preempted, g_object_ref (other->feedback));
+  }
+
+  /* Suspend after updating our state as this can re-enter */
+  for (GSList *s = preempted; s; s = s->next) {
+    g_debug ("%s preempts %s", G_OBJECT_TYPE_NAME (feedback), G_OBJECT_TYPE_NAME (s->data));
+    fbd_feedback_suspend (s->data);
+  }
+  g_slist_free_full (preempted, g_object_unref);
+
+  return TRUE;
+}
+
+/**
+ * fbd_arbiter_release:
+ * @self: The arbiter
+ * @event_id: The event the feedback ran for
+ * @feedback: The feedback that no longer needs its device
+ *
+ * Drops the claim of @feedback for the given event. If no active
+ * claim is left the pending claims with the highest priority are
+ * resumed.
+ */
+void
+fbd_arbiter_release (FbdArbiter *self, guint event_id, FbdFeedbackBase *feedback)
+{
+  FbdArbiterDevice device;
+  FbdArbiterClaim *claim;
+  GSList *resumed = NULL;
+  GList *l;
+  guint max = 0;
+
+  g_return_if_fail (FBD_IS_ARBITER (self));
+  g_return_if_fail (FBD_IS_FEEDBACK_BASE (feedback));
+
+  device = get_arbitrated_device (feedback);
+  if (device == FBD_ARBITER_DEVICE_NONE)
+    return;
+
+  l = find_claim (self->claims[device], event_id, feedback);
+  if (!l)
+    return;
+
+  claim = l->data;
+  self->claims[device] = g_list_delete_link (self->claims[device], l);
+  fbd_arbiter_claim_free (claim);
+
+  for (l = self->claims[device]; l; l = l->next) {
+    FbdArbiterClaim *other = l->data;
+
+    if (other->active)
+      return;
+    max = MAX (max, other->priority);
+  }
+
+  for (l = self->claims[device]; l; l = l->next) {
+    FbdArbiterClaim *other = l->data;
+
+    if (other->priority != max)
+      continue;
+
+    other->active = TRUE;
+    resumed = g_slist_prepend (resumed, g_object_ref (other->feedback));
+  }
+
+  resumed = g_slist_reverse (resumed);
+  for (GSList *s = resumed; s; s = s->next) {
+    g_debug ("Resuming %s", G_OBJECT_TYPE_NAME (s->data));
+    fbd_feedback_resume (s->data);
+  }
+  g_slist_free_full (resumed, g_object_unref);
+}
+
+/**
+ * fbd_arbiter_get_n_claims:
+ * @self: The arbiter
+ * @device: The device
+ *
+ * Returns: The number of active and pending claims on @device
+ */
+guint
+fbd_arbiter_get_n_claims (FbdArbiter *self, FbdArbiterDevice device)
+{
+  g_return_val_if_fail (FBD_IS_ARBITER (self), 0);
+  g_return_val_if_fail (device > FBD_ARBITER_DEVICE_NONE && device <= FBD_ARBITER_DEVICE_LAST, 0);
+
+  return g_list_length (self->claims[device]);
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+#pragma once
+
+#include <glib-object.h>
+
+#include "fbd-feedback-base.h"
+
+G_BEGIN_DECLS
+
+typedef enum _FbdArbiterDevice {
+  /* Feedback doesn't use any shared hardware */
+  FBD_ARBITER_DEVICE_NONE  = -1,
+  FBD_ARBITER_DEVICE_VIBRA =  0,
+  FBD_ARBITER_DEVICE_SOUND =  1,
+  FBD_ARBITER_DEVICE_LEDS  =  2,
+  FBD_ARBITER_DEVICE_LAST  = FBD_ARBITER_DEVICE_LEDS,
+} FbdArbiterDevice;
+
+#define FBD_TYPE_ARBITER (fbd_arbiter_get_type())
+
+G_DECLARE_FINAL_TYPE (FbdArbiter, fbd_arbiter, FBD, ARBITER, GObject);
+
+FbdArbiter      *fbd_arbiter_new (void);
+FbdArbiterDevice fbd_arbiter_get_device (FbdFeedbackBase *feedback);
+gboolean         fbd_arbiter_claim (FbdArbiter      *self,
+                                    guint            event_id,
+                                    FbdFeedbackBase *feedback,
+                                    guint            priority);
+void             fbd_arbiter_release (FbdArbiter      *self,
+                                      guint            event_id,
+                                      FbdFeedbackBase *feedback);
+guint            fbd_arbiter_get_n_claims (FbdArbiter *self, FbdArbiterDevice device);
+
+G_END_DECLS
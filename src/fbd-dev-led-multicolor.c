@@ -15,6 +15,8 @@
 
 #include <gio/gio.h>
 
+#include <math.h>
+
 #define LED_MULTI_INDEX_ATTR     "multi_index"
 #define LED_MULTI_INDEX_RED      "red"
 #define LED_MULTI_INDEX_GREEN    "green"
@@ -28,8 +30,16 @@ typedef struct _FbdDevLedMulticolor {
   guint               red_index;
   guint               green_index;
   guint               blue_index;
+
+  /* Per feedback intensity cache */
+  GQuark              intensity_quark;
 } FbdDevLedMulticolor;
 
+typedef struct _FbdLedIntensity {
+  guint channels[3];
+  char *str;
+} FbdLedIntensity;
+
 
 G_DEFINE_TYPE (FbdDevLedMulticolor, fbd_dev_led_multicolor, FBD_TYPE_DEV_LED)
 
@@ -42,6 +52,7 @@ fbd_dev_led_probe_multicolor (FbdDevLed *led, GError **error)
   GUdevDevice *dev = fbd_dev_led_get_device (led);
   const gchar *name, *path;
   const gchar * const *index;
+  g_autofree char *intensity_key = NULL;
   guint counter = 0;
   guint max_brightness;
 
@@ -83,66 +94,108 @@ fbd_dev_led_probe_multicolor (FbdDevLed *led, GError **error)
 
   path = g_udev_device_get_sysfs_path (dev);
   g_debug ("LED at '%s' usable as multicolor", path);
+
+  intensity_key = g_strdup_printf ("fbd-dev-led-intensity-%s", path);
+  self->intensity_quark = g_quark_from_string (intensity_key);
+
   return TRUE;
 }
 
 
+static void
+fbd_led_intensity_free (FbdLedIntensity *intensity)
+{
+  g_free (intensity->str);
+  g_free (intensity);
+}
+
+/*
+ * The multi_intensity value only depends on the feedback's color and
+ * this LED so compute it once and keep it with the feedback.
+ */
+static FbdLedIntensity *
+get_intensity (FbdDevLedMulticolor *self, FbdFeedbackLed *feedback)
+{
+  FbdLedIntensity *intensity;
+  const gdouble *rgb;
+  guint max_brightness;
+
+  intensity = g_object_get_qdata (G_OBJECT (feedback), self->intensity_quark);
+  if (intensity)
+    return intensity;
+
+  max_brightness = fbd_dev_led_get_max_brightness (FBD_DEV_LED (self));
+  rgb = fbd_feedback_led_get_intensity (feedback);
+
+  intensity = g_new0 (FbdLedIntensity, 1);
+  intensity->channels[self->red_index] = round (rgb[0] * max_brightness);
+  intensity->channels[self->green_index] = round (rgb[1] * max_brightness);
+  intensity->channels[self->blue_index] = round (rgb[2] * max_brightness);
+  intensity->str = g_strdup_printf ("%u %u %u\n",
+                                    intensity->channels[0],
+                                    intensity->channels[1],
+                                    intensity->channels[2]);
+
+  g_object_set_qdata_full (G_OBJECT (feedback), self->intensity_quark, intensity,
+                           (GDestroyNotify)fbd_led_intensity_free);
+  return intensity;
+}
+
+
+/*
+ * multi_intensity applies to the whole pattern so the colors of
+ * several feedbacks can't be shown in turn and mixing them shows a
+ * color none of them asked for. Show the feedback with the highest
+ * priority instead, the most recent one if several have the same.
+ */
+static FbdFeedbackLed *
+pick_feedback (GList *feedbacks)
+{
+  FbdFeedbackLed *picked = NULL;
+  guint max = 0;
+
+  for (GList *l = feedbacks; l; l = l->next) {
+    guint priority = fbd_feedback_get_priority (FBD_FEEDBACK_BASE (l->data));
+
+    if (picked == NULL || priority >= max) {
+      picked = l->data;
+      max = priority;
+    }
+  }
+
+  return picked;
+}
+
+
 static gboolean
-fbd_dev_led_start_periodic_multicolor (FbdDevLed           *led,
-                                       FbdFeedbackLedColor  color,
-                                       guint                max_brightness_percentage,
-                                       guint                freq)
+fbd_dev_led_start_periodic_multicolor (FbdDevLed *led, GList *feedbacks)
 {
   FbdDevLedMulticolor *self = FBD_DEV_LED_MULTICOLOR (led);
-  GUdevDevice *dev = fbd_dev_led_get_device (led);
-  g_autofree char *intensity = NULL;
   g_autoptr (GError) err = NULL;
-  g_autofree gchar *str = NULL;
-  gboolean success = FALSE;
-  guint max_brightness;
-  guint colors[] = { 0, 0, 0 };
-
-  max_brightness = fbd_dev_led_get_max_brightness (led);
-  switch (color) {
-  case FBD_FEEDBACK_LED_COLOR_WHITE:
-    colors[self->red_index] = max_brightness;
-    colors[self->green_index] = max_brightness;
-    colors[self->blue_index] = max_brightness;
-    break;
-  case FBD_FEEDBACK_LED_COLOR_RED:
-    colors[self->red_index] = max_brightness;
-    colors[self->green_index] = 0;
-    colors[self->blue_index] = 0;
-    break;
-  case FBD_FEEDBACK_LED_COLOR_GREEN:
-    colors[self->red_index] = 0;
-    colors[self->green_index] = max_brightness;
-    colors[self->blue_index] = 0;
-    break;
-  case FBD_FEEDBACK_LED_COLOR_BLUE:
-    colors[self->red_index] = 0;
-    colors[self->green_index] = 0;
-    colors[self->blue_index] = max_brightness;
-    break;
-  default:
-    g_warning("Unhandled color: %d\n", color);
-    return FALSE;
-  }
+  FbdFeedbackLed *feedback = pick_feedback (feedbacks);
+  GList shown = { .data = feedback };
+
+  /* Only needed when the LED was off */
+  if (fbd_dev_led_get_attr (led, LED_MULTI_INTENSITY_ATTR) == NULL)
+    fbd_dev_led_set_brightness (led, fbd_dev_led_get_max_brightness (led));
 
-  intensity = g_strdup_printf ("%d %d %d\n", colors[0], colors[1], colors[2]);
-  fbd_dev_led_set_brightness (led, max_brightness);
-  success = fbd_udev_set_sysfs_path_attr_as_string (dev,
-                                                    LED_MULTI_INTENSITY_ATTR,
-                                                    intensity,
-                                                    &err);
-  if (!success) {
+  if (!fbd_dev_led_write_attr (led, LED_MULTI_INTENSITY_ATTR,
+                               get_intensity (self, feedback)->str, &err)) {
     g_warning ("Failed to set multi intensity: %s", err->message);
     return FALSE;
   }
 
   /* Chain up to parent class to set the pattern */
-  return FBD_DEV_LED_CLASS (fbd_dev_led_multicolor_parent_class)->start_periodic (
-    led, color, max_brightness_percentage, freq);
+  return FBD_DEV_LED_CLASS (fbd_dev_led_multicolor_parent_class)->start_periodic (led, &shown);
+}
+
+
+static void
+fbd_dev_led_prepare_multicolor (FbdDevLed *led, FbdFeedbackLed *feedback)
+{
+  get_intensity (FBD_DEV_LED_MULTICOLOR (led), feedback);
+
+  FBD_DEV_LED_CLASS (fbd_dev_led_multicolor_parent_class)->prepare (led, feedback);
 }
 
 
@@ -161,6 +214,7 @@ fbd_dev_led_multicolor_class_init (FbdDevLedMulticolorClass *klass)
   fbd_dev_led_class->probe = fbd_dev_led_probe_multicolor;
   fbd_dev_led_class->start_periodic = fbd_dev_led_start_periodic_multicolor;
   fbd_dev_led_class->has_color = fbd_dev_led_has_color_multicolor;
+  fbd_dev_led_class->prepare = fbd_dev_led_prepare_multicolor;
 }
 
 
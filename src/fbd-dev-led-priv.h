@@ -18,5 +18,12 @@ G_BEGIN_DECLS
 GUdevDevice      *fbd_dev_led_get_device  (FbdDevLed *led);
 void              fbd_dev_led_set_max_brightness (FbdDevLed *led, guint max_brightness);
 void              fbd_dev_led_set_color (FbdDevLed *led, FbdFeedbackLedColor color);
+gchar            *fbd_dev_led_build_pattern (FbdDevLed *led, GList *feedbacks);
+gboolean          fbd_dev_led_write_attr (FbdDevLed   *led,
+                                          const char  *attr,
+                                          const char  *value,
+                                          GError     **error);
+const char       *fbd_dev_led_get_attr (FbdDevLed *led, const char *attr);
+GList            *fbd_dev_led_get_feedbacks (FbdDevLed *led);
 
 G_END_DECLS
@@ -22,6 +22,7 @@
 #define LED_MULTI_INDEX_BLUE     "blue"
 #define LED_MULTI_INTENSITY_ATTR "multi_intensity"
 #define LED_PATTERN_ATTR         "pattern"
+#define LED_HW_PATTERN_ATTR      "hw_pattern"
 
 enum {
   PROP_0,
@@ -38,6 +39,15 @@ typedef struct _FbdDevLedPrivate {
    * do rgb mixing, etc
    */
   FbdFeedbackLedColor color;
+  /* Whether the pattern trigger can offload patterns to hardware */
+  gboolean            hw_pattern;
+  /* Per feedback pattern cache */
+  GQuark              pattern_quark;
+
+  /* The feedbacks currently shown on this LED in start order */
+  GList              *feedbacks;
+  /* Key: sysfs attribute, value: last written value */
+  GHashTable         *attrs;
 } FbdDevLedPrivate;
 
 
@@ -93,33 +103,130 @@ fbd_dev_led_probe_default (FbdDevLed *led, GError **error)
 }
 
 
+/*
+ * The pattern of a single feedback only depends on the feedback and
+ * this LED's max brightness so format it once and keep it with the
+ * feedback.
+ */
+static const char *
+get_feedback_pattern (FbdDevLed *led, FbdFeedbackLed *feedback)
+{
+  FbdDevLedPrivate *priv = fbd_dev_led_get_instance_private (led);
+  const FbdFeedbackLedStep *steps;
+  GString *pattern;
+  char *str;
+  guint n_steps;
+
+  str = g_object_get_qdata (G_OBJECT (feedback), priv->pattern_quark);
+  if (str)
+    return str;
+
+  steps = fbd_feedback_led_get_steps (feedback, &n_steps);
+  pattern = g_string_new (NULL);
+  for (guint i = 0; i < n_steps; i++) {
+    g_string_append_printf (pattern, "%s%d %u", i ? " " : "",
+                            (gint)(steps[i].level * priv->max_brightness),
+                            steps[i].duration);
+  }
+
+  str = g_string_free (pattern, FALSE);
+  g_object_set_qdata_full (G_OBJECT (feedback), priv->pattern_quark, str, g_free);
+  return str;
+}
+
+/**
+ * fbd_dev_led_build_pattern:
+ * @led: The LED
+ * @feedbacks: (element-type FbdFeedbackLed): The feedbacks to compose
+ *
+ * Build a pattern that runs each feedback's pattern once per
+ * cycle. With a single feedback this is just its pattern.
+ *
+ * Returns: The pattern for the pattern trigger
+ */
+gchar *
+fbd_dev_led_build_pattern (FbdDevLed *led, GList *feedbacks)
+{
+  GString *pattern = g_string_new (NULL);
+
+  for (GList *l = feedbacks; l; l = l->next) {
+    FbdFeedbackLed *feedback = FBD_FEEDBACK_LED (l->data);
+
+    if (pattern->len)
+      g_string_append_c (pattern, ' ');
+    g_string_append (pattern, get_feedback_pattern (led, feedback));
+  }
+  g_string_append_c (pattern, '\n');
+
+  return g_string_free (pattern, FALSE);
+}
+
+
 static gboolean
-fbd_dev_led_start_periodic_default (FbdDevLed           *led,
-                                    FbdFeedbackLedColor  color,
-                                    guint                max_brightness_percentage,
-                                    guint                freq)
+fbd_dev_led_start_hw_pattern (FbdDevLed *led, GList *feedbacks)
+{
+  g_autoptr (GError) err = NULL;
+  g_autofree gchar *str = NULL;
+  FbdDevLedPrivate *priv = fbd_dev_led_get_instance_private (led);
+
+  /* Without interpolation the steps become a staircase */
+  str = fbd_dev_led_build_pattern (led, feedbacks);
+  g_debug ("%u feedbacks, HW blink pattern: %s", g_list_length (feedbacks), str);
+
+  if (!fbd_dev_led_write_attr (led, LED_HW_PATTERN_ATTR, str, &err)) {
+    /* The engine might not support this pattern (e.g. too many steps) */
+    g_debug ("Failed to set hw pattern, using software pattern: %s", err->message);
+    return FALSE;
+  }
+
+  /* Writing either pattern replaces the other one */
+  g_hash_table_remove (priv->attrs, LED_PATTERN_ATTR);
+  return TRUE;
+}
+
+
+static gboolean
+fbd_dev_led_start_periodic_default (FbdDevLed *led, GList *feedbacks)
 {
-  FbdDevLedPrivate *priv;
   g_autoptr (GError) err = NULL;
   g_autofree gchar *str = NULL;
-  gboolean success = FALSE;
-  gdouble max;
-  gdouble t;
+  FbdDevLedPrivate *priv;
 
   g_return_val_if_fail (FBD_IS_DEV_LED (led), FALSE);
   priv = fbd_dev_led_get_instance_private (led);
 
-  max =  priv->max_brightness * (max_brightness_percentage / 100.0);
-  /*  ms     mHz           T/2 */
-  t = 1000.0 * 1000.0 / freq / 2.0;
-  str = g_strdup_printf ("0 %d %d %d\n", (gint)t, (gint)max, (gint)t);
-  g_debug ("Freq %d mHz, Brightness: %d%%, Blink pattern: %s", freq, max_brightness_percentage, str);
+  if (priv->hw_pattern && fbd_dev_led_start_hw_pattern (led, feedbacks))
+    return TRUE;
+
+  str = fbd_dev_led_build_pattern (led, feedbacks);
+  g_debug ("%u feedbacks, Blink pattern: %s", g_list_length (feedbacks), str);
 
-  success = fbd_udev_set_sysfs_path_attr_as_string (priv->dev, LED_PATTERN_ATTR, str, &err);
-  if (!success)
+  if (!fbd_dev_led_write_attr (led, LED_PATTERN_ATTR, str, &err)) {
     g_warning ("Failed to set led pattern: %s", err->message);
+    return FALSE;
+  }
+  g_hash_table_remove (priv->attrs, LED_HW_PATTERN_ATTR);
 
-  return success;
+  return TRUE;
+}
+
+
+static void
+fbd_dev_led_prepare_default (FbdDevLed *led, FbdFeedbackLed *feedback)
+{
+  get_feedback_pattern (led, feedback);
+}
+
+
+static gboolean
+fbd_dev_led_write_attr_default (FbdDevLed   *led,
+                                const char  *attr,
+                                const char  *value,
+                                GError     **error)
+{
+  FbdDevLedPrivate *priv = fbd_dev_led_get_instance_private (led);
+
+  return fbd_udev_set_sysfs_path_attr_as_string (priv->dev, attr, value, error);
 }
 
 
@@ -182,6 +289,8 @@ fbd_dev_led_finalize (GObject *object)
   FbdDevLedPrivate *priv = fbd_dev_led_get_instance_private (self);
 
   g_clear_object (&priv->dev);
+  g_list_free_full (priv->feedbacks, g_object_unref);
+  g_clear_pointer (&priv->attrs, g_hash_table_destroy);
 
   G_OBJECT_CLASS (fbd_dev_led_parent_class)->finalize (object);
 }
@@ -193,8 +302,24 @@ initable_init (GInitable    *initable,
                GError      **error)
 {
   FbdDevLedClass *fbd_dev_led_class = FBD_DEV_LED_GET_CLASS (initable);
+  FbdDevLedPrivate *priv = fbd_dev_led_get_instance_private (FBD_DEV_LED (initable));
+  g_autofree char *pattern_key = NULL;
+
+  if (!fbd_dev_led_class->probe (FBD_DEV_LED (initable), error))
+    return FALSE;
 
-  return fbd_dev_led_class->probe (FBD_DEV_LED (initable), error);
+  /* LEDs with the same max brightness can share the patterns */
+  pattern_key = g_strdup_printf ("fbd-dev-led-pattern-%u", priv->max_brightness);
+  priv->pattern_quark = g_quark_from_string (pattern_key);
+
+  /* LEDs without a device only exist in tests */
+  priv->hw_pattern = priv->dev && g_udev_device_has_sysfs_attr (priv->dev, LED_HW_PATTERN_ATTR);
+  if (priv->hw_pattern) {
+    g_debug ("LED at '%s' supports hardware patterns",
+             g_udev_device_get_sysfs_path (priv->dev));
+  }
+
+  return TRUE;
 }
 
 
@@ -218,6 +343,8 @@ fbd_dev_led_class_init (FbdDevLedClass *klass)
   fbd_dev_led_class->probe = fbd_dev_led_probe_default;
   fbd_dev_led_class->start_periodic = fbd_dev_led_start_periodic_default;
   fbd_dev_led_class->has_color = fbd_dev_led_has_color_default;
+  fbd_dev_led_class->prepare = fbd_dev_led_prepare_default;
+  fbd_dev_led_class->write_attr = fbd_dev_led_write_attr_default;
 
   props[PROP_DEV] =
     g_param_spec_object ("dev", "", "",
@@ -231,6 +358,9 @@ fbd_dev_led_class_init (FbdDevLedClass *klass)
 static void
 fbd_dev_led_init (FbdDevLed *self)
 {
+  FbdDevLedPrivate *priv = fbd_dev_led_get_instance_private (self);
+
+  priv->attrs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 }
 
 
@@ -244,13 +374,14 @@ fbd_dev_led_new (GUdevDevice *dev, GError **err)
 gboolean
 fbd_dev_led_set_brightness (FbdDevLed *led, guint brightness)
 {
-  FbdDevLedPrivate *priv;
   g_autoptr (GError) err = NULL;
+  g_autofree char *value = NULL;
 
   g_return_val_if_fail (FBD_IS_DEV_LED (led), FALSE);
-  priv = fbd_dev_led_get_instance_private (led);
 
-  if (!fbd_udev_set_sysfs_path_attr_as_int (priv->dev, LED_BRIGHTNESS_ATTR, brightness, &err)) {
+  value = g_strdup_printf ("%u", brightness);
+  /* Not cached, the kernel changes it when the pattern runs */
+  if (!FBD_DEV_LED_GET_CLASS (led)->write_attr (led, LED_BRIGHTNESS_ATTR, value, &err)) {
     g_warning ("Failed to setup brightness: %s", err->message);
     return FALSE;
   }
@@ -259,17 +390,95 @@ fbd_dev_led_set_brightness (FbdDevLed *led, guint brightness)
 }
 
 
-gboolean
-fbd_dev_led_start_periodic (FbdDevLed           *led,
-                            FbdFeedbackLedColor  color,
-                            guint                max_brightness_percentage,
-                            guint                freq)
+static gboolean
+fbd_dev_led_update (FbdDevLed *led)
 {
   FbdDevLedClass *fbd_dev_led_class = FBD_DEV_LED_GET_CLASS (led);
+  FbdDevLedPrivate *priv = fbd_dev_led_get_instance_private (led);
+
+  if (priv->feedbacks == NULL) {
+    /* Turning the LED off resets the trigger so forget what we wrote */
+    g_hash_table_remove_all (priv->attrs);
+    return fbd_dev_led_set_brightness (led, 0);
+  }
+
+  return fbd_dev_led_class->start_periodic (led, priv->feedbacks);
+}
+
+/**
+ * fbd_dev_led_start_periodic:
+ * @led: The LED
+ * @feedback: The feedback to show
+ *
+ * Adds @feedback to the feedbacks shown on this LED. All feedbacks are
+ * composed into a single pattern. Multicolor LEDs only show the one
+ * with the highest priority as they can't change color within a
+ * pattern.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fbd_dev_led_start_periodic (FbdDevLed *led, FbdFeedbackLed *feedback)
+{
+  FbdDevLedPrivate *priv;
 
   g_return_val_if_fail (FBD_IS_DEV_LED (led), FALSE);
+  g_return_val_if_fail (FBD_IS_FEEDBACK_LED (feedback), FALSE);
+  priv = fbd_dev_led_get_instance_private (led);
+
+  if (!g_list_find (priv->feedbacks, feedback))
+    priv->feedbacks = g_list_append (priv->feedbacks, g_object_ref (feedback));
 
-  return fbd_dev_led_class->start_periodic (led, color, max_brightness_percentage, freq);
+  return fbd_dev_led_update (led);
+}
+
+/**
+ * fbd_dev_led_prepare:
+ * @led: The LED
+ * @feedback: The feedback that is about to be shown
+ *
+ * Formats what needs to be written to the LED for @feedback so
+ * fbd_dev_led_start_periodic() only needs to write it out.
+ */
+void
+fbd_dev_led_prepare (FbdDevLed *led, FbdFeedbackLed *feedback)
+{
+  FbdDevLedClass *fbd_dev_led_class;
+
+  g_return_if_fail (FBD_IS_DEV_LED (led));
+  g_return_if_fail (FBD_IS_FEEDBACK_LED (feedback));
+
+  fbd_dev_led_class = FBD_DEV_LED_GET_CLASS (led);
+  fbd_dev_led_class->prepare (led, feedback);
+}
+
+/**
+ * fbd_dev_led_stop:
+ * @led: The LED
+ * @feedback: The feedback to remove
+ *
+ * Removes @feedback from the feedbacks shown on this LED. The LED is
+ * turned off once the last feedback is gone.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fbd_dev_led_stop (FbdDevLed *led, FbdFeedbackLed *feedback)
+{
+  FbdDevLedPrivate *priv;
+  GList *l;
+
+  g_return_val_if_fail (FBD_IS_DEV_LED (led), FALSE);
+  priv = fbd_dev_led_get_instance_private (led);
+
+  l = g_list_find (priv->feedbacks, feedback);
+  if (l == NULL)
+    return TRUE;
+
+  priv->feedbacks = g_list_delete_link (priv->feedbacks, l);
+  g_object_unref (feedback);
+
+  return fbd_dev_led_update (led);
 }
 
 
@@ -295,6 +504,25 @@ fbd_dev_led_get_max_brightness (FbdDevLed *led)
   return priv->max_brightness;
 }
 
+/**
+ * fbd_dev_led_get_feedbacks:
+ * @led: The LED
+ *
+ * Gets the feedbacks currently shown on the LED.
+ *
+ * Returns: (transfer none) (element-type FbdFeedbackLed): The feedbacks in start order
+ */
+GList *
+fbd_dev_led_get_feedbacks (FbdDevLed *led)
+{
+  FbdDevLedPrivate *priv;
+
+  g_return_val_if_fail (FBD_IS_DEV_LED (led), NULL);
+  priv = fbd_dev_led_get_instance_private (led);
+
+  return priv->feedbacks;
+}
+
 /* Functions for derived classes */
 
 GUdevDevice *
@@ -331,3 +559,56 @@ fbd_dev_led_set_max_brightness (FbdDevLed *led, guint max_brightness)
 
   priv->max_brightness = max_brightness;
 }
+
+
+/**
+ * fbd_dev_led_write_attr:
+ * @led: The LED
+ * @attr: The sysfs attribute
+ * @value: The value
+ * @error: Return location for an error
+ *
+ * Writes @value to the sysfs attribute @attr unless the last value
+ * written is identical.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fbd_dev_led_write_attr (FbdDevLed *led, const char *attr, const char *value, GError **error)
+{
+  FbdDevLedPrivate *priv;
+
+  g_return_val_if_fail (FBD_IS_DEV_LED (led), FALSE);
+  priv = fbd_dev_led_get_instance_private (led);
+
+  if (g_strcmp0 (g_hash_table_lookup (priv->attrs, attr), value) == 0)
+    return TRUE;
+
+  if (!FBD_DEV_LED_GET_CLASS (led)->write_attr (led, attr, value, error)) {
+    g_hash_table_remove (priv->attrs, attr);
+    return FALSE;
+  }
+
+  g_hash_table_insert (priv->attrs, g_strdup (attr), g_strdup (value));
+  return TRUE;
+}
+
+
+/**
+ * fbd_dev_led_get_attr:
+ * @led: The LED
+ * @attr: The sysfs attribute
+ *
+ * Returns: (nullable): The last value written to @attr since the LED
+ *   was turned off
+ */
+const char *
+fbd_dev_led_get_attr (FbdDevLed *led, const char *attr)
+{
+  FbdDevLedPrivate *priv;
+
+  g_return_val_if_fail (FBD_IS_DEV_LED (led), NULL);
+  priv = fbd_dev_led_get_instance_private (led);
+
+  return g_hash_table_lookup (priv->attrs, attr);
+}
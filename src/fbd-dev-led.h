@@ -20,22 +20,25 @@ G_DECLARE_DERIVABLE_TYPE (FbdDevLed, fbd_dev_led, FBD, DEV_LED, GObject)
 FbdDevLed          *fbd_dev_led_new  (GUdevDevice *dev, GError **err);
 gboolean            fbd_dev_led_set_brightness (FbdDevLed *led, guint brightness);
 guint               fbd_dev_led_get_max_brightness (FbdDevLed *led);
-gboolean            fbd_dev_led_start_periodic (FbdDevLed           *led,
-                                                FbdFeedbackLedColor  color,
-                                                guint                max_brightness_percentage,
-                                                guint                freq);
+gboolean            fbd_dev_led_start_periodic (FbdDevLed *led, FbdFeedbackLed *feedback);
+gboolean            fbd_dev_led_stop (FbdDevLed *led, FbdFeedbackLed *feedback);
 gboolean            fbd_dev_led_has_color (FbdDevLed *led, FbdFeedbackLedColor color);
+void                fbd_dev_led_prepare (FbdDevLed *led, FbdFeedbackLed *feedback);
 
 struct _FbdDevLedClass {
   GObjectClass parent_class;
 
   gboolean (*probe)          (FbdDevLed           *led, GError **error);
   gboolean (*start_periodic) (FbdDevLed           *led,
-                              FbdFeedbackLedColor  color,
-                              guint                max_brightness_percentage,
-                              guint                freq);
+                              GList               *feedbacks);
   gboolean (*has_color)      (FbdDevLed           *led,
                               FbdFeedbackLedColor  color);
+  void     (*prepare)        (FbdDevLed           *led,
+                              FbdFeedbackLed      *feedback);
+  gboolean (*write_attr)     (FbdDevLed           *led,
+                              const char          *attr,
+                              const char          *value,
+                              GError             **error);
 };
 
 G_END_DECLS
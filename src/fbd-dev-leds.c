@@ -11,6 +11,7 @@
 #include "fbd.h"
 #include "fbd-enums.h"
 #include "fbd-dev-led.h"
+#include "fbd-dev-led-priv.h"
 #include "fbd-dev-led-multicolor.h"
 #include "fbd-dev-leds.h"
 #include "fbd-feedback-led.h"
@@ -26,13 +27,16 @@
  * LED device interface
  *
  * #FbdDevLeds is used to interface with LEDS via sysfs
- * It currently only supports one pattern per led at a time.
+ * Concurrent feedbacks on the same LED are composed into a single pattern.
+ * LEDs that show up or go away later on are picked up via uevents.
  */
 typedef struct _FbdDevLeds {
   GObject      parent;
 
   GUdevClient *client;
   GSList      *leds;
+  /* The LED to use for each color, rebuilt when LEDs come and go */
+  FbdDevLed   *by_color[FBD_FEEDBACK_LED_COLOR_LAST + 1];
 } FbdDevLeds;
 
 static void initable_iface_init (GInitableIface *iface);
@@ -40,19 +44,124 @@ static void initable_iface_init (GInitableIface *iface);
 G_DEFINE_TYPE_WITH_CODE (FbdDevLeds, fbd_dev_leds, G_TYPE_OBJECT,
                          G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, initable_iface_init));
 
+/*
+ * Rebuilds the color index. The @orphans were shown on an LED that went
+ * away and are moved to the LED now used for their color.
+ */
+static void
+update_color_index (FbdDevLeds *self, GList *orphans)
+{
+  for (int color = 0; color <= FBD_FEEDBACK_LED_COLOR_LAST; color++) {
+    self->by_color[color] = NULL;
+
+    for (GSList *l = self->leds; l != NULL; l = l->next) {
+      FbdDevLed *led = l->data;
+
+      if (fbd_dev_led_has_color (led, color)) {
+        self->by_color[color] = led;
+        break;
+      }
+    }
+
+    /* If we did not match a color pick the first */
+    if (self->by_color[color] == NULL && self->leds)
+      self->by_color[color] = self->leds->data;
+  }
+
+  for (GList *l = orphans; l != NULL; l = l->next) {
+    FbdFeedbackLed *feedback = l->data;
+    FbdDevLed *led = self->by_color[fbd_feedback_led_get_color (feedback)];
+
+    if (led == NULL) {
+      g_debug ("No LED left to show feedback on");
+      break;
+    }
+
+    fbd_dev_led_start_periodic (led, feedback);
+  }
+}
+
 static FbdDevLed *
 find_led_by_color (FbdDevLeds *self, FbdFeedbackLedColor color)
 {
-  g_return_val_if_fail (self->leds, NULL);
+  g_return_val_if_fail (color <= FBD_FEEDBACK_LED_COLOR_LAST, NULL);
 
+  return self->by_color[color];
+}
+
+static GSList *
+find_led_by_path (FbdDevLeds *self, const char *sysfs_path)
+{
   for (GSList *l = self->leds; l != NULL; l = l->next) {
-    FbdDevLed *led = l->data;
-    if (fbd_dev_led_has_color (led, color))
-      return led;
+    GUdevDevice *dev = fbd_dev_led_get_device (l->data);
+
+    if (g_strcmp0 (g_udev_device_get_sysfs_path (dev), sysfs_path) == 0)
+      return l;
   }
 
-  /* If we did not match a color pick the first */
-  return self->leds->data;
+  return NULL;
+}
+
+static gboolean
+add_led (FbdDevLeds *self, GUdevDevice *dev)
+{
+  g_autoptr (GError) err = NULL;
+  FbdDevLed *led;
+
+  if (g_strcmp0 (g_udev_device_get_property (dev, FEEDBACKD_UDEV_ATTR),
+                 FEEDBACKD_UDEV_VAL_LED)) {
+    return FALSE;
+  }
+
+  if (find_led_by_path (self, g_udev_device_get_sysfs_path (dev)))
+    return FALSE;
+
+  /* Try multicolor first, fall back to single color */
+  led = fbd_dev_led_multicolor_new (dev, &err);
+  if (led == NULL) {
+    g_debug ("Led not usable as multicolor: '%s'", err->message);
+    g_clear_error (&err);
+    led = fbd_dev_led_new (dev, &err);
+    if (led == NULL) {
+      g_debug ("Led not usable as single color: '%s'", err->message);
+      return FALSE;
+    }
+  }
+
+  self->leds = g_slist_append (self->leds, led);
+  return TRUE;
+}
+
+static void
+on_uevent (FbdDevLeds  *self,
+           const char  *action,
+           GUdevDevice *device,
+           GUdevClient *client)
+{
+  const char *path = g_udev_device_get_sysfs_path (device);
+  g_autolist (FbdFeedbackLed) orphans = NULL;
+  gboolean changed = FALSE;
+
+  if (g_strcmp0 (action, "remove") == 0) {
+    GSList *l = find_led_by_path (self, path);
+
+    if (l) {
+      g_debug ("LED %s got removed", path);
+      orphans = g_list_copy_deep (fbd_dev_led_get_feedbacks (l->data),
+                                  (GCopyFunc)g_object_ref, NULL);
+      g_object_unref (l->data);
+      self->leds = g_slist_delete_link (self->leds, l);
+      changed = TRUE;
+    }
+  } else if (g_strcmp0 (action, "add") == 0 || g_strcmp0 (action, "change") == 0) {
+    /* The udev rule might only tag the LED on a later change event */
+    changed = add_led (self, device);
+    if (changed)
+      g_debug ("Found hotplugged LED at %s", path);
+  }
+
+  if (changed)
+    update_color_index (self, orphans);
 }
 
 static gboolean
@@ -63,46 +172,24 @@ initable_init (GInitable    *initable,
   const gchar * const subsystems[] = { LED_SUBSYSTEM, NULL };
   FbdDevLeds *self = FBD_DEV_LEDS (initable);
   g_autolist (GUdevDevice) leds = NULL;
-  gboolean found = FALSE;
 
   self->client = g_udev_client_new (subsystems);
+  g_signal_connect_object (self->client, "uevent",
+                           G_CALLBACK (on_uevent), self,
+                           G_CONNECT_SWAPPED);
 
   leds = g_udev_client_query_by_subsystem (self->client, LED_SUBSYSTEM);
 
-  for (GList *l = leds; l != NULL; l = l->next) {
-    g_autoptr (GError) err = NULL;
-    GUdevDevice *dev = G_UDEV_DEVICE (l->data);
-    FbdDevLed *led;
-
-    if (g_strcmp0 (g_udev_device_get_property (dev, FEEDBACKD_UDEV_ATTR),
-                   FEEDBACKD_UDEV_VAL_LED)) {
-      continue;
-    }
-
-    /* Try multicolor first, fall back to single color */
-    led = fbd_dev_led_multicolor_new (dev, &err);
-    if (led == NULL) {
-      g_debug ("Led not usable as multicolor: '%s'", err->message);
-      led = fbd_dev_led_new (dev, &err);
-      if (led == NULL)
-        g_debug ("Led not usable as single color: '%s'", err->message);
-    }
-
-    if (led) {
-      self->leds = g_slist_append (self->leds, led);
-      found = TRUE;
-    }
-  }
+  for (GList *l = leds; l != NULL; l = l->next)
+    add_led (self, G_UDEV_DEVICE (l->data));
 
-  /* TODO: listen for new leds via udev events */
+  update_color_index (self, NULL);
 
-  if (!found) {
-    g_set_error (error,
-                 G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                 "No usable LEDs found");
-  }
+  /* LEDs might show up later on, see fbd_dev_leds_has_leds() */
+  if (self->leds == NULL)
+    g_debug ("No usable LEDs found yet");
 
-  return found;
+  return TRUE;
 }
 
 static void
@@ -119,6 +206,7 @@ fbd_dev_leds_dispose (GObject *object)
   g_clear_object (&self->client);
   g_slist_free_full (self->leds, (GDestroyNotify)g_object_unref);
   self->leds = NULL;
+  update_color_index (self, NULL);
 
   G_OBJECT_CLASS (fbd_dev_leds_parent_class)->dispose (object);
 }
@@ -148,35 +236,90 @@ fbd_dev_leds_new (GError **error)
 /**
  * fbd_dev_leds_start_periodic:
  * @self: The #FbdDevLeds
- * @color: The color to use for the LED pattern
- * @max_brightness_percentage: The max brightness (in percent) to use for the pattern
- * @freq: The pattern's frequency in mHz
+ * @feedback: The LED feedback to show
  *
- * Start periodic feedback.
+ * Start periodic feedback. Feedbacks using the same LED are composed
+ * into a single pattern.
  */
 gboolean
-fbd_dev_leds_start_periodic (FbdDevLeds *self, FbdFeedbackLedColor color,
-                             guint max_brightness_percentage, guint freq)
+fbd_dev_leds_start_periodic (FbdDevLeds *self, FbdFeedbackLed *feedback)
 {
   FbdDevLed *led;
 
   g_return_val_if_fail (FBD_IS_DEV_LEDS (self), FALSE);
-  g_return_val_if_fail (max_brightness_percentage <= 100.0, FALSE);
-  led = find_led_by_color (self, color);
-  g_return_val_if_fail (led, FALSE);
+  g_return_val_if_fail (FBD_IS_FEEDBACK_LED (feedback), FALSE);
+  led = find_led_by_color (self, fbd_feedback_led_get_color (feedback));
+  if (led == NULL) {
+    g_debug ("No LED to show feedback on");
+    return FALSE;
+  }
 
-  return fbd_dev_led_start_periodic (led, color, max_brightness_percentage, freq);
+  return fbd_dev_led_start_periodic (led, feedback);
 }
 
+/**
+ * fbd_dev_leds_stop:
+ * @self: The #FbdDevLeds
+ * @feedback: The LED feedback to stop
+ *
+ * Stop periodic feedback. The LED is only turned off once no other
+ * feedback uses it.
+ */
 gboolean
-fbd_dev_leds_stop (FbdDevLeds *self, FbdFeedbackLedColor color)
+fbd_dev_leds_stop (FbdDevLeds *self, FbdFeedbackLed *feedback)
 {
-  FbdDevLed *led;
+  gboolean success = TRUE;
 
   g_return_val_if_fail (FBD_IS_DEV_LEDS (self), FALSE);
+  g_return_val_if_fail (FBD_IS_FEEDBACK_LED (feedback), FALSE);
 
-  led = find_led_by_color (self, color);
-  g_return_val_if_fail (led, FALSE);
+  /*
+   * The LED for the feedback's color might have changed due to
+   * hotplug since it got started so check all of them.
+   */
+  for (GSList *l = self->leds; l != NULL; l = l->next) {
+    if (!fbd_dev_led_stop (l->data, feedback))
+      success = FALSE;
+  }
+
+  return success;
+}
+
+/**
+ * fbd_dev_leds_prepare:
+ * @self: The #FbdDevLeds
+ * @feedback: The LED feedback that is about to be started
+ *
+ * Prepares the LED used for @feedback so that
+ * fbd_dev_leds_start_periodic() has as little work left as possible.
+ */
+void
+fbd_dev_leds_prepare (FbdDevLeds *self, FbdFeedbackLed *feedback)
+{
+  FbdDevLed *led;
+
+  g_return_if_fail (FBD_IS_DEV_LEDS (self));
+  g_return_if_fail (FBD_IS_FEEDBACK_LED (feedback));
+
+  led = find_led_by_color (self, fbd_feedback_led_get_color (feedback));
+  if (led)
+    fbd_dev_led_prepare (led, feedback);
+}
+
+/**
+ * fbd_dev_leds_has_leds:
+ * @self: The #FbdDevLeds
+ *
+ * LEDs can be hotplugged so the device is usable without any LED.
+ * Use this to check whether there's currently an LED to show
+ * feedbacks on.
+ *
+ * Returns: %TRUE if there's at least one usable LED
+ */
+gboolean
+fbd_dev_leds_has_leds (FbdDevLeds *self)
+{
+  g_return_val_if_fail (FBD_IS_DEV_LEDS (self), FALSE);
 
-  return fbd_dev_led_set_brightness (led, 0);
+  return self->leds != NULL;
 }
@@ -17,10 +17,12 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (FbdDevLeds, fbd_dev_leds, FBD, DEV_LEDS, GObject);
 
 FbdDevLeds *fbd_dev_leds_new (GError **error);
-gboolean    fbd_dev_leds_start_periodic (FbdDevLeds *self,
-                                         FbdFeedbackLedColor color,
-                                         guint max_brighness, guint freq);
-gboolean    fbd_dev_leds_stop (FbdDevLeds         *self,
-                               FbdFeedbackLedColor color);
+gboolean    fbd_dev_leds_start_periodic (FbdDevLeds     *self,
+                                         FbdFeedbackLed *feedback);
+gboolean    fbd_dev_leds_stop (FbdDevLeds     *self,
+                               FbdFeedbackLed *feedback);
+void        fbd_dev_leds_prepare (FbdDevLeds     *self,
+                                  FbdFeedbackLed *feedback);
+gboolean    fbd_dev_leds_has_leds (FbdDevLeds *self);
 
 G_END_DECLS
@@ -11,34 +11,80 @@
 
 #include "fbd-dev-sound.h"
 #include "fbd-feedback-sound.h"
-
-#include <gsound.h>
+#include "fbd-sound-backend.h"
 
 #define GNOME_SOUND_SCHEMA_ID "org.gnome.desktop.sound"
 #define GNOME_SOUND_KEY_THEME_NAME "theme-name"
 
+/* Sounds to start caching per idle callback and to cache at once */
+#define PRELOAD_CHUNK_SIZE 1
+#define PRELOAD_MAX_PENDING 2
+
+#define DEFAULT_MAX_VOICES 4
+
 /**
  * SECTION:fbd-dev-sound
  * @short_description: Sound interface
  * @Title: FbdDevSound
  *
  * The #FbdDevSound is used to play sounds via the systems audio
- * system.
+ * system. Sounds can be preloaded into the sound server's cache so
+ * their first playback doesn't need to look up and decode the file.
+ *
+ * The actual playback is done by a #FbdSoundBackend picked via the
+ * `FEEDBACKD_SOUND_BACKEND` environment variable.
+ *
+ * At most #FbdDevSound:max-voices sounds play at once. A sound that is
+ * already playing isn't started a second time, the new playback rather
+ * finishes together with the running one. If all voices are in use the
+ * lowest priority, oldest one is stopped to make room. If all of them
+ * have a higher priority than the new sound the new one is dropped.
  */
 
+enum {
+  PROP_0,
+  PROP_MAX_VOICES,
+  PROP_LAST_PROP,
+};
+static GParamSpec *props[PROP_LAST_PROP];
+
 typedef struct _FbdAsyncData {
   FbdDevSoundPlayedCallback  callback;
   FbdFeedbackSound          *feedback;
   FbdDevSound               *dev;
   GCancellable              *cancel;
+  gboolean                   suspended;
+  /* Replay until cancelled or the deadline passed */
+  gboolean                   repeat;
+  gint64                     deadline;
+  FbdDevSoundPlayedCallback  iteration_callback;
+  /* Voice management */
+  guint                      priority;
+  gint64                     start;
+  gboolean                   stolen;
+  gboolean                   completing;
+  /* The playback this one got coalesced with and the ones coalesced with us */
+  struct _FbdAsyncData      *leader;
+  GSList                    *followers;
 } FbdAsyncData;
 
 typedef struct _FbdDevSound {
   GObject parent;
 
-  GSoundContext *ctx;
+  FbdSoundBackend *backend;
   GSettings     *sound_settings;
   GHashTable    *playbacks;
+
+  /* Sound effects yet to be cached */
+  GQueue        *preload;
+  guint          preload_id;
+  GCancellable  *preload_cancel;
+  guint          preload_pending;
+  gint64         preload_start;
+  guint          preload_count;
+
+  guint          max_voices;
+  FbdDevSoundCounters counters;
 } FbdDevSound;
 
 static void initable_iface_init (GInitableIface *iface);
@@ -51,25 +97,17 @@ on_sound_theme_name_changed (FbdDevSound *self,
                              const gchar *key,
                              GSettings   *settings)
 {
-  gboolean ok;
-  g_autoptr(GError) error = NULL;
   g_autofree gchar *name = NULL;
 
   g_return_if_fail (FBD_IS_DEV_SOUND (self));
   g_return_if_fail (G_IS_SETTINGS (settings));
   g_return_if_fail (!g_strcmp0 (key, GNOME_SOUND_KEY_THEME_NAME));
-  g_return_if_fail (self->ctx);
+  g_return_if_fail (self->backend);
 
   name = g_settings_get_string (settings, key);
   g_debug ("Setting sound theme to %s", name);
 
-  ok = gsound_context_set_attributes (self->ctx,
-				      &error,
-				      GSOUND_ATTR_CANBERRA_XDG_THEME_NAME,
-				      name,
-				      NULL);
-  if (!ok)
-    g_warning ("Failed to set sound theme name to %s: %s", key, error->message);
+  fbd_sound_backend_set_theme_name (self->backend, name);
 }
 
 static FbdAsyncData*
@@ -89,6 +127,8 @@ fbd_async_data_new (FbdDevSound *dev, FbdFeedbackSound *feedback, FbdDevSoundPla
 static void
 fbd_async_data_dispose (FbdAsyncData *data)
 {
+  g_warn_if_fail (data->followers == NULL);
+
   g_object_unref (data->feedback);
   g_object_unref (data->dev);
   g_object_unref (data->cancel);
@@ -100,13 +140,56 @@ fbd_dev_sound_dispose (GObject *object)
 {
   FbdDevSound *self = FBD_DEV_SOUND (object);
 
-  g_clear_object (&self->ctx);
+  g_clear_object (&self->backend);
   g_clear_object (&self->sound_settings);
   g_clear_pointer (&self->playbacks, g_hash_table_unref);
+  g_clear_handle_id (&self->preload_id, g_source_remove);
+  g_cancellable_cancel (self->preload_cancel);
+  g_clear_object (&self->preload_cancel);
+  if (self->preload) {
+    g_queue_free_full (self->preload, g_free);
+    self->preload = NULL;
+  }
 
   G_OBJECT_CLASS (fbd_dev_sound_parent_class)->dispose (object);
 }
 
+static void
+fbd_dev_sound_set_property (GObject      *object,
+                            guint         property_id,
+                            const GValue *value,
+                            GParamSpec   *pspec)
+{
+  FbdDevSound *self = FBD_DEV_SOUND (object);
+
+  switch (property_id) {
+  case PROP_MAX_VOICES:
+    self->max_voices = g_value_get_uint (value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+}
+
+static void
+fbd_dev_sound_get_property (GObject    *object,
+                            guint       property_id,
+                            GValue     *value,
+                            GParamSpec *pspec)
+{
+  FbdDevSound *self = FBD_DEV_SOUND (object);
+
+  switch (property_id) {
+  case PROP_MAX_VOICES:
+    g_value_set_uint (value, self->max_voices);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+}
+
 static gboolean
 initable_init (GInitable    *initable,
                GCancellable *cancellable,
@@ -117,8 +200,8 @@ initable_init (GInitable    *initable,
   gboolean gnome_session = FALSE;
 
   self->playbacks = g_hash_table_new (g_direct_hash, g_direct_equal);
-  self->ctx = gsound_context_new (NULL, error);
-  if (!self->ctx)
+  self->backend = fbd_sound_backend_new (g_getenv ("FEEDBACKD_SOUND_BACKEND"), error);
+  if (!self->backend)
     return FALSE;
 
   desktop = g_getenv ("XDG_CURRENT_DESKTOP");
@@ -150,12 +233,28 @@ fbd_dev_sound_class_init (FbdDevSoundClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
+  object_class->set_property = fbd_dev_sound_set_property;
+  object_class->get_property = fbd_dev_sound_get_property;
   object_class->dispose = fbd_dev_sound_dispose;
+
+  /**
+   * FbdDevSound:max-voices:
+   *
+   * The maximum number of sounds playing at the same time. `0` means
+   * no limit.
+   */
+  props[PROP_MAX_VOICES] =
+    g_param_spec_uint ("max-voices", "", "",
+                       0, G_MAXUINT, DEFAULT_MAX_VOICES,
+                       G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, PROP_LAST_PROP, props);
 }
 
 static void
 fbd_dev_sound_init (FbdDevSound *self)
 {
+  self->max_voices = DEFAULT_MAX_VOICES;
 }
 
 FbdDevSound *
@@ -168,15 +267,56 @@ fbd_dev_sound_new (GError **error)
 }
 
 
+/* Coalesced playbacks end together with their leader */
 static void
-on_sound_play_finished_callback (GSoundContext *ctx,
-                                 GAsyncResult  *res,
-                                 FbdAsyncData  *data)
+finish_followers (FbdAsyncData *data)
 {
-  g_autoptr (GError) err = NULL;
+  GSList *followers = g_steal_pointer (&data->followers);
 
-  if (!gsound_context_play_full_finish (ctx, res, &err)) {
-    if (err->domain == GSOUND_ERROR && err->code == GSOUND_ERROR_NOTFOUND) {
+  for (GSList *l = followers; l; l = l->next) {
+    FbdAsyncData *follower = l->data;
+
+    follower->leader = NULL;
+    g_hash_table_remove (follower->dev->playbacks, follower->feedback);
+    (*follower->callback)(follower->feedback);
+    fbd_async_data_dispose (follower);
+  }
+  g_slist_free (followers);
+}
+
+static gboolean
+on_complete_idle (FbdAsyncData *data)
+{
+  if (!data->suspended) {
+    g_hash_table_remove (data->dev->playbacks, data->feedback);
+    (*data->callback)(data->feedback);
+  }
+
+  fbd_async_data_dispose (data);
+  return G_SOURCE_REMOVE;
+}
+
+/* Finish a playback that has no sound of its own from the main loop */
+static void
+complete_later (FbdAsyncData *data)
+{
+  data->completing = TRUE;
+  g_idle_add ((GSourceFunc)on_complete_idle, data);
+}
+
+/* Detach a coalesced playback from the one it follows */
+static void
+detach_follower (FbdAsyncData *data)
+{
+  data->leader->followers = g_slist_remove (data->leader->followers, data);
+  data->leader = NULL;
+}
+
+static void
+finish_playback (FbdAsyncData *data, GError *err)
+{
+  if (err) {
+    if (g_error_matches (err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
       g_debug ("Failed to find sound '%s'", fbd_feedback_sound_get_effect (data->feedback));
     } else if (g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
       g_debug ("Sound '%s' cancelled", fbd_feedback_sound_get_effect (data->feedback));
@@ -187,6 +327,15 @@ on_sound_play_finished_callback (GSoundContext *ctx,
     }
   }
 
+  finish_followers (data);
+
+  /* Suspended playbacks are already gone from the hash table and the
+     feedback might be playing again */
+  if (data->suspended) {
+    fbd_async_data_dispose (data);
+    return;
+  }
+
   /* Order matters here. We need to remove the feedback from the hash table before
      invoking the callback. */
   g_hash_table_remove (data->dev->playbacks, data->feedback);
@@ -196,29 +345,223 @@ on_sound_play_finished_callback (GSoundContext *ctx,
 }
 
 
-gboolean
-fbd_dev_sound_play (FbdDevSound *self, FbdFeedbackSound *feedback, FbdDevSoundPlayedCallback callback)
+static void
+on_sound_play_finished_callback (FbdSoundBackend *backend,
+                                 GAsyncResult    *res,
+                                 FbdAsyncData    *data)
+{
+  g_autoptr (GError) err = NULL;
+
+  fbd_sound_backend_play_finish (backend, res, &err);
+  finish_playback (data, err);
+}
+
+
+static void
+on_sound_repeat_finished_callback (FbdSoundBackend *backend,
+                                 GAsyncResult    *res,
+                                 FbdAsyncData    *data)
+{
+  g_autoptr (GError) err = NULL;
+
+  fbd_sound_backend_play_repeat_finish (backend, res, &err);
+  finish_playback (data, err);
+}
+
+
+static void
+on_sound_iteration (FbdAsyncData *data)
+{
+  if (data->suspended)
+    return;
+
+  /* Don't start another iteration past the event's deadline */
+  if (data->deadline && g_get_monotonic_time () >= data->deadline) {
+    g_cancellable_cancel (data->cancel);
+    return;
+  }
+
+  if (data->iteration_callback)
+    (*data->iteration_callback)(data->feedback);
+}
+
+
+static void
+start_playback (FbdAsyncData *data)
+{
+  const char *effect = fbd_feedback_sound_get_effect (data->feedback);
+
+  if (data->repeat) {
+    fbd_sound_backend_play_repeat (data->dev->backend,
+                                   effect,
+                                   (FbdSoundBackendIterationFunc) on_sound_iteration,
+                                   data->cancel,
+                                   (GAsyncReadyCallback) on_sound_repeat_finished_callback,
+                                   data);
+  } else {
+    fbd_sound_backend_play (data->dev->backend,
+                            effect,
+                            FALSE,
+                            data->cancel,
+                            (GAsyncReadyCallback) on_sound_play_finished_callback,
+                            data);
+  }
+}
+
+
+static gboolean
+is_voice (FbdAsyncData *data)
 {
+  return data->leader == NULL && !data->stolen && !data->completing;
+}
+
+static guint
+count_voices (FbdDevSound *self)
+{
+  GHashTableIter iter;
   FbdAsyncData *data;
+  guint n = 0;
+
+  g_hash_table_iter_init (&iter, self->playbacks);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&data)) {
+    if (is_voice (data))
+      n++;
+  }
+
+  return n;
+}
+
+/* A running one shot playback of @effect new playbacks can join */
+static FbdAsyncData *
+find_voice (FbdDevSound *self, const char *effect)
+{
+  GHashTableIter iter;
+  FbdAsyncData *data;
+
+  g_hash_table_iter_init (&iter, self->playbacks);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&data)) {
+    if (!is_voice (data) || data->repeat || g_cancellable_is_cancelled (data->cancel))
+      continue;
+
+    if (g_strcmp0 (fbd_feedback_sound_get_effect (data->feedback), effect) == 0)
+      return data;
+  }
+
+  return NULL;
+}
+
+/* The lowest priority, oldest voice */
+static FbdAsyncData *
+find_victim (FbdDevSound *self)
+{
+  GHashTableIter iter;
+  FbdAsyncData *data, *victim = NULL;
+
+  g_hash_table_iter_init (&iter, self->playbacks);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&data)) {
+    if (!is_voice (data))
+      continue;
+
+    if (victim == NULL || data->priority < victim->priority ||
+        (data->priority == victim->priority && data->start < victim->start))
+      victim = data;
+  }
+
+  return victim;
+}
+
+static gboolean
+play (FbdDevSound               *self,
+      FbdFeedbackSound          *feedback,
+      gboolean                   repeat,
+      gint64                     deadline,
+      FbdDevSoundPlayedCallback  iteration_callback,
+      FbdDevSoundPlayedCallback  callback)
+{
+  FbdAsyncData *data, *leader = NULL, *victim = NULL;
+  const char *effect = fbd_feedback_sound_get_effect (feedback);
 
   g_return_val_if_fail (FBD_IS_DEV_SOUND (self), FALSE);
-  g_return_val_if_fail (GSOUND_IS_CONTEXT (self->ctx), FALSE);
+  g_return_val_if_fail (FBD_IS_SOUND_BACKEND (self->backend), FALSE);
 
   data = fbd_async_data_new (self, feedback, callback);
+  data->repeat = repeat;
+  data->deadline = deadline;
+  data->iteration_callback = iteration_callback;
+  data->priority = fbd_feedback_get_priority (FBD_FEEDBACK_BASE (feedback));
+  data->start = g_get_monotonic_time ();
+
+  if (!repeat)
+    leader = find_voice (self, effect);
 
   if (!g_hash_table_insert (self->playbacks, feedback, data))
     g_warning ("Feedback %p already present", feedback);
 
-  gsound_context_play_full (self->ctx, data->cancel,
-                            (GAsyncReadyCallback) on_sound_play_finished_callback,
-                            data,
-                            GSOUND_ATTR_EVENT_ID, fbd_feedback_sound_get_effect (feedback),
-                            GSOUND_ATTR_EVENT_DESCRIPTION, "Feedbackd sound feedback",
-                            GSOUND_ATTR_MEDIA_ROLE, "event",
-                            NULL);
+  if (leader) {
+    g_debug ("Coalescing sound '%s'", effect);
+    data->leader = leader;
+    leader->followers = g_slist_prepend (leader->followers, data);
+    self->counters.coalesced++;
+    return TRUE;
+  }
+
+  if (self->max_voices && count_voices (self) >= self->max_voices) {
+    victim = find_victim (self);
+
+    if (victim == NULL || victim->priority > data->priority) {
+      g_debug ("All voices busy, dropping sound '%s'", effect);
+      self->counters.dropped++;
+      complete_later (data);
+      return FALSE;
+    }
+
+    g_debug ("Stealing voice of '%s' for '%s'",
+             fbd_feedback_sound_get_effect (victim->feedback), effect);
+    victim->stolen = TRUE;
+    g_cancellable_cancel (victim->cancel);
+    self->counters.stolen++;
+  }
+
+  start_playback (data);
+  self->counters.started++;
+  self->counters.peak = MAX (self->counters.peak, count_voices (self));
+
   return TRUE;
 }
 
+
+gboolean
+fbd_dev_sound_play (FbdDevSound *self, FbdFeedbackSound *feedback, FbdDevSoundPlayedCallback callback)
+{
+  return play (self, feedback, FALSE, 0, NULL, callback);
+}
+
+/**
+ * fbd_dev_sound_play_repeat:
+ * @self: The sound device
+ * @feedback: The feedback to play
+ * @deadline: Monotonic time in µs after which no new iteration starts or `0`
+ * @iteration_callback: (nullable): Invoked each time an iteration finished
+ * @callback: Invoked once playback stopped
+ *
+ * Plays @feedback's sound again each time it finished until it's
+ * stopped via fbd_dev_sound_stop(), @deadline passed or playback fails. See
+ * fbd_sound_backend_play_repeat() for how iterations are started.
+ * Stopping the feedback from @iteration_callback keeps the next
+ * iteration from starting.
+ *
+ * Returns: %TRUE if playback was started
+ */
+gboolean
+fbd_dev_sound_play_repeat (FbdDevSound               *self,
+                           FbdFeedbackSound          *feedback,
+                           gint64                     deadline,
+                           FbdDevSoundPlayedCallback  iteration_callback,
+                           FbdDevSoundPlayedCallback  callback)
+{
+  return play (self, feedback, TRUE, deadline, iteration_callback, callback);
+}
+
 gboolean
 fbd_dev_sound_stop (FbdDevSound *self, FbdFeedbackSound *feedback)
 {
@@ -231,7 +574,174 @@ fbd_dev_sound_stop (FbdDevSound *self, FbdFeedbackSound *feedback)
   if (data == NULL)
     return FALSE;
 
+  if (data->leader) {
+    detach_follower (data);
+    complete_later (data);
+  }
+
   g_cancellable_cancel (data->cancel);
 
   return TRUE;
 }
+
+/**
+ * fbd_dev_sound_suspend:
+ * @self: The sound device
+ * @feedback: The feedback to suspend
+ *
+ * Like fbd_dev_sound_stop() but the played callback isn't invoked so the
+ * feedback can be played again later on.
+ *
+ * Returns: %TRUE if a playback was suspended.
+ */
+gboolean
+fbd_dev_sound_suspend (FbdDevSound *self, FbdFeedbackSound *feedback)
+{
+  FbdAsyncData *data;
+
+  g_return_val_if_fail (FBD_IS_DEV_SOUND (self), FALSE);
+
+  data = g_hash_table_lookup (self->playbacks, feedback);
+
+  if (data == NULL)
+    return FALSE;
+
+  data->suspended = TRUE;
+  g_hash_table_remove (self->playbacks, feedback);
+
+  if (data->leader) {
+    detach_follower (data);
+    fbd_async_data_dispose (data);
+    return TRUE;
+  }
+
+  g_cancellable_cancel (data->cancel);
+
+  return TRUE;
+}
+
+/**
+ * fbd_dev_sound_get_counters:
+ * @self: The sound device
+ *
+ * Gets the counters of the voice management.
+ *
+ * Returns: (transfer none): The counters
+ */
+const FbdDevSoundCounters *
+fbd_dev_sound_get_counters (FbdDevSound *self)
+{
+  g_return_val_if_fail (FBD_IS_DEV_SOUND (self), NULL);
+
+  return &self->counters;
+}
+
+
+static gboolean on_preload_idle (FbdDevSound *self);
+
+static void
+schedule_preload (FbdDevSound *self)
+{
+  if (self->preload_id)
+    return;
+
+  self->preload_id = g_idle_add_full (G_PRIORITY_LOW,
+                                      (GSourceFunc)on_preload_idle,
+                                      self,
+                                      NULL);
+  g_source_set_name_by_id (self->preload_id, "sound preload source");
+}
+
+
+static void
+on_preload_finished (FbdSoundBackend *backend, GAsyncResult *res, FbdDevSound *self)
+{
+  g_autoptr (GError) err = NULL;
+
+  if (!fbd_sound_backend_preload_finish (backend, res, &err)) {
+    if (g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      /* Replaced by a newer preload or disposed */
+      g_object_unref (self);
+      return;
+    }
+    g_debug ("Failed to cache sound: %s", err->message);
+  } else {
+    self->preload_count++;
+  }
+
+  self->preload_pending--;
+  if (!g_queue_is_empty (self->preload)) {
+    schedule_preload (self);
+  } else if (self->preload_pending == 0) {
+    g_debug ("Preloaded %u sounds in %" G_GINT64_FORMAT " ms",
+             self->preload_count,
+             (g_get_monotonic_time () - self->preload_start) / 1000);
+  }
+
+  g_object_unref (self);
+}
+
+
+static gboolean
+on_preload_idle (FbdDevSound *self)
+{
+  for (int i = 0; i < PRELOAD_CHUNK_SIZE; i++) {
+    g_autofree char *effect = NULL;
+
+    /* Resumed once a pending one finished */
+    if (self->preload_pending >= PRELOAD_MAX_PENDING)
+      break;
+
+    effect = g_queue_pop_head (self->preload);
+    if (effect == NULL)
+      break;
+
+    self->preload_pending++;
+    fbd_sound_backend_preload (self->backend,
+                               effect,
+                               self->preload_cancel,
+                               (GAsyncReadyCallback)on_preload_finished,
+                               g_object_ref (self));
+  }
+
+  if (g_queue_is_empty (self->preload) || self->preload_pending >= PRELOAD_MAX_PENDING) {
+    self->preload_id = 0;
+    return G_SOURCE_REMOVE;
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+/**
+ * fbd_dev_sound_preload:
+ * @self: The sound device
+ * @effects: The sound effects to cache
+ *
+ * Asks the sound server to cache the given sound effects. The backend
+ * caches them asynchronously, only a few at a time so playback isn't
+ * slowed down. Any preload still in progress is replaced.
+ */
+void
+fbd_dev_sound_preload (FbdDevSound *self, const char * const *effects)
+{
+  g_return_if_fail (FBD_IS_DEV_SOUND (self));
+
+  g_clear_handle_id (&self->preload_id, g_source_remove);
+  g_cancellable_cancel (self->preload_cancel);
+  g_clear_object (&self->preload_cancel);
+  self->preload_pending = 0;
+  if (self->preload)
+    g_queue_free_full (self->preload, g_free);
+  self->preload = g_queue_new ();
+
+  for (int i = 0; effects && effects[i]; i++)
+    g_queue_push_tail (self->preload, g_strdup (effects[i]));
+
+  if (g_queue_is_empty (self->preload))
+    return;
+
+  self->preload_cancel = g_cancellable_new ();
+  self->preload_start = g_get_monotonic_time ();
+  self->preload_count = 0;
+  schedule_preload (self);
+}
@@ -17,10 +17,36 @@ G_DECLARE_FINAL_TYPE (FbdDevSound, fbd_dev_sound, FBD, DEV_SOUND, GObject);
 
 typedef void (*FbdDevSoundPlayedCallback)(FbdFeedbackSound *feedback);
 
+/**
+ * FbdDevSoundCounters:
+ * @started: Number of sounds started
+ * @coalesced: Number of playbacks that joined an identical running sound
+ * @stolen: Number of sounds stopped to make room for another one
+ * @dropped: Number of sounds not played as all voices were busy
+ * @peak: The highest number of concurrent voices
+ *
+ * Counters of the sound device's voice management.
+ */
+typedef struct _FbdDevSoundCounters {
+  guint started;
+  guint coalesced;
+  guint stolen;
+  guint dropped;
+  guint peak;
+} FbdDevSoundCounters;
+
 FbdDevSound *fbd_dev_sound_new (GError **error);
 gboolean     fbd_dev_sound_play (FbdDevSound *self,
                                  FbdFeedbackSound *feedback,
                                  FbdDevSoundPlayedCallback callback);
+gboolean     fbd_dev_sound_play_repeat (FbdDevSound *self,
+                                        FbdFeedbackSound *feedback,
+                                        gint64 deadline,
+                                        FbdDevSoundPlayedCallback iteration_callback,
+                                        FbdDevSoundPlayedCallback callback);
 gboolean     fbd_dev_sound_stop (FbdDevSound *self, FbdFeedbackSound *feedback);
+gboolean     fbd_dev_sound_suspend (FbdDevSound *self, FbdFeedbackSound *feedback);
+void         fbd_dev_sound_preload (FbdDevSound *self, const char * const *effects);
+const FbdDevSoundCounters *fbd_dev_sound_get_counters (FbdDevSound *self);
 
 G_END_DECLS
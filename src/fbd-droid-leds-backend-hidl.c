@@ -87,23 +87,21 @@ fbd_droid_leds_backend_hidl_is_supported (FbdDroidLedsBackend *backend)
 
 static gboolean
 fbd_droid_leds_backend_hidl_start_periodic (FbdDroidLedsBackend *backend,
-                                            FbdFeedbackLedColor color,
-                                            guint               max_brightness,
-                                            guint               freq)
+                                            guint32              argb,
+                                            guint                freq)
 {
   FbdDroidLedsBackendHidl *self = FBD_DROID_LEDS_BACKEND_HIDL (backend);
   GBinderLocalRequest *req = gbinder_client_new_request (self->client);
   GBinderRemoteReply *reply;
   GBinderWriter writer;
   LightState* notification_state;
-  int32_t status, argb_color, t;
+  int32_t status, t;
 
-  argb_color = fbd_droid_leds_backend_get_argb_color (color, max_brightness);
   t = 1000 * 1000 / freq / 2;
 
   gbinder_local_request_init_writer (req, &writer);
   notification_state = gbinder_writer_new0 (&writer, LightState);
-  notification_state->color = argb_color;
+  notification_state->color = argb;
   notification_state->flashMode = FLASH_TYPE_TIMED;
   notification_state->flashOnMs = t;
   notification_state->flashOffMs = t;
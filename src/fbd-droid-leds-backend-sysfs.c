@@ -9,6 +9,7 @@
 #include <glib.h>
 #include <glib-object.h>
 #include <gio/gio.h>
+#include <gudev/gudev.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
@@ -16,15 +17,53 @@
 
 #include "fbd-droid-leds-backend.h"
 #include "fbd-droid-leds-backend-sysfs.h"
+#include "fbd-udev.h"
 
-#define LED_PATH "/sys/class/leds/"
+#define LED_SUBSYSTEM "leds"
 #define BRIGHTNESS_FILE "brightness"
+#define MAX_BRIGHTNESS_FILE "max_brightness"
+#define MULTI_INDEX_FILE "multi_index"
+#define MULTI_INTENSITY_FILE "multi_intensity"
+#define TRIGGER_FILE "trigger"
 #define BLINK_FILE "blink"
+#define DELAY_ON_FILE "delay_on"
+#define DELAY_OFF_FILE "delay_off"
+
+typedef enum {
+  LED_CHANNEL_RED,
+  LED_CHANNEL_GREEN,
+  LED_CHANNEL_BLUE,
+  LED_CHANNEL_LAST,
+} LedChannel;
+
+static const char * const channel_names[] = { "red", "green", "blue" };
+
+/*
+ * A LED driving one color channel or, for multicolor LEDs, several
+ * of them. The attributes written on each change are kept open. The
+ * timer trigger's delay_on and delay_off only exist while it's active
+ * so these are opened when switching to it.
+ */
+typedef struct {
+  GUdevDevice *dev;
+  guint        max_brightness;
+  LedChannel   channel;
+  /* For multicolor LEDs the channel at each multi_intensity position */
+  int         *multi_channels;
+  guint        n_multi_channels;
+
+  int          brightness_fd;
+  int          trigger_fd;
+  int          blink_fd;
+  int          multi_intensity_fd;
+  /* The timer trigger's current delay, 0 if not blinking via the trigger */
+  guint        delay;
+} LedData;
 
 struct _FbdDroidLedsBackendSysfs
 {
-  GObject parent_instance;
-  gchar *led_paths[3];
+  GObject    parent_instance;
+  GPtrArray *leds;
 };
 
 static void initable_interface_init (GInitableIface *iface);
@@ -35,54 +74,153 @@ G_DEFINE_TYPE_WITH_CODE (FbdDroidLedsBackendSysfs, fbd_droid_leds_backend_sysfs,
                          G_IMPLEMENT_INTERFACE (FBD_TYPE_DROID_LEDS_BACKEND,
                                                 fbd_droid_leds_backend_interface_init))
 
+static LedData *
+led_data_new (GUdevDevice *dev, guint max_brightness)
+{
+  LedData *led = g_new0 (LedData, 1);
+
+  led->dev = g_object_ref (dev);
+  led->max_brightness = max_brightness;
+  led->brightness_fd = -1;
+  led->trigger_fd = -1;
+  led->blink_fd = -1;
+  led->multi_intensity_fd = -1;
+
+  return led;
+}
+
+static void
+led_data_free (LedData *led)
+{
+  int fds[] = { led->brightness_fd, led->trigger_fd, led->blink_fd, led->multi_intensity_fd };
+
+  for (guint i = 0; i < G_N_ELEMENTS (fds); i++) {
+    if (fds[i] >= 0)
+      close (fds[i]);
+  }
+
+  g_clear_object (&led->dev);
+  g_free (led->multi_channels);
+  g_free (led);
+}
+
+static int
+open_attr (LedData *led, const char *attr)
+{
+  g_autofree gchar *path = NULL;
+  int fd;
+
+  if (!g_udev_device_has_sysfs_attr (led->dev, attr))
+    return -1;
+
+  path = g_build_filename (g_udev_device_get_sysfs_path (led->dev), attr, NULL);
+  fd = open (path, O_WRONLY | O_CLOEXEC);
+  if (fd == -1)
+    g_warning ("Failed to open %s: %s", path, strerror (errno));
+
+  return fd;
+}
+
 static gboolean
-set_led_brightness (const gchar *led_path, guint brightness) {
-  int fd, fd_blink;
-  ssize_t ret, ret_blink;
-  gboolean result = FALSE;
-  gchar *brightness_str, *blink_str;
-  gchar *brightness_path, *blink_path;
-
-  brightness_path = g_build_filename (led_path, BRIGHTNESS_FILE, NULL);
-  blink_path = g_build_filename (led_path, BLINK_FILE, NULL);
-
-  brightness_str = g_strdup_printf ("%d", brightness);
-  blink_str = g_strdup_printf ("%d", brightness > 0 ? 1 : 0);
-
-  fd = open (brightness_path, O_WRONLY);
-  if (fd == -1) {
-    g_warning ("Failed to open %s: %s", brightness_path, strerror (errno));
-  } else {
-    ret = write (fd, brightness_str, strlen (brightness_str));
-    if (ret == -1) {
-      g_warning ("Failed to write to %s: %s", brightness_path, strerror (errno));
-    } else {
-      result = TRUE;
-    }
+write_attr (int fd, const char *attr, const char *value)
+{
+  if (pwrite (fd, value, strlen (value), 0) == -1) {
+    g_warning ("Failed to write %s to %s: %s", value, attr, strerror (errno));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+write_attr_int (int fd, const char *attr, guint value)
+{
+  char buf[16];
+
+  g_snprintf (buf, sizeof (buf), "%u", value);
+  return write_attr (fd, attr, buf);
+}
+
+/* The delays only exist with the timer trigger so open them each time */
+static gboolean
+write_delay (LedData *led, const char *attr, guint delay)
+{
+  g_autoptr (GError) err = NULL;
 
-    close (fd);
+  if (!fbd_udev_set_sysfs_path_attr_as_int (led->dev, attr, delay, &err)) {
+    g_warning ("Failed to set %s: %s", attr, err->message);
+    return FALSE;
   }
 
+  return TRUE;
+}
+
+static gboolean
+set_led (LedData *led, guint brightness, guint delay)
+{
+  /* Turning the LED off also removes the trigger */
+  if (brightness == 0) {
+    led->delay = 0;
+    return write_attr_int (led->brightness_fd, BRIGHTNESS_FILE, 0);
+  }
 
-  fd_blink = open (blink_path, O_WRONLY);
-  if (fd_blink == -1) {
-    g_warning ("Failed to open %s: %s", blink_path, strerror (errno));
-  } else {
-    ret_blink = write (fd_blink, blink_str, strlen (blink_str));
-    if (ret_blink == -1) {
-      g_warning ("Failed to write to %s: %s", blink_path, strerror (errno));
-    } else {
-      result = TRUE;
+  if (delay && led->trigger_fd >= 0) {
+    if (led->delay != delay) {
+      if (led->delay == 0 && !write_attr (led->trigger_fd, TRIGGER_FILE, "timer"))
+        return FALSE;
+      led->delay = delay;
+      if (!write_delay (led, DELAY_ON_FILE, delay) || !write_delay (led, DELAY_OFF_FILE, delay))
+        return FALSE;
     }
-    close (fd_blink);
+    /* While blinking this sets the brightness of the on phase */
+    return write_attr_int (led->brightness_fd, BRIGHTNESS_FILE, brightness);
   }
 
-  g_free (brightness_path);
-  g_free (brightness_str);
-  g_free (blink_path);
-  g_free (blink_str);
+  if (led->delay) {
+    led->delay = 0;
+    if (!write_attr (led->trigger_fd, TRIGGER_FILE, "none"))
+      return FALSE;
+  }
+
+  if (!write_attr_int (led->brightness_fd, BRIGHTNESS_FILE, brightness))
+    return FALSE;
+
+  if (delay && led->blink_fd >= 0)
+    return write_attr_int (led->blink_fd, BLINK_FILE, 1);
 
-  return result;
+  return TRUE;
+}
+
+static guint
+scale_channel (LedData *led, guint32 argb, LedChannel channel)
+{
+  guint value = (argb >> (8 * (2 - channel))) & 0xff;
+
+  return value * led->max_brightness / 0xff;
+}
+
+static gboolean
+set_multicolor_led (LedData *led, guint32 argb, guint delay)
+{
+  g_autoptr (GString) intensity = g_string_new (NULL);
+  gboolean on = FALSE;
+
+  for (guint i = 0; i < led->n_multi_channels; i++) {
+    guint value = 0;
+
+    if (led->multi_channels[i] != -1)
+      value = scale_channel (led, argb, led->multi_channels[i]);
+    g_string_append_printf (intensity, "%s%u", i ? " " : "", value);
+    on = on || value;
+  }
+
+  if (!on)
+    return set_led (led, 0, 0);
+
+  if (!write_attr (led->multi_intensity_fd, MULTI_INTENSITY_FILE, intensity->str))
+    return FALSE;
+
+  return set_led (led, led->max_brightness, delay);
 }
 
 static gboolean
@@ -93,19 +231,30 @@ fbd_droid_leds_backend_sysfs_is_supported (FbdDroidLedsBackend *backend)
 
 static gboolean
 fbd_droid_leds_backend_sysfs_start_periodic (FbdDroidLedsBackend *backend,
-                                            FbdFeedbackLedColor color,
-                                            guint               max_brightness,
-                                            guint               freq)
+                                            guint32              argb,
+                                            guint                freq)
 {
   FbdDroidLedsBackendSysfs *self = FBD_DROID_LEDS_BACKEND_SYSFS (backend);
+  gboolean success = TRUE;
+  guint delay = 0;
+
   g_return_val_if_fail (FBD_IS_DROID_LEDS_BACKEND_SYSFS (self), FALSE);
 
-  gboolean success = TRUE;
+  /*  ms     mHz           T/2 */
+  if (freq)
+    delay = 1000 * 1000 / freq / 2;
 
-  for (int i = 0; i < 3; ++i) {
-    if (!set_led_brightness (self->led_paths[i], 1)) {
-        success = FALSE;
-    }
+  for (guint i = 0; i < self->leds->len; i++) {
+    LedData *led = g_ptr_array_index (self->leds, i);
+    gboolean ret;
+
+    if (led->multi_channels)
+      ret = set_multicolor_led (led, argb, delay);
+    else
+      ret = set_led (led, scale_channel (led, argb, led->channel), delay);
+
+    if (!ret)
+      success = FALSE;
   }
 
   return success;
@@ -116,17 +265,82 @@ fbd_droid_leds_backend_sysfs_stop (FbdDroidLedsBackend *backend,
                                   FbdFeedbackLedColor  color)
 {
   FbdDroidLedsBackendSysfs *self = FBD_DROID_LEDS_BACKEND_SYSFS (backend);
+  gboolean success = TRUE;
+
   g_return_val_if_fail (FBD_IS_DROID_LEDS_BACKEND_SYSFS (self), FALSE);
 
-  gboolean success = TRUE;
+  for (guint i = 0; i < self->leds->len; i++) {
+    if (!set_led (g_ptr_array_index (self->leds, i), 0, 0))
+      success = FALSE;
+  }
+
+  return success;
+}
+
+static int
+lookup_channel (const char *color)
+{
+  for (int i = 0; i < LED_CHANNEL_LAST; i++) {
+    if (g_strcmp0 (color, channel_names[i]) == 0)
+      return i;
+  }
+
+  return -1;
+}
 
-  for (int i = 0; i < 3; ++i) {
-    if (!set_led_brightness (self->led_paths[i], 0)) {
-        success = FALSE;
+/* Multicolor LEDs name their channels in multi_index */
+static LedData *
+probe_multicolor (GUdevDevice *dev, guint max_brightness, gboolean *channels)
+{
+  const char * const *index = g_udev_device_get_sysfs_attr_as_strv (dev, MULTI_INDEX_FILE);
+  LedData *led;
+  gboolean usable = FALSE;
+
+  if (index == NULL)
+    return NULL;
+
+  led = led_data_new (dev, max_brightness);
+  led->n_multi_channels = g_strv_length ((GStrv)index);
+  led->multi_channels = g_new (int, led->n_multi_channels);
+  for (guint i = 0; i < led->n_multi_channels; i++) {
+    int channel = lookup_channel (index[i]);
+
+    /* Each channel is driven by a single LED */
+    if (channel != -1 && channels[channel])
+      channel = -1;
+    if (channel != -1) {
+      channels[channel] = TRUE;
+      usable = TRUE;
     }
+    led->multi_channels[i] = channel;
   }
 
-  return success;
+  if (!usable) {
+    led_data_free (led);
+    return NULL;
+  }
+
+  return led;
+}
+
+/* Single color LEDs have the color in their name, e.g. `red:status` */
+static LedData *
+probe_single (GUdevDevice *dev, guint max_brightness, gboolean *channels)
+{
+  const char *name = g_udev_device_get_name (dev);
+  LedData *led;
+
+  for (int i = 0; i < LED_CHANNEL_LAST; i++) {
+    if (channels[i] || !g_strstr_len (name, -1, channel_names[i]))
+      continue;
+
+    led = led_data_new (dev, max_brightness);
+    led->channel = i;
+    channels[i] = TRUE;
+    return led;
+  }
+
+  return NULL;
 }
 
 static gboolean
@@ -134,6 +348,50 @@ initable_init (GInitable     *initable,
                GCancellable  *cancellable,
                GError       **error)
 {
+  FbdDroidLedsBackendSysfs *self = FBD_DROID_LEDS_BACKEND_SYSFS (initable);
+  const gchar * const subsystems[] = { LED_SUBSYSTEM, NULL };
+  g_autoptr (GUdevClient) client = g_udev_client_new (subsystems);
+  g_autolist (GUdevDevice) leds = NULL;
+  gboolean channels[LED_CHANNEL_LAST] = { FALSE };
+
+  leds = g_udev_client_query_by_subsystem (client, LED_SUBSYSTEM);
+
+  for (GList *l = leds; l != NULL; l = l->next) {
+    GUdevDevice *dev = G_UDEV_DEVICE (l->data);
+    guint max_brightness;
+    LedData *led;
+
+    max_brightness = g_udev_device_get_sysfs_attr_as_int (dev, MAX_BRIGHTNESS_FILE);
+    if (!max_brightness)
+      continue;
+
+    led = probe_multicolor (dev, max_brightness, channels);
+    if (led == NULL && !g_udev_device_has_sysfs_attr (dev, MULTI_INDEX_FILE))
+      led = probe_single (dev, max_brightness, channels);
+    if (led == NULL)
+      continue;
+
+    led->brightness_fd = open_attr (led, BRIGHTNESS_FILE);
+    if (led->multi_channels)
+      led->multi_intensity_fd = open_attr (led, MULTI_INTENSITY_FILE);
+    if (led->brightness_fd == -1 || (led->multi_channels && led->multi_intensity_fd == -1)) {
+      led_data_free (led);
+      continue;
+    }
+    led->trigger_fd = open_attr (led, TRIGGER_FILE);
+    led->blink_fd = open_attr (led, BLINK_FILE);
+
+    g_debug ("Using LED at %s", g_udev_device_get_sysfs_path (dev));
+    g_ptr_array_add (self->leds, led);
+  }
+
+  if (self->leds->len == 0) {
+    g_set_error (error,
+                 G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                 "No red, green or blue LED found");
+    return FALSE;
+  }
+
   return TRUE;
 }
 
@@ -142,9 +400,7 @@ fbd_droid_leds_backend_sysfs_finalize (GObject *object)
 {
   FbdDroidLedsBackendSysfs *self = FBD_DROID_LEDS_BACKEND_SYSFS (object);
 
-  for (int i = 0; i < 3; ++i) {
-    g_free (self->led_paths[i]);
-  }
+  g_ptr_array_unref (self->leds);
 
   G_OBJECT_CLASS (fbd_droid_leds_backend_sysfs_parent_class)->finalize (object);
 }
@@ -174,13 +430,15 @@ fbd_droid_leds_backend_interface_init (FbdDroidLedsBackendInterface *iface)
 static void
 fbd_droid_leds_backend_sysfs_init (FbdDroidLedsBackendSysfs *self)
 {
-  self->led_paths[0] = g_strdup (LED_PATH "blue");
-  self->led_paths[1] = g_strdup (LED_PATH "green");
-  self->led_paths[2] = g_strdup (LED_PATH "red");
+  self->leds = g_ptr_array_new_with_free_func ((GDestroyNotify)led_data_free);
 }
 
 FbdDroidLedsBackendSysfs *
 fbd_droid_leds_backend_sysfs_new (GError **error)
 {
-  return g_object_new (FBD_TYPE_DROID_LEDS_BACKEND_SYSFS, NULL);
+  return FBD_DROID_LEDS_BACKEND_SYSFS (
+    g_initable_new (FBD_TYPE_DROID_LEDS_BACKEND_SYSFS,
+                    NULL,
+                    error,
+                    NULL));
 }
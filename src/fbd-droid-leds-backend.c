@@ -18,34 +18,6 @@ fbd_droid_leds_backend_default_init (FbdDroidLedsBackendInterface *iface)
     /* Nothing yet */
 }
 
-int32_t
-fbd_droid_leds_backend_get_argb_color (FbdFeedbackLedColor color,
-                                       guint               max_brightness)
-{
-  int32_t alpha, max, argb_color;
-
-  max = (max_brightness / 100.0) * 0xff;
-  alpha = 0xff; // Full Alpha
-
-  argb_color = (alpha & 0xff) << 24;
-  switch (color) {
-      case FBD_FEEDBACK_LED_COLOR_WHITE:
-          argb_color += ((max & 0xff) << 16) + ((max & 0xff) << 8) + (max & 0xff);
-          break;
-      case FBD_FEEDBACK_LED_COLOR_RED:
-          argb_color += (max & 0xff) << 16;
-          break;
-      case FBD_FEEDBACK_LED_COLOR_GREEN:
-          argb_color += (max & 0xff) << 8;
-          break;
-      case FBD_FEEDBACK_LED_COLOR_BLUE:
-          argb_color += max & 0xff;
-          break;
-  }
-
-  return argb_color;
-}
-
 gboolean
 fbd_droid_leds_backend_is_supported (FbdDroidLedsBackend *self)
 {
@@ -60,9 +32,8 @@ fbd_droid_leds_backend_is_supported (FbdDroidLedsBackend *self)
 
 gboolean
 fbd_droid_leds_backend_start_periodic (FbdDroidLedsBackend *self,
-                                       FbdFeedbackLedColor color,
-                                       guint               max_brightness,
-                                       guint               freq)
+                                       guint32              argb,
+                                       guint                freq)
 {
   FbdDroidLedsBackendInterface *iface;
   
@@ -70,7 +41,7 @@ fbd_droid_leds_backend_start_periodic (FbdDroidLedsBackend *self,
   
   iface = FBD_DROID_LEDS_BACKEND_GET_IFACE (self);
   g_return_val_if_fail (iface->start_periodic != NULL, FALSE);
-  return iface->start_periodic (self, color, max_brightness, freq);
+  return iface->start_periodic (self, argb, freq);
 }
 
 gboolean
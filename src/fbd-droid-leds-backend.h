@@ -61,20 +61,16 @@ struct _FbdDroidLedsBackendInterface
 
   gboolean (*is_supported) (FbdDroidLedsBackend *self);
   gboolean (*start_periodic) (FbdDroidLedsBackend *self,
-                              FbdFeedbackLedColor color,
-                              guint               max_brightness,
-                              guint               freq);
+                              guint32              argb,
+                              guint                freq);
   gboolean (*stop) (FbdDroidLedsBackend *self,
                     FbdFeedbackLedColor color);
 };
 
-int32_t fbd_droid_leds_backend_get_argb_color (FbdFeedbackLedColor color,
-                                               guint               max_brightness);
 gboolean fbd_droid_leds_backend_is_supported (FbdDroidLedsBackend *self);
 gboolean fbd_droid_leds_backend_start_periodic (FbdDroidLedsBackend *self,
-                                                FbdFeedbackLedColor color,
-                                                guint               max_brightness,
-                                                guint               freq);
+                                                guint32              argb,
+                                                guint                freq);
 gboolean fbd_droid_leds_backend_stop (FbdDroidLedsBackend  *self,
                                       FbdFeedbackLedColor color);
 
@@ -35,6 +35,8 @@ typedef struct _FbdDevLeds {
     GObject      parent;
 
     FbdDroidLedsBackend *backend;
+    /* Active feedbacks, most recent first */
+    GList               *feedbacks;
 } FbdDevLeds;
 
 static void initable_iface_init (GInitableIface *iface);
@@ -56,9 +58,7 @@ initable_init (GInitable     *initable,
     if (g_file_test ("/usr/lib/droidian/device/leds-sysfs", G_FILE_TEST_EXISTS)) {
         self->backend = (FbdDroidLedsBackend *) fbd_droid_leds_backend_sysfs_new (error);
         if (!self->backend) {
-            g_set_error (error,
-                         G_IO_ERROR, G_IO_ERROR_FAILED,
-                         "Failed to initialize leds backend using sysfs");
+            g_prefix_error (error, "Failed to initialize leds backend using sysfs: ");
             return FALSE;
         }
 
@@ -110,6 +110,7 @@ fbd_dev_leds_dispose (GObject *object)
     g_debug("Disposing droid leds");
 
     g_clear_object (&self->backend);
+    g_list_free_full (g_steal_pointer (&self->feedbacks), g_object_unref);
 
     G_OBJECT_CLASS (fbd_dev_leds_parent_class)->dispose (object);
 }
@@ -138,30 +139,97 @@ fbd_dev_leds_new (GError **error)
                                           NULL));
 }
 
+static gboolean
+start_periodic (FbdDevLeds *self, FbdFeedbackLed *feedback)
+{
+    return fbd_droid_leds_backend_start_periodic (self->backend,
+                                                  fbd_feedback_led_get_argb (feedback),
+                                                  fbd_feedback_led_get_frequency (feedback));
+}
+
 /**
  * fbd_dev_leds_start_periodic:
  * @self: The #FbdDevLeds
- * @color: The color to use for the LED pattern
- * @max_brightness: The max brightness (in percent) to use for the pattern
- * @freq: The pattern's frequency in mHz
+ * @feedback: The LED feedback to show
  *
- * Start periodic feedback.
+ * Start periodic feedback. The light HAL can only show a single
+ * pattern so the most recent feedback wins.
  */
 gboolean
-fbd_dev_leds_start_periodic (FbdDevLeds *self, FbdFeedbackLedColor color,
-                             guint max_brightness, guint freq)
+fbd_dev_leds_start_periodic (FbdDevLeds *self, FbdFeedbackLed *feedback)
 {
+    GList *l;
+
     g_debug ("droid LED start flashing");
 
-    return fbd_droid_leds_backend_start_periodic (self->backend, color,
-      max_brightness, freq);
+    l = g_list_find (self->feedbacks, feedback);
+    if (l) {
+        self->feedbacks = g_list_delete_link (self->feedbacks, l);
+        g_object_unref (feedback);
+    }
+    self->feedbacks = g_list_prepend (self->feedbacks, g_object_ref (feedback));
+
+    return start_periodic (self, feedback);
 }
 
+/**
+ * fbd_dev_leds_stop:
+ * @self: The #FbdDevLeds
+ * @feedback: The LED feedback to stop
+ *
+ * Stop periodic feedback. If other feedbacks are still active the most
+ * recent one is shown again.
+ */
 gboolean
-fbd_dev_leds_stop (FbdDevLeds *self, FbdFeedbackLedColor color)
+fbd_dev_leds_stop (FbdDevLeds *self, FbdFeedbackLed *feedback)
 {
+    FbdFeedbackLedColor color = fbd_feedback_led_get_color (feedback);
+    GList *l;
+
     g_debug ("droid LED stop flashing");
 
+    l = g_list_find (self->feedbacks, feedback);
+    if (l == NULL)
+        return TRUE;
+
+    self->feedbacks = g_list_delete_link (self->feedbacks, l);
+    g_object_unref (feedback);
+
+    if (self->feedbacks)
+        return start_periodic (self, self->feedbacks->data);
+
     return fbd_droid_leds_backend_stop (self->backend, color);
 }
 
+/**
+ * fbd_dev_leds_prepare:
+ * @self: The #FbdDevLeds
+ * @feedback: The LED feedback that is about to be started
+ *
+ * The light HAL and the sysfs backend only take a color and a
+ * frequency so there's nothing that could be formatted upfront. All
+ * the work happens in fbd_dev_leds_start_periodic().
+ */
+void
+fbd_dev_leds_prepare (FbdDevLeds *self, FbdFeedbackLed *feedback)
+{
+    g_return_if_fail (FBD_IS_DEV_LEDS (self));
+    g_return_if_fail (FBD_IS_FEEDBACK_LED (feedback));
+}
+
+/**
+ * fbd_dev_leds_has_leds:
+ * @self: The #FbdDevLeds
+ *
+ * The backends fail to initialize without a usable light so there's
+ * always one.
+ *
+ * Returns: %TRUE
+ */
+gboolean
+fbd_dev_leds_has_leds (FbdDevLeds *self)
+{
+    g_return_val_if_fail (FBD_IS_DEV_LEDS (self), FALSE);
+
+    return TRUE;
+}
@@ -10,6 +10,10 @@
 #include "fbd.h"
 #include "fbd-enums.h"
 #include "fbd-event.h"
+#include "fbd-feedback-manager.h"
+
+/* Feedbacks ending up to this fraction of the period late restart right away */
+#define LOOP_SLOT_TOLERANCE_DIV 4
 
 enum {
   SIGNAL_FEEDBACKS_ENDED,
@@ -25,7 +29,10 @@ enum {
   PROP_END_REASON,
   PROP_FEEDBACKS_ENDED,
   PROP_TIMEOUT,
+  PROP_TIMEOUT_MS,
   PROP_SENDER,
+  PROP_PRIORITY,
+  PROP_LEVEL,
   PROP_LAST_PROP,
 };
 static GParamSpec *props[PROP_LAST_PROP];
@@ -35,10 +42,17 @@ typedef struct _FbdEvent {
 
   guint id;
   char *app_id;
+  /* The app id as used for the app's settings path and theme overlay */
+  char *munged_app_id;
   char *event;
   char *sender;
+  guint priority;
+  FbdFeedbackProfileLevel level;
 
   int  timeout;
+  /* The timeout given on construction, used again when timeout_ms is cleared */
+  int  requested_timeout;
+  guint timeout_ms;
   gboolean expired;
   guint timeout_id;
 
@@ -46,23 +60,41 @@ typedef struct _FbdEvent {
   FbdEventEndReason end_reason;
 
   GSList *feedbacks;
+
+  /* Loop scheduling */
+  gint64 loop_start;
+  gint64 loop_period;
+  GSList *pending;
+  guint restart_id;
+
+  /* Feedbacks held back to line up with slower devices */
+  GSList *delayed;
+
+  /* Theme generation the feedbacks were looked up in */
+  guint generation;
+  gint64 deadline;
+  gboolean migrating;
+  guint next_generation;
+  GSList *next_feedbacks;
 } FbdEvent;
 
-G_DEFINE_TYPE (FbdEvent, fbd_event, G_TYPE_OBJECT);
+typedef struct _FbdDelayedRun {
+  FbdEvent        *event;
+  FbdFeedbackBase *feedback;
+  guint            timeout_id;
+} FbdDelayedRun;
 
-static gboolean
-on_timeout_expired (FbdEvent *self)
-{
-  g_return_val_if_fail (FBD_IS_EVENT (self), G_SOURCE_REMOVE);
+G_DEFINE_TYPE (FbdEvent, fbd_event, G_TYPE_OBJECT);
 
-  self->expired = TRUE;
-  self->timeout_id = 0;
-  return G_SOURCE_REMOVE;
-}
+static void on_fb_ended (FbdEvent *self, FbdFeedbackBase *fb);
+static void on_fb_iteration_ended (FbdEvent *self, FbdFeedbackBase *fb);
 
 static gboolean
 check_ended (FbdEvent *self)
 {
+  if (self->ended)
+    return TRUE;
+
   if (!fbd_event_get_feedbacks_ended (self))
     return FALSE;
 
@@ -72,26 +104,400 @@ check_ended (FbdEvent *self)
   return TRUE;
 }
 
+/*
+ * Whether all feedbacks the event restarts ended their current
+ * iteration. Feedbacks that loop by themselves (like looping sounds)
+ * keep running and don't take part in the loop grid.
+ */
+static gboolean
+iteration_ended (FbdEvent *self)
+{
+  /* Held back feedbacks still report the state of their last run */
+  if (self->delayed)
+    return FALSE;
+
+  for (GSList *l = self->feedbacks; l; l = l->next) {
+    FbdFeedbackBase *fb = FBD_FEEDBACK_BASE (l->data);
+
+    if (!fbd_feedback_get_ended (fb) && !fbd_feedback_get_loops_itself (fb))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Feedbacks are shared between events so claim the device for this one */
+static void
+run_feedback (FbdEvent *self, FbdFeedbackBase *fb)
+{
+  fbd_feedback_set_event_id (fb, self->id);
+  fbd_feedback_run (fb);
+}
+
+static void
+fbd_delayed_run_free (FbdDelayedRun *run)
+{
+  g_clear_handle_id (&run->timeout_id, g_source_remove);
+  g_free (run);
+}
+
+static gboolean
+on_delayed_run_timeout (FbdDelayedRun *run)
+{
+  FbdEvent *self = run->event;
+  FbdFeedbackBase *fb = run->feedback;
+
+  run->timeout_id = 0;
+  self->delayed = g_slist_remove (self->delayed, run);
+  fbd_delayed_run_free (run);
+
+  if (self->end_reason == FBD_EVENT_END_REASON_NATURAL)
+    run_feedback (self, fb);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+run_delayed (FbdEvent *self, FbdFeedbackBase *fb, guint delay)
+{
+  FbdDelayedRun *run = g_new0 (FbdDelayedRun, 1);
+
+  run->event = self;
+  run->feedback = fb;
+  run->timeout_id = g_timeout_add (delay, (GSourceFunc)on_delayed_run_timeout, run);
+  g_source_set_name_by_id (run->timeout_id, "event delayed run source");
+
+  self->delayed = g_slist_prepend (self->delayed, run);
+}
+
+/* Drop the delayed run of @fb or all of them if %NULL */
+static void
+remove_delayed (FbdEvent *self, FbdFeedbackBase *fb)
+{
+  GSList *delayed = g_steal_pointer (&self->delayed);
+
+  for (GSList *l = delayed; l; l = l->next) {
+    FbdDelayedRun *run = l->data;
+
+    if (fb && run->feedback != fb)
+      self->delayed = g_slist_prepend (self->delayed, run);
+    else
+      fbd_delayed_run_free (run);
+  }
+  g_slist_free (delayed);
+}
+
+/* Feedbacks that didn't start yet end right away */
+static void
+end_delayed (FbdEvent *self)
+{
+  GSList *delayed = g_steal_pointer (&self->delayed);
+
+  for (GSList *l = delayed; l; l = l->next) {
+    FbdDelayedRun *run = l->data;
+    FbdFeedbackBase *fb = run->feedback;
+
+    fbd_delayed_run_free (run);
+    fbd_feedback_base_done (fb);
+  }
+  g_slist_free (delayed);
+}
+
+/*
+ * Prepare all feedbacks first so the slow parts of one feedback don't
+ * delay the start of the others, then start them back to back. Only
+ * sysfs LEDs have something to prepare, droid LEDs, vibra and sound
+ * still do all their work when started.
+ * Feedbacks on devices with a lower output latency are held back so
+ * the user notices all of them at the same time.
+ */
+static void
+run_feedbacks (FbdEvent *self, GSList *feedbacks)
+{
+  gint64 first = G_MAXINT64, last = 0;
+  guint n = 0, max_latency = 0;
+
+  for (GSList *l = feedbacks; l; l = l->next) {
+    fbd_feedback_prepare (FBD_FEEDBACK_BASE (l->data));
+    max_latency = MAX (max_latency, fbd_feedback_get_latency (l->data));
+  }
+
+  /* Feedbacks ending synchronously can end the event */
+  g_object_ref (self);
+  for (GSList *l = feedbacks; l; l = l->next) {
+    FbdFeedbackBase *fb = FBD_FEEDBACK_BASE (l->data);
+    gint64 start;
+    guint delay;
+
+    if (self->end_reason != FBD_EVENT_END_REASON_NATURAL)
+      break;
+
+    delay = (max_latency - fbd_feedback_get_latency (fb)) / 1000;
+    if (delay) {
+      g_debug ("Delaying %s of event %d by %u ms", G_OBJECT_TYPE_NAME (fb), self->id, delay);
+      run_delayed (self, fb, delay);
+      continue;
+    }
+
+    run_feedback (self, fb);
+
+    start = fbd_feedback_get_start_time (fb);
+    if (!start)
+      continue;
+    first = MIN (first, start);
+    last = MAX (last, start);
+    n++;
+  }
+
+  if (n > 1) {
+    g_debug ("Started %u feedbacks of event %d within %" G_GINT64_FORMAT " µs",
+             n, self->id, last - first);
+  }
+  g_object_unref (self);
+}
+
+static void
+setup_feedback (FbdEvent *self, FbdFeedbackBase *fb)
+{
+  fbd_feedback_set_deadline (fb, self->deadline);
+  fbd_feedback_set_looping (fb, self->timeout != FBD_EVENT_TIMEOUT_ONESHOT);
+}
+
+/* The feedback in @feedbacks that has the same type and properties as @fb */
+static FbdFeedbackBase *
+find_equal_feedback (GSList *feedbacks, FbdFeedbackBase *fb)
+{
+  for (GSList *l = feedbacks; l; l = l->next) {
+    if (fbd_feedback_equal (l->data, fb))
+      return l->data;
+  }
+
+  return NULL;
+}
+
+/*
+ * Swap in the feedbacks of the new theme generation between two
+ * iterations. Feedbacks that didn't change keep their current object
+ * and keep running, old ones that loop by themselves are stopped.
+ */
+static void
+migrate_feedbacks (FbdEvent *self)
+{
+  GSList *old = g_steal_pointer (&self->feedbacks);
+  GSList *next = g_slist_reverse (g_steal_pointer (&self->next_feedbacks));
+  GSList *run = NULL;
+
+  self->migrating = FALSE;
+  g_clear_handle_id (&self->restart_id, g_source_remove);
+  g_clear_pointer (&self->pending, g_slist_free);
+  remove_delayed (self, NULL);
+
+  for (GSList *l = old; l; l = l->next) {
+    FbdFeedbackBase *fb = FBD_FEEDBACK_BASE (l->data);
+
+    if (find_equal_feedback (next, fb))
+      continue;
+
+    g_signal_handlers_disconnect_by_func (fb, on_fb_ended, self);
+    g_signal_handlers_disconnect_by_func (fb, on_fb_iteration_ended, self);
+    if (!fbd_feedback_get_ended (fb))
+      fbd_feedback_end (fb);
+    fbd_feedback_release (fb, self->id);
+  }
+
+  for (GSList *l = next; l; l = l->next) {
+    FbdFeedbackBase *fb = FBD_FEEDBACK_BASE (l->data);
+    FbdFeedbackBase *kept = find_equal_feedback (old, fb);
+
+    if (kept) {
+      if (g_slist_find (self->feedbacks, kept))
+        continue;
+      self->feedbacks = g_slist_prepend (self->feedbacks, g_object_ref (kept));
+      if (!fbd_feedback_get_ended (kept))
+        continue;
+      fb = kept;
+    } else {
+      fbd_event_add_feedback (self, fb);
+      setup_feedback (self, fb);
+    }
+    run = g_slist_prepend (run, fb);
+  }
+
+  g_debug ("Event %d migrated from theme generation %u to %u with %u feedbacks",
+           self->id, self->generation, self->next_generation, g_slist_length (self->feedbacks));
+  self->generation = self->next_generation;
+  g_slist_free_full (old, g_object_unref);
+  g_slist_free_full (next, g_object_unref);
+
+  if (self->feedbacks == NULL) {
+    check_ended (self);
+    return;
+  }
+
+  /* The new feedbacks can have a different length */
+  self->loop_start = g_get_monotonic_time ();
+  self->loop_period = 0;
+  run = g_slist_reverse (run);
+  run_feedbacks (self, run);
+  g_slist_free (run);
+}
+
+static void
+restart_pending (FbdEvent *self)
+{
+  GSList *pending;
+
+  if (self->migrating) {
+    /* Don't play old and new feedbacks at the same time */
+    if (iteration_ended (self))
+      migrate_feedbacks (self);
+    return;
+  }
+
+  pending = g_slist_reverse (self->pending);
+  self->pending = NULL;
+
+  /* Feedbacks ending synchronously reschedule themselves */
+  run_feedbacks (self, pending);
+  g_slist_free (pending);
+}
+
+static gboolean
+on_restart_timeout (FbdEvent *self)
+{
+  g_return_val_if_fail (FBD_IS_EVENT (self), G_SOURCE_REMOVE);
+
+  self->restart_id = 0;
+  restart_pending (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Looping feedbacks are restarted on a fixed grid anchored at the
+ * event's first start so that iterations don't accumulate signal and
+ * device latency and feedbacks of the same event stay in phase. The
+ * period is the length of the slowest feedback's first iteration.
+ * Feedbacks that loop by themselves aren't taken into account.
+ */
+static void
+schedule_restart (FbdEvent *self, FbdFeedbackBase *fb)
+{
+  gint64 now, elapsed, started, next;
+  guint delay;
+
+  if (!g_slist_find (self->pending, fb))
+    self->pending = g_slist_prepend (self->pending, fb);
+
+  now = g_get_monotonic_time ();
+  elapsed = now - self->loop_start;
+
+  if (!self->loop_period) {
+    /* Wait for the slowest feedback of the first iteration */
+    if (!iteration_ended (self))
+      return;
+
+    self->loop_period = MAX (elapsed, 1000);
+    g_debug ("Event %d loops with a period of %" G_GINT64_FORMAT " ms",
+             self->id, self->loop_period / 1000);
+    restart_pending (self);
+    return;
+  }
+
+  if (self->restart_id)
+    return;
+
+  /*
+   * The next slot is the one after the slot the iteration started in.
+   * As the period is the slowest feedback's measured length it can end
+   * a bit after that slot due to jitter. Restart right away then rather
+   * than skipping a whole period.
+   */
+  started = fbd_feedback_get_start_time (fb);
+  if (started >= self->loop_start) {
+    started -= self->loop_start;
+    next = self->loop_start + (started / self->loop_period + 1) * self->loop_period;
+  } else {
+    /* Not started in this loop, e.g. while suspended */
+    next = 0;
+  }
+
+  if (now - next > self->loop_period / LOOP_SLOT_TOLERANCE_DIV) {
+    /* Way late, go for the next slot that isn't in the past */
+    next = self->loop_start +
+      ((elapsed + self->loop_period - 1) / self->loop_period) * self->loop_period;
+  }
+  delay = next > now ? (next - now + 999) / 1000 : 0;
+
+  self->restart_id = g_timeout_add (delay, (GSourceFunc)on_restart_timeout, self);
+  g_source_set_name_by_id (self->restart_id, "event restart source");
+}
+
 static void
 on_fb_ended (FbdEvent *self, FbdFeedbackBase *fb)
 {
+  gboolean loop;
+
   switch (self->timeout) {
   case FBD_EVENT_TIMEOUT_ONESHOT:
-    check_ended (self);
+    loop = FALSE;
     break;
   case FBD_EVENT_TIMEOUT_LOOP:
-    if (self->end_reason != FBD_EVENT_END_REASON_NATURAL)
-      check_ended (self);
-    else
-      fbd_feedback_run (fb);
+    loop = self->end_reason == FBD_EVENT_END_REASON_NATURAL;
     break;
   default:
-    if (!self->expired && self->end_reason == FBD_EVENT_END_REASON_NATURAL)
-      fbd_feedback_run (fb);
-    else
-      check_ended (self);
+    loop = !self->expired && self->end_reason == FBD_EVENT_END_REASON_NATURAL;
     break;
   }
+
+  if (loop) {
+    schedule_restart (self, fb);
+  } else {
+    /* Let lower priority feedbacks use the device */
+    fbd_feedback_release (fb, self->id);
+    check_ended (self);
+  }
+}
+
+static void
+on_fb_iteration_ended (FbdEvent *self, FbdFeedbackBase *fb)
+{
+  /* Events with only self looping feedbacks have no other point to migrate */
+  if (self->migrating && self->end_reason == FBD_EVENT_END_REASON_NATURAL &&
+      iteration_ended (self))
+    migrate_feedbacks (self);
+}
+
+static gboolean
+on_timeout_expired (FbdEvent *self)
+{
+  g_return_val_if_fail (FBD_IS_EVENT (self), G_SOURCE_REMOVE);
+
+  self->expired = TRUE;
+  self->timeout_id = 0;
+
+  if (self->end_reason != FBD_EVENT_END_REASON_NATURAL)
+    return G_SOURCE_REMOVE;
+
+  /* Don't wait for the current iteration to finish, end at the deadline */
+  g_debug ("Event %d expired", self->id);
+  fbd_event_set_end_reason (self, FBD_EVENT_END_REASON_EXPIRED);
+  g_clear_handle_id (&self->restart_id, g_source_remove);
+  g_clear_pointer (&self->pending, g_slist_free);
+
+  /* Ending the last feedback can make the manager drop its reference */
+  g_object_ref (self);
+  end_delayed (self);
+  for (GSList *l = self->feedbacks; l; l = l->next) {
+    FbdFeedbackBase *fb = FBD_FEEDBACK_BASE (l->data);
+
+    if (!fbd_feedback_get_ended (fb))
+      fbd_feedback_end (fb);
+  }
+  check_ended (self);
+  g_object_unref (self);
+
+  return G_SOURCE_REMOVE;
 }
 
 static void
@@ -109,13 +515,18 @@ fbd_event_set_property (GObject      *object,
   case PROP_APP_ID:
     g_free (self->app_id);
     self->app_id = g_value_dup_string (value);
+    g_free (self->munged_app_id);
+    self->munged_app_id = self->app_id ? fbd_event_munge_app_id (self->app_id) : NULL;
     break;
   case PROP_EVENT:
     g_free (self->event);
     self->event = g_value_dup_string (value);
     break;
   case PROP_TIMEOUT:
-    self->timeout = g_value_get_int (value);
+    self->timeout = self->requested_timeout = g_value_get_int (value);
+    break;
+  case PROP_TIMEOUT_MS:
+    fbd_event_set_timeout_ms (self, g_value_get_uint (value));
     break;
   case PROP_END_REASON:
     fbd_event_set_end_reason (self, g_value_get_enum (value));
@@ -124,6 +535,12 @@ fbd_event_set_property (GObject      *object,
     g_free (self->sender);
     self->sender = g_value_dup_string (value);
     break;
+  case PROP_PRIORITY:
+    fbd_event_set_priority (self, g_value_get_uint (value));
+    break;
+  case PROP_LEVEL:
+    fbd_event_set_level (self, g_value_get_enum (value));
+    break;
   case PROP_FEEDBACKS_ENDED:
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -152,6 +569,9 @@ fbd_event_get_property (GObject    *object,
   case PROP_TIMEOUT:
     g_value_set_int (value, self->timeout);
     break;
+  case PROP_TIMEOUT_MS:
+    g_value_set_uint (value, self->timeout_ms);
+    break;
   case PROP_END_REASON:
     g_value_set_enum (value, fbd_event_get_end_reason (self));
     break;
@@ -161,6 +581,12 @@ fbd_event_get_property (GObject    *object,
   case PROP_SENDER:
     g_value_set_string (value, self->sender);
     break;
+  case PROP_PRIORITY:
+    g_value_set_uint (value, self->priority);
+    break;
+  case PROP_LEVEL:
+    g_value_set_enum (value, self->level);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -173,8 +599,14 @@ fbd_event_dispose (GObject *object)
   FbdEvent *self = FBD_EVENT (object);
 
   g_clear_handle_id (&self->timeout_id, g_source_remove);
+  g_clear_handle_id (&self->restart_id, g_source_remove);
+  g_clear_pointer (&self->pending, g_slist_free);
+  g_slist_free_full (g_steal_pointer (&self->next_feedbacks), g_object_unref);
+  remove_delayed (self, NULL);
 
   if (self->feedbacks) {
+    for (GSList *l = self->feedbacks; l; l = l->next)
+      fbd_feedback_release (l->data, self->id);
     /* Feedbacks end themselves when unrefed */
     g_slist_free_full (self->feedbacks, g_object_unref);
     self->feedbacks = NULL;
@@ -189,6 +621,7 @@ fbd_event_finalize (GObject *object)
   FbdEvent *self = FBD_EVENT (object);
 
   g_clear_pointer (&self->app_id, g_free);
+  g_clear_pointer (&self->munged_app_id, g_free);
   g_clear_pointer (&self->event, g_free);
   g_clear_pointer (&self->sender, g_free);
 
@@ -238,6 +671,21 @@ fbd_event_class_init (FbdEventClass *klass)
       -1, G_MAXINT, -1,
       G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+  /**
+   * FbdEvent:timeout-ms:
+   *
+   * Deadline in milliseconds after which running feedbacks are ended. When
+   * set it takes precedence over #FbdEvent:timeout. `0` means no
+   * millisecond deadline was given.
+   */
+  props[PROP_TIMEOUT_MS] =
+    g_param_spec_uint (
+      "timeout-ms",
+      "",
+      "",
+      0, G_MAXUINT, 0,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY);
+
   props[PROP_FEEDBACKS_ENDED] =
     g_param_spec_boolean (
       "feedbacks-ended",
@@ -268,6 +716,35 @@ fbd_event_class_init (FbdEventClass *klass)
       NULL,
       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY);
 
+  /**
+   * FbdEvent:priority:
+   *
+   * The minimum priority of the event's feedbacks. Feedbacks with a
+   * lower priority in the theme get raised to this priority.
+   */
+  props[PROP_PRIORITY] =
+    g_param_spec_uint (
+      "priority",
+      "",
+      "",
+      0, 255, 0,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY);
+
+  /**
+   * FbdEvent:level:
+   *
+   * The feedback level the event's feedbacks were looked up with.
+   * Needed to look them up again when the theme changes.
+   */
+  props[PROP_LEVEL] =
+    g_param_spec_enum (
+      "level",
+      "",
+      "",
+      FBD_TYPE_FEEDBACK_PROFILE_LEVEL,
+      FBD_FEEDBACK_PROFILE_LEVEL_UNKNOWN,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY);
+
   g_object_class_install_properties (object_class, PROP_LAST_PROP, props);
 
   /**
@@ -287,6 +764,7 @@ static void
 fbd_event_init (FbdEvent *self)
 {
   self->timeout = -1;
+  self->level = FBD_FEEDBACK_PROFILE_LEVEL_UNKNOWN;
 }
 
 FbdEvent *
@@ -317,6 +795,52 @@ fbd_event_get_app_id (FbdEvent *self)
   return self->app_id;
 }
 
+/**
+ * fbd_event_get_munged_app_id:
+ * @self: The Event
+ *
+ * Gets the event's app id munged by fbd_event_munge_app_id().
+ *
+ * Returns: The munged app id
+ */
+const char *
+fbd_event_get_munged_app_id (FbdEvent *self)
+{
+  g_return_val_if_fail (FBD_IS_EVENT (self), NULL);
+
+  return self->munged_app_id;
+}
+
+/**
+ * fbd_event_munge_app_id:
+ * @app_id: An app id
+ *
+ * Munges an app id the same way as for its per app settings path and
+ * the file names of app overlays: characters other than ASCII letters,
+ * digits and `-` are replaced by `-` and letters are lower cased.
+ *
+ * Returns: (transfer full): The munged app id
+ */
+char *
+fbd_event_munge_app_id (const char *app_id)
+{
+  char *id;
+
+  g_return_val_if_fail (app_id, NULL);
+
+  id = g_strdup (app_id);
+  g_strcanon (id,
+              "0123456789"
+              "abcdefghijklmnopqrstuvwxyz"
+              "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+              "-",
+              '-');
+  for (int i = 0; id[i] != '\0'; i++)
+    id[i] = g_ascii_tolower (id[i]);
+
+  return id;
+}
+
 guint
 fbd_event_get_id (FbdEvent *self)
 {
@@ -333,6 +857,49 @@ fbd_event_get_timeout (FbdEvent *self)
   return self->timeout;
 }
 
+/**
+ * fbd_event_set_timeout_ms:
+ * @self: The event
+ * @timeout_ms: The deadline in milliseconds
+ *
+ * Sets a deadline in milliseconds after which all running feedbacks
+ * of the event are ended. This turns the event into a timed one
+ * (see #FbdEvent:timeout) and needs to be called before
+ * fbd_event_run_feedbacks(). Passing `0` restores the timeout the
+ * event was created with.
+ */
+void
+fbd_event_set_timeout_ms (FbdEvent *self, guint timeout_ms)
+{
+  int timeout;
+
+  g_return_if_fail (FBD_IS_EVENT (self));
+
+  if (self->timeout_ms == timeout_ms)
+    return;
+
+  self->timeout_ms = timeout_ms;
+  /* Keep the second based timeout in sync, rounding up */
+  if (timeout_ms)
+    timeout = MIN (timeout_ms / 1000 + !!(timeout_ms % 1000), G_MAXINT);
+  else
+    timeout = self->requested_timeout;
+
+  if (self->timeout != timeout) {
+    self->timeout = timeout;
+    g_object_notify_by_pspec (G_OBJECT (self), props[PROP_TIMEOUT]);
+  }
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_TIMEOUT_MS]);
+}
+
+guint
+fbd_event_get_timeout_ms (FbdEvent *self)
+{
+  g_return_val_if_fail (FBD_IS_EVENT (self), 0);
+
+  return self->timeout_ms;
+}
+
 /**
  * fbd_event_add_feedback:
  * @self: The event that gets a feedback added
@@ -344,12 +911,16 @@ void
 fbd_event_add_feedback (FbdEvent *self, FbdFeedbackBase *feedback)
 {
   self->feedbacks = g_slist_prepend (self->feedbacks, g_object_ref(feedback));
-  g_object_set_data (G_OBJECT (feedback), "event-id", GUINT_TO_POINTER(self->id));
   g_signal_connect_object (feedback,
                            "ended",
                            (GCallback) on_fb_ended,
                            self,
                            G_CONNECT_SWAPPED);
+  g_signal_connect_object (feedback,
+                           "iteration-ended",
+                           (GCallback) on_fb_iteration_ended,
+                           self,
+                           G_CONNECT_SWAPPED);
 }
 
 GSList *
@@ -364,6 +935,8 @@ fbd_event_remove_feedback (FbdEvent *self, FbdFeedbackBase *feedback)
   g_return_val_if_fail (FBD_IS_EVENT (self), 0);
 
   self->feedbacks = g_slist_remove (self->feedbacks, feedback);
+  self->pending = g_slist_remove (self->pending, feedback);
+  remove_delayed (self, feedback);
   return g_slist_length (self->feedbacks);
 }
 
@@ -376,6 +949,8 @@ fbd_event_remove_feedback (FbdEvent *self, FbdFeedbackBase *feedback)
 void
 fbd_event_run_feedbacks (FbdEvent *self)
 {
+  gint64 deadline = 0;
+
   g_return_if_fail (FBD_IS_EVENT (self));
 
   g_debug ("Running %d feedbacks for event %d", g_slist_length (self->feedbacks), self->id);
@@ -383,19 +958,35 @@ fbd_event_run_feedbacks (FbdEvent *self)
   if (!self->feedbacks)
     return;
 
+  self->loop_start = g_get_monotonic_time ();
+  self->loop_period = 0;
+
   if (self->timeout > 0) {
-    self->timeout_id = g_timeout_add_seconds (self->timeout,
-                                              (GSourceFunc)on_timeout_expired,
-                                              self);
+    guint timeout_ms = self->timeout_ms;
+
+    /* Use a precise timer so the deadline doesn't get coalesced */
+    if (!timeout_ms && self->timeout <= G_MAXUINT / 1000)
+      timeout_ms = (guint)self->timeout * 1000;
+
+    if (timeout_ms) {
+      self->timeout_id = g_timeout_add (timeout_ms,
+                                        (GSourceFunc)on_timeout_expired,
+                                        self);
+    } else {
+      self->timeout_id = g_timeout_add_seconds (self->timeout,
+                                                (GSourceFunc)on_timeout_expired,
+                                                self);
+    }
     g_source_set_name_by_id (self->timeout_id, "event timeout source");
+    deadline = self->loop_start + (timeout_ms ? (gint64)timeout_ms * 1000 :
+                                   (gint64)self->timeout * G_USEC_PER_SEC);
   }
 
-  g_object_ref (self);
-  for (GSList *l = self->feedbacks; l; l = l->next) {
-    FbdFeedbackBase *fb = FBD_FEEDBACK_BASE (l->data);
-    fbd_feedback_run (fb);
-  }
-  g_object_unref (self);
+  self->deadline = deadline;
+  for (GSList *l = self->feedbacks; l; l = l->next)
+    setup_feedback (self, l->data);
+
+  run_feedbacks (self, self->feedbacks);
 }
 
 /**
@@ -411,7 +1002,21 @@ fbd_event_end_feedbacks (FbdEvent *self)
 
   fbd_event_set_end_reason (self, FBD_EVENT_END_REASON_EXPLICIT);
   g_debug ("Ending %d feedbacks for event %d", g_slist_length (self->feedbacks), self->id);
-  g_slist_foreach (self->feedbacks, (GFunc)fbd_feedback_end, NULL);
+
+  /* Feedbacks waiting for their next loop slot already ended */
+  g_clear_handle_id (&self->restart_id, g_source_remove);
+  g_clear_pointer (&self->pending, g_slist_free);
+
+  g_object_ref (self);
+  end_delayed (self);
+  for (GSList *l = self->feedbacks; l; l = l->next) {
+    FbdFeedbackBase *fb = FBD_FEEDBACK_BASE (l->data);
+
+    if (!fbd_feedback_get_ended (fb))
+      fbd_feedback_end (fb);
+  }
+  check_ended (self);
+  g_object_unref (self);
 }
 
 /**
@@ -429,6 +1034,10 @@ fbd_event_get_feedbacks_ended (FbdEvent *self)
 
   g_return_val_if_fail (FBD_IS_EVENT (self), FALSE);
 
+  /* Held back feedbacks still report the state of their last run */
+  if (self->delayed)
+    return FALSE;
+
   if (!self->feedbacks)
     return TRUE;
 
@@ -485,3 +1094,148 @@ fbd_event_get_sender (FbdEvent *self)
 
   return self->sender;
 }
+
+/**
+ * fbd_event_set_priority:
+ * @self: The Event
+ * @priority: The priority
+ *
+ * Sets the minimum priority the event's feedbacks use when claiming
+ * their device.
+ */
+void
+fbd_event_set_priority (FbdEvent *self, guint priority)
+{
+  g_return_if_fail (FBD_IS_EVENT (self));
+
+  if (self->priority == priority)
+    return;
+
+  self->priority = priority;
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_PRIORITY]);
+}
+
+guint
+fbd_event_get_priority (FbdEvent *self)
+{
+  g_return_val_if_fail (FBD_IS_EVENT (self), 0);
+
+  return self->priority;
+}
+
+/**
+ * fbd_event_set_level:
+ * @self: The Event
+ * @level: The feedback level
+ *
+ * Sets the feedback level the event's feedbacks are looked up with.
+ */
+void
+fbd_event_set_level (FbdEvent *self, FbdFeedbackProfileLevel level)
+{
+  g_return_if_fail (FBD_IS_EVENT (self));
+
+  if (self->level == level)
+    return;
+
+  self->level = level;
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_LEVEL]);
+}
+
+FbdFeedbackProfileLevel
+fbd_event_get_level (FbdEvent *self)
+{
+  g_return_val_if_fail (FBD_IS_EVENT (self), FBD_FEEDBACK_PROFILE_LEVEL_UNKNOWN);
+
+  return self->level;
+}
+
+/**
+ * fbd_event_set_generation:
+ * @self: The Event
+ * @generation: The theme generation
+ *
+ * Sets the generation of the theme the event's feedbacks were looked
+ * up in.
+ */
+void
+fbd_event_set_generation (FbdEvent *self, guint generation)
+{
+  g_return_if_fail (FBD_IS_EVENT (self));
+
+  self->generation = generation;
+}
+
+guint
+fbd_event_get_generation (FbdEvent *self)
+{
+  g_return_val_if_fail (FBD_IS_EVENT (self), 0);
+
+  return self->generation;
+}
+
+/**
+ * fbd_event_get_loop_period:
+ * @self: The Event
+ * @loop_start: (out) (optional): The monotonic time the current loop started
+ *
+ * Gets the period looping feedbacks are restarted with. Iterations
+ * start in slots at @loop_start plus multiples of the period.
+ *
+ * Returns: The period in µs or `0` if the first iteration didn't end yet
+ */
+gint64
+fbd_event_get_loop_period (FbdEvent *self, gint64 *loop_start)
+{
+  g_return_val_if_fail (FBD_IS_EVENT (self), 0);
+
+  if (loop_start)
+    *loop_start = self->loop_start;
+
+  return self->loop_period;
+}
+
+/**
+ * fbd_event_migrate:
+ * @self: The Event
+ * @feedbacks: (element-type FbdFeedbackBase) (transfer none): The feedbacks
+ *   from the new theme
+ * @generation: The new theme's generation
+ *
+ * Replaces the event's feedbacks by @feedbacks once all of them ended
+ * their current iteration. Feedbacks equal to a running one (see
+ * fbd_feedback_equal()) keep using the running one. One shot events
+ * aren't migrated as they end on their own. If @feedbacks is empty the
+ * event ends after the current iteration.
+ */
+void
+fbd_event_migrate (FbdEvent *self, GSList *feedbacks, guint generation)
+{
+  gboolean same;
+
+  g_return_if_fail (FBD_IS_EVENT (self));
+
+  if (self->timeout == FBD_EVENT_TIMEOUT_ONESHOT || self->ended)
+    return;
+
+  g_slist_free_full (g_steal_pointer (&self->next_feedbacks), g_object_unref);
+  self->migrating = FALSE;
+
+  same = g_slist_length (feedbacks) == g_slist_length (self->feedbacks);
+  for (GSList *l = feedbacks; l && same; l = l->next)
+    same = !!find_equal_feedback (self->feedbacks, l->data);
+
+  /*
+   * Full reloads create new objects for all feedbacks so compare by
+   * value. Unchanged events keep running on their loop grid.
+   */
+  if (same) {
+    self->generation = generation;
+    return;
+  }
+
+  g_debug ("Migrating event %d to theme generation %u", self->id, generation);
+  self->next_feedbacks = g_slist_copy_deep (feedbacks, (GCopyFunc)g_object_ref, NULL);
+  self->next_generation = generation;
+  self->migrating = TRUE;
+}
@@ -7,6 +7,7 @@
 
 #include "fbd-feedback-base.h"
 #include "fbd-feedback-manager.h"
+#include "fbd-feedback-profile.h"
 
 #include <glib-object.h>
 
@@ -36,8 +37,12 @@ G_DECLARE_FINAL_TYPE (FbdEvent, fbd_event, FBD, EVENT, GObject);
 FbdEvent    *fbd_event_new (gint id, const char *app_id, const char *event, int timeout, const char *sender);
 const char  *fbd_event_get_event (FbdEvent *event);
 const char  *fbd_event_get_app_id (FbdEvent *event);
+const char  *fbd_event_get_munged_app_id (FbdEvent *event);
+char        *fbd_event_munge_app_id (const char *app_id);
 guint        fbd_event_get_id (FbdEvent *event);
 int          fbd_event_get_timeout (FbdEvent *self);
+void         fbd_event_set_timeout_ms (FbdEvent *self, guint timeout_ms);
+guint        fbd_event_get_timeout_ms (FbdEvent *self);
 void         fbd_event_set_end_reason (FbdEvent *self, FbdEventEndReason reason);
 FbdEventEndReason fbd_event_get_end_reason (FbdEvent *self);
 GSList *     fbd_event_get_feedbacks (FbdEvent *self);
@@ -49,5 +54,13 @@ void         fbd_event_run_feedbacks (FbdEvent *self);
 void         fbd_event_end_feedbacks (FbdEvent *self);
 gboolean     fbd_event_get_feedbacks_ended (FbdEvent *self);
 const char  *fbd_event_get_sender (FbdEvent *self);
+void         fbd_event_set_priority (FbdEvent *self, guint priority);
+guint        fbd_event_get_priority (FbdEvent *self);
+void         fbd_event_set_level (FbdEvent *self, FbdFeedbackProfileLevel level);
+FbdFeedbackProfileLevel fbd_event_get_level (FbdEvent *self);
+void         fbd_event_set_generation (FbdEvent *self, guint generation);
+guint        fbd_event_get_generation (FbdEvent *self);
+gint64       fbd_event_get_loop_period (FbdEvent *self, gint64 *loop_start);
+void         fbd_event_migrate (FbdEvent *self, GSList *feedbacks, guint generation);
 
 G_END_DECLS
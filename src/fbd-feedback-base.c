@@ -6,7 +6,10 @@
 
 #define G_LOG_DOMAIN "fbd-feedback-base"
 
+#include "fbd-arbiter.h"
 #include "fbd-feedback-base.h"
+#include "fbd-feedback-manager.h"
+#include "fbd-latency.h"
 
 /**
  * SECTION:fbd-feedback-base
@@ -20,12 +23,14 @@
 enum {
   PROP_0,
   PROP_EVENT_NAME,
+  PROP_PRIORITY,
   PROP_LAST_PROP,
 };
 static GParamSpec *props[PROP_LAST_PROP];
 
 enum {
   SIGNAL_ENDED,
+  SIGNAL_ITERATION_ENDED,
   N_SIGNALS
 };
 static guint signals[N_SIGNALS];
@@ -33,6 +38,22 @@ static guint signals[N_SIGNALS];
 typedef struct _FbdFeedbackBasePrivate {
   gchar *event_name;
   gboolean ended;
+
+  guint priority;
+  /* The event the feedback is run for next */
+  guint event_id;
+  /* Ids of the events holding a claim on the device for this feedback */
+  GArray *claims;
+  gboolean suspended;
+
+  /* Monotonic time in µs when the feedback will be ended, 0 if unknown */
+  gint64 deadline;
+  /* Whether the event restarts the feedback when it ended */
+  gboolean looping;
+  /* Whether the feedback rather loops by itself until ended */
+  gboolean loops_itself;
+  /* Monotonic time in µs the feedback was last started, 0 if never */
+  gint64 start_time;
 } FbdFeedbackBasePrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (FbdFeedbackBase, fbd_feedback_base, G_TYPE_OBJECT);
@@ -51,6 +72,9 @@ fbd_feedback_base_set_property (GObject        *object,
     g_free (priv->event_name);
     priv->event_name = g_value_dup_string (value);
     break;
+  case PROP_PRIORITY:
+    priv->priority = g_value_get_uint (value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -71,6 +95,9 @@ fbd_feedback_base_get_property (GObject  *object,
   case PROP_EVENT_NAME:
     g_value_set_string (value, priv->event_name);
     break;
+  case PROP_PRIORITY:
+    g_value_set_uint (value, priv->priority);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -81,10 +108,13 @@ static void
 fbd_feedback_base_dispose (GObject *object)
 {
   FbdFeedbackBase *self = FBD_FEEDBACK_BASE (object);
+  FbdFeedbackBasePrivate *priv = fbd_feedback_base_get_instance_private (self);
 
   /* end feedback if running */
   if (!fbd_feedback_get_ended (self))
     fbd_feedback_end (self);
+  while (priv->claims && priv->claims->len)
+    fbd_feedback_release (self, g_array_index (priv->claims, guint, priv->claims->len - 1));
 
   G_OBJECT_CLASS (fbd_feedback_base_parent_class)->dispose (object);
 }
@@ -96,6 +126,7 @@ fbd_feedback_base_finalize (GObject *object)
   FbdFeedbackBasePrivate *priv = fbd_feedback_base_get_instance_private (self);
 
   g_clear_pointer (&priv->event_name, g_free);
+  g_clear_pointer (&priv->claims, g_array_unref);
 
   G_OBJECT_CLASS (fbd_feedback_base_parent_class)->finalize (object);
 }
@@ -119,6 +150,22 @@ fbd_feedback_base_class_init (FbdFeedbackBaseClass *klass)
       NULL,
       G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+  /**
+   * FbdFeedbackBase:priority:
+   *
+   * Priority of the feedback. Devices like the vibra motor or LEDs can
+   * only emit a limited amount of feedback at a time. In this case the
+   * feedback with the highest priority wins and lower priority feedback
+   * is suspended until it ends.
+   */
+  props[PROP_PRIORITY] =
+    g_param_spec_uint (
+      "priority",
+      "Priority",
+      "The feedback priority",
+      0, 255, 0,
+      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (object_class, PROP_LAST_PROP, props);
 
   /**
@@ -132,11 +179,42 @@ fbd_feedback_base_class_init (FbdFeedbackBaseClass *klass)
                                         NULL,
                                         G_TYPE_NONE,
                                         0);
+
+  /**
+   * FbdFeedbackBase::iteration-ended:
+   *
+   * Emitted by feedbacks that loop by themselves each time an
+   * iteration ended. The feedback keeps running.
+   */
+  signals[SIGNAL_ITERATION_ENDED] = g_signal_new ("iteration-ended",
+                                                  G_TYPE_FROM_CLASS (klass),
+                                                  G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+                                                  NULL,
+                                                  G_TYPE_NONE,
+                                                  0);
 }
 
 static void
 fbd_feedback_base_init (FbdFeedbackBase *self)
 {
+  FbdFeedbackBasePrivate *priv = fbd_feedback_base_get_instance_private (self);
+
+  priv->claims = g_array_new (FALSE, FALSE, sizeof (guint));
+}
+
+
+static gboolean
+find_claim (FbdFeedbackBasePrivate *priv, guint event_id, guint *index)
+{
+  for (guint i = 0; i < priv->claims->len; i++) {
+    if (g_array_index (priv->claims, guint, i) == event_id) {
+      if (index)
+        *index = i;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
 }
 
 /**
@@ -156,11 +234,57 @@ fbd_feedback_get_event_name (FbdFeedbackBase *self)
   return priv->event_name;
 }
 
+/**
+ * fbd_feedback_prepare:
+ * @self: The feedback to prepare
+ *
+ * Do the work needed to run the feedback that doesn't yet change the
+ * device's state, e.g. formatting the commands to send. This allows
+ * the feedbacks of an event to be prepared first and then started
+ * together via fbd_feedback_run().
+ *
+ * Only LED feedbacks on sysfs LEDs have work to move here. Droid LEDs,
+ * vibra and sound feedbacks do all their work when being run.
+ */
+void
+fbd_feedback_prepare (FbdFeedbackBase *self)
+{
+  FbdFeedbackBaseClass *klass;
+
+  g_return_if_fail (FBD_IS_FEEDBACK_BASE (self));
+
+  klass = FBD_FEEDBACK_BASE_GET_CLASS (self);
+  if (klass->prepare)
+    klass->prepare (self);
+}
+
+/**
+ * fbd_feedback_set_event_id:
+ * @self: The feedback
+ * @event_id: The id of the event
+ *
+ * Set the event the feedback is run for next. As feedbacks are shared
+ * between events the device is claimed per event so it gets the
+ * event's priority and one event releasing its claim doesn't affect
+ * the others.
+ */
+void
+fbd_feedback_set_event_id (FbdFeedbackBase *self, guint event_id)
+{
+  FbdFeedbackBasePrivate *priv;
+
+  g_return_if_fail (FBD_IS_FEEDBACK_BASE (self));
+  priv = fbd_feedback_base_get_instance_private (self);
+
+  priv->event_id = event_id;
+}
+
 /**
  * fbd_feedback_run:
  * @self: The feedback to run
  *
- * Emit the feedback.
+ * Emit the feedback. The device is claimed for the event set via
+ * fbd_feedback_set_event_id().
  */
 void
 fbd_feedback_run (FbdFeedbackBase *self)
@@ -172,9 +296,25 @@ fbd_feedback_run (FbdFeedbackBase *self)
   priv = fbd_feedback_base_get_instance_private (self);
 
   priv->ended = FALSE;
+  priv->start_time = 0;
+  priv->loops_itself = FALSE;
   klass = FBD_FEEDBACK_BASE_GET_CLASS (self);
   g_return_if_fail (klass->run);
+
+  if (fbd_arbiter_get_device (self) != FBD_ARBITER_DEVICE_NONE) {
+    FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
+
+    if (!find_claim (priv, priv->event_id, NULL))
+      g_array_append_val (priv->claims, priv->event_id);
+    if (!fbd_feedback_manager_claim_device (manager, self, priv->event_id)) {
+      priv->suspended = TRUE;
+      return;
+    }
+  }
+
   klass->run (self);
+  /* The device call returned, that's when the feedback got started */
+  priv->start_time = g_get_monotonic_time ();
 }
 
 /**
@@ -187,8 +327,17 @@ void
 fbd_feedback_end (FbdFeedbackBase *self)
 {
   FbdFeedbackBaseClass *klass;
+  FbdFeedbackBasePrivate *priv;
 
   g_return_if_fail (FBD_IS_FEEDBACK_BASE (self));
+  priv = fbd_feedback_base_get_instance_private (self);
+
+  /* Suspended feedback doesn't use the device */
+  if (priv->suspended) {
+    priv->suspended = FALSE;
+    fbd_feedback_base_done (self);
+    return;
+  }
 
   klass = FBD_FEEDBACK_BASE_GET_CLASS (self);
   g_return_if_fail (klass->end);
@@ -228,6 +377,102 @@ fbd_feedback_base_done (FbdFeedbackBase *self)
   g_signal_emit (self, signals[SIGNAL_ENDED], 0);
 }
 
+/**
+ * fbd_feedback_base_iteration_done:
+ * @self: The feedback
+ *
+ * Invoked by derived classes that loop by themselves to notify that an
+ * iteration ended while the feedback keeps running, e.g. when a looping
+ * sound wraps around.
+ */
+void
+fbd_feedback_base_iteration_done (FbdFeedbackBase *self)
+{
+  g_signal_emit (self, signals[SIGNAL_ITERATION_ENDED], 0);
+}
+
+/**
+ * fbd_feedback_base_set_loops_itself:
+ * @self: The feedback
+ * @loops_itself: Whether the feedback loops by itself
+ *
+ * Invoked by derived classes from their run function when they keep
+ * running until ended rather than ending after each iteration and
+ * being restarted by the event. The flag is reset when the feedback
+ * is run again.
+ */
+void
+fbd_feedback_base_set_loops_itself (FbdFeedbackBase *self, gboolean loops_itself)
+{
+  FbdFeedbackBasePrivate *priv = fbd_feedback_base_get_instance_private (self);
+
+  priv->loops_itself = loops_itself;
+}
+
+/**
+ * fbd_feedback_get_loops_itself:
+ * @self: The feedback
+ *
+ * Returns: %TRUE if the feedback keeps running until it's ended
+ *   rather than being restarted by its event
+ */
+gboolean
+fbd_feedback_get_loops_itself (FbdFeedbackBase *self)
+{
+  FbdFeedbackBasePrivate *priv;
+
+  g_return_val_if_fail (FBD_IS_FEEDBACK_BASE (self), FALSE);
+  priv = fbd_feedback_base_get_instance_private (self);
+
+  return priv->loops_itself;
+}
+
+/**
+ * fbd_feedback_equal:
+ * @self: The feedback
+ * @other: The feedback to compare with
+ *
+ * Compares two feedbacks by value. This allows to tell whether a
+ * feedback of a reloaded theme differs from the one it replaces.
+ *
+ * Returns: %TRUE if both feedbacks are of the same type and all their
+ *   properties have the same values.
+ */
+gboolean
+fbd_feedback_equal (FbdFeedbackBase *self, FbdFeedbackBase *other)
+{
+  g_autofree GParamSpec **pspecs = NULL;
+  guint n_pspecs;
+
+  g_return_val_if_fail (FBD_IS_FEEDBACK_BASE (self), FALSE);
+  g_return_val_if_fail (FBD_IS_FEEDBACK_BASE (other), FALSE);
+
+  if (self == other)
+    return TRUE;
+
+  if (G_OBJECT_TYPE (self) != G_OBJECT_TYPE (other))
+    return FALSE;
+
+  pspecs = g_object_class_list_properties (G_OBJECT_GET_CLASS (self), &n_pspecs);
+  for (guint i = 0; i < n_pspecs; i++) {
+    g_auto (GValue) value = G_VALUE_INIT;
+    g_auto (GValue) other_value = G_VALUE_INIT;
+
+    if (!(pspecs[i]->flags & G_PARAM_READABLE))
+      continue;
+
+    g_value_init (&value, pspecs[i]->value_type);
+    g_value_init (&other_value, pspecs[i]->value_type);
+    g_object_get_property (G_OBJECT (self), pspecs[i]->name, &value);
+    g_object_get_property (G_OBJECT (other), pspecs[i]->name, &other_value);
+
+    if (g_param_values_cmp (pspecs[i], &value, &other_value) != 0)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
 /**
  * fbd_feedback_available:
  * @self: The feedback
@@ -252,3 +497,242 @@ fbd_feedback_is_available (FbdFeedbackBase *self)
     return TRUE;
 }
 
+
+/**
+ * fbd_feedback_get_priority:
+ * @self: The feedback
+ *
+ * Returns: The feedback's priority
+ */
+guint
+fbd_feedback_get_priority (FbdFeedbackBase *self)
+{
+  FbdFeedbackBasePrivate *priv;
+
+  g_return_val_if_fail (FBD_IS_FEEDBACK_BASE (self), 0);
+  priv = fbd_feedback_base_get_instance_private (self);
+
+  return priv->priority;
+}
+
+/**
+ * fbd_feedback_suspend:
+ * @self: The feedback to suspend
+ *
+ * Stop emitting feedback as a higher priority feedback needs the
+ * device. Unlike fbd_feedback_end() this doesn't end the feedback. It
+ * is restarted via fbd_feedback_resume() once the device is available
+ * again.
+ */
+void
+fbd_feedback_suspend (FbdFeedbackBase *self)
+{
+  FbdFeedbackBaseClass *klass;
+  FbdFeedbackBasePrivate *priv;
+
+  g_return_if_fail (FBD_IS_FEEDBACK_BASE (self));
+  priv = fbd_feedback_base_get_instance_private (self);
+
+  if (priv->suspended || priv->ended)
+    return;
+
+  priv->suspended = TRUE;
+  klass = FBD_FEEDBACK_BASE_GET_CLASS (self);
+  if (klass->suspend)
+    klass->suspend (self);
+}
+
+/**
+ * fbd_feedback_resume:
+ * @self: The feedback to resume
+ *
+ * Restart a suspended feedback.
+ */
+void
+fbd_feedback_resume (FbdFeedbackBase *self)
+{
+  FbdFeedbackBaseClass *klass;
+  FbdFeedbackBasePrivate *priv;
+
+  g_return_if_fail (FBD_IS_FEEDBACK_BASE (self));
+  priv = fbd_feedback_base_get_instance_private (self);
+
+  if (!priv->suspended)
+    return;
+
+  priv->suspended = FALSE;
+  klass = FBD_FEEDBACK_BASE_GET_CLASS (self);
+  klass->run (self);
+  priv->start_time = g_get_monotonic_time ();
+}
+
+/**
+ * fbd_feedback_get_suspended:
+ * @self: The feedback
+ *
+ * Returns: %TRUE if the feedback is suspended in favour of a higher
+ * priority feedback.
+ */
+gboolean
+fbd_feedback_get_suspended (FbdFeedbackBase *self)
+{
+  FbdFeedbackBasePrivate *priv;
+
+  g_return_val_if_fail (FBD_IS_FEEDBACK_BASE (self), FALSE);
+  priv = fbd_feedback_base_get_instance_private (self);
+
+  return priv->suspended;
+}
+
+/**
+ * fbd_feedback_release:
+ * @self: The feedback
+ * @event_id: The event that ran the feedback
+ *
+ * Give up the device claimed when the feedback was run for the given
+ * event. This is invoked by the event once it doesn't need to run the
+ * feedback anymore so lower priority feedbacks can resume.
+ */
+void
+fbd_feedback_release (FbdFeedbackBase *self, guint event_id)
+{
+  FbdFeedbackBasePrivate *priv;
+  guint index;
+
+  g_return_if_fail (FBD_IS_FEEDBACK_BASE (self));
+  priv = fbd_feedback_base_get_instance_private (self);
+
+  if (!find_claim (priv, event_id, &index))
+    return;
+
+  g_array_remove_index_fast (priv->claims, index);
+  if (priv->claims->len == 0)
+    priv->suspended = FALSE;
+  fbd_feedback_manager_release_device (fbd_feedback_manager_get_default (), self, event_id);
+}
+
+/**
+ * fbd_feedback_set_deadline:
+ * @self: The feedback
+ * @deadline: The monotonic time in µs or `0`
+ *
+ * Let the feedback know when it will be ended by its event. Feedbacks
+ * can use this to stop by themselves.
+ */
+void
+fbd_feedback_set_deadline (FbdFeedbackBase *self, gint64 deadline)
+{
+  FbdFeedbackBasePrivate *priv;
+
+  g_return_if_fail (FBD_IS_FEEDBACK_BASE (self));
+  priv = fbd_feedback_base_get_instance_private (self);
+
+  priv->deadline = deadline;
+}
+
+/**
+ * fbd_feedback_get_deadline:
+ * @self: The feedback
+ *
+ * Returns: The monotonic time in µs the feedback will be ended or `0`
+ *   if unknown.
+ */
+gint64
+fbd_feedback_get_deadline (FbdFeedbackBase *self)
+{
+  FbdFeedbackBasePrivate *priv;
+
+  g_return_val_if_fail (FBD_IS_FEEDBACK_BASE (self), 0);
+  priv = fbd_feedback_base_get_instance_private (self);
+
+  return priv->deadline;
+}
+
+/**
+ * fbd_feedback_set_looping:
+ * @self: The feedback
+ * @looping: Whether the feedback's event restarts it
+ *
+ * Let the feedback know that its event restarts it until the event
+ * ends. Feedbacks that can loop by themselves can use this to avoid
+ * the gap between iterations.
+ */
+void
+fbd_feedback_set_looping (FbdFeedbackBase *self, gboolean looping)
+{
+  FbdFeedbackBasePrivate *priv;
+
+  g_return_if_fail (FBD_IS_FEEDBACK_BASE (self));
+  priv = fbd_feedback_base_get_instance_private (self);
+
+  priv->looping = looping;
+}
+
+/**
+ * fbd_feedback_get_looping:
+ * @self: The feedback
+ *
+ * Returns: %TRUE if the feedback's event restarts it until the event ends
+ */
+gboolean
+fbd_feedback_get_looping (FbdFeedbackBase *self)
+{
+  FbdFeedbackBasePrivate *priv;
+
+  g_return_val_if_fail (FBD_IS_FEEDBACK_BASE (self), FALSE);
+  priv = fbd_feedback_base_get_instance_private (self);
+
+  return priv->looping;
+}
+
+/**
+ * fbd_feedback_get_start_time:
+ * @self: The feedback
+ *
+ * Returns: The monotonic time in µs the call starting the feedback on
+ *   its device returned or `0` if it didn't start (yet).
+ */
+gint64
+fbd_feedback_get_start_time (FbdFeedbackBase *self)
+{
+  FbdFeedbackBasePrivate *priv;
+
+  g_return_val_if_fail (FBD_IS_FEEDBACK_BASE (self), 0);
+  priv = fbd_feedback_base_get_instance_private (self);
+
+  return priv->start_time;
+}
+
+/**
+ * fbd_feedback_get_latency:
+ * @self: The feedback
+ *
+ * Gets the time it takes from starting the feedback until the user
+ * notices it. By default this is the output latency of the feedback's
+ * device.
+ *
+ * Returns: The latency in µs
+ */
+guint
+fbd_feedback_get_latency (FbdFeedbackBase *self)
+{
+  FbdFeedbackBaseClass *klass;
+  FbdArbiterDevice device;
+  FbdLatency *latency;
+
+  g_return_val_if_fail (FBD_IS_FEEDBACK_BASE (self), 0);
+
+  klass = FBD_FEEDBACK_BASE_GET_CLASS (self);
+  if (klass->get_latency)
+    return klass->get_latency (self);
+
+  device = fbd_arbiter_get_device (self);
+  if (device == FBD_ARBITER_DEVICE_NONE)
+    return 0;
+
+  latency = fbd_feedback_manager_get_latency (fbd_feedback_manager_get_default ());
+  if (latency == NULL)
+    return 0;
+
+  return fbd_latency_get (latency, device);
+}
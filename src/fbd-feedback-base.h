@@ -20,14 +20,34 @@ struct _FbdFeedbackBaseClass
   void     (*run) (FbdFeedbackBase *self);
   void     (*end) (FbdFeedbackBase *self);
   gboolean (*is_available) (FbdFeedbackBase *self);
+  void     (*suspend) (FbdFeedbackBase *self);
+  void     (*prepare) (FbdFeedbackBase *self);
+  guint    (*get_latency) (FbdFeedbackBase *self);
 };
 
 
 const gchar *fbd_feedback_get_event_name (FbdFeedbackBase *self);
+void         fbd_feedback_prepare (FbdFeedbackBase *self);
+void         fbd_feedback_set_event_id (FbdFeedbackBase *self, guint event_id);
 void         fbd_feedback_run (FbdFeedbackBase *self);
 void         fbd_feedback_end (FbdFeedbackBase *self);
 gboolean     fbd_feedback_get_ended (FbdFeedbackBase *self);
 void         fbd_feedback_base_done (FbdFeedbackBase *self);
+void         fbd_feedback_base_iteration_done (FbdFeedbackBase *self);
+void         fbd_feedback_base_set_loops_itself (FbdFeedbackBase *self, gboolean loops_itself);
+gboolean     fbd_feedback_get_loops_itself (FbdFeedbackBase *self);
 gboolean     fbd_feedback_is_available (FbdFeedbackBase *self);
+gboolean     fbd_feedback_equal (FbdFeedbackBase *self, FbdFeedbackBase *other);
+guint        fbd_feedback_get_priority (FbdFeedbackBase *self);
+void         fbd_feedback_suspend (FbdFeedbackBase *self);
+void         fbd_feedback_resume (FbdFeedbackBase *self);
+gboolean     fbd_feedback_get_suspended (FbdFeedbackBase *self);
+void         fbd_feedback_release (FbdFeedbackBase *self, guint event_id);
+void         fbd_feedback_set_deadline (FbdFeedbackBase *self, gint64 deadline);
+gint64       fbd_feedback_get_deadline (FbdFeedbackBase *self);
+void         fbd_feedback_set_looping (FbdFeedbackBase *self, gboolean looping);
+gboolean     fbd_feedback_get_looping (FbdFeedbackBase *self);
+gint64       fbd_feedback_get_start_time (FbdFeedbackBase *self);
+guint        fbd_feedback_get_latency (FbdFeedbackBase *self);
 
 G_END_DECLS
@@ -19,6 +19,9 @@
 enum {
   PROP_0,
   PROP_DURATION,
+  PROP_LOOPS_ITSELF,
+  PROP_LATENCY,
+  PROP_DEVICE,
   PROP_LAST_PROP,
 };
 static GParamSpec *props[PROP_LAST_PROP];
@@ -28,6 +31,9 @@ typedef struct _FbdFeedbackDummy {
 
   guint duration;
   guint timer_id;
+  gboolean loops_itself;
+  guint latency;
+  FbdArbiterDevice device;
 } FbdFeedbackDummy;
 
 G_DEFINE_TYPE (FbdFeedbackDummy, fbd_feedback_dummy, FBD_TYPE_FEEDBACK_BASE);
@@ -44,6 +50,15 @@ fbd_feedback_dummy_set_property (GObject      *object,
   case PROP_DURATION:
     self->duration = g_value_get_uint (value);
     break;
+  case PROP_LOOPS_ITSELF:
+    self->loops_itself = g_value_get_boolean (value);
+    break;
+  case PROP_LATENCY:
+    self->latency = g_value_get_uint (value);
+    break;
+  case PROP_DEVICE:
+    self->device = g_value_get_enum (value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -62,6 +77,15 @@ fbd_feedback_dummy_get_property (GObject    *object,
   case PROP_DURATION:
     g_value_set_uint (value, self->duration);
     break;
+  case PROP_LOOPS_ITSELF:
+    g_value_set_boolean (value, self->loops_itself);
+    break;
+  case PROP_LATENCY:
+    g_value_set_uint (value, self->latency);
+    break;
+  case PROP_DEVICE:
+    g_value_set_enum (value, self->device);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -75,12 +99,25 @@ on_timeout_expired (FbdFeedbackDummy *self)
   return G_SOURCE_REMOVE;
 }
 
+static gboolean
+on_iteration_expired (FbdFeedbackDummy *self)
+{
+  fbd_feedback_base_iteration_done (FBD_FEEDBACK_BASE (self));
+  return G_SOURCE_CONTINUE;
+}
+
 static void
 fbd_feedback_dummy_run (FbdFeedbackBase *base)
 {
   FbdFeedbackDummy *self = FBD_FEEDBACK_DUMMY (base);
 
-  if (self->duration) {
+  if (self->duration && self->loops_itself && fbd_feedback_get_looping (base)) {
+    fbd_feedback_base_set_loops_itself (base, TRUE);
+    self->timer_id = g_timeout_add (self->duration,
+                                    (GSourceFunc)on_iteration_expired,
+                                    self);
+    g_source_set_name_by_id (self->timer_id, "feedback-dummy-timer");
+  } else if (self->duration) {
     self->timer_id = g_timeout_add (self->duration,
 				  (GSourceFunc)on_timeout_expired,
 				  self);
@@ -99,6 +136,14 @@ fbd_feedback_dummy_end (FbdFeedbackBase *base)
   fbd_feedback_base_done (base);
 }
 
+static guint
+fbd_feedback_dummy_get_latency (FbdFeedbackBase *base)
+{
+  FbdFeedbackDummy *self = FBD_FEEDBACK_DUMMY (base);
+
+  return self->latency * 1000;
+}
+
 static void
 fbd_feedback_dummy_class_init (FbdFeedbackDummyClass *klass)
 {
@@ -110,6 +155,7 @@ fbd_feedback_dummy_class_init (FbdFeedbackDummyClass *klass)
 
   base_class->run = fbd_feedback_dummy_run;
   base_class->end = fbd_feedback_dummy_end;
+  base_class->get_latency = fbd_feedback_dummy_get_latency;
 
   props[PROP_DURATION] =
     g_param_spec_uint (
@@ -119,6 +165,49 @@ fbd_feedback_dummy_class_init (FbdFeedbackDummyClass *klass)
       0, G_MAXUINT, 0,
       G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+  /**
+   * FbdFeedbackDummy:loops-itself:
+   *
+   * Whether the dummy keeps running in looping events and reports an
+   * iteration each #FbdFeedbackDummy:duration ms like looping sounds
+   * do.
+   */
+  props[PROP_LOOPS_ITSELF] =
+    g_param_spec_boolean (
+      "loops-itself",
+      "",
+      "",
+      FALSE,
+      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * FbdFeedbackDummy:latency:
+   *
+   * The output latency in ms the dummy pretends to have.
+   */
+  props[PROP_LATENCY] =
+    g_param_spec_uint (
+      "latency",
+      "",
+      "",
+      0, G_MAXUINT / 1000, 0,
+      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * FbdFeedbackDummy:device:
+   *
+   * The device the dummy pretends to use so it takes part in device
+   * arbitration.
+   */
+  props[PROP_DEVICE] =
+    g_param_spec_enum (
+      "device",
+      "",
+      "",
+      FBD_TYPE_ARBITER_DEVICE,
+      FBD_ARBITER_DEVICE_NONE,
+      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (object_class, PROP_LAST_PROP, props);
 }
 
@@ -134,3 +223,11 @@ fbd_feedback_dummy_get_duration (FbdFeedbackDummy *self)
 
   return self->duration;
 }
+
+FbdArbiterDevice
+fbd_feedback_dummy_get_device (FbdFeedbackDummy *self)
+{
+  g_return_val_if_fail (FBD_IS_FEEDBACK_DUMMY (self), FBD_ARBITER_DEVICE_NONE);
+
+  return self->device;
+}
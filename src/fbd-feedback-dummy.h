@@ -5,6 +5,7 @@
  */
 #pragma once
 
+#include "fbd-arbiter.h"
 #include "fbd-feedback-base.h"
 
 G_BEGIN_DECLS
@@ -13,6 +14,7 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (FbdFeedbackDummy, fbd_feedback_dummy, FBD, FEEDBACK_DUMMY, FbdFeedbackBase);
 
-guint fbd_feedback_dummy_get_duration (FbdFeedbackDummy *self);
+guint            fbd_feedback_dummy_get_duration (FbdFeedbackDummy *self);
+FbdArbiterDevice fbd_feedback_dummy_get_device (FbdFeedbackDummy *self);
 
 G_END_DECLS
@@ -11,6 +11,11 @@
 #include "fbd-feedback-led.h"
 #include "fbd-feedback-manager.h"
 
+#include <math.h>
+
+#define LED_GAMMA 2.2
+#define LED_STEADY_DURATION 500
+
 /**
  * SECTION:fbd-feedback-led
  * @short_description: Describes a led feedback
@@ -18,6 +23,14 @@
  *
  * The #FbdFeedbackLed describes a feedback via an LED. It currently
  * only supports periodic patterns.
+ *
+ * The color is either one of the #FbdFeedbackLedColor values or an
+ * arbitrary "#rrggbb" value given via the #FbdFeedbackLed:rgb
+ * property.
+ *
+ * The pattern's steps are computed once when the feedback is created
+ * from its #FbdFeedbackLed:shape, #FbdFeedbackLed:steps and
+ * #FbdFeedbackLed:frequency.
  */
 
 enum {
@@ -25,7 +38,9 @@ enum {
   PROP_FREQUENCY,
   PROP_COLOR,
   PROP_MAX_BRIGHTNESS,
-  PROP_PRIORITY,
+  PROP_RGB,
+  PROP_SHAPE,
+  PROP_STEPS,
   PROP_LAST_PROP,
 };
 static GParamSpec *props[PROP_LAST_PROP];
@@ -34,9 +49,17 @@ typedef struct _FbdFeedbackLed {
   FbdFeedbackBase     parent;
 
   guint               frequency;
-  guint               priority;
   guint               max_brightness;
   FbdFeedbackLedColor color;
+  gchar              *rgb;
+  FbdFeedbackLedShape shape;
+  guint               n_steps;
+
+  /* Computed once at construct time */
+  gdouble             intensity[3];
+  guint32             argb;
+  GArray             *steps;
+  guint               period;
 } FbdFeedbackLed;
 
 G_DEFINE_TYPE (FbdFeedbackLed, fbd_feedback_led, FBD_TYPE_FEEDBACK_BASE)
@@ -53,15 +76,22 @@ fbd_feedback_led_set_property (GObject      *object,
   case PROP_FREQUENCY:
     self->frequency = g_value_get_uint (value);
     break;
-  case PROP_PRIORITY:
-    self->priority = g_value_get_uint (value);
-    break;
   case PROP_MAX_BRIGHTNESS:
     self->max_brightness = g_value_get_uint (value);
     break;
   case PROP_COLOR:
     self->color = g_value_get_enum (value);
     break;
+  case PROP_RGB:
+    g_free (self->rgb);
+    self->rgb = g_value_dup_string (value);
+    break;
+  case PROP_SHAPE:
+    self->shape = g_value_get_enum (value);
+    break;
+  case PROP_STEPS:
+    self->n_steps = g_value_get_uint (value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -80,21 +110,146 @@ fbd_feedback_led_get_property (GObject    *object,
   case PROP_FREQUENCY:
     g_value_set_uint (value, self->frequency);
     break;
-  case PROP_PRIORITY:
-    g_value_set_uint (value, self->priority);
-    break;
   case PROP_MAX_BRIGHTNESS:
     g_value_set_uint (value, self->max_brightness);
     break;
   case PROP_COLOR:
     g_value_set_enum (value, self->color);
     break;
+  case PROP_RGB:
+    g_value_set_string (value, self->rgb);
+    break;
+  case PROP_SHAPE:
+    g_value_set_enum (value, self->shape);
+    break;
+  case PROP_STEPS:
+    g_value_set_uint (value, self->n_steps);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
   }
 }
 
+static gboolean
+parse_rgb (const char *rgb, guint8 channels[3])
+{
+  if (rgb == NULL || rgb[0] != '#' || strlen (rgb) != 7)
+    return FALSE;
+
+  for (int i = 0; i < 3; i++) {
+    int hi = g_ascii_xdigit_value (rgb[1 + 2 * i]);
+    int lo = g_ascii_xdigit_value (rgb[2 + 2 * i]);
+
+    if (hi < 0 || lo < 0)
+      return FALSE;
+    channels[i] = hi << 4 | lo;
+  }
+
+  return TRUE;
+}
+
+static void
+add_step (FbdFeedbackLed *self, gdouble level, guint duration)
+{
+  FbdFeedbackLedStep step = {
+    .level = level * (self->max_brightness / 100.0),
+    .duration = duration,
+  };
+
+  g_array_append_val (self->steps, step);
+  self->period += duration;
+}
+
+static void
+build_steps (FbdFeedbackLed *self)
+{
+  guint period, n = self->n_steps;
+
+  if (self->frequency == 0) {
+    /* Steady on */
+    add_step (self, 1.0, LED_STEADY_DURATION);
+    add_step (self, 1.0, LED_STEADY_DURATION);
+    return;
+  }
+
+  /*       ms     mHz */
+  period = 1000 * 1000 / self->frequency;
+
+  switch (self->shape) {
+  case FBD_FEEDBACK_LED_SHAPE_BREATHE:
+    /* Raised cosine, the kernel interpolates linearly in between */
+    for (guint i = 0; i < n; i++)
+      add_step (self, (1.0 - cos (2.0 * G_PI * i / n)) / 2.0, period / n);
+    break;
+  case FBD_FEEDBACK_LED_SHAPE_RAMP:
+    /* Evenly spaced steps up, then drop to off */
+    for (guint i = 0; i < n - 1; i++)
+      add_step (self, (gdouble)i / (n - 1), period / (n - 1));
+    add_step (self, 1.0, 0);
+    break;
+  case FBD_FEEDBACK_LED_SHAPE_BLINK:
+  default:
+    add_step (self, 0.0, period / 2);
+    add_step (self, 1.0, period / 2);
+    break;
+  }
+}
+
+static void
+fbd_feedback_led_constructed (GObject *object)
+{
+  FbdFeedbackLed *self = FBD_FEEDBACK_LED (object);
+  guint8 channels[3] = { 0, 0, 0 };
+  guint max;
+
+  G_OBJECT_CLASS (fbd_feedback_led_parent_class)->constructed (object);
+
+  if (self->rgb) {
+    if (parse_rgb (self->rgb, channels))
+      self->color = FBD_FEEDBACK_LED_COLOR_RGB;
+    else
+      g_warning ("Invalid LED color '%s', expected #rrggbb", self->rgb);
+  }
+
+  if (self->color != FBD_FEEDBACK_LED_COLOR_RGB) {
+    channels[0] = (self->color == FBD_FEEDBACK_LED_COLOR_WHITE ||
+                   self->color == FBD_FEEDBACK_LED_COLOR_RED) ? 0xff : 0;
+    channels[1] = (self->color == FBD_FEEDBACK_LED_COLOR_WHITE ||
+                   self->color == FBD_FEEDBACK_LED_COLOR_GREEN) ? 0xff : 0;
+    channels[2] = (self->color == FBD_FEEDBACK_LED_COLOR_WHITE ||
+                   self->color == FBD_FEEDBACK_LED_COLOR_BLUE) ? 0xff : 0;
+  } else if (self->rgb == NULL) {
+    /* No value given, use white */
+    channels[0] = channels[1] = channels[2] = 0xff;
+  }
+
+  /*
+   * LEDs are linear, compensate for perceived brightness. The droid
+   * backends pass the color on as is so it needs the correction too.
+   */
+  self->argb = 0xff << 24;
+  for (int i = 0; i < 3; i++) {
+    self->intensity[i] = pow (channels[i] / 255.0, LED_GAMMA);
+
+    max = round (self->intensity[i] * 255 * self->max_brightness / 100.0);
+    self->argb |= (max & 0xff) << (8 * (2 - i));
+  }
+
+  build_steps (self);
+}
+
+static void
+fbd_feedback_led_finalize (GObject *object)
+{
+  FbdFeedbackLed *self = FBD_FEEDBACK_LED (object);
+
+  g_clear_pointer (&self->rgb, g_free);
+  g_clear_pointer (&self->steps, g_array_unref);
+
+  G_OBJECT_CLASS (fbd_feedback_led_parent_class)->finalize (object);
+}
+
 static void
 fbd_feedback_led_run (FbdFeedbackBase *base)
 {
@@ -103,13 +258,20 @@ fbd_feedback_led_run (FbdFeedbackBase *base)
   FbdDevLeds *dev = fbd_feedback_manager_get_dev_leds (manager);
 
   g_return_if_fail (FBD_IS_DEV_LEDS (dev));
-  g_debug ("Periodic led feedback: self->max_brightness, self->frequency");
+  g_debug ("Periodic led feedback: %u%%, %u mHz", self->max_brightness, self->frequency);
+
+  fbd_dev_leds_start_periodic (dev, self);
+}
+
+static void
+fbd_feedback_led_prepare (FbdFeedbackBase *base)
+{
+  FbdFeedbackLed *self = FBD_FEEDBACK_LED (base);
+  FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
+  FbdDevLeds *dev = fbd_feedback_manager_get_dev_leds (manager);
 
-  /* FIXME: handle priority */
-  fbd_dev_leds_start_periodic (dev,
-                               self->color,
-                               self->max_brightness,
-                               self->frequency);
+  if (dev)
+    fbd_dev_leds_prepare (dev, self);
 }
 
 static void
@@ -120,17 +282,29 @@ fbd_feedback_led_end (FbdFeedbackBase *base)
   FbdDevLeds *dev = fbd_feedback_manager_get_dev_leds (manager);
 
   if (dev)
-    fbd_dev_leds_stop (dev, self->color);
+    fbd_dev_leds_stop (dev, self);
   fbd_feedback_base_done (FBD_FEEDBACK_BASE (self));
 }
 
+static void
+fbd_feedback_led_suspend (FbdFeedbackBase *base)
+{
+  FbdFeedbackLed *self = FBD_FEEDBACK_LED (base);
+  FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
+  FbdDevLeds *dev = fbd_feedback_manager_get_dev_leds (manager);
+
+  if (dev)
+    fbd_dev_leds_stop (dev, self);
+}
+
 static gboolean
 fbd_feedback_led_is_available (FbdFeedbackBase *base)
 {
   FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
   FbdDevLeds *dev = fbd_feedback_manager_get_dev_leds (manager);
 
-  return FBD_IS_DEV_LEDS (dev);
+  /* LEDs might get hotplugged later on */
+  return FBD_IS_DEV_LEDS (dev) && fbd_dev_leds_has_leds (dev);
 }
 
 static void
@@ -141,10 +315,14 @@ fbd_feedback_led_class_init (FbdFeedbackLedClass *klass)
 
   object_class->set_property = fbd_feedback_led_set_property;
   object_class->get_property = fbd_feedback_led_get_property;
+  object_class->constructed = fbd_feedback_led_constructed;
+  object_class->finalize = fbd_feedback_led_finalize;
 
   base_class->run = fbd_feedback_led_run;
+  base_class->prepare = fbd_feedback_led_prepare;
   base_class->end = fbd_feedback_led_end;
   base_class->is_available = fbd_feedback_led_is_available;
+  base_class->suspend = fbd_feedback_led_suspend;
 
   props[PROP_FREQUENCY] =
     g_param_spec_uint (
@@ -163,21 +341,6 @@ fbd_feedback_led_class_init (FbdFeedbackLedClass *klass)
       FBD_FEEDBACK_LED_COLOR_WHITE,
       G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
-  /**
-   * FbdFeedbackLed:priority:
-   *
-   * Priority of the led pattern. Led devices can only display a limited
-   * amount of patterns at time. In this case the pattern with the highest
-   * priority wins.
-   */
-  props[PROP_PRIORITY] =
-    g_param_spec_uint (
-      "priority",
-      "Priority",
-      "The LED pattern priority",
-      0, 255, 0,
-      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
-
   /**
    * FbdFeedbackLed:max-brightness:
    *
@@ -192,6 +355,50 @@ fbd_feedback_led_class_init (FbdFeedbackLedClass *klass)
       1, 100, 100,
       G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+  /**
+   * FbdFeedbackLed:rgb:
+   *
+   * An arbitrary LED color in "#rrggbb" notation. When set it takes
+   * precedence over #FbdFeedbackLed:color. This needs a multicolor
+   * LED to look as expected.
+   */
+  props[PROP_RGB] =
+    g_param_spec_string (
+      "rgb",
+      "RGB",
+      "The LED color as #rrggbb",
+      NULL,
+      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * FbdFeedbackLed:shape:
+   *
+   * The brightness curve of a pattern period.
+   */
+  props[PROP_SHAPE] =
+    g_param_spec_enum (
+      "shape",
+      "Shape",
+      "The pattern shape",
+      FBD_TYPE_FEEDBACK_LED_SHAPE,
+      FBD_FEEDBACK_LED_SHAPE_BLINK,
+      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * FbdFeedbackLed:steps:
+   *
+   * The number of steps used to approximate the breathe and ramp
+   * shapes. More steps give smoother curves on LEDs that don't
+   * interpolate.
+   */
+  props[PROP_STEPS] =
+    g_param_spec_uint (
+      "steps",
+      "Steps",
+      "Steps per pattern period",
+      2, 64, 8,
+      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (object_class, PROP_LAST_PROP, props);
 }
 
@@ -199,4 +406,104 @@ static void
 fbd_feedback_led_init (FbdFeedbackLed *self)
 {
   self->max_brightness = 100;
+  self->n_steps = 8;
+  self->steps = g_array_new (FALSE, FALSE, sizeof (FbdFeedbackLedStep));
+}
+
+FbdFeedbackLedColor
+fbd_feedback_led_get_color (FbdFeedbackLed *self)
+{
+  g_return_val_if_fail (FBD_IS_FEEDBACK_LED (self), FBD_FEEDBACK_LED_COLOR_WHITE);
+
+  return self->color;
+}
+
+/**
+ * fbd_feedback_led_get_frequency:
+ * @self: The led feedback
+ *
+ * Returns: The blink frequency in mHz
+ */
+guint
+fbd_feedback_led_get_frequency (FbdFeedbackLed *self)
+{
+  g_return_val_if_fail (FBD_IS_FEEDBACK_LED (self), 0);
+
+  return self->frequency;
+}
+
+/**
+ * fbd_feedback_led_get_max_brightness:
+ * @self: The led feedback
+ *
+ * Returns: The maximum brightness in percent of the LED's maximum brightness
+ */
+guint
+fbd_feedback_led_get_max_brightness (FbdFeedbackLed *self)
+{
+  g_return_val_if_fail (FBD_IS_FEEDBACK_LED (self), 100);
+
+  return self->max_brightness;
+}
+
+/**
+ * fbd_feedback_led_get_intensity:
+ * @self: The led feedback
+ *
+ * Returns: The gamma corrected intensity of the red, green and blue
+ * channels in the range 0 to 1.
+ */
+const gdouble *
+fbd_feedback_led_get_intensity (FbdFeedbackLed *self)
+{
+  g_return_val_if_fail (FBD_IS_FEEDBACK_LED (self), NULL);
+
+  return self->intensity;
+}
+
+/**
+ * fbd_feedback_led_get_argb:
+ * @self: The led feedback
+ *
+ * Returns: The gamma corrected color as ARGB value with the maximum
+ *   brightness applied
+ */
+guint32
+fbd_feedback_led_get_argb (FbdFeedbackLed *self)
+{
+  g_return_val_if_fail (FBD_IS_FEEDBACK_LED (self), 0);
+
+  return self->argb;
+}
+
+/**
+ * fbd_feedback_led_get_steps:
+ * @self: The led feedback
+ * @n_steps: (out): Return location for the number of steps
+ *
+ * Returns: (array length=n_steps): One period of the LED pattern with
+ *   the feedback's maximum brightness applied
+ */
+const FbdFeedbackLedStep *
+fbd_feedback_led_get_steps (FbdFeedbackLed *self, guint *n_steps)
+{
+  g_return_val_if_fail (FBD_IS_FEEDBACK_LED (self), NULL);
+  g_return_val_if_fail (n_steps, NULL);
+
+  *n_steps = self->steps->len;
+  return (const FbdFeedbackLedStep *)self->steps->data;
+}
+
+/**
+ * fbd_feedback_led_get_period:
+ * @self: The led feedback
+ *
+ * Returns: The duration of one pattern period in ms
+ */
+guint
+fbd_feedback_led_get_period (FbdFeedbackLed *self)
+{
+  g_return_val_if_fail (FBD_IS_FEEDBACK_LED (self), 0);
+
+  return self->period;
 }
@@ -18,8 +18,43 @@ typedef enum _FbdFeedbackLedColor {
   FBD_FEEDBACK_LED_COLOR_LAST = FBD_FEEDBACK_LED_COLOR_RGB,
 } FbdFeedbackLedColor;
 
+/**
+ * FbdFeedbackLedShape:
+ * @FBD_FEEDBACK_LED_SHAPE_BLINK: Ramp up and down linearly
+ * @FBD_FEEDBACK_LED_SHAPE_BREATHE: Fade in and out smoothly
+ * @FBD_FEEDBACK_LED_SHAPE_RAMP: Ramp up, then turn off
+ *
+ * The brightness curve of an LED pattern.
+ */
+typedef enum _FbdFeedbackLedShape {
+  FBD_FEEDBACK_LED_SHAPE_BLINK = 0,
+  FBD_FEEDBACK_LED_SHAPE_BREATHE = 1,
+  FBD_FEEDBACK_LED_SHAPE_RAMP = 2,
+} FbdFeedbackLedShape;
+
+/**
+ * FbdFeedbackLedStep:
+ * @level: The brightness in the range 0 to 1
+ * @duration: The duration of this step in ms
+ *
+ * A step of an LED pattern. Like with the kernel's pattern trigger the
+ * brightness changes linearly towards the next step's level.
+ */
+typedef struct _FbdFeedbackLedStep {
+  gdouble level;
+  guint   duration;
+} FbdFeedbackLedStep;
+
 #define FBD_TYPE_FEEDBACK_LED (fbd_feedback_led_get_type ())
 
 G_DECLARE_FINAL_TYPE (FbdFeedbackLed, fbd_feedback_led, FBD, FEEDBACK_LED, FbdFeedbackBase);
 
+FbdFeedbackLedColor fbd_feedback_led_get_color (FbdFeedbackLed *self);
+guint               fbd_feedback_led_get_frequency (FbdFeedbackLed *self);
+guint               fbd_feedback_led_get_max_brightness (FbdFeedbackLed *self);
+const gdouble      *fbd_feedback_led_get_intensity (FbdFeedbackLed *self);
+guint32             fbd_feedback_led_get_argb (FbdFeedbackLed *self);
+const FbdFeedbackLedStep *fbd_feedback_led_get_steps (FbdFeedbackLed *self, guint *n_steps);
+guint               fbd_feedback_led_get_period (FbdFeedbackLed *self);
+
 G_END_DECLS
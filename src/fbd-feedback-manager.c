@@ -9,6 +9,8 @@
 
 #include "lfb-names.h"
 #include "fbd.h"
+#include "fbd-arbiter.h"
+#include "fbd-latency.h"
 #ifdef WITH_DROID_SUPPORT
 #include "fbd-droid-vibra.h"
 #include "fbd-droid-leds.h"
@@ -17,9 +19,11 @@
 #include "fbd-dev-leds.h"
 #endif
 #include "fbd-event.h"
+#include "fbd-feedback-sound.h"
 #include "fbd-feedback-vibra.h"
 #include "fbd-feedback-manager.h"
 #include "fbd-feedback-theme.h"
+#include "fbd-theme-dirs.h"
 #include "fbd-theme-expander.h"
 
 #define GMOBILE_USE_UNSTABLE_API
@@ -32,6 +36,8 @@
 #define FEEDBACKD_SCHEMA_ID "org.sigxcpu.feedbackd"
 #define FEEDBACKD_KEY_PROFILE "profile"
 #define FEEDBACKD_KEY_THEME "theme"
+#define FEEDBACKD_KEY_MAX_SOUND_VOICES "max-sound-voices"
+#define FEEDBACKD_KEY_PRELOAD_THEMES "preload-themes"
 
 #define APP_SCHEMA FEEDBACKD_SCHEMA_ID ".application"
 #define APP_PREFIX "/org/sigxcpu/feedbackd/application/"
@@ -53,6 +59,8 @@ typedef struct _FbdFeedbackManager {
   GSettings               *settings;
   FbdFeedbackProfileLevel  level;
   FbdFeedbackTheme        *theme;
+  /* Bumped whenever a new theme gets published */
+  guint                    theme_generation;
   guint                    next_id;
 
   /* Key: event id, value: event */
@@ -65,9 +73,34 @@ typedef struct _FbdFeedbackManager {
   FbdDevVibra             *vibra;
   FbdDevSound             *sound;
   FbdDevLeds              *leds;
+  FbdArbiter              *arbiter;
+  FbdLatency              *latency;
+  FbdThemeExpander        *expander;
+  /* Shared by all expanders so full loads don't rescan unchanged folders */
+  FbdThemeDirs            *theme_dirs;
+  char                    *theme_name;
+  GStrv                    compatibles;
+  /* Key: theme name, value: FbdResidentTheme */
+  GHashTable              *resident_themes;
 } FbdFeedbackManager;
 
+/* A theme kept loaded so switching to it doesn't need to parse files */
+typedef struct {
+  FbdThemeExpander *expander;
+  FbdFeedbackTheme *theme;
+} FbdResidentTheme;
+
+static void
+fbd_resident_theme_free (FbdResidentTheme *resident)
+{
+  g_clear_object (&resident->expander);
+  g_clear_object (&resident->theme);
+  g_free (resident);
+}
+
 static void fbd_feedback_manager_feedback_iface_init (LfbGdbusFeedbackIface *iface);
+static void switch_theme (FbdFeedbackManager *self);
+static void preload_themes (FbdFeedbackManager *self, gboolean reload);
 
 G_DEFINE_TYPE_WITH_CODE (FbdFeedbackManager,
                          fbd_feedback_manager,
@@ -104,34 +137,15 @@ device_changes (FbdFeedbackManager *self, gchar *action, GUdevDevice *device,
   }
 }
 
-static gchar *
-munge_app_id (const gchar *app_id)
-{
-  gchar *id = g_strdup (app_id);
-  gint i;
-
-  g_strcanon (id,
-              "0123456789"
-              "abcdefghijklmnopqrstuvwxyz"
-              "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-              "-",
-              '-');
-  for (i = 0; id[i] != '\0'; i++)
-    id[i] = g_ascii_tolower (id[i]);
-
-  return id;
-}
-
 static FbdFeedbackProfileLevel
-app_get_feedback_level (const gchar *app_id)
+app_get_feedback_level (FbdEvent *event)
 {
   g_autofree gchar *profile = NULL;
-  g_autofree gchar *munged_app_id = munge_app_id (app_id);
-  g_autofree gchar *path = g_strconcat (APP_PREFIX, munged_app_id, "/", NULL);
+  g_autofree gchar *path = g_strconcat (APP_PREFIX, fbd_event_get_munged_app_id (event), "/", NULL);
   g_autoptr (GSettings) setting =  g_settings_new_with_path (APP_SCHEMA, path);
 
   profile = g_settings_get_string (setting, FEEDBACKD_KEY_PROFILE);
-  g_debug ("%s uses app profile %s", app_id, profile);
+  g_debug ("%s uses app profile %s", fbd_event_get_app_id (event), profile);
   return fbd_feedback_profile_level (profile);
 }
 
@@ -236,7 +250,9 @@ on_feedbackd_setting_changed (FbdFeedbackManager *self,
     profile = g_settings_get_string (settings, key);
     fbd_feedback_manager_set_profile (self, profile);
   } else if (g_str_equal (key, FEEDBACKD_KEY_THEME)) {
-    fbd_feedback_manager_load_theme (self);
+    switch_theme (self);
+  } else if (g_str_equal (key, FEEDBACKD_KEY_PRELOAD_THEMES)) {
+    preload_themes (self, FALSE);
   } else {
     g_critical ("Unknown settings key '%s'", key);
   }
@@ -322,7 +338,10 @@ get_max_level (FbdFeedbackProfileLevel global_level,
 }
 
 static gboolean
-parse_hints (GVariant *hints, FbdFeedbackProfileLevel *level)
+parse_hints (GVariant                *hints,
+             FbdFeedbackProfileLevel *level,
+             guint                   *timeout_ms,
+             guint                   *priority)
 {
   const gchar *profile;
   gboolean found;
@@ -333,9 +352,34 @@ parse_hints (GVariant *hints, FbdFeedbackProfileLevel *level)
 
   if (level && found)
     *level = fbd_feedback_profile_level (profile);
+
+  if (timeout_ms)
+    g_variant_dict_lookup (&dict, "timeout-ms", "u", timeout_ms);
+
+  if (priority && g_variant_dict_lookup (&dict, "priority", "u", priority))
+    *priority = MIN (*priority, 255);
+
   return TRUE;
 }
 
+/* The feedbacks for @event in @level that can run on this device */
+static GSList *
+lookup_feedbacks (FbdFeedbackManager *self, FbdEvent *event, FbdFeedbackProfileLevel level)
+{
+  GSList *feedbacks, *available = NULL;
+
+  feedbacks = fbd_feedback_theme_lookup_feedback (self->theme, level, event);
+  for (GSList *l = feedbacks; l; l = l->next) {
+    FbdFeedbackBase *fb = l->data;
+
+    if (fbd_feedback_is_available (fb))
+      available = g_slist_prepend (available, g_object_ref (fb));
+  }
+  g_slist_free_full (feedbacks, g_object_unref);
+
+  return g_slist_reverse (available);
+}
+
 static gboolean
 fbd_feedback_manager_handle_trigger_feedback (LfbGdbusFeedback      *object,
                                               GDBusMethodInvocation *invocation,
@@ -346,11 +390,12 @@ fbd_feedback_manager_handle_trigger_feedback (LfbGdbusFeedback      *object,
 {
   FbdFeedbackManager *self;
   FbdEvent *event;
-  GSList *feedbacks, *l;
+  GSList *feedbacks;
   guint event_id;
   const gchar *sender;
   FbdFeedbackProfileLevel app_level, level, hint_level = FBD_FEEDBACK_PROFILE_LEVEL_FULL;
   gboolean found_fb = FALSE;
+  guint timeout_ms = 0, priority = 0;
 
   sender = g_dbus_method_invocation_get_sender (invocation);
   g_debug ("Event '%s' for '%s' from %s", arg_event, arg_app_id, sender);
@@ -374,7 +419,7 @@ fbd_feedback_manager_handle_trigger_feedback (LfbGdbusFeedback      *object,
     return TRUE;
   }
 
-  if (!parse_hints (arg_hints, &hint_level)) {
+  if (!parse_hints (arg_hints, &hint_level, &timeout_ms, &priority)) {
     g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
                                            G_DBUS_ERROR_INVALID_ARGS,
                                            "Invalid hints");
@@ -387,26 +432,22 @@ fbd_feedback_manager_handle_trigger_feedback (LfbGdbusFeedback      *object,
   event_id = self->next_id++;
 
   event = fbd_event_new (event_id, arg_app_id, arg_event, arg_timeout, sender);
+  if (timeout_ms)
+    fbd_event_set_timeout_ms (event, timeout_ms);
+  fbd_event_set_priority (event, priority);
+  fbd_event_set_generation (event, self->theme_generation);
   g_hash_table_insert (self->events, GUINT_TO_POINTER (event_id), event);
 
-  app_level = app_get_feedback_level (arg_app_id);
+  app_level = app_get_feedback_level (event);
   level = get_max_level (self->level, app_level, hint_level);
+  fbd_event_set_level (event, level);
 
-  feedbacks = fbd_feedback_theme_lookup_feedback (self->theme, level, event);
-  if (feedbacks) {
-    for (l = feedbacks; l; l = l->next) {
-      FbdFeedbackBase *fb = l->data;
-
-      if (fbd_feedback_is_available (FBD_FEEDBACK_BASE (fb))) {
-        fbd_event_add_feedback (event, fb);
-        found_fb = TRUE;
-      }
-    }
-    g_slist_free_full (feedbacks, g_object_unref);
-  } else {
-    /* No feedbacks found at all */
-    found_fb = FALSE;
+  feedbacks = lookup_feedbacks (self, event, level);
+  for (GSList *l = feedbacks; l; l = l->next) {
+    fbd_event_add_feedback (event, l->data);
+    found_fb = TRUE;
   }
+  g_slist_free_full (feedbacks, g_object_unref);
 
   lfb_gdbus_feedback_complete_trigger_feedback (object, invocation, event_id);
 
@@ -469,7 +510,15 @@ fbd_feedback_manager_constructed (GObject *object)
                             G_CALLBACK (on_feedbackd_setting_changed), self);
   g_signal_connect_swapped (self->settings, "changed::" FEEDBACKD_KEY_PROFILE,
                             G_CALLBACK (on_feedbackd_setting_changed), self);
+  g_signal_connect_swapped (self->settings, "changed::" FEEDBACKD_KEY_PRELOAD_THEMES,
+                            G_CALLBACK (on_feedbackd_setting_changed), self);
   on_feedbackd_setting_changed (self, FEEDBACKD_KEY_PROFILE, self->settings);
+
+  if (self->sound) {
+    g_settings_bind (self->settings, FEEDBACKD_KEY_MAX_SOUND_VOICES,
+                     self->sound, "max-voices",
+                     G_SETTINGS_BIND_GET);
+  }
 }
 
 static void
@@ -478,6 +527,11 @@ fbd_feedback_manager_dispose (GObject *object)
   FbdFeedbackManager *self = FBD_FEEDBACK_MANAGER (object);
 
   g_clear_object (&self->settings);
+  g_clear_object (&self->expander);
+  g_clear_pointer (&self->resident_themes, g_hash_table_destroy);
+  g_clear_object (&self->theme_dirs);
+  g_clear_pointer (&self->theme_name, g_free);
+  g_clear_pointer (&self->compatibles, g_strfreev);
   g_clear_object (&self->theme);
   g_clear_object (&self->sound);
   g_clear_object (&self->vibra);
@@ -485,6 +539,8 @@ fbd_feedback_manager_dispose (GObject *object)
   g_clear_object (&self->client);
   g_clear_pointer (&self->events, g_hash_table_destroy);
   g_clear_pointer (&self->clients, g_hash_table_destroy);
+  g_clear_object (&self->arbiter);
+  g_clear_object (&self->latency);
 
   G_OBJECT_CLASS (fbd_feedback_manager_parent_class)->dispose (object);
 }
@@ -513,6 +569,9 @@ fbd_feedback_manager_init (FbdFeedbackManager *self)
   self->next_id = 1;
   self->level = FBD_FEEDBACK_PROFILE_LEVEL_UNKNOWN;
 
+  self->arbiter = fbd_arbiter_new ();
+  self->theme_dirs = fbd_theme_dirs_new ();
+
   self->client = g_udev_client_new (subsystems);
   g_signal_connect_swapped (G_OBJECT (self->client), "uevent",
                             G_CALLBACK (device_changes), self);
@@ -526,6 +585,10 @@ fbd_feedback_manager_init (FbdFeedbackManager *self)
                                          g_str_equal,
                                          g_free,
                                          free_client_watch);
+  self->resident_themes = g_hash_table_new_full (g_str_hash,
+                                                 g_str_equal,
+                                                 g_free,
+                                                 (GDestroyNotify)fbd_resident_theme_free);
 }
 
 FbdFeedbackManager *
@@ -564,30 +627,158 @@ fbd_feedback_manager_get_dev_leds (FbdFeedbackManager *self)
   return self->leds;
 }
 
-void
-fbd_feedback_manager_load_theme (FbdFeedbackManager *self)
+/**
+ * fbd_feedback_manager_get_latency:
+ * @self: The feedback manager
+ *
+ * Returns: (transfer none) (nullable): The output latencies of the
+ *   feedback devices
+ */
+FbdLatency *
+fbd_feedback_manager_get_latency (FbdFeedbackManager *self)
+{
+  g_return_val_if_fail (FBD_IS_FEEDBACK_MANAGER (self), NULL);
+
+  return self->latency;
+}
+
+static void
+collect_sound_effect (FbdFeedbackSound *feedback, GHashTable *effects)
+{
+  g_hash_table_add (effects, (gpointer)fbd_feedback_sound_get_effect (feedback));
+}
+
+static void
+preload_sounds (FbdFeedbackManager *self)
+{
+  g_autoptr (GHashTable) effects = g_hash_table_new (g_str_hash, g_str_equal);
+  g_autofree const char **names = NULL;
+
+  if (self->sound == NULL || self->theme == NULL)
+    return;
+
+  /* Only sound feedbacks of cached themes need to be created */
+  fbd_feedback_theme_foreach_feedback_of_type (self->theme, FBD_TYPE_FEEDBACK_SOUND,
+                                               (GFunc)collect_sound_effect, effects);
+  g_hash_table_remove (effects, NULL);
+
+  names = (const char **)g_hash_table_get_keys_as_array (effects, NULL);
+  g_debug ("Preloading %u sounds", g_hash_table_size (effects));
+  fbd_dev_sound_preload (self->sound, names);
+}
+
+/*
+ * Make @theme the current theme. Events triggered from now on use the
+ * new generation while running events either end on the generation
+ * they were started with (one shot events) or switch over between two
+ * iterations (looping events) so nothing plays twice.
+ */
+static void
+publish_theme (FbdFeedbackManager *self, FbdFeedbackTheme *theme)
+{
+  GHashTableIter iter;
+  FbdEvent *event;
+
+  g_set_object (&self->theme, theme);
+  self->theme_generation++;
+  g_debug ("Published theme generation %u", self->theme_generation);
+
+  /* Cache sounds so their first playback isn't delayed */
+  preload_sounds (self);
+
+  g_hash_table_iter_init (&iter, self->events);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&event)) {
+    GSList *feedbacks;
+
+    if (fbd_event_get_generation (event) == self->theme_generation)
+      continue;
+
+    feedbacks = lookup_feedbacks (self, event, fbd_event_get_level (event));
+    fbd_event_migrate (event, feedbacks, self->theme_generation);
+    g_slist_free_full (feedbacks, g_object_unref);
+  }
+}
+
+static void
+on_theme_changed (FbdFeedbackManager *self, FbdThemeExpander *expander)
+{
+  g_autoptr (FbdFeedbackTheme) theme = NULL;
+  g_autoptr (GError) err = NULL;
+  gint64 start = g_get_monotonic_time ();
+  GHashTableIter iter;
+  FbdResidentTheme *resident;
+
+  theme = fbd_theme_expander_reload (expander, &err);
+  if (theme == NULL) {
+    g_warning ("Failed to reload theme: %s", err->message);
+    return;
+  }
+
+  g_debug ("Reloaded theme in %" G_GINT64_FORMAT " ms",
+           (g_get_monotonic_time () - start) / 1000);
+
+  g_hash_table_iter_init (&iter, self->resident_themes);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&resident)) {
+    if (resident->expander == expander)
+      g_set_object (&resident->theme, theme);
+  }
+
+  if (expander == self->expander)
+    publish_theme (self, theme);
+}
+
+
+static FbdThemeExpander *
+load_expander (FbdFeedbackManager  *self,
+               const char          *theme_name,
+               const char          *theme_file,
+               FbdFeedbackTheme   **theme,
+               GError             **err)
+{
+  g_autoptr (FbdThemeExpander) expander = NULL;
+  gint64 start = g_get_monotonic_time ();
+
+  expander = g_object_new (FBD_TYPE_THEME_EXPANDER,
+                           "theme-name", theme_name,
+                           "theme-file", theme_file,
+                           "compatibles", self->compatibles,
+                           "theme-dirs", self->theme_dirs,
+                           NULL);
+  *theme = fbd_theme_expander_load_theme_files (expander, err);
+  if (*theme == NULL)
+    return NULL;
+
+  g_debug ("Loaded theme '%s' in %" G_GINT64_FORMAT " ms", theme_name ?: theme_file,
+           (g_get_monotonic_time () - start) / 1000);
+
+  /* Pick up edits to the theme files without a reload */
+  g_signal_connect_object (expander, "theme-changed",
+                           G_CALLBACK (on_theme_changed), self,
+                           G_CONNECT_SWAPPED);
+  fbd_theme_expander_set_watch (expander, TRUE);
+
+  return g_steal_pointer (&expander);
+}
+
+
+static void
+load_current_theme (FbdFeedbackManager *self)
 {
   g_autoptr (FbdThemeExpander) expander = NULL;
   g_autoptr (FbdFeedbackTheme) theme = NULL;
   g_autoptr (GError) err = NULL;
-  g_auto (GStrv) compatibles = NULL;
   g_autofree char *theme_name = NULL;
   const char *theme_file = g_getenv (FEEDBACKD_THEME_VAR);
 
-  compatibles = gm_device_tree_get_compatibles (NULL, &err);
-  if (compatibles == NULL && err) {
-    g_debug ("Failed to get compatibles: %s", err->message);
-    g_clear_error (&err);
-  }
-
   if (theme_file == NULL)
     theme_name = g_settings_get_string (self->settings, FEEDBACKD_KEY_THEME);
 
-  expander = fbd_theme_expander_new ((const char *const *)compatibles,
-                                     theme_name, theme_file);
-  theme = fbd_theme_expander_load_theme_files (expander, &err);
-  if (theme) {
-    g_set_object(&self->theme, theme);
+  expander = load_expander (self, theme_name, theme_file, &theme, &err);
+  if (expander) {
+    publish_theme (self, theme);
+    g_set_object (&self->expander, expander);
+    g_free (self->theme_name);
+    self->theme_name = g_steal_pointer (&theme_name);
   } else {
     if (self->theme)
       g_warning ("Failed to reload theme: %s", err->message);
@@ -596,6 +787,144 @@ fbd_feedback_manager_load_theme (FbdFeedbackManager *self)
   }
 }
 
+/*
+ * Keep the themes listed in the preload-themes setting loaded so
+ * switching to them only needs to publish the already expanded
+ * theme. With @reload set all themes are loaded from the theme files
+ * again, otherwise only themes not yet resident are loaded.
+ */
+static void
+preload_themes (FbdFeedbackManager *self, gboolean reload)
+{
+  g_autoptr (GHashTable) old = NULL;
+  g_auto (GStrv) names = NULL;
+
+  old = g_steal_pointer (&self->resident_themes);
+  self->resident_themes = g_hash_table_new_full (g_str_hash,
+                                                 g_str_equal,
+                                                 g_free,
+                                                 (GDestroyNotify)fbd_resident_theme_free);
+
+  /* A theme file from the environment overrides all themes */
+  if (g_getenv (FEEDBACKD_THEME_VAR))
+    return;
+
+  names = g_settings_get_strv (self->settings, FEEDBACKD_KEY_PRELOAD_THEMES);
+  for (guint i = 0; names[i]; i++) {
+    g_autoptr (GError) err = NULL;
+    FbdResidentTheme *resident = NULL;
+    gpointer key;
+
+    if (g_hash_table_contains (self->resident_themes, names[i]))
+      continue;
+
+    if (!reload && g_hash_table_steal_extended (old, names[i], &key, (gpointer *)&resident))
+      g_free (key);
+
+    if (resident == NULL && self->expander && g_strcmp0 (self->theme_name, names[i]) == 0) {
+      /* The current theme is loaded already */
+      resident = g_new0 (FbdResidentTheme, 1);
+      resident->expander = g_object_ref (self->expander);
+      resident->theme = g_object_ref (self->theme);
+    }
+
+    if (resident == NULL) {
+      resident = g_new0 (FbdResidentTheme, 1);
+      resident->expander = load_expander (self, names[i], NULL, &resident->theme, &err);
+      if (resident->expander == NULL) {
+        g_warning ("Failed to preload theme '%s': %s", names[i], err->message);
+        fbd_resident_theme_free (resident);
+        continue;
+      }
+    }
+
+    g_hash_table_insert (self->resident_themes, g_strdup (names[i]), resident);
+  }
+
+  g_debug ("%u themes resident", g_hash_table_size (self->resident_themes));
+}
+
+
+static void
+switch_theme (FbdFeedbackManager *self)
+{
+  g_autofree char *theme_name = NULL;
+  FbdResidentTheme *resident = NULL;
+
+  if (g_getenv (FEEDBACKD_THEME_VAR) == NULL) {
+    theme_name = g_settings_get_string (self->settings, FEEDBACKD_KEY_THEME);
+    resident = g_hash_table_lookup (self->resident_themes, theme_name);
+  }
+
+  if (resident == NULL) {
+    load_current_theme (self);
+    return;
+  }
+
+  g_debug ("Switching to preloaded theme '%s'", theme_name);
+  g_set_object (&self->expander, resident->expander);
+  g_free (self->theme_name);
+  self->theme_name = g_steal_pointer (&theme_name);
+  publish_theme (self, resident->theme);
+}
+
+
+void
+fbd_feedback_manager_load_theme (FbdFeedbackManager *self)
+{
+  g_autoptr (GError) err = NULL;
+
+  g_return_if_fail (FBD_IS_FEEDBACK_MANAGER (self));
+
+  g_clear_pointer (&self->compatibles, g_strfreev);
+  self->compatibles = gm_device_tree_get_compatibles (NULL, &err);
+  if (self->compatibles == NULL && err) {
+    g_debug ("Failed to get compatibles: %s", err->message);
+    g_clear_error (&err);
+  }
+
+  /* Device quirks are reloaded along with the theme */
+  g_clear_object (&self->latency);
+  self->latency = fbd_latency_new ((const char *const *)self->compatibles);
+
+  load_current_theme (self);
+  preload_themes (self, TRUE);
+}
+
+/**
+ * fbd_feedback_manager_get_theme_sizes:
+ * @self: The feedback manager
+ * @current: (out) (optional): The name of the theme in use if it's preloaded
+ *
+ * Gets the approximate memory usage of the preloaded themes.
+ *
+ * Returns: (transfer floating): The size in bytes keyed by theme name
+ */
+GVariant *
+fbd_feedback_manager_get_theme_sizes (FbdFeedbackManager *self, const char **current)
+{
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  FbdResidentTheme *resident;
+  const char *name;
+
+  g_return_val_if_fail (FBD_IS_FEEDBACK_MANAGER (self), NULL);
+
+  if (current)
+    *current = NULL;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{st}"));
+  g_hash_table_iter_init (&iter, self->resident_themes);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&name, (gpointer *)&resident)) {
+    g_variant_builder_add (&builder, "{st}", name,
+                           (guint64)fbd_feedback_theme_get_size (resident->theme));
+    if (current && resident->expander == self->expander)
+      *current = name;
+  }
+
+  return g_variant_builder_end (&builder);
+}
+
 gboolean
 fbd_feedback_manager_set_profile (FbdFeedbackManager *self, const gchar *profile)
 {
@@ -617,3 +946,59 @@ fbd_feedback_manager_set_profile (FbdFeedbackManager *self, const gchar *profile
   g_settings_set_string (self->settings, FEEDBACKD_KEY_PROFILE, profile);
   return TRUE;
 }
+
+/**
+ * fbd_feedback_manager_claim_device:
+ * @self: The feedback manager
+ * @feedback: The feedback that wants to use its device
+ * @event_id: The event the feedback runs for
+ *
+ * Claims the device used by @feedback for the given event. The
+ * priority is the higher of the feedback's priority from the theme and
+ * the priority of the event.
+ *
+ * Returns: %TRUE if the feedback can be run now, %FALSE if it got
+ * deferred by a higher priority feedback.
+ */
+gboolean
+fbd_feedback_manager_claim_device (FbdFeedbackManager *self,
+                                   FbdFeedbackBase    *feedback,
+                                   guint               event_id)
+{
+  FbdEvent *event = NULL;
+  guint priority;
+
+  g_return_val_if_fail (FBD_IS_FEEDBACK_MANAGER (self), TRUE);
+
+  if (self->arbiter == NULL)
+    return TRUE;
+
+  priority = fbd_feedback_get_priority (feedback);
+  if (self->events)
+    event = g_hash_table_lookup (self->events, GUINT_TO_POINTER (event_id));
+  if (event)
+    priority = MAX (priority, fbd_event_get_priority (event));
+
+  return fbd_arbiter_claim (self->arbiter, event_id, feedback, priority);
+}
+
+/**
+ * fbd_feedback_manager_release_device:
+ * @self: The feedback manager
+ * @feedback: The feedback that doesn't need its device anymore
+ * @event_id: The event the feedback ran for
+ *
+ * Releases the device claimed by @feedback for the given event.
+ */
+void
+fbd_feedback_manager_release_device (FbdFeedbackManager *self,
+                                     FbdFeedbackBase    *feedback,
+                                     guint               event_id)
+{
+  g_return_if_fail (FBD_IS_FEEDBACK_MANAGER (self));
+
+  if (self->arbiter == NULL)
+    return;
+
+  fbd_arbiter_release (self->arbiter, event_id, feedback);
+}
@@ -13,6 +13,8 @@
 #include "fbd-dev-leds.h"
 #endif
 #include "fbd-dev-sound.h"
+#include "fbd-feedback-base.h"
+#include "fbd-latency.h"
 
 #include "lfb-gdbus.h"
 #include <glib-object.h>
@@ -27,7 +29,16 @@ FbdFeedbackManager *fbd_feedback_manager_get_default (void);
 FbdDevVibra *fbd_feedback_manager_get_dev_vibra (FbdFeedbackManager *self);
 FbdDevSound *fbd_feedback_manager_get_dev_sound (FbdFeedbackManager *self);
 FbdDevLeds  *fbd_feedback_manager_get_dev_leds  (FbdFeedbackManager *self);
+FbdLatency  *fbd_feedback_manager_get_latency   (FbdFeedbackManager *self);
 void         fbd_feedback_manager_load_theme    (FbdFeedbackManager *self);
+GVariant    *fbd_feedback_manager_get_theme_sizes (FbdFeedbackManager *self,
+                                                  const char        **current);
 gboolean     fbd_feedback_manager_set_profile (FbdFeedbackManager *self, const gchar *profile);
+gboolean     fbd_feedback_manager_claim_device (FbdFeedbackManager *self,
+                                                FbdFeedbackBase    *feedback,
+                                                guint               event_id);
+void         fbd_feedback_manager_release_device (FbdFeedbackManager *self,
+                                                  FbdFeedbackBase    *feedback,
+                                                  guint               event_id);
 
 G_END_DECLS
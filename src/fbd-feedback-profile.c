@@ -12,11 +12,10 @@
 #include "fbd-feedback-led.h"
 #include "fbd-feedback-vibra-periodic.h"
 #include "fbd-feedback-vibra-rumble.h"
+#include "fbd-theme-parser.h"
 
 #include <json-glib/json-glib.h>
 
-#define FBD_FEEDBACK_CLS_PREFIX "FbdFeedback"
-
 enum {
   PROP_0,
   PROP_NAME,
@@ -29,13 +28,38 @@ static GParamSpec *props[PROP_LAST_PROP];
  * SECTION:fbd-feedback-profile
  * @short_description: A profile in a #FbdFeedbackTheme
  * @Title: FbdFeedbackProfile
+ *
+ * A feedback whose event name ends in `*` like `message-new-*` is
+ * used for all events starting with that prefix that don't have a
+ * feedback of their own. When several prefixes match the longest one
+ * wins.
  */
 
+#define FBD_EVENT_NAME_WILDCARD '*'
+
+#define MAX_CACHED_MISSES 256
+
+/* A node in the trie of event name prefixes */
+typedef struct _FbdPrefixNode FbdPrefixNode;
+struct _FbdPrefixNode {
+  char             c;
+  FbdPrefixNode   *child;    /* first child */
+  FbdPrefixNode   *next;     /* next sibling */
+  FbdFeedbackBase *feedback; /* feedback for events with this prefix */
+};
+
 typedef struct _FbdFeedbackProfile {
   GObject parent;
 
   gchar *name;
   GHashTable *feedbacks; /* key: event name, value: feedback */
+  FbdPrefixNode *prefixes; /* feedbacks for event name prefixes */
+
+  /* Feedbacks not created yet, see fbd_feedback_profile_set_cached_feedbacks() */
+  GVariant *cached;
+  FbdFeedbackProfileNewFunc new_feedback;
+  gsize cached_created_size;
+  GHashTable *cached_misses; /* event names not in cached */
 } FbdFeedbackProfile;
 
 static void json_serializable_iface_init (JsonSerializableIface *iface);
@@ -77,27 +101,14 @@ fbd_feedback_profile_serializable_serialize_property (JsonSerializable *serializ
 static GType
 feedback_get_type (JsonNode *feedback_node)
 {
-  g_autofree gchar *type_name = NULL;
   JsonObject *obj = json_node_get_object (feedback_node);
   JsonNode *type_node = json_object_get_member (obj, "type");
-  GType gtype = 0;
-
-  /* Ensure all feedback types so the json parsing can use them */
-  g_type_ensure (FBD_TYPE_FEEDBACK_DUMMY);
-  g_type_ensure (FBD_TYPE_FEEDBACK_LED);
-  g_type_ensure (FBD_TYPE_FEEDBACK_VIBRA_PERIODIC);
-  g_type_ensure (FBD_TYPE_FEEDBACK_VIBRA_RUMBLE);
-  g_type_ensure (FBD_TYPE_FEEDBACK_SOUND);
+  GType gtype;
 
   g_return_val_if_fail (type_node, FBD_TYPE_FEEDBACK_DUMMY);
 
-  type_name = g_strdup_printf ("FbdFeedback%s",
-                               json_node_get_string (type_node));
-  type_name[strlen(FBD_FEEDBACK_CLS_PREFIX)] =
-    g_ascii_toupper (type_name[strlen(FBD_FEEDBACK_CLS_PREFIX)]);
-  gtype = g_type_from_name (type_name);
-
-  g_debug ("Feedback %s, type %" G_GSIZE_FORMAT, type_name, gtype);
+  gtype = fbd_theme_parser_lookup_type (json_node_get_string (type_node));
+  g_debug ("Feedback %s, type %" G_GSIZE_FORMAT, json_node_get_string (type_node), gtype);
   g_return_val_if_fail (gtype, FBD_TYPE_FEEDBACK_DUMMY);
   return gtype;
 }
@@ -149,6 +160,214 @@ fbd_feedback_profile_serializable_deserialize_property (JsonSerializable *serial
   return FALSE;
 }
 
+static void
+prefix_node_free (FbdPrefixNode *node)
+{
+  while (node) {
+    FbdPrefixNode *next = node->next;
+
+    prefix_node_free (node->child);
+    g_clear_object (&node->feedback);
+    g_free (node);
+    node = next;
+  }
+}
+
+
+static FbdPrefixNode *
+prefix_node_get_child (FbdPrefixNode *node, char c, gboolean create)
+{
+  FbdPrefixNode *child;
+
+  for (child = node->child; child; child = child->next) {
+    if (child->c == c)
+      return child;
+  }
+
+  if (!create)
+    return NULL;
+
+  child = g_new0 (FbdPrefixNode, 1);
+  child->c = c;
+  child->next = node->child;
+  node->child = child;
+
+  return child;
+}
+
+
+static gboolean
+is_prefix_pattern (const char *event_name, gsize *len)
+{
+  if (event_name == NULL)
+    return FALSE;
+
+  *len = strlen (event_name);
+
+  return *len && event_name[*len - 1] == FBD_EVENT_NAME_WILDCARD;
+}
+
+
+static void
+add_prefix (FbdFeedbackProfile *self, const char *event_name, FbdFeedbackBase *feedback)
+{
+  FbdPrefixNode *node;
+  gsize len;
+
+  if (!is_prefix_pattern (event_name, &len))
+    return;
+
+  if (self->prefixes == NULL)
+    self->prefixes = g_new0 (FbdPrefixNode, 1);
+
+  node = self->prefixes;
+  for (gsize i = 0; i < len - 1; i++)
+    node = prefix_node_get_child (node, event_name[i], TRUE);
+
+  g_set_object (&node->feedback, feedback);
+}
+
+
+static void
+rebuild_prefixes (FbdFeedbackProfile *self)
+{
+  GHashTableIter iter;
+  const char *event_name;
+  gpointer feedback;
+
+  g_clear_pointer (&self->prefixes, prefix_node_free);
+  if (self->feedbacks == NULL)
+    return;
+
+  g_hash_table_iter_init (&iter, self->feedbacks);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&event_name, &feedback))
+    add_prefix (self, event_name, feedback);
+}
+
+
+/* Find the feedback of the longest prefix of @event_name */
+static FbdFeedbackBase *
+lookup_prefix (FbdFeedbackProfile *self, const char *event_name)
+{
+  FbdPrefixNode *node = self->prefixes;
+  FbdFeedbackBase *feedback;
+
+  if (node == NULL)
+    return NULL;
+
+  feedback = node->feedback;
+  for (const char *c = event_name; *c; c++) {
+    node = prefix_node_get_child (node, *c, FALSE);
+    if (node == NULL)
+      break;
+    if (node->feedback)
+      feedback = node->feedback;
+  }
+
+  return feedback;
+}
+
+
+static FbdFeedbackBase *
+create_cached (FbdFeedbackProfile *self, GVariant *entry)
+{
+  g_autoptr (GError) err = NULL;
+  FbdFeedbackBase *feedback;
+  const char *event_name;
+
+  g_variant_get_child (entry, 0, "&s", &event_name);
+  feedback = self->new_feedback (entry, &err);
+  if (feedback == NULL) {
+    g_warning ("Failed to create feedback for %s in profile %s: %s",
+               event_name, self->name, err->message);
+    return NULL;
+  }
+
+  self->cached_created_size += g_variant_get_size (entry);
+  g_hash_table_insert (self->feedbacks, g_strdup (event_name), feedback);
+
+  return feedback;
+}
+
+
+/*
+ * Binary search the cached feedbacks, they're sorted by event name.
+ * Hits end up in the feedbacks table, misses are remembered so events
+ * that only match a prefix don't search the cache each time.
+ */
+static FbdFeedbackBase *
+lookup_cached (FbdFeedbackProfile *self, const char *event_name)
+{
+  gsize lo = 0, hi;
+
+  if (self->cached == NULL)
+    return NULL;
+
+  if (self->cached_misses && g_hash_table_contains (self->cached_misses, event_name))
+    return NULL;
+
+  hi = g_variant_n_children (self->cached);
+  while (lo < hi) {
+    gsize mid = lo + (hi - lo) / 2;
+    g_autoptr (GVariant) entry = g_variant_get_child_value (self->cached, mid);
+    const char *name;
+    int cmp;
+
+    g_variant_get_child (entry, 0, "&s", &name);
+    cmp = strcmp (event_name, name);
+    if (cmp == 0)
+      return create_cached (self, entry);
+    if (cmp < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  if (self->cached_misses == NULL)
+    self->cached_misses = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  /* Event names come from clients so don't grow without bound */
+  if (g_hash_table_size (self->cached_misses) >= MAX_CACHED_MISSES)
+    g_hash_table_remove_all (self->cached_misses);
+  g_hash_table_add (self->cached_misses, g_strdup (event_name));
+
+  return NULL;
+}
+
+
+/* Create the cached feedbacks of @type that don't exist yet */
+static void
+create_all_cached (FbdFeedbackProfile *self, GType type)
+{
+  GVariantIter iter;
+  GVariant *entry;
+  gboolean all = TRUE;
+
+  if (self->cached == NULL)
+    return;
+
+  g_variant_iter_init (&iter, self->cached);
+  while ((entry = g_variant_iter_next_value (&iter))) {
+    const char *event_name, *type_name;
+
+    g_variant_get_child (entry, 0, "&s", &event_name);
+    g_variant_get_child (entry, 1, "&s", &type_name);
+    if (!g_hash_table_contains (self->feedbacks, event_name)) {
+      if (g_type_is_a (g_type_from_name (type_name), type))
+        create_cached (self, entry);
+      else
+        all = FALSE;
+    }
+    g_variant_unref (entry);
+  }
+
+  if (all) {
+    g_clear_pointer (&self->cached, g_variant_unref);
+    g_clear_pointer (&self->cached_misses, g_hash_table_unref);
+    self->cached_created_size = 0;
+  }
+}
+
+
 static void
 fbd_feedback_profile_set_property (GObject        *object,
                                    guint         property_id,
@@ -166,6 +385,10 @@ fbd_feedback_profile_set_property (GObject        *object,
     if (self->feedbacks)
       g_hash_table_unref (self->feedbacks);
     self->feedbacks = g_value_get_boxed (value);
+    g_clear_pointer (&self->cached, g_variant_unref);
+    g_clear_pointer (&self->cached_misses, g_hash_table_unref);
+    self->cached_created_size = 0;
+    rebuild_prefixes (self);
     break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -187,6 +410,7 @@ fbd_feedback_profile_get_property (GObject  *object,
     g_value_set_string (value, self->name);
     break;
   case PROP_FEEDBACKS:
+    create_all_cached (self, FBD_TYPE_FEEDBACK_BASE);
     g_value_set_boxed (value, self->feedbacks);
     break;
   default:
@@ -201,6 +425,9 @@ fbd_feedback_profile_dispose (GObject *object)
   FbdFeedbackProfile *self = FBD_FEEDBACK_PROFILE (object);
 
   g_clear_pointer (&self->feedbacks, g_hash_table_unref);
+  g_clear_pointer (&self->prefixes, prefix_node_free);
+  g_clear_pointer (&self->cached, g_variant_unref);
+  g_clear_pointer (&self->cached_misses, g_hash_table_unref);
 
   G_OBJECT_CLASS (fbd_feedback_profile_parent_class)->dispose (object);
 }
@@ -300,14 +527,150 @@ fbd_feedback_profile_add_feedback (FbdFeedbackProfile *self, FbdFeedbackBase *fe
 
   /* TODO: allow for more than one feedback per event and profile */
   g_hash_table_insert (self->feedbacks, name, g_object_ref (feedback));
+  add_prefix (self, name, feedback);
 }
 
+/**
+ * fbd_feedback_profile_get_feedback:
+ * @self: The profile
+ * @event_name: The event name
+ *
+ * Looks up the feedback for @event_name. If there's no feedback for
+ * exactly this event the feedback of the longest matching event name
+ * prefix is used.
+ *
+ * Returns: (transfer none) (nullable): The feedback
+ */
 FbdFeedbackBase *
 fbd_feedback_profile_get_feedback (FbdFeedbackProfile *self, const char *event_name)
 {
+  FbdFeedbackBase *feedback;
+
   g_return_val_if_fail (FBD_IS_FEEDBACK_PROFILE (self), NULL);
 
-  return g_hash_table_lookup (self->feedbacks, event_name);
+  feedback = g_hash_table_lookup (self->feedbacks, event_name);
+  if (feedback == NULL && event_name)
+    feedback = lookup_cached (self, event_name);
+  if (feedback == NULL && event_name)
+    feedback = lookup_prefix (self, event_name);
+
+  return feedback;
+}
+
+/**
+ * fbd_feedback_profile_set_cached_feedbacks:
+ * @self: The profile
+ * @feedbacks: The cached feedbacks
+ * @new_func: Function to create a feedback from an entry of @feedbacks
+ *
+ * Adds feedbacks that are only created once they're looked up. This
+ * keeps themes loaded from the theme cache small as most events are
+ * never triggered. @feedbacks is an array of `(ssa{sv})` holding the
+ * event name, the feedback's type name and its properties sorted by
+ * event name. Event name prefixes must be added as feedbacks.
+ */
+void
+fbd_feedback_profile_set_cached_feedbacks (FbdFeedbackProfile        *self,
+                                           GVariant                  *feedbacks,
+                                           FbdFeedbackProfileNewFunc  new_func)
+{
+  g_return_if_fail (FBD_IS_FEEDBACK_PROFILE (self));
+  g_return_if_fail (g_variant_is_of_type (feedbacks, G_VARIANT_TYPE ("a(ssa{sv})")));
+  g_return_if_fail (new_func);
+
+  g_clear_pointer (&self->cached, g_variant_unref);
+  g_clear_pointer (&self->cached_misses, g_hash_table_unref);
+  self->cached = g_variant_ref_sink (feedbacks);
+  self->new_feedback = new_func;
+  self->cached_created_size = 0;
+}
+
+/**
+ * fbd_feedback_profile_foreach_feedback:
+ * @self: The profile
+ * @func: The function to call for each feedback
+ * @user_data: User data to pass to @func
+ *
+ * Calls @func for each #FbdFeedbackBase in @self.
+ */
+void
+fbd_feedback_profile_foreach_feedback (FbdFeedbackProfile *self, GFunc func, gpointer user_data)
+{
+  fbd_feedback_profile_foreach_feedback_of_type (self, FBD_TYPE_FEEDBACK_BASE, func, user_data);
+}
+
+/**
+ * fbd_feedback_profile_foreach_feedback_of_type:
+ * @self: The profile
+ * @type: The feedback type
+ * @func: The function to call for each feedback
+ * @user_data: User data to pass to @func
+ *
+ * Calls @func for each #FbdFeedbackBase in @self that is a @type.
+ * Cached feedbacks of other types aren't created.
+ */
+void
+fbd_feedback_profile_foreach_feedback_of_type (FbdFeedbackProfile *self,
+                                               GType               type,
+                                               GFunc               func,
+                                               gpointer            user_data)
+{
+  GHashTableIter iter;
+  gpointer feedback;
+
+  g_return_if_fail (FBD_IS_FEEDBACK_PROFILE (self));
+  g_return_if_fail (g_type_is_a (type, FBD_TYPE_FEEDBACK_BASE));
+
+  create_all_cached (self, type);
+
+  g_hash_table_iter_init (&iter, self->feedbacks);
+  while (g_hash_table_iter_next (&iter, NULL, &feedback)) {
+    if (G_TYPE_CHECK_INSTANCE_TYPE (feedback, type))
+      func (feedback, user_data);
+  }
+}
+
+/**
+ * fbd_feedback_profile_get_size:
+ * @self: The profile
+ * @seen: Feedbacks already accounted for
+ *
+ * Estimates the memory used by the profile. Feedbacks in @seen aren't
+ * accounted for again and the others are added to it. Cached feedbacks
+ * that weren't created yet account for the size of their data.
+ *
+ * Returns: The approximate size in bytes
+ */
+gsize
+fbd_feedback_profile_get_size (FbdFeedbackProfile *self, GHashTable *seen)
+{
+  GHashTableIter iter;
+  const char *event_name;
+  gpointer feedback;
+  GTypeQuery query;
+  gsize size;
+
+  g_return_val_if_fail (FBD_IS_FEEDBACK_PROFILE (self), 0);
+  g_return_val_if_fail (seen, 0);
+
+  g_type_query (FBD_TYPE_FEEDBACK_PROFILE, &query);
+  size = query.instance_size + strlen (self->name) + 1;
+
+  g_hash_table_iter_init (&iter, self->feedbacks);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&event_name, &feedback)) {
+    /* The hash table entry and its key */
+    size += 3 * sizeof (gpointer) + strlen (event_name) + 1;
+    if (!g_hash_table_add (seen, feedback))
+      continue;
+
+    g_type_query (G_OBJECT_TYPE (feedback), &query);
+    size += query.instance_size + strlen (fbd_feedback_get_event_name (feedback)) + 1;
+  }
+
+  if (self->cached)
+    size += g_variant_get_size (self->cached) - self->cached_created_size;
+
+  return size;
 }
 
 FbdFeedbackProfileLevel
@@ -366,8 +729,10 @@ fbd_feedback_profile_update (FbdFeedbackProfile *self, FbdFeedbackProfile *new)
   g_return_if_fail (g_str_equal (fbd_feedback_profile_get_name (self),
                                  fbd_feedback_profile_get_name (new)));
 
+  create_all_cached (new, FBD_TYPE_FEEDBACK_BASE);
   g_hash_table_iter_init (&iter, new->feedbacks);
   while (g_hash_table_iter_next (&iter, (gpointer)&event_name, (gpointer)&fb)) {
     g_hash_table_insert (self->feedbacks, g_strdup (event_name), g_object_ref (fb));
+    add_prefix (self, event_name, fb);
   }
 }
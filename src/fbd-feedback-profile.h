@@ -23,6 +23,17 @@ typedef enum _FbdFeedbackProfileLevel {
 
 G_DECLARE_FINAL_TYPE (FbdFeedbackProfile, fbd_feedback_profile, FBD, FEEDBACK_PROFILE, GObject);
 
+/**
+ * FbdFeedbackProfileNewFunc:
+ * @entry: A cached feedback
+ * @error: Return location for an error
+ *
+ * Creates a feedback from the cached data.
+ *
+ * Returns: (transfer full) (nullable): The feedback
+ */
+typedef FbdFeedbackBase *(*FbdFeedbackProfileNewFunc) (GVariant *entry, GError **error);
+
 FbdFeedbackProfile      *fbd_feedback_profile_new (const gchar *name);
 void                     fbd_feedback_profile_update (FbdFeedbackProfile *self,
                                                       FbdFeedbackProfile *new);
@@ -31,6 +42,18 @@ void                     fbd_feedback_profile_add_feedback (FbdFeedbackProfile *
                                                             FbdFeedbackBase *feedback);
 FbdFeedbackBase         *fbd_feedback_profile_get_feedback (FbdFeedbackProfile *self,
 							    const char *event_name);
+void                     fbd_feedback_profile_foreach_feedback (FbdFeedbackProfile *self,
+                                                                GFunc               func,
+                                                                gpointer            user_data);
+void                     fbd_feedback_profile_foreach_feedback_of_type (FbdFeedbackProfile *self,
+                                                                        GType               type,
+                                                                        GFunc               func,
+                                                                        gpointer            user_data);
+void                     fbd_feedback_profile_set_cached_feedbacks (FbdFeedbackProfile        *self,
+                                                                    GVariant                  *feedbacks,
+                                                                    FbdFeedbackProfileNewFunc  new_func);
+gsize                    fbd_feedback_profile_get_size (FbdFeedbackProfile *self,
+                                                        GHashTable         *seen);
 FbdFeedbackProfileLevel  fbd_feedback_profile_level (const char *name);
 const char*              fbd_feedback_profile_level_to_string (FbdFeedbackProfileLevel level);
 
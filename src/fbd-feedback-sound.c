@@ -42,6 +42,12 @@ on_effect_finished (FbdFeedbackSound *self)
   fbd_feedback_base_done (FBD_FEEDBACK_BASE(self));
 }
 
+static void
+on_effect_iteration (FbdFeedbackSound *self)
+{
+  fbd_feedback_base_iteration_done (FBD_FEEDBACK_BASE (self));
+}
+
 static void
 fbd_feedback_sound_run (FbdFeedbackBase *base)
 {
@@ -51,7 +57,14 @@ fbd_feedback_sound_run (FbdFeedbackBase *base)
 
   g_return_if_fail (FBD_IS_DEV_SOUND (sound));
   g_debug ("Sound event %s", self->effect);
-  fbd_dev_sound_play (sound, self, on_effect_finished);
+  if (fbd_feedback_get_looping (base)) {
+    /* The sound gets replayed until the event ends it */
+    fbd_feedback_base_set_loops_itself (base, TRUE);
+    fbd_dev_sound_play_repeat (sound, self, fbd_feedback_get_deadline (base),
+                               on_effect_iteration, on_effect_finished);
+  } else {
+    fbd_dev_sound_play (sound, self, on_effect_finished);
+  }
 }
 
 
@@ -65,6 +78,16 @@ fbd_feedback_sound_end (FbdFeedbackBase *base)
   fbd_dev_sound_stop (sound, self);
 }
 
+static void
+fbd_feedback_sound_suspend (FbdFeedbackBase *base)
+{
+  FbdFeedbackSound *self = FBD_FEEDBACK_SOUND (base);
+  FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
+  FbdDevSound *sound = fbd_feedback_manager_get_dev_sound (manager);
+
+  fbd_dev_sound_suspend (sound, self);
+}
+
 static gboolean
 fbd_feedback_sound_is_available (FbdFeedbackBase *base)
 {
@@ -133,6 +156,7 @@ fbd_feedback_sound_class_init (FbdFeedbackSoundClass *klass)
   base_class->run = fbd_feedback_sound_run;
   base_class->end = fbd_feedback_sound_end;
   base_class->is_available = fbd_feedback_sound_is_available;
+  base_class->suspend = fbd_feedback_sound_suspend;
 
   props[PROP_EFFECT] =
     g_param_spec_string (
@@ -12,6 +12,7 @@
 #include "fbd-feedback-theme.h"
 #include "fbd-feedback-vibra.h"
 #include "fbd-feedback-profile.h"
+#include "fbd-theme-parser.h"
 
 #include <json-glib/json-glib.h>
 
@@ -31,8 +32,15 @@ typedef struct _FbdFeedbackTheme {
   char *parent_name;
 
   GHashTable *profiles;
+  /* Key: munged app id, value: the app's FbdAppOverlay */
+  GHashTable *app_overlays;
 } FbdFeedbackTheme;
 
+/* The profiles of an app's overlay indexed by profile level */
+typedef struct _FbdAppOverlay {
+  FbdFeedbackProfile *profiles[FBD_FEEDBACK_PROFILE_N_PROFILES];
+} FbdAppOverlay;
+
 static void json_serializable_iface_init (JsonSerializableIface *iface);
 
 G_DEFINE_TYPE_WITH_CODE (FbdFeedbackTheme, fbd_feedback_theme, G_TYPE_OBJECT,
@@ -173,6 +181,7 @@ fbd_feedback_theme_dispose (GObject *object)
   FbdFeedbackTheme *self = FBD_FEEDBACK_THEME (object);
 
   g_clear_pointer (&self->profiles, g_hash_table_unref);
+  g_clear_pointer (&self->app_overlays, g_hash_table_unref);
 
   G_OBJECT_CLASS (fbd_feedback_theme_parent_class)->dispose (object);
 }
@@ -255,11 +264,7 @@ fbd_feedback_theme_new (const gchar *name)
 FbdFeedbackTheme *
 fbd_feedback_theme_new_from_data (const gchar *data, GError **error)
 {
-  g_autoptr (JsonNode) node = json_from_string(data, error);
-  if (!node)
-    return NULL;
-
-  return FBD_FEEDBACK_THEME (json_gobject_deserialize (FBD_TYPE_FEEDBACK_THEME, node));
+  return fbd_theme_parser_parse (data, -1, NULL, error);
 }
 
 
@@ -267,11 +272,12 @@ FbdFeedbackTheme *
 fbd_feedback_theme_new_from_file (const gchar *filename, GError **error)
 {
   g_autofree char *data = NULL;
+  gsize length;
 
-  if (!g_file_get_contents (filename, &data, NULL, error))
+  if (!g_file_get_contents (filename, &data, &length, error))
     return NULL;
 
-  return fbd_feedback_theme_new_from_data (data, error);
+  return fbd_theme_parser_parse (data, length, filename, error);
 }
 
 void
@@ -341,25 +347,295 @@ fbd_feedback_theme_get_profile (FbdFeedbackTheme *self, const char *name)
   return g_hash_table_lookup (self->profiles, name);
 }
 
+/**
+ * fbd_feedback_theme_foreach_feedback:
+ * @self: The theme
+ * @func: The function to call for each feedback
+ * @user_data: User data to pass to @func
+ *
+ * Calls @func for each #FbdFeedbackBase in all of the theme's profiles
+ * including the ones of the per application overlays.
+ */
+void
+fbd_feedback_theme_foreach_feedback (FbdFeedbackTheme *self, GFunc func, gpointer user_data)
+{
+  fbd_feedback_theme_foreach_feedback_of_type (self, FBD_TYPE_FEEDBACK_BASE, func, user_data);
+}
+
+/**
+ * fbd_feedback_theme_foreach_feedback_of_type:
+ * @self: The theme
+ * @type: The feedback type
+ * @func: The function to call for each feedback
+ * @user_data: User data to pass to @func
+ *
+ * Like fbd_feedback_theme_foreach_feedback() but only for feedbacks
+ * that are a @type. Cached feedbacks of other types aren't created.
+ */
+void
+fbd_feedback_theme_foreach_feedback_of_type (FbdFeedbackTheme *self,
+                                             GType             type,
+                                             GFunc             func,
+                                             gpointer          user_data)
+{
+  GHashTableIter iter;
+  gpointer profile;
+  FbdAppOverlay *overlay;
+
+  g_return_if_fail (FBD_IS_FEEDBACK_THEME (self));
+
+  g_hash_table_iter_init (&iter, self->profiles);
+  while (g_hash_table_iter_next (&iter, NULL, &profile))
+    fbd_feedback_profile_foreach_feedback_of_type (profile, type, func, user_data);
+
+  if (self->app_overlays == NULL)
+    return;
+
+  g_hash_table_iter_init (&iter, self->app_overlays);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&overlay)) {
+    for (int i = 0; i < FBD_FEEDBACK_PROFILE_N_PROFILES; i++) {
+      if (overlay->profiles[i])
+        fbd_feedback_profile_foreach_feedback_of_type (overlay->profiles[i], type, func, user_data);
+    }
+  }
+}
+
+/**
+ * fbd_feedback_theme_get_size:
+ * @self: The theme
+ *
+ * Estimates the memory used by the theme's profiles and feedbacks
+ * including the per application overlays. Feedbacks used in several
+ * profiles are accounted for once.
+ *
+ * Returns: The approximate size in bytes
+ */
+gsize
+fbd_feedback_theme_get_size (FbdFeedbackTheme *self)
+{
+  g_autoptr (GHashTable) seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+  GHashTableIter iter;
+  gpointer profile;
+  GTypeQuery query;
+  gsize size;
+
+  g_return_val_if_fail (FBD_IS_FEEDBACK_THEME (self), 0);
+
+  g_type_query (FBD_TYPE_FEEDBACK_THEME, &query);
+  size = query.instance_size;
+  if (self->name)
+    size += strlen (self->name) + 1;
+  if (self->parent_name)
+    size += strlen (self->parent_name) + 1;
+
+  g_hash_table_iter_init (&iter, self->profiles);
+  while (g_hash_table_iter_next (&iter, NULL, &profile)) {
+    /* The hash table entry, the key is the profile's name */
+    size += 3 * sizeof (gpointer) + strlen (fbd_feedback_profile_get_name (profile)) + 1;
+    size += fbd_feedback_profile_get_size (profile, seen);
+  }
+
+  if (self->app_overlays) {
+    gpointer app_id;
+    FbdAppOverlay *overlay;
+
+    g_hash_table_iter_init (&iter, self->app_overlays);
+    while (g_hash_table_iter_next (&iter, &app_id, (gpointer *)&overlay)) {
+      size += strlen (app_id) + 1 + 3 * sizeof (gpointer) + sizeof (FbdAppOverlay);
+      for (int i = 0; i < FBD_FEEDBACK_PROFILE_N_PROFILES; i++) {
+        if (overlay->profiles[i])
+          size += fbd_feedback_profile_get_size (overlay->profiles[i], seen);
+      }
+    }
+  }
+
+  return size;
+}
+
+static void
+fbd_app_overlay_free (FbdAppOverlay *overlay)
+{
+  for (int i = 0; i < FBD_FEEDBACK_PROFILE_N_PROFILES; i++)
+    g_clear_object (&overlay->profiles[i]);
+
+  g_free (overlay);
+}
+
+/**
+ * fbd_feedback_theme_add_app_profile:
+ * @self: The feedback theme
+ * @app_id: The munged application id
+ * @profile: A profile of the application's overlay
+ *
+ * Uses the feedbacks of @profile on top of the ones of the profile
+ * with the same name in @self for events of the given application.
+ * @app_id must be munged via fbd_event_munge_app_id().
+ */
+void
+fbd_feedback_theme_add_app_profile (FbdFeedbackTheme   *self,
+                                    const char         *app_id,
+                                    FbdFeedbackProfile *profile)
+{
+  const char *profile_name = fbd_feedback_profile_get_name (profile);
+  FbdFeedbackProfileLevel level = fbd_feedback_profile_level (profile_name);
+  FbdAppOverlay *overlay;
+
+  g_return_if_fail (FBD_IS_FEEDBACK_THEME (self));
+  g_return_if_fail (app_id);
+  g_return_if_fail (FBD_IS_FEEDBACK_PROFILE (profile));
+
+  if (level == FBD_FEEDBACK_PROFILE_LEVEL_UNKNOWN) {
+    g_warning ("Ignoring unknown profile '%s' in overlay for '%s'", profile_name, app_id);
+    return;
+  }
+
+  if (self->app_overlays == NULL) {
+    self->app_overlays = g_hash_table_new_full (g_str_hash,
+                                                g_str_equal,
+                                                g_free,
+                                                (GDestroyNotify)fbd_app_overlay_free);
+  }
+
+  overlay = g_hash_table_lookup (self->app_overlays, app_id);
+  if (overlay == NULL) {
+    overlay = g_new0 (FbdAppOverlay, 1);
+    g_hash_table_insert (self->app_overlays, g_strdup (app_id), overlay);
+  }
+  g_set_object (&overlay->profiles[level], profile);
+}
+
+/**
+ * fbd_feedback_theme_add_app_overlay:
+ * @self: The feedback theme
+ * @app_id: The application id
+ * @overlay: The application's overlay theme
+ *
+ * Adds all profiles of @overlay via
+ * fbd_feedback_theme_add_app_profile(). Only the overlay's profiles
+ * are referenced, the ones of @self are not copied.
+ */
+void
+fbd_feedback_theme_add_app_overlay (FbdFeedbackTheme *self,
+                                    const char       *app_id,
+                                    FbdFeedbackTheme *overlay)
+{
+  g_autofree char *munged_app_id = NULL;
+  GHashTableIter iter;
+  FbdFeedbackProfile *profile;
+
+  g_return_if_fail (FBD_IS_FEEDBACK_THEME (self));
+  g_return_if_fail (app_id);
+  g_return_if_fail (FBD_IS_FEEDBACK_THEME (overlay));
+
+  munged_app_id = fbd_event_munge_app_id (app_id);
+  g_hash_table_iter_init (&iter, overlay->profiles);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer)&profile))
+    fbd_feedback_theme_add_app_profile (self, munged_app_id, profile);
+}
+
+/**
+ * fbd_feedback_theme_has_app_overlay:
+ * @self: The feedback theme
+ * @app_id: The application id
+ *
+ * Checks whether events of the given application use an overlay. The
+ * application id doesn't need to be munged.
+ *
+ * Returns: %TRUE if the application has an overlay
+ */
+gboolean
+fbd_feedback_theme_has_app_overlay (FbdFeedbackTheme *self, const char *app_id)
+{
+  g_autofree char *munged_app_id = NULL;
+
+  g_return_val_if_fail (FBD_IS_FEEDBACK_THEME (self), FALSE);
+
+  if (self->app_overlays == NULL || app_id == NULL)
+    return FALSE;
+
+  munged_app_id = fbd_event_munge_app_id (app_id);
+  return g_hash_table_contains (self->app_overlays, munged_app_id);
+}
+
+/**
+ * fbd_feedback_theme_foreach_app_profile:
+ * @self: The feedback theme
+ * @func: The function to call with the munged app id and the profile
+ * @user_data: User data to pass to @func
+ *
+ * Calls @func for each profile of the per application overlays.
+ */
+void
+fbd_feedback_theme_foreach_app_profile (FbdFeedbackTheme *self,
+                                        GHFunc            func,
+                                        gpointer          user_data)
+{
+  GHashTableIter iter;
+  gpointer app_id;
+  FbdAppOverlay *overlay;
+
+  g_return_if_fail (FBD_IS_FEEDBACK_THEME (self));
+
+  if (self->app_overlays == NULL)
+    return;
+
+  g_hash_table_iter_init (&iter, self->app_overlays);
+  while (g_hash_table_iter_next (&iter, &app_id, (gpointer *)&overlay)) {
+    for (int i = 0; i < FBD_FEEDBACK_PROFILE_N_PROFILES; i++) {
+      if (overlay->profiles[i])
+        func (app_id, overlay->profiles[i], user_data);
+    }
+  }
+}
+
+/* How specific a feedback matches, exact matches beat any prefix */
+static gsize
+get_match_length (FbdFeedbackBase *feedback)
+{
+  const char *name = fbd_feedback_get_event_name (feedback);
+
+  return g_str_has_suffix (name, "*") ? strlen (name) - 1 : G_MAXSIZE;
+}
+
+
 GSList *
 fbd_feedback_theme_lookup_feedback (FbdFeedbackTheme *self,
                                     FbdFeedbackProfileLevel level,
                                     FbdEvent *event)
 {
   GSList *feedbacks = NULL;
+  FbdAppOverlay *overlay = NULL;
+  const char *app_id = fbd_event_get_munged_app_id (event);
+  const char *event_name = fbd_event_get_event (event);
+
+  if (self->app_overlays && app_id)
+    overlay = g_hash_table_lookup (self->app_overlays, app_id);
 
   for (int i = level; i >= FBD_FEEDBACK_PROFILE_LEVEL_SILENT; i--) {
     const char *profile_name = fbd_feedback_profile_level_to_string (i);
     FbdFeedbackProfile *profile = fbd_feedback_theme_get_profile (self, profile_name);
-    FbdFeedbackBase *feedback = fbd_feedback_profile_get_feedback (profile,
-								   fbd_event_get_event (event));
+    FbdFeedbackBase *feedback = NULL;
+
+    if (profile)
+      feedback = fbd_feedback_profile_get_feedback (profile, event_name);
+
+    /* The app's feedback wins unless it's a less specific wildcard */
+    if (overlay && overlay->profiles[i]) {
+      FbdFeedbackBase *app_feedback;
+
+      app_feedback = fbd_feedback_profile_get_feedback (overlay->profiles[i], event_name);
+      if (app_feedback &&
+          (feedback == NULL || get_match_length (app_feedback) >= get_match_length (feedback)))
+        feedback = app_feedback;
+    }
+
     if (feedback) {
       feedbacks = g_slist_prepend (feedbacks, g_object_ref(feedback));
     }
   }
 
   if (!g_slist_length (feedbacks))
-    g_debug ("No feedback for event %s", fbd_event_get_event (event));
+    g_debug ("No feedback for event %s", event_name);
   return feedbacks;
 }
 
@@ -31,6 +31,25 @@ const char         *fbd_feedback_theme_get_parent_name (FbdFeedbackTheme *self);
 void                fbd_feedback_theme_add_profile (FbdFeedbackTheme *self,
 						    FbdFeedbackProfile *profile);
 FbdFeedbackProfile *fbd_feedback_theme_get_profile (FbdFeedbackTheme *self, const char *name);
+void                fbd_feedback_theme_foreach_feedback (FbdFeedbackTheme *self,
+                                                         GFunc             func,
+                                                         gpointer          user_data);
+void                fbd_feedback_theme_foreach_feedback_of_type (FbdFeedbackTheme *self,
+                                                                 GType             type,
+                                                                 GFunc             func,
+                                                                 gpointer          user_data);
+gsize               fbd_feedback_theme_get_size (FbdFeedbackTheme *self);
+void                fbd_feedback_theme_add_app_overlay (FbdFeedbackTheme *self,
+                                                        const char       *app_id,
+                                                        FbdFeedbackTheme *overlay);
+void                fbd_feedback_theme_add_app_profile (FbdFeedbackTheme   *self,
+                                                        const char         *app_id,
+                                                        FbdFeedbackProfile *profile);
+gboolean            fbd_feedback_theme_has_app_overlay (FbdFeedbackTheme *self,
+                                                        const char       *app_id);
+void                fbd_feedback_theme_foreach_app_profile (FbdFeedbackTheme *self,
+                                                            GHFunc            func,
+                                                            gpointer          user_data);
 
 GSList           *fbd_feedback_theme_lookup_feedback (FbdFeedbackTheme *self,
                                                       FbdFeedbackProfileLevel profile,
@@ -80,6 +80,20 @@ fbd_feedback_vibra_end (FbdFeedbackBase *base)
   fbd_feedback_base_done (FBD_FEEDBACK_BASE(self));
 }
 
+static void
+fbd_feedback_vibra_suspend (FbdFeedbackBase *base)
+{
+  FbdFeedbackVibra *self = FBD_FEEDBACK_VIBRA (base);
+  FbdFeedbackVibraPrivate *priv = fbd_feedback_vibra_get_instance_private (self);
+  FbdFeedbackVibraClass *klass = FBD_FEEDBACK_VIBRA_GET_CLASS (self);
+
+  if (!priv->timer_id)
+    return;
+
+  g_return_if_fail (klass->end_vibra);
+  klass->end_vibra (self);
+  g_clear_handle_id (&priv->timer_id, g_source_remove);
+}
 
 static void
 fbd_feedback_vibra_set_property (GObject      *object,
@@ -130,6 +144,7 @@ fbd_feedback_vibra_class_init (FbdFeedbackVibraClass *klass)
 
   base_class->run = fbd_feedback_vibra_run;
   base_class->end = fbd_feedback_vibra_end;
+  base_class->suspend = fbd_feedback_vibra_suspend;
 
   props[PROP_DURATION] =
     g_param_spec_uint (
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#define G_LOG_DOMAIN "fbd-latency"
+
+#include "fbd-latency.h"
+
+#define LATENCY_GROUP "Latency"
+
+/**
+ * SECTION:fbd-latency
+ * @short_description: Output latency of the feedback devices
+ * @Title: FbdLatency
+ *
+ * The #FbdLatency holds the time in µs it takes from starting a
+ * feedback until the user perceives it for each device. Events use
+ * it to delay feedbacks on faster devices so all of them are noticed
+ * at the same time.
+ *
+ * The latencies are read in ms from the `Latency` group of
+ * `feedbackd/latency/<compatible>.ini` in the XDG data dirs using the
+ * first compatible that has such a file. `feedbackd/latency.ini` in
+ * the user's config dir overrides single values, e.g. after measuring
+ * them on a device:
+ *
+ * |[
+ * [Latency]
+ * sound=45
+ * vibra=3
+ * ]|
+ *
+ * The daemon doesn't measure the latencies itself. The values in use
+ * can be queried via the `GetLatencies` method of the
+ * `org.sigxcpu.Feedback.Debug` D-Bus interface.
+ */
+
+static const char * const device_keys[] = { "vibra", "sound", "leds" };
+
+struct _FbdLatency {
+  GObject    parent;
+
+  guint      latency[FBD_ARBITER_DEVICE_LAST + 1];
+};
+
+G_DEFINE_TYPE (FbdLatency, fbd_latency, G_TYPE_OBJECT)
+
+static gboolean
+load_file (FbdLatency *self, const char *path)
+{
+  g_autoptr (GKeyFile) keyfile = g_key_file_new ();
+  g_autoptr (GError) err = NULL;
+
+  if (!g_key_file_load_from_file (keyfile, path, G_KEY_FILE_NONE, &err)) {
+    if (!g_error_matches (err, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+      g_warning ("Failed to load %s: %s", path, err->message);
+    return FALSE;
+  }
+
+  g_debug ("Loading latencies from %s", path);
+  for (int i = 0; i <= FBD_ARBITER_DEVICE_LAST; i++) {
+    g_autoptr (GError) key_err = NULL;
+    gint ms;
+
+    if (!g_key_file_has_key (keyfile, LATENCY_GROUP, device_keys[i], NULL))
+      continue;
+
+    ms = g_key_file_get_integer (keyfile, LATENCY_GROUP, device_keys[i], &key_err);
+    if (key_err || ms < 0) {
+      g_warning ("Invalid %s latency in %s", device_keys[i], path);
+      continue;
+    }
+    self->latency[i] = ms * 1000;
+  }
+
+  return TRUE;
+}
+
+static void
+fbd_latency_class_init (FbdLatencyClass *klass)
+{
+}
+
+static void
+fbd_latency_init (FbdLatency *self)
+{
+}
+
+/**
+ * fbd_latency_new:
+ * @compatibles: (nullable): The device's compatibles
+ *
+ * Loads the latencies for the device with the given compatibles.
+ *
+ * Returns: The latencies
+ */
+FbdLatency *
+fbd_latency_new (const char * const *compatibles)
+{
+  FbdLatency *self = g_object_new (FBD_TYPE_LATENCY, NULL);
+  const char * const *data_dirs = g_get_system_data_dirs ();
+  g_autofree char *user_path = NULL;
+  gboolean found = FALSE;
+
+  for (int i = 0; compatibles && compatibles[i] && !found; i++) {
+    g_autofree char *name = g_strconcat (compatibles[i], ".ini", NULL);
+
+    for (int j = 0; data_dirs[j] && !found; j++) {
+      g_autofree char *path = g_build_filename (data_dirs[j], "feedbackd", "latency",
+                                                name, NULL);
+
+      found = load_file (self, path);
+    }
+  }
+
+  user_path = g_build_filename (g_get_user_config_dir (), "feedbackd", "latency.ini", NULL);
+  load_file (self, user_path);
+
+  g_debug ("Latencies: vibra %u µs, sound %u µs, leds %u µs",
+           self->latency[FBD_ARBITER_DEVICE_VIBRA],
+           self->latency[FBD_ARBITER_DEVICE_SOUND],
+           self->latency[FBD_ARBITER_DEVICE_LEDS]);
+
+  return self;
+}
+
+/**
+ * fbd_latency_get:
+ * @self: The latencies
+ * @device: The device
+ *
+ * Returns: The output latency of @device in µs
+ */
+guint
+fbd_latency_get (FbdLatency *self, FbdArbiterDevice device)
+{
+  g_return_val_if_fail (FBD_IS_LATENCY (self), 0);
+
+  if (device == FBD_ARBITER_DEVICE_NONE)
+    return 0;
+
+  g_return_val_if_fail (device <= FBD_ARBITER_DEVICE_LAST, 0);
+
+  return self->latency[device];
+}
+
+/**
+ * fbd_latency_set:
+ * @self: The latencies
+ * @device: The device
+ * @latency: The output latency in µs
+ *
+ * Sets the output latency of @device.
+ */
+void
+fbd_latency_set (FbdLatency *self, FbdArbiterDevice device, guint latency)
+{
+  g_return_if_fail (FBD_IS_LATENCY (self));
+  g_return_if_fail (device > FBD_ARBITER_DEVICE_NONE && device <= FBD_ARBITER_DEVICE_LAST);
+
+  self->latency[device] = latency;
+}
+
+/**
+ * fbd_latency_to_variant:
+ * @self: The latencies
+ *
+ * Returns: (transfer floating): The latencies in µs keyed by device name
+ */
+GVariant *
+fbd_latency_to_variant (FbdLatency *self)
+{
+  GVariantBuilder builder;
+
+  g_return_val_if_fail (FBD_IS_LATENCY (self), NULL);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{su}"));
+  for (int i = 0; i <= FBD_ARBITER_DEVICE_LAST; i++)
+    g_variant_builder_add (&builder, "{su}", device_keys[i], self->latency[i]);
+
+  return g_variant_builder_end (&builder);
+}
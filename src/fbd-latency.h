@@ -0,0 +1,23 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+#pragma once
+
+#include "fbd-arbiter.h"
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define FBD_TYPE_LATENCY (fbd_latency_get_type ())
+
+G_DECLARE_FINAL_TYPE (FbdLatency, fbd_latency, FBD, LATENCY, GObject)
+
+FbdLatency *fbd_latency_new (const char * const *compatibles);
+guint       fbd_latency_get (FbdLatency *self, FbdArbiterDevice device);
+void        fbd_latency_set (FbdLatency *self, FbdArbiterDevice device, guint latency);
+GVariant   *fbd_latency_to_variant (FbdLatency *self);
+
+G_END_DECLS
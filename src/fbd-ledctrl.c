@@ -19,6 +19,7 @@
 #define LED_BRIGHTNESS_ATTR "brightness"
 #define LED_MULTI_INTENSITY_ATTR "multi_intensity"
 #define LED_PATTERN_ATTR    "pattern"
+#define LED_HW_PATTERN_ATTR "hw_pattern"
 #define LED_REPEAT_ATTR     "repeat"
 #define LED_TRIGGER_ATTR    "trigger"
 #define LED_TRIGGER_PATTERN "pattern"
@@ -135,6 +136,8 @@ set_perms (const char *sysfs_path, const char *trigger, const char *gname)
       success = FALSE;
     if (!set_sysfs_attr_perm (sysfs_path, LED_REPEAT_ATTR, group->gr_gid))
       success = FALSE;
+    // Attribute is optional, only present with a hardware pattern engine
+    set_sysfs_attr_perm (sysfs_path, LED_HW_PATTERN_ATTR, group->gr_gid);
   }
 
   /* specific setup for other triggers goes here */
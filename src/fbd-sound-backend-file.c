@@ -0,0 +1,381 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#define G_LOG_DOMAIN "fbd-sound-backend-file"
+
+#include "fbd-sound-backend.h"
+#include "fbd-sound-backend-file.h"
+#include "fbd-sound-file.h"
+
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <string.h>
+
+#define WAV_HEADER_SIZE 44
+#define SILENCE_CHUNK_SIZE (64 * 1024)
+
+/**
+ * SECTION:fbd-sound-backend-file
+ * @short_description: Sound backend that writes WAV files
+ * @Title: FbdSoundBackendFile
+ *
+ * Instead of playing sounds this writes what would be played to WAV
+ * files named after the monotonic time in µs the playback started and
+ * the sound's effect name. WAV sounds are written as is, other formats are
+ * written as silence of the same duration. Playback completes after
+ * the sound's duration.
+ */
+
+enum {
+  PROP_0,
+  PROP_DIRECTORY,
+  PROP_LAST_PROP,
+};
+static GParamSpec *props[PROP_LAST_PROP];
+
+struct _FbdSoundBackendFile
+{
+  GObject     parent_instance;
+
+  char       *directory;
+  char       *theme_name;
+};
+
+static void initable_interface_init (GInitableIface *iface);
+static void fbd_sound_backend_interface_init (FbdSoundBackendInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (FbdSoundBackendFile, fbd_sound_backend_file, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, initable_interface_init)
+                         G_IMPLEMENT_INTERFACE (FBD_TYPE_SOUND_BACKEND,
+                                                fbd_sound_backend_interface_init))
+
+static void
+put_le16 (guint8 *p, guint16 val)
+{
+  p[0] = val & 0xff;
+  p[1] = val >> 8;
+}
+
+static void
+put_le32 (guint8 *p, guint32 val)
+{
+  put_le16 (p, val & 0xffff);
+  put_le16 (p + 2, val >> 16);
+}
+
+/* A WAV header for silence with the sound's duration as 16 bit PCM */
+static gsize
+build_silence_header (const FbdSoundFileInfo *info, guint8 wav[WAV_HEADER_SIZE])
+{
+  guint channels = info->channels ?: 2;
+  guint rate = info->rate ?: 48000;
+  gsize data_size = (guint64)rate * info->duration / 1000 * channels * 2;
+
+  memcpy (wav, "RIFF", 4);
+  put_le32 (wav + 4, 36 + data_size);
+  memcpy (wav + 8, "WAVEfmt ", 8);
+  put_le32 (wav + 16, 16);
+  put_le16 (wav + 20, 1); /* PCM */
+  put_le16 (wav + 22, channels);
+  put_le32 (wav + 24, rate);
+  put_le32 (wav + 28, rate * channels * 2);
+  put_le16 (wav + 32, channels * 2);
+  put_le16 (wav + 34, 16);
+  memcpy (wav + 36, "data", 4);
+  put_le32 (wav + 40, data_size);
+
+  return data_size;
+}
+
+static gboolean
+write_silence (GFile                  *out,
+               const FbdSoundFileInfo *info,
+               GCancellable           *cancellable,
+               GError                **error)
+{
+  static const guint8 zeros[SILENCE_CHUNK_SIZE] = { 0 };
+  g_autoptr (GFileOutputStream) stream = NULL;
+  guint8 header[WAV_HEADER_SIZE];
+  gsize data_size;
+
+  stream = g_file_replace (out, NULL, FALSE, G_FILE_CREATE_REPLACE_DESTINATION,
+                           cancellable, error);
+  if (stream == NULL)
+    return FALSE;
+
+  data_size = build_silence_header (info, header);
+  if (!g_output_stream_write_all (G_OUTPUT_STREAM (stream), header, sizeof (header),
+                                  NULL, cancellable, error))
+    return FALSE;
+
+  /* Long sounds make for large files so don't build them in memory */
+  while (data_size) {
+    gsize len = MIN (data_size, sizeof (zeros));
+
+    if (!g_output_stream_write_all (G_OUTPUT_STREAM (stream), zeros, len,
+                                    NULL, cancellable, error))
+      return FALSE;
+    data_size -= len;
+  }
+
+  return g_output_stream_close (G_OUTPUT_STREAM (stream), cancellable, error);
+}
+
+typedef struct {
+  char               *path;
+  char               *out;
+  FbdSoundFileInfo    info;
+  gint64              start;
+  GAsyncReadyCallback callback;
+  gpointer            user_data;
+} FbdSoundWriteData;
+
+static void
+write_data_free (FbdSoundWriteData *data)
+{
+  g_free (data->path);
+  g_free (data->out);
+  g_free (data);
+}
+
+static void
+write_thread (GTask        *task,
+              gpointer      source_object,
+              gpointer      task_data,
+              GCancellable *cancellable)
+{
+  FbdSoundWriteData *data = task_data;
+  g_autoptr (GFile) out = g_file_new_for_path (data->out);
+  g_autoptr (GFile) in = NULL;
+  GError *err = NULL;
+
+  if (!fbd_sound_file_get_info (data->path, &data->info, &err)) {
+    g_task_return_error (task, err);
+    return;
+  }
+
+  if (data->info.bits) {
+    in = g_file_new_for_path (data->path);
+    g_file_copy (in, out, G_FILE_COPY_OVERWRITE, cancellable, NULL, NULL, &err);
+  } else {
+    write_silence (out, &data->info, cancellable, &err);
+  }
+
+  if (err)
+    g_task_return_error (task, err);
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+static void fbd_sound_backend_file_play (FbdSoundBackend     *backend,
+                                         const char          *effect,
+                                         gboolean             cache,
+                                         GCancellable        *cancellable,
+                                         GAsyncReadyCallback  callback,
+                                         gpointer             user_data);
+
+static void
+on_sound_written (FbdSoundBackendFile *self, GAsyncResult *res, gpointer unused)
+{
+  FbdSoundWriteData *data = g_task_get_task_data (G_TASK (res));
+  g_autoptr (GError) err = NULL;
+  gint64 elapsed;
+
+  if (!g_task_propagate_boolean (G_TASK (res), &err)) {
+    g_task_report_error (self, data->callback, data->user_data, fbd_sound_backend_file_play,
+                         g_steal_pointer (&err));
+    return;
+  }
+
+  /* Playback started when the file was requested */
+  elapsed = (g_get_monotonic_time () - data->start) / 1000;
+  fbd_sound_file_complete_after (self,
+                                 elapsed < data->info.duration ? data->info.duration - elapsed : 0,
+                                 g_task_get_cancellable (G_TASK (res)),
+                                 data->callback,
+                                 data->user_data);
+}
+
+static void
+fbd_sound_backend_file_set_theme_name (FbdSoundBackend *backend, const char *name)
+{
+  FbdSoundBackendFile *self = FBD_SOUND_BACKEND_FILE (backend);
+
+  g_free (self->theme_name);
+  self->theme_name = g_strdup (name);
+}
+
+static gboolean
+fbd_sound_backend_file_get_duration (FbdSoundBackend  *backend,
+                                     const char       *effect,
+                                     guint            *duration,
+                                     GError          **error)
+{
+  FbdSoundBackendFile *self = FBD_SOUND_BACKEND_FILE (backend);
+
+  return fbd_sound_file_get_duration (self->theme_name, effect, duration, error);
+}
+
+static void
+fbd_sound_backend_file_play (FbdSoundBackend     *backend,
+                             const char          *effect,
+                             gboolean             cache,
+                             GCancellable        *cancellable,
+                             GAsyncReadyCallback  callback,
+                             gpointer             user_data)
+{
+  FbdSoundBackendFile *self = FBD_SOUND_BACKEND_FILE (backend);
+  g_autoptr (GTask) task = NULL;
+  g_autofree char *path = NULL;
+  g_autofree char *name = NULL;
+  FbdSoundWriteData *data;
+
+  path = fbd_sound_file_lookup (self->theme_name, effect);
+  if (path == NULL) {
+    g_task_report_new_error (self, callback, user_data, fbd_sound_backend_file_play,
+                             G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No sound for '%s'", effect);
+    return;
+  }
+
+  data = g_new0 (FbdSoundWriteData, 1);
+  data->start = g_get_monotonic_time ();
+  name = g_strdup_printf ("%" G_GINT64_FORMAT "-%s.wav", data->start, effect);
+  data->out = g_build_filename (self->directory, name, NULL);
+  data->path = g_steal_pointer (&path);
+  data->callback = callback;
+  data->user_data = user_data;
+
+  /* Writing long sounds takes a while, keep the main loop going */
+  task = g_task_new (self, cancellable, (GAsyncReadyCallback)on_sound_written, NULL);
+  g_task_set_task_data (task, data, (GDestroyNotify)write_data_free);
+  g_task_run_in_thread (task, write_thread);
+}
+
+static gboolean
+fbd_sound_backend_file_play_finish (FbdSoundBackend *backend, GAsyncResult *res, GError **error)
+{
+  return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+fbd_sound_backend_file_set_property (GObject      *object,
+                                     guint         property_id,
+                                     const GValue *value,
+                                     GParamSpec   *pspec)
+{
+  FbdSoundBackendFile *self = FBD_SOUND_BACKEND_FILE (object);
+
+  switch (property_id) {
+  case PROP_DIRECTORY:
+    g_free (self->directory);
+    self->directory = g_value_dup_string (value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+}
+
+static void
+fbd_sound_backend_file_get_property (GObject    *object,
+                                     guint       property_id,
+                                     GValue     *value,
+                                     GParamSpec *pspec)
+{
+  FbdSoundBackendFile *self = FBD_SOUND_BACKEND_FILE (object);
+
+  switch (property_id) {
+  case PROP_DIRECTORY:
+    g_value_set_string (value, self->directory);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+}
+
+static gboolean
+initable_init (GInitable     *initable,
+               GCancellable  *cancellable,
+               GError       **error)
+{
+  FbdSoundBackendFile *self = FBD_SOUND_BACKEND_FILE (initable);
+
+  if (g_mkdir_with_parents (self->directory, 0755) < 0) {
+    int saved_errno = errno;
+
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                 "Failed to create %s: %s", self->directory, g_strerror (saved_errno));
+    return FALSE;
+  }
+
+  g_debug ("Writing sounds to %s", self->directory);
+  return TRUE;
+}
+
+static void
+fbd_sound_backend_file_finalize (GObject *object)
+{
+  FbdSoundBackendFile *self = FBD_SOUND_BACKEND_FILE (object);
+
+  g_clear_pointer (&self->directory, g_free);
+  g_clear_pointer (&self->theme_name, g_free);
+
+  G_OBJECT_CLASS (fbd_sound_backend_file_parent_class)->finalize (object);
+}
+
+static void
+fbd_sound_backend_file_class_init (FbdSoundBackendFileClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->set_property = fbd_sound_backend_file_set_property;
+  object_class->get_property = fbd_sound_backend_file_get_property;
+  object_class->finalize = fbd_sound_backend_file_finalize;
+
+  /**
+   * FbdSoundBackendFile:directory:
+   *
+   * The directory to write the WAV files to.
+   */
+  props[PROP_DIRECTORY] =
+    g_param_spec_string ("directory", "", "",
+                         NULL,
+                         G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (object_class, PROP_LAST_PROP, props);
+}
+
+static void
+initable_interface_init (GInitableIface *iface)
+{
+  iface->init = initable_init;
+}
+
+static void
+fbd_sound_backend_interface_init (FbdSoundBackendInterface *iface)
+{
+  iface->set_theme_name = fbd_sound_backend_file_set_theme_name;
+  iface->play           = fbd_sound_backend_file_play;
+  iface->play_finish    = fbd_sound_backend_file_play_finish;
+  iface->get_duration   = fbd_sound_backend_file_get_duration;
+}
+
+static void
+fbd_sound_backend_file_init (FbdSoundBackendFile *self)
+{
+}
+
+FbdSoundBackendFile *
+fbd_sound_backend_file_new (const char *directory, GError **error)
+{
+  return FBD_SOUND_BACKEND_FILE (
+    g_initable_new (FBD_TYPE_SOUND_BACKEND_FILE,
+                    NULL,
+                    error,
+                    "directory", directory,
+                    NULL));
+}
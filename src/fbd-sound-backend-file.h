@@ -0,0 +1,18 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define FBD_TYPE_SOUND_BACKEND_FILE fbd_sound_backend_file_get_type ()
+G_DECLARE_FINAL_TYPE (FbdSoundBackendFile, fbd_sound_backend_file, FBD, SOUND_BACKEND_FILE, GObject)
+
+FbdSoundBackendFile *fbd_sound_backend_file_new (const char *directory, GError **error);
+
+G_END_DECLS
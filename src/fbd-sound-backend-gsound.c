@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#define G_LOG_DOMAIN "fbd-sound-backend-gsound"
+
+#include "fbd-sound-backend.h"
+#include "fbd-sound-backend-gsound.h"
+#include "fbd-sound-file.h"
+
+#include <gsound.h>
+
+/**
+ * SECTION:fbd-sound-backend-gsound
+ * @short_description: Sound backend using GSound
+ * @Title: FbdSoundBackendGSound
+ *
+ * Plays sounds via GSound and thus libcanberra and the system's sound
+ * server. Durations are taken from the theme's sound files.
+ */
+
+struct _FbdSoundBackendGSound
+{
+  GObject        parent_instance;
+
+  GSoundContext *ctx;
+  char          *theme_name;
+};
+
+static void initable_interface_init (GInitableIface *iface);
+static void fbd_sound_backend_interface_init (FbdSoundBackendInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (FbdSoundBackendGSound, fbd_sound_backend_gsound, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE, initable_interface_init)
+                         G_IMPLEMENT_INTERFACE (FBD_TYPE_SOUND_BACKEND,
+                                                fbd_sound_backend_interface_init))
+
+static void
+fbd_sound_backend_gsound_set_theme_name (FbdSoundBackend *backend, const char *name)
+{
+  FbdSoundBackendGSound *self = FBD_SOUND_BACKEND_GSOUND (backend);
+  g_autoptr (GError) error = NULL;
+  gboolean ok;
+
+  g_free (self->theme_name);
+  self->theme_name = g_strdup (name);
+
+  ok = gsound_context_set_attributes (self->ctx,
+                                      &error,
+                                      GSOUND_ATTR_CANBERRA_XDG_THEME_NAME,
+                                      name,
+                                      NULL);
+  if (!ok)
+    g_warning ("Failed to set sound theme name to %s: %s", name, error->message);
+}
+
+static void
+preload_thread (GTask        *task,
+                gpointer      source_object,
+                gpointer      task_data,
+                GCancellable *cancellable)
+{
+  FbdSoundBackendGSound *self = FBD_SOUND_BACKEND_GSOUND (source_object);
+  const char *effect = task_data;
+  g_autoptr (GError) err = NULL;
+
+  /* Decoding and uploading the sample blocks so keep it off the main loop */
+  if (!gsound_context_cache (self->ctx, cancellable, &err,
+                             GSOUND_ATTR_EVENT_ID, effect,
+                             NULL)) {
+    g_task_return_error (task, g_steal_pointer (&err));
+    return;
+  }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+fbd_sound_backend_gsound_preload (FbdSoundBackend     *backend,
+                                  const char          *effect,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data)
+{
+  FbdSoundBackendGSound *self = FBD_SOUND_BACKEND_GSOUND (backend);
+  g_autoptr (GTask) task = g_task_new (self, cancellable, callback, user_data);
+
+  g_task_set_task_data (task, g_strdup (effect), g_free);
+  g_task_run_in_thread (task, preload_thread);
+}
+
+static gboolean
+fbd_sound_backend_gsound_preload_finish (FbdSoundBackend *backend, GAsyncResult *res, GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (res, backend), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static gboolean
+fbd_sound_backend_gsound_get_duration (FbdSoundBackend  *backend,
+                                       const char       *effect,
+                                       guint            *duration,
+                                       GError          **error)
+{
+  FbdSoundBackendGSound *self = FBD_SOUND_BACKEND_GSOUND (backend);
+
+  return fbd_sound_file_get_duration (self->theme_name, effect, duration, error);
+}
+
+static void
+on_play_finished (GSoundContext *ctx, GAsyncResult *res, GTask *task)
+{
+  g_autoptr (GError) err = NULL;
+
+  if (gsound_context_play_full_finish (ctx, res, &err)) {
+    g_task_return_boolean (task, TRUE);
+  } else if (err->domain == GSOUND_ERROR && err->code == GSOUND_ERROR_NOTFOUND) {
+    /* Let users handle this without knowing about GSound */
+    g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "%s", err->message);
+  } else {
+    g_task_return_error (task, g_steal_pointer (&err));
+  }
+
+  g_object_unref (task);
+}
+
+static void
+fbd_sound_backend_gsound_play (FbdSoundBackend     *backend,
+                               const char          *effect,
+                               gboolean             cache,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+  FbdSoundBackendGSound *self = FBD_SOUND_BACKEND_GSOUND (backend);
+  GTask *task = g_task_new (self, cancellable, callback, user_data);
+
+  gsound_context_play_full (self->ctx, cancellable,
+                            (GAsyncReadyCallback) on_play_finished,
+                            task,
+                            GSOUND_ATTR_EVENT_ID, effect,
+                            GSOUND_ATTR_EVENT_DESCRIPTION, "Feedbackd sound feedback",
+                            GSOUND_ATTR_MEDIA_ROLE, "event",
+                            GSOUND_ATTR_CANBERRA_CACHE_CONTROL, cache ? "permanent" : "volatile",
+                            NULL);
+}
+
+static gboolean
+fbd_sound_backend_gsound_play_finish (FbdSoundBackend *backend, GAsyncResult *res, GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (res, backend), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static gboolean
+initable_init (GInitable     *initable,
+               GCancellable  *cancellable,
+               GError       **error)
+{
+  FbdSoundBackendGSound *self = FBD_SOUND_BACKEND_GSOUND (initable);
+
+  self->ctx = gsound_context_new (cancellable, error);
+
+  return self->ctx != NULL;
+}
+
+static void
+fbd_sound_backend_gsound_dispose (GObject *object)
+{
+  FbdSoundBackendGSound *self = FBD_SOUND_BACKEND_GSOUND (object);
+
+  g_clear_object (&self->ctx);
+  g_clear_pointer (&self->theme_name, g_free);
+
+  G_OBJECT_CLASS (fbd_sound_backend_gsound_parent_class)->dispose (object);
+}
+
+static void
+fbd_sound_backend_gsound_class_init (FbdSoundBackendGSoundClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = fbd_sound_backend_gsound_dispose;
+}
+
+static void
+initable_interface_init (GInitableIface *iface)
+{
+  iface->init = initable_init;
+}
+
+static void
+fbd_sound_backend_interface_init (FbdSoundBackendInterface *iface)
+{
+  iface->set_theme_name = fbd_sound_backend_gsound_set_theme_name;
+  iface->preload        = fbd_sound_backend_gsound_preload;
+  iface->preload_finish = fbd_sound_backend_gsound_preload_finish;
+  iface->play           = fbd_sound_backend_gsound_play;
+  iface->play_finish    = fbd_sound_backend_gsound_play_finish;
+  iface->get_duration   = fbd_sound_backend_gsound_get_duration;
+}
+
+static void
+fbd_sound_backend_gsound_init (FbdSoundBackendGSound *self)
+{
+}
+
+FbdSoundBackendGSound *
+fbd_sound_backend_gsound_new (GError **error)
+{
+  return FBD_SOUND_BACKEND_GSOUND (
+    g_initable_new (FBD_TYPE_SOUND_BACKEND_GSOUND,
+                    NULL,
+                    error,
+                    NULL));
+}
@@ -0,0 +1,18 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define FBD_TYPE_SOUND_BACKEND_GSOUND fbd_sound_backend_gsound_get_type ()
+G_DECLARE_FINAL_TYPE (FbdSoundBackendGSound, fbd_sound_backend_gsound, FBD, SOUND_BACKEND_GSOUND, GObject)
+
+FbdSoundBackendGSound *fbd_sound_backend_gsound_new (GError **error);
+
+G_END_DECLS
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#define G_LOG_DOMAIN "fbd-sound-backend-null"
+
+#include "fbd-sound-backend.h"
+#include "fbd-sound-backend-null.h"
+#include "fbd-sound-file.h"
+
+/**
+ * SECTION:fbd-sound-backend-null
+ * @short_description: Sound backend that plays nothing
+ * @Title: FbdSoundBackendNull
+ *
+ * Looks up sounds in the sound theme like a real backend would but
+ * instead of playing them just completes after their duration. Useful
+ * for tests and benchmarks on systems without a sound server.
+ */
+
+struct _FbdSoundBackendNull
+{
+  GObject     parent_instance;
+
+  char       *theme_name;
+  /* Key: effect, value: duration in ms */
+  GHashTable *durations;
+};
+
+static void fbd_sound_backend_interface_init (FbdSoundBackendInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (FbdSoundBackendNull, fbd_sound_backend_null, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (FBD_TYPE_SOUND_BACKEND,
+                                                fbd_sound_backend_interface_init))
+
+static void
+fbd_sound_backend_null_set_theme_name (FbdSoundBackend *backend, const char *name)
+{
+  FbdSoundBackendNull *self = FBD_SOUND_BACKEND_NULL (backend);
+
+  if (g_strcmp0 (self->theme_name, name) == 0)
+    return;
+
+  g_free (self->theme_name);
+  self->theme_name = g_strdup (name);
+  g_hash_table_remove_all (self->durations);
+}
+
+static gboolean
+fbd_sound_backend_null_get_duration (FbdSoundBackend  *backend,
+                                     const char       *effect,
+                                     guint            *duration,
+                                     GError          **error)
+{
+  FbdSoundBackendNull *self = FBD_SOUND_BACKEND_NULL (backend);
+  gpointer value;
+
+  if (g_hash_table_lookup_extended (self->durations, effect, NULL, &value)) {
+    *duration = GPOINTER_TO_UINT (value);
+    return TRUE;
+  }
+
+  if (!fbd_sound_file_get_duration (self->theme_name, effect, duration, error))
+    return FALSE;
+
+  g_hash_table_insert (self->durations, g_strdup (effect), GUINT_TO_POINTER (*duration));
+  return TRUE;
+}
+
+static void
+fbd_sound_backend_null_preload (FbdSoundBackend     *backend,
+                                const char          *effect,
+                                GCancellable        *cancellable,
+                                GAsyncReadyCallback  callback,
+                                gpointer             user_data)
+{
+  g_autoptr (GTask) task = g_task_new (backend, cancellable, callback, user_data);
+  g_autoptr (GError) err = NULL;
+  guint duration;
+
+  /* Only parses a header so no need for a thread */
+  if (!fbd_sound_backend_null_get_duration (backend, effect, &duration, &err)) {
+    g_task_return_error (task, g_steal_pointer (&err));
+    return;
+  }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static gboolean
+fbd_sound_backend_null_preload_finish (FbdSoundBackend *backend, GAsyncResult *res, GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (res, backend), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+fbd_sound_backend_null_play (FbdSoundBackend     *backend,
+                             const char          *effect,
+                             gboolean             cache,
+                             GCancellable        *cancellable,
+                             GAsyncReadyCallback  callback,
+                             gpointer             user_data)
+{
+  FbdSoundBackendNull *self = FBD_SOUND_BACKEND_NULL (backend);
+  g_autoptr (GError) err = NULL;
+  guint duration;
+
+  if (!fbd_sound_backend_null_get_duration (backend, effect, &duration, &err)) {
+    g_task_report_error (self, callback, user_data, fbd_sound_backend_null_play,
+                         g_steal_pointer (&err));
+    return;
+  }
+
+  g_debug ("Playing '%s' for %u ms", effect, duration);
+  fbd_sound_file_complete_after (self, duration, cancellable, callback, user_data);
+}
+
+static gboolean
+fbd_sound_backend_null_play_finish (FbdSoundBackend *backend, GAsyncResult *res, GError **error)
+{
+  return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+fbd_sound_backend_null_finalize (GObject *object)
+{
+  FbdSoundBackendNull *self = FBD_SOUND_BACKEND_NULL (object);
+
+  g_clear_pointer (&self->theme_name, g_free);
+  g_clear_pointer (&self->durations, g_hash_table_destroy);
+
+  G_OBJECT_CLASS (fbd_sound_backend_null_parent_class)->finalize (object);
+}
+
+static void
+fbd_sound_backend_null_class_init (FbdSoundBackendNullClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = fbd_sound_backend_null_finalize;
+}
+
+static void
+fbd_sound_backend_interface_init (FbdSoundBackendInterface *iface)
+{
+  iface->set_theme_name = fbd_sound_backend_null_set_theme_name;
+  iface->preload        = fbd_sound_backend_null_preload;
+  iface->preload_finish = fbd_sound_backend_null_preload_finish;
+  iface->play           = fbd_sound_backend_null_play;
+  iface->play_finish    = fbd_sound_backend_null_play_finish;
+  iface->get_duration   = fbd_sound_backend_null_get_duration;
+}
+
+static void
+fbd_sound_backend_null_init (FbdSoundBackendNull *self)
+{
+  self->durations = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+FbdSoundBackendNull *
+fbd_sound_backend_null_new (GError **error)
+{
+  return g_object_new (FBD_TYPE_SOUND_BACKEND_NULL, NULL);
+}
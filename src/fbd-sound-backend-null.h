@@ -0,0 +1,18 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define FBD_TYPE_SOUND_BACKEND_NULL fbd_sound_backend_null_get_type ()
+G_DECLARE_FINAL_TYPE (FbdSoundBackendNull, fbd_sound_backend_null, FBD, SOUND_BACKEND_NULL, GObject)
+
+FbdSoundBackendNull *fbd_sound_backend_null_new (GError **error);
+
+G_END_DECLS
@@ -0,0 +1,377 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#define G_LOG_DOMAIN "fbd-sound-backend"
+
+#include "fbd.h"
+#include "fbd-sound-backend.h"
+#include "fbd-sound-backend-file.h"
+#include "fbd-sound-backend-gsound.h"
+#include "fbd-sound-backend-null.h"
+
+#define FEEDBACKD_SOUND_FILE_DIR_VAR "FEEDBACKD_SOUND_FILE_DIR"
+
+/**
+ * SECTION:fbd-sound-backend
+ * @short_description: Interface for sound backends
+ * @Title: FbdSoundBackend
+ *
+ * A #FbdSoundBackend plays sounds from the sound theme for
+ * #FbdDevSound. Playback is stopped by cancelling the #GCancellable
+ * passed to fbd_sound_backend_play().
+ *
+ * Sounds that should repeat until stopped are played via
+ * fbd_sound_backend_play_repeat(). Each repetition is a new playback
+ * request started once the previous one completed so there's a short
+ * gap in between. The sample stays cached in the sound server so it
+ * isn't decoded again. This isn't gapless looping: GSound can't loop
+ * a single stream.
+ */
+
+typedef struct _FbdSoundRepeat {
+  char                         *effect;
+  FbdSoundBackendIterationFunc  iteration;
+  gpointer                      user_data;
+  guint                         idle_id;
+  gulong                        cancel_id;
+  gboolean                      playing;
+  gboolean                      done;
+  GError                       *error;
+} FbdSoundRepeat;
+
+G_DEFINE_INTERFACE (FbdSoundBackend, fbd_sound_backend, G_TYPE_OBJECT)
+
+static void
+fbd_sound_backend_default_init (FbdSoundBackendInterface *iface)
+{
+  /* Nothing yet */
+}
+
+/**
+ * fbd_sound_backend_new:
+ * @name: (nullable): The backend to use: `gsound`, `null` or `file`
+ * @error: Return location for an error
+ *
+ * Creates the sound backend with the given name. The `file` backend
+ * writes to the directory given in `FEEDBACKD_SOUND_FILE_DIR`
+ * defaulting to a directory in the user's runtime dir.
+ *
+ * Returns: (transfer full) (nullable): The backend
+ */
+FbdSoundBackend *
+fbd_sound_backend_new (const char *name, GError **error)
+{
+  if (name == NULL || g_strcmp0 (name, "gsound") == 0)
+    return FBD_SOUND_BACKEND (fbd_sound_backend_gsound_new (error));
+
+  if (g_strcmp0 (name, "null") == 0)
+    return FBD_SOUND_BACKEND (fbd_sound_backend_null_new (error));
+
+  if (g_strcmp0 (name, "file") == 0) {
+    const char *dir = g_getenv (FEEDBACKD_SOUND_FILE_DIR_VAR);
+    g_autofree char *default_dir = NULL;
+
+    if (dir == NULL) {
+      default_dir = g_build_filename (g_get_user_runtime_dir (), "feedbackd", "sounds", NULL);
+      dir = default_dir;
+    }
+    return FBD_SOUND_BACKEND (fbd_sound_backend_file_new (dir, error));
+  }
+
+  g_set_error (error, fbd_error_quark (), FBD_ERROR_FAILED,
+               "Unknown sound backend '%s'", name);
+  return NULL;
+}
+
+void
+fbd_sound_backend_set_theme_name (FbdSoundBackend *self, const char *name)
+{
+  FbdSoundBackendInterface *iface;
+
+  g_return_if_fail (FBD_IS_SOUND_BACKEND (self));
+
+  iface = FBD_SOUND_BACKEND_GET_IFACE (self);
+  if (iface->set_theme_name)
+    iface->set_theme_name (self, name);
+}
+
+/**
+ * fbd_sound_backend_preload:
+ * @self: The sound backend
+ * @effect: The sound effect to cache
+ * @cancellable: (nullable): A cancellable
+ * @callback: Invoked once the effect got cached
+ * @user_data: The user data passed to @callback
+ *
+ * Caches the given effect so it can be played with less latency.
+ * Backends must not block the main loop while doing so.
+ */
+void
+fbd_sound_backend_preload (FbdSoundBackend     *self,
+                           const char          *effect,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+  FbdSoundBackendInterface *iface;
+
+  g_return_if_fail (FBD_IS_SOUND_BACKEND (self));
+
+  iface = FBD_SOUND_BACKEND_GET_IFACE (self);
+  /* Nothing to preload */
+  if (iface->preload == NULL) {
+    g_autoptr (GTask) task = g_task_new (self, cancellable, callback, user_data);
+
+    g_task_set_source_tag (task, fbd_sound_backend_preload);
+    g_task_return_boolean (task, TRUE);
+    return;
+  }
+
+  iface->preload (self, effect, cancellable, callback, user_data);
+}
+
+gboolean
+fbd_sound_backend_preload_finish (FbdSoundBackend *self, GAsyncResult *res, GError **error)
+{
+  FbdSoundBackendInterface *iface;
+
+  g_return_val_if_fail (FBD_IS_SOUND_BACKEND (self), FALSE);
+
+  iface = FBD_SOUND_BACKEND_GET_IFACE (self);
+  if (g_task_is_valid (res, self) &&
+      g_task_get_source_tag (G_TASK (res)) == fbd_sound_backend_preload)
+    return g_task_propagate_boolean (G_TASK (res), error);
+
+  g_return_val_if_fail (iface->preload_finish != NULL, FALSE);
+  return iface->preload_finish (self, res, error);
+}
+
+void
+fbd_sound_backend_play (FbdSoundBackend     *self,
+                        const char          *effect,
+                        gboolean             cache,
+                        GCancellable        *cancellable,
+                        GAsyncReadyCallback  callback,
+                        gpointer             user_data)
+{
+  FbdSoundBackendInterface *iface;
+
+  g_return_if_fail (FBD_IS_SOUND_BACKEND (self));
+
+  iface = FBD_SOUND_BACKEND_GET_IFACE (self);
+  g_return_if_fail (iface->play != NULL);
+  iface->play (self, effect, cache, cancellable, callback, user_data);
+}
+
+gboolean
+fbd_sound_backend_play_finish (FbdSoundBackend *self, GAsyncResult *res, GError **error)
+{
+  FbdSoundBackendInterface *iface;
+
+  g_return_val_if_fail (FBD_IS_SOUND_BACKEND (self), FALSE);
+
+  iface = FBD_SOUND_BACKEND_GET_IFACE (self);
+  g_return_val_if_fail (iface->play_finish != NULL, FALSE);
+  return iface->play_finish (self, res, error);
+}
+
+/**
+ * fbd_sound_backend_get_duration:
+ * @self: The backend
+ * @effect: The sound effect
+ * @duration: (out): Return location for the duration in ms
+ * @error: Return location for an error
+ *
+ * Gets how long @effect plays.
+ *
+ * Returns: %TRUE if the duration is known
+ */
+gboolean
+fbd_sound_backend_get_duration (FbdSoundBackend  *self,
+                                const char       *effect,
+                                guint            *duration,
+                                GError          **error)
+{
+  FbdSoundBackendInterface *iface;
+
+  g_return_val_if_fail (FBD_IS_SOUND_BACKEND (self), FALSE);
+  g_return_val_if_fail (duration, FALSE);
+
+  iface = FBD_SOUND_BACKEND_GET_IFACE (self);
+  if (iface->get_duration == NULL) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                 "Backend can't determine sound durations");
+    return FALSE;
+  }
+
+  return iface->get_duration (self, effect, duration, error);
+}
+
+
+static void
+fbd_sound_repeat_free (FbdSoundRepeat *repeat)
+{
+  g_clear_handle_id (&repeat->idle_id, g_source_remove);
+  g_clear_pointer (&repeat->effect, g_free);
+  g_clear_error (&repeat->error);
+  g_free (repeat);
+}
+
+
+/* Complete once playback failed or got cancelled and nothing plays anymore */
+static void
+maybe_complete_repeat (GTask *task)
+{
+  FbdSoundRepeat *repeat = g_task_get_task_data (task);
+  GCancellable *cancellable = g_task_get_cancellable (task);
+
+  if (repeat->done || repeat->playing)
+    return;
+
+  if (repeat->error == NULL && !g_cancellable_is_cancelled (cancellable))
+    return;
+
+  repeat->done = TRUE;
+  g_clear_handle_id (&repeat->idle_id, g_source_remove);
+  if (repeat->cancel_id) {
+    g_cancellable_disconnect (cancellable, repeat->cancel_id);
+    repeat->cancel_id = 0;
+  }
+
+  if (repeat->error)
+    g_task_return_error (task, g_steal_pointer (&repeat->error));
+  else
+    g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Playback cancelled");
+}
+
+
+static void play_iteration (GTask *task);
+
+static void
+on_iteration_finished (FbdSoundBackend *self, GAsyncResult *res, GTask *task)
+{
+  FbdSoundRepeat *repeat = g_task_get_task_data (task);
+  g_autoptr (GError) err = NULL;
+
+  repeat->playing = FALSE;
+
+  if (!fbd_sound_backend_play_finish (self, res, &err) &&
+      !g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+      repeat->error == NULL) {
+    repeat->error = g_steal_pointer (&err);
+  }
+
+  if (repeat->error || g_cancellable_is_cancelled (g_task_get_cancellable (task))) {
+    maybe_complete_repeat (task);
+    g_object_unref (task);
+    return;
+  }
+
+  /* The previous iteration is over, let the caller know and go on */
+  (*repeat->iteration) (repeat->user_data);
+
+  if (g_cancellable_is_cancelled (g_task_get_cancellable (task)))
+    maybe_complete_repeat (task);
+  else
+    play_iteration (task);
+
+  g_object_unref (task);
+}
+
+
+static void
+play_iteration (GTask *task)
+{
+  FbdSoundRepeat *repeat = g_task_get_task_data (task);
+
+  repeat->playing = TRUE;
+  /* Repeated sounds stay in the sound server's cache so replays don't decode again */
+  fbd_sound_backend_play (g_task_get_source_object (task),
+                          repeat->effect,
+                          TRUE,
+                          g_task_get_cancellable (task),
+                          (GAsyncReadyCallback) on_iteration_finished,
+                          g_object_ref (task));
+}
+
+
+static gboolean
+on_repeat_cancelled_idle (GTask *task)
+{
+  FbdSoundRepeat *repeat = g_task_get_task_data (task);
+
+  repeat->idle_id = 0;
+  /* A running iteration is cancelled as well and completes the task */
+  maybe_complete_repeat (task);
+
+  return G_SOURCE_REMOVE;
+}
+
+
+static void
+on_repeat_cancelled (GCancellable *cancellable, GTask *task)
+{
+  FbdSoundRepeat *repeat = g_task_get_task_data (task);
+
+  /* Can't disconnect from within the handler so complete from an idle */
+  if (repeat->idle_id == 0) {
+    repeat->idle_id = g_idle_add_full (G_PRIORITY_DEFAULT,
+                                       (GSourceFunc) on_repeat_cancelled_idle,
+                                       g_object_ref (task),
+                                       g_object_unref);
+  }
+}
+
+/**
+ * fbd_sound_backend_play_repeat:
+ * @self: The backend
+ * @effect: The sound effect
+ * @iteration: Invoked each time an iteration finished
+ * @cancellable: (nullable): A cancellable to stop playback
+ * @callback: Invoked once playback stopped
+ * @user_data: The user data for @iteration and @callback
+ *
+ * Plays @effect again each time it finished until @cancellable is
+ * cancelled or playback fails. Cancelling from within @iteration
+ * keeps the next iteration from starting. Use
+ * fbd_sound_backend_play_repeat_finish() to finish.
+ */
+void
+fbd_sound_backend_play_repeat (FbdSoundBackend              *self,
+                               const char                   *effect,
+                               FbdSoundBackendIterationFunc  iteration,
+                               GCancellable                 *cancellable,
+                               GAsyncReadyCallback           callback,
+                               gpointer                      user_data)
+{
+  g_autoptr (GTask) task = NULL;
+  FbdSoundRepeat *repeat;
+
+  g_return_if_fail (FBD_IS_SOUND_BACKEND (self));
+  g_return_if_fail (iteration);
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  repeat = g_new0 (FbdSoundRepeat, 1);
+  repeat->effect = g_strdup (effect);
+  repeat->iteration = iteration;
+  repeat->user_data = user_data;
+  g_task_set_task_data (task, repeat, (GDestroyNotify) fbd_sound_repeat_free);
+
+  if (cancellable) {
+    repeat->cancel_id = g_cancellable_connect (cancellable,
+                                               G_CALLBACK (on_repeat_cancelled),
+                                               task, NULL);
+  }
+
+  play_iteration (task);
+}
+
+gboolean
+fbd_sound_backend_play_repeat_finish (FbdSoundBackend *self, GAsyncResult *res, GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (res, self), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (res), error);
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define FBD_TYPE_SOUND_BACKEND fbd_sound_backend_get_type()
+G_DECLARE_INTERFACE (FbdSoundBackend, fbd_sound_backend, FBD, SOUND_BACKEND, GObject)
+
+typedef void (*FbdSoundBackendIterationFunc) (gpointer user_data);
+
+struct _FbdSoundBackendInterface
+{
+  GTypeInterface parent_iface;
+
+  void     (*set_theme_name) (FbdSoundBackend     *self,
+                              const char          *name);
+  void     (*preload)        (FbdSoundBackend     *self,
+                              const char          *effect,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data);
+  gboolean (*preload_finish) (FbdSoundBackend     *self,
+                              GAsyncResult        *res,
+                              GError             **error);
+  void     (*play)           (FbdSoundBackend     *self,
+                              const char          *effect,
+                              gboolean             cache,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data);
+  gboolean (*play_finish)    (FbdSoundBackend     *self,
+                              GAsyncResult        *res,
+                              GError             **error);
+  gboolean (*get_duration)   (FbdSoundBackend     *self,
+                              const char          *effect,
+                              guint               *duration,
+                              GError             **error);
+};
+
+FbdSoundBackend *fbd_sound_backend_new (const char *name, GError **error);
+void     fbd_sound_backend_set_theme_name (FbdSoundBackend *self, const char *name);
+void     fbd_sound_backend_preload (FbdSoundBackend     *self,
+                                    const char          *effect,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data);
+gboolean fbd_sound_backend_preload_finish (FbdSoundBackend  *self,
+                                           GAsyncResult     *res,
+                                           GError          **error);
+void     fbd_sound_backend_play (FbdSoundBackend     *self,
+                                 const char          *effect,
+                                 gboolean             cache,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data);
+gboolean fbd_sound_backend_play_finish (FbdSoundBackend  *self,
+                                        GAsyncResult     *res,
+                                        GError          **error);
+void     fbd_sound_backend_play_repeat (FbdSoundBackend              *self,
+                                        const char                   *effect,
+                                        FbdSoundBackendIterationFunc  iteration,
+                                        GCancellable                 *cancellable,
+                                        GAsyncReadyCallback           callback,
+                                        gpointer                      user_data);
+gboolean fbd_sound_backend_play_repeat_finish (FbdSoundBackend  *self,
+                                               GAsyncResult     *res,
+                                               GError          **error);
+gboolean fbd_sound_backend_get_duration (FbdSoundBackend  *self,
+                                         const char       *effect,
+                                         guint            *duration,
+                                         GError          **error);
+
+G_END_DECLS
@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ * SPDX-License-Identifier: GPL-3.0+
+ *
+ * See http://0pointer.de/public/sound-theme-spec.html
+ */
+
+#define G_LOG_DOMAIN "fbd-sound-file"
+
+#include "fbd.h"
+#include "fbd-sound-file.h"
+
+#include <string.h>
+
+#define FALLBACK_THEME "freedesktop"
+
+/**
+ * SECTION:fbd-sound-file
+ * @short_description: Helpers for backends that handle sound files themselves
+ * @Title: FbdSoundFile
+ *
+ * Sound theme lookup and just enough parsing of WAV and Ogg files to
+ * know how long a sound plays.
+ */
+
+static const char * const extensions[] = { ".oga", ".ogg", ".wav", NULL };
+
+static char *
+lookup_in_dir (const char *data_dir, const char *theme_name, const char *effect)
+{
+  for (int i = 0; extensions[i]; i++) {
+    g_autofree char *name = g_strconcat (effect, extensions[i], NULL);
+    g_autofree char *path = g_build_filename (data_dir, "sounds", theme_name,
+                                              "stereo", name, NULL);
+
+    if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+      return g_steal_pointer (&path);
+  }
+
+  return NULL;
+}
+
+/**
+ * fbd_sound_file_lookup:
+ * @theme_name: (nullable): The sound theme to look in
+ * @effect: The sound effect
+ *
+ * Looks up the file for @effect in @theme_name falling back to the
+ * freedesktop theme.
+ *
+ * Returns: (nullable): The file's path
+ */
+char *
+fbd_sound_file_lookup (const char *theme_name, const char *effect)
+{
+  const char * const *dirs = g_get_system_data_dirs ();
+  const char *themes[] = { theme_name, FALLBACK_THEME, NULL };
+  char *path;
+
+  g_return_val_if_fail (effect, NULL);
+
+  for (int t = theme_name ? 0 : 1; themes[t]; t++) {
+    path = lookup_in_dir (g_get_user_data_dir (), themes[t], effect);
+    if (path)
+      return path;
+
+    for (int i = 0; dirs[i]; i++) {
+      path = lookup_in_dir (dirs[i], themes[t], effect);
+      if (path)
+        return path;
+    }
+  }
+
+  return NULL;
+}
+
+/* Sound files aren't necessarily aligned */
+static guint16
+read_le16 (const guint8 *p)
+{
+  return p[0] | p[1] << 8;
+}
+
+static guint32
+read_le32 (const guint8 *p)
+{
+  return read_le16 (p) | (guint32)read_le16 (p + 2) << 16;
+}
+
+static guint64
+read_le64 (const guint8 *p)
+{
+  return read_le32 (p) | (guint64)read_le32 (p + 4) << 32;
+}
+
+static gboolean
+parse_wav (const guint8 *data, gsize len, FbdSoundFileInfo *info)
+{
+  gsize pos = 12;
+  guint byte_rate = 0;
+
+  if (len < 12 || memcmp (data, "RIFF", 4) || memcmp (data + 8, "WAVE", 4))
+    return FALSE;
+
+  while (pos + 8 <= len) {
+    const guint8 *chunk = data + pos;
+    guint32 size = read_le32 (chunk + 4);
+
+    if (memcmp (chunk, "fmt ", 4) == 0 && size >= 16 && pos + 8 + 16 <= len) {
+      info->channels = read_le16 (chunk + 10);
+      info->rate = read_le32 (chunk + 12);
+      byte_rate = read_le32 (chunk + 16);
+      info->bits = read_le16 (chunk + 22);
+    } else if (memcmp (chunk, "data", 4) == 0) {
+      if (!byte_rate)
+        return FALSE;
+
+      info->data_offset = pos + 8;
+      info->data_size = MIN (size, len - info->data_offset);
+      info->duration = (guint64)info->data_size * 1000 / byte_rate;
+      return TRUE;
+    }
+
+    /* Chunks are padded to an even size */
+    pos += 8 + size + (size & 1);
+  }
+
+  return FALSE;
+}
+
+static gboolean
+parse_ogg (const guint8 *data, gsize len, FbdSoundFileInfo *info)
+{
+  const guint8 *packet;
+  guint64 granule = 0;
+  guint pre_skip = 0;
+  gsize nsegs;
+
+  if (len < 28 || memcmp (data, "OggS", 4))
+    return FALSE;
+
+  /* The first page holds the codec's identification header */
+  nsegs = data[26];
+  if (27 + nsegs + 19 > len)
+    return FALSE;
+  packet = data + 27 + nsegs;
+
+  if (memcmp (packet, "\x01vorbis", 7) == 0) {
+    info->channels = packet[11];
+    info->rate = read_le32 (packet + 12);
+  } else if (memcmp (packet, "OpusHead", 8) == 0) {
+    info->channels = packet[9];
+    pre_skip = read_le16 (packet + 10);
+    /* Opus granule positions always use 48kHz */
+    info->rate = 48000;
+  } else {
+    return FALSE;
+  }
+
+  if (!info->rate)
+    return FALSE;
+
+  /* The last page's granule position is the number of samples */
+  for (gsize pos = len - 14; pos > 0; pos--) {
+    if (memcmp (data + pos, "OggS", 4) == 0) {
+      granule = read_le64 (data + pos + 6);
+      break;
+    }
+  }
+
+  info->duration = granule > pre_skip ? (granule - pre_skip) * 1000 / info->rate : 0;
+  return TRUE;
+}
+
+/**
+ * fbd_sound_file_get_info:
+ * @path: The sound file
+ * @info: (out): Return location for the file's info
+ * @error: Return location for an error
+ *
+ * Gets a sound file's duration. WAV files also get their PCM data's
+ * format and location.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fbd_sound_file_get_info (const char *path, FbdSoundFileInfo *info, GError **error)
+{
+  g_autoptr (GMappedFile) file = NULL;
+  const guint8 *data;
+  gsize len;
+
+  g_return_val_if_fail (path, FALSE);
+  g_return_val_if_fail (info, FALSE);
+
+  memset (info, 0, sizeof (*info));
+
+  file = g_mapped_file_new (path, FALSE, error);
+  if (file == NULL)
+    return FALSE;
+
+  data = (const guint8 *)g_mapped_file_get_contents (file);
+  len = g_mapped_file_get_length (file);
+
+  if (parse_wav (data, len, info) || parse_ogg (data, len, info))
+    return TRUE;
+
+  memset (info, 0, sizeof (*info));
+  g_set_error (error, fbd_error_quark (), FBD_ERROR_FAILED,
+               "Unsupported sound file %s", path);
+  return FALSE;
+}
+
+/**
+ * fbd_sound_file_get_duration:
+ * @theme_name: (nullable): The sound theme to look in
+ * @effect: The sound effect
+ * @duration: (out): Return location for the duration in ms
+ * @error: Return location for an error
+ *
+ * Looks up @effect like fbd_sound_file_lookup() and gets its duration.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fbd_sound_file_get_duration (const char  *theme_name,
+                             const char  *effect,
+                             guint       *duration,
+                             GError     **error)
+{
+  g_autofree char *path = NULL;
+  FbdSoundFileInfo info;
+
+  g_return_val_if_fail (duration, FALSE);
+
+  path = fbd_sound_file_lookup (theme_name, effect);
+  if (path == NULL) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No sound for '%s'", effect);
+    return FALSE;
+  }
+
+  if (!fbd_sound_file_get_info (path, &info, error))
+    return FALSE;
+
+  *duration = info.duration;
+  return TRUE;
+}
+
+
+typedef struct {
+  guint   timeout_id;
+  gulong  cancel_id;
+} FbdTimedData;
+
+
+static void
+fbd_timed_data_free (FbdTimedData *data)
+{
+  g_clear_handle_id (&data->timeout_id, g_source_remove);
+  g_free (data);
+}
+
+
+static gboolean
+on_timed_complete (GTask *task)
+{
+  FbdTimedData *data = g_task_get_task_data (task);
+
+  data->timeout_id = 0;
+  g_cancellable_disconnect (g_task_get_cancellable (task), data->cancel_id);
+  g_task_return_boolean (task, TRUE);
+  g_object_unref (task);
+
+  return G_SOURCE_REMOVE;
+}
+
+
+static gboolean
+on_timed_cancelled_idle (GTask *task)
+{
+  FbdTimedData *data = g_task_get_task_data (task);
+
+  /* Already completed */
+  if (data->timeout_id == 0) {
+    g_object_unref (task);
+    return G_SOURCE_REMOVE;
+  }
+
+  g_clear_handle_id (&data->timeout_id, g_source_remove);
+  g_cancellable_disconnect (g_task_get_cancellable (task), data->cancel_id);
+  g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Playback cancelled");
+  /* One ref for the idle, one for the timeout */
+  g_object_unref (task);
+  g_object_unref (task);
+
+  return G_SOURCE_REMOVE;
+}
+
+
+static void
+on_timed_cancelled (GCancellable *cancellable, GTask *task)
+{
+  /* Can't disconnect from within the handler so complete from an idle */
+  g_idle_add ((GSourceFunc)on_timed_cancelled_idle, g_object_ref (task));
+}
+
+/**
+ * fbd_sound_file_complete_after:
+ * @source_object: The backend
+ * @duration: The time in ms after which to complete
+ * @cancellable: (nullable): A cancellable to stop early
+ * @callback: The callback to invoke
+ * @user_data: The user data for @callback
+ *
+ * Completes a #GTask after @duration ms like a real playback would.
+ * Cancelling @cancellable completes it right away with
+ * %G_IO_ERROR_CANCELLED. Use g_task_propagate_boolean() to finish.
+ */
+void
+fbd_sound_file_complete_after (gpointer             source_object,
+                               guint                duration,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+  GTask *task = g_task_new (source_object, cancellable, callback, user_data);
+  FbdTimedData *data = g_new0 (FbdTimedData, 1);
+
+  g_task_set_task_data (task, data, (GDestroyNotify)fbd_timed_data_free);
+  g_task_set_return_on_cancel (task, FALSE);
+
+  /* The timeout holds a ref on the task */
+  data->timeout_id = g_timeout_add (duration, (GSourceFunc)on_timed_complete, task);
+  g_source_set_name_by_id (data->timeout_id, "sound playback source");
+
+  if (cancellable) {
+    data->cancel_id = g_cancellable_connect (cancellable,
+                                             G_CALLBACK (on_timed_cancelled),
+                                             task, NULL);
+  }
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/**
+ * FbdSoundFileInfo:
+ * @duration: The duration in ms
+ * @rate: The sample rate in Hz
+ * @channels: The number of channels
+ * @bits: Bits per sample, `0` if the file isn't PCM
+ * @data_offset: Offset of the PCM data, `0` if the file isn't PCM
+ * @data_size: Size of the PCM data
+ *
+ * Information about a sound file
+ */
+typedef struct _FbdSoundFileInfo {
+  guint   duration;
+  guint   rate;
+  guint   channels;
+  guint   bits;
+  gsize   data_offset;
+  gsize   data_size;
+} FbdSoundFileInfo;
+
+char       *fbd_sound_file_lookup (const char *theme_name, const char *effect);
+gboolean    fbd_sound_file_get_info (const char        *path,
+                                     FbdSoundFileInfo  *info,
+                                     GError           **error);
+gboolean    fbd_sound_file_get_duration (const char  *theme_name,
+                                         const char  *effect,
+                                         guint       *duration,
+                                         GError     **error);
+void        fbd_sound_file_complete_after (gpointer             source_object,
+                                           guint                duration,
+                                           GCancellable        *cancellable,
+                                           GAsyncReadyCallback  callback,
+                                           gpointer             user_data);
+
+G_END_DECLS
@@ -0,0 +1,723 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#define G_LOG_DOMAIN "fbd-theme-cache"
+
+#include "fbd.h"
+#include "fbd-feedback-dummy.h"
+#include "fbd-feedback-led.h"
+#include "fbd-feedback-sound.h"
+#include "fbd-feedback-vibra-periodic.h"
+#include "fbd-feedback-vibra-rumble.h"
+#include "fbd-theme-cache.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <string.h>
+
+/* Bump when the format or the feedback properties change */
+#define THEME_CACHE_VERSION 4
+
+/*
+ * version
+ * sources: (parent name, path, mtime, size)
+ * app overlays: (path, mtime, size)
+ * merged theme name
+ * profiles: (munged app id or empty for the theme's own profiles,
+ *            name,
+ *            feedbacks sorted by event name,
+ *            feedbacks for event name prefixes)
+ * feedbacks: (event name, type name, properties)
+ */
+#define THEME_CACHE_PROFILES_FORMAT "a(ssa(ssa{sv})a(ssa{sv}))"
+#define THEME_CACHE_FORMAT "(ua(ssxt)a(sxt)s" THEME_CACHE_PROFILES_FORMAT ")"
+
+/**
+ * SECTION:fbd-theme-cache
+ * @short_description: Binary cache of expanded themes
+ * @Title: FbdThemeCache
+ *
+ * Expanding a theme parses the JSON of each theme in its parent chain
+ * and merges the results. The merged theme is stored as a #GVariant in
+ * the user's cache dir so later loads only need to map that file. The
+ * feedbacks are created from the mapped data once they're looked up
+ * so events that never trigger don't use any memory. The per
+ * application overlays are stored as profiles keyed by the munged app
+ * id.
+ *
+ * The cache is keyed by the modification times and sizes of all the
+ * theme and overlay files it was built from and ignored once any of
+ * them changes, a parent theme resolves to a different file or the
+ * set of overlays changes. Checking these only needs a stat() per
+ * file so loading stays cheap. The cache is written from a thread.
+ */
+
+/**
+ * fbd_theme_cache_get_path:
+ * @theme_name: (nullable): The theme's name
+ * @theme_file: The theme's file
+ *
+ * Returns: The path of the cache file for the given theme
+ */
+char *
+fbd_theme_cache_get_path (const char *theme_name, const char *theme_file)
+{
+  g_autofree char *key = NULL;
+  g_autofree char *checksum = NULL;
+  g_autofree char *name = NULL;
+
+  g_return_val_if_fail (theme_file, NULL);
+
+  key = g_strdup_printf ("%s:%s", theme_name ?: "", theme_file);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, key, -1);
+  name = g_strdup_printf ("theme-%s.cache", checksum);
+
+  return g_build_filename (g_get_user_cache_dir (), "feedbackd", name, NULL);
+}
+
+
+static gboolean
+get_file_stamp (const char *path, gint64 *mtime, guint64 *size, GError **error)
+{
+  g_autoptr (GFile) file = g_file_new_for_path (path);
+  g_autoptr (GFileInfo) info = NULL;
+
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL,
+                            error);
+  if (info == NULL)
+    return FALSE;
+
+  /* Seconds alone miss quick successive edits */
+  *mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+    g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+  *size = g_file_info_get_size (info);
+
+  return TRUE;
+}
+
+
+static gboolean
+source_is_current (const char *path, gint64 mtime, guint64 size)
+{
+  gint64 current_mtime;
+  guint64 current_size;
+
+  if (!get_file_stamp (path, &current_mtime, &current_size, NULL))
+    return FALSE;
+
+  return current_mtime == mtime && current_size == size;
+}
+
+
+static GVariant *
+value_to_variant (const GValue *value)
+{
+  switch (G_TYPE_FUNDAMENTAL (G_VALUE_TYPE (value))) {
+  case G_TYPE_STRING:
+    return g_value_get_string (value) ? g_variant_new_string (g_value_get_string (value)) : NULL;
+  case G_TYPE_BOOLEAN:
+    return g_variant_new_boolean (g_value_get_boolean (value));
+  case G_TYPE_INT:
+    return g_variant_new_int32 (g_value_get_int (value));
+  case G_TYPE_UINT:
+    return g_variant_new_uint32 (g_value_get_uint (value));
+  case G_TYPE_INT64:
+    return g_variant_new_int64 (g_value_get_int64 (value));
+  case G_TYPE_UINT64:
+    return g_variant_new_uint64 (g_value_get_uint64 (value));
+  case G_TYPE_DOUBLE:
+    return g_variant_new_double (g_value_get_double (value));
+  case G_TYPE_ENUM:
+    return g_variant_new_int32 (g_value_get_enum (value));
+  case G_TYPE_FLAGS:
+    return g_variant_new_uint32 (g_value_get_flags (value));
+  default:
+    return NULL;
+  }
+}
+
+
+static gboolean
+variant_to_value (GVariant *variant, GValue *value)
+{
+  switch (G_TYPE_FUNDAMENTAL (G_VALUE_TYPE (value))) {
+  case G_TYPE_STRING:
+    if (!g_variant_is_of_type (variant, G_VARIANT_TYPE_STRING))
+      return FALSE;
+    g_value_set_string (value, g_variant_get_string (variant, NULL));
+    return TRUE;
+  case G_TYPE_BOOLEAN:
+    if (!g_variant_is_of_type (variant, G_VARIANT_TYPE_BOOLEAN))
+      return FALSE;
+    g_value_set_boolean (value, g_variant_get_boolean (variant));
+    return TRUE;
+  case G_TYPE_INT:
+    if (!g_variant_is_of_type (variant, G_VARIANT_TYPE_INT32))
+      return FALSE;
+    g_value_set_int (value, g_variant_get_int32 (variant));
+    return TRUE;
+  case G_TYPE_UINT:
+    if (!g_variant_is_of_type (variant, G_VARIANT_TYPE_UINT32))
+      return FALSE;
+    g_value_set_uint (value, g_variant_get_uint32 (variant));
+    return TRUE;
+  case G_TYPE_INT64:
+    if (!g_variant_is_of_type (variant, G_VARIANT_TYPE_INT64))
+      return FALSE;
+    g_value_set_int64 (value, g_variant_get_int64 (variant));
+    return TRUE;
+  case G_TYPE_UINT64:
+    if (!g_variant_is_of_type (variant, G_VARIANT_TYPE_UINT64))
+      return FALSE;
+    g_value_set_uint64 (value, g_variant_get_uint64 (variant));
+    return TRUE;
+  case G_TYPE_DOUBLE:
+    if (!g_variant_is_of_type (variant, G_VARIANT_TYPE_DOUBLE))
+      return FALSE;
+    g_value_set_double (value, g_variant_get_double (variant));
+    return TRUE;
+  case G_TYPE_ENUM:
+    if (!g_variant_is_of_type (variant, G_VARIANT_TYPE_INT32))
+      return FALSE;
+    g_value_set_enum (value, g_variant_get_int32 (variant));
+    return TRUE;
+  case G_TYPE_FLAGS:
+    if (!g_variant_is_of_type (variant, G_VARIANT_TYPE_UINT32))
+      return FALSE;
+    g_value_set_flags (value, g_variant_get_uint32 (variant));
+    return TRUE;
+  default:
+    return FALSE;
+  }
+}
+
+
+static GVariant *
+feedback_to_variant (FbdFeedbackBase *feedback)
+{
+  g_autofree GParamSpec **pspecs = NULL;
+  GVariantBuilder props;
+  guint n_pspecs;
+
+  pspecs = g_object_class_list_properties (G_OBJECT_GET_CLASS (feedback), &n_pspecs);
+  g_variant_builder_init (&props, G_VARIANT_TYPE_VARDICT);
+
+  for (guint i = 0; i < n_pspecs; i++) {
+    g_auto (GValue) value = G_VALUE_INIT;
+    GParamSpec *pspec = pspecs[i];
+    GVariant *variant;
+
+    if (!(pspec->flags & G_PARAM_READABLE) || !(pspec->flags & G_PARAM_WRITABLE))
+      continue;
+
+    g_value_init (&value, G_PARAM_SPEC_VALUE_TYPE (pspec));
+    g_object_get_property (G_OBJECT (feedback), pspec->name, &value);
+    if (g_param_value_defaults (pspec, &value))
+      continue;
+
+    variant = value_to_variant (&value);
+    if (variant == NULL) {
+      g_warning ("Can't cache property %s of %s", pspec->name, G_OBJECT_TYPE_NAME (feedback));
+      continue;
+    }
+    g_variant_builder_add (&props, "{sv}", pspec->name, variant);
+  }
+
+  return g_variant_new ("(ssa{sv})", fbd_feedback_get_event_name (feedback),
+                        G_OBJECT_TYPE_NAME (feedback), &props);
+}
+
+
+static void
+collect_feedback (FbdFeedbackBase *feedback, GPtrArray *feedbacks)
+{
+  g_ptr_array_add (feedbacks, feedback);
+}
+
+
+static int
+compare_event_names (gconstpointer a, gconstpointer b)
+{
+  FbdFeedbackBase *fb1 = *(FbdFeedbackBase **)a;
+  FbdFeedbackBase *fb2 = *(FbdFeedbackBase **)b;
+
+  return strcmp (fbd_feedback_get_event_name (fb1), fbd_feedback_get_event_name (fb2));
+}
+
+
+static void
+add_profile (const char *app_id, FbdFeedbackProfile *profile, GVariantBuilder *profiles)
+{
+  g_autoptr (GPtrArray) feedbacks = g_ptr_array_new ();
+  GVariantBuilder exact, prefixes;
+
+  fbd_feedback_profile_foreach_feedback (profile, (GFunc)collect_feedback, feedbacks);
+  /* Lookups bisect the exact event names */
+  g_ptr_array_sort (feedbacks, compare_event_names);
+
+  g_variant_builder_init (&exact, G_VARIANT_TYPE ("a(ssa{sv})"));
+  g_variant_builder_init (&prefixes, G_VARIANT_TYPE ("a(ssa{sv})"));
+  for (guint i = 0; i < feedbacks->len; i++) {
+    FbdFeedbackBase *feedback = g_ptr_array_index (feedbacks, i);
+
+    if (g_str_has_suffix (fbd_feedback_get_event_name (feedback), "*"))
+      g_variant_builder_add_value (&prefixes, feedback_to_variant (feedback));
+    else
+      g_variant_builder_add_value (&exact, feedback_to_variant (feedback));
+  }
+
+  g_variant_builder_add (profiles, "(ssa(ssa{sv})a(ssa{sv}))",
+                         app_id, fbd_feedback_profile_get_name (profile), &exact, &prefixes);
+}
+
+
+static void
+add_theme_profile (FbdFeedbackProfile *profile, GVariantBuilder *profiles)
+{
+  add_profile ("", profile, profiles);
+}
+
+
+static FbdFeedbackBase *
+new_feedback (const char *type_name, GVariant *props, GError **error)
+{
+  g_autofree const char **names = NULL;
+  g_autofree GValue *values = NULL;
+  GObjectClass *klass;
+  FbdFeedbackBase *feedback = NULL;
+  GVariantIter iter;
+  const char *name;
+  GVariant *variant;
+  GType gtype;
+  guint n = 0;
+
+  gtype = g_type_from_name (type_name);
+  if (!g_type_is_a (gtype, FBD_TYPE_FEEDBACK_BASE)) {
+    g_set_error (error, fbd_error_quark (), FBD_ERROR_FAILED,
+                 "Unknown feedback type %s", type_name);
+    return NULL;
+  }
+
+  klass = g_type_class_ref (gtype);
+  names = g_new0 (const char *, g_variant_n_children (props));
+  values = g_new0 (GValue, g_variant_n_children (props));
+
+  g_variant_iter_init (&iter, props);
+  while (g_variant_iter_loop (&iter, "{&sv}", &name, &variant)) {
+    GParamSpec *pspec = g_object_class_find_property (klass, name);
+
+    if (pspec == NULL) {
+      g_set_error (error, fbd_error_quark (), FBD_ERROR_FAILED,
+                   "Unknown property %s of %s", name, type_name);
+      g_variant_unref (variant);
+      goto out;
+    }
+
+    g_value_init (&values[n], G_PARAM_SPEC_VALUE_TYPE (pspec));
+    if (!variant_to_value (variant, &values[n])) {
+      g_set_error (error, fbd_error_quark (), FBD_ERROR_FAILED,
+                   "Invalid value for property %s of %s", name, type_name);
+      g_value_unset (&values[n]);
+      g_variant_unref (variant);
+      goto out;
+    }
+    names[n++] = name;
+  }
+
+  feedback = FBD_FEEDBACK_BASE (g_object_new_with_properties (gtype, n, names, values));
+
+ out:
+  for (guint i = 0; i < n; i++)
+    g_value_unset (&values[i]);
+  g_type_class_unref (klass);
+
+  return feedback;
+}
+
+
+static FbdFeedbackBase *
+new_cached_feedback (GVariant *entry, GError **error)
+{
+  g_autoptr (GVariant) props = NULL;
+  const char *type_name;
+
+  g_variant_get (entry, "(&s&s@a{sv})", NULL, &type_name, &props);
+
+  return new_feedback (type_name, props, error);
+}
+
+
+/* The app overlays must be the same files in the same order */
+static gboolean
+check_overlays (GVariant *overlays, const char * const *overlay_paths, GError **error)
+{
+  GVariantIter iter;
+  const char *path;
+  gint64 mtime;
+  guint64 size;
+  guint i = 0;
+
+  g_variant_iter_init (&iter, overlays);
+  while (g_variant_iter_next (&iter, "(&sxt)", &path, &mtime, &size)) {
+    if (overlay_paths == NULL || g_strcmp0 (overlay_paths[i], path)) {
+      g_set_error (error, fbd_error_quark (), FBD_ERROR_FAILED,
+                   "App overlay %s got removed", path);
+      return FALSE;
+    }
+
+    if (!source_is_current (path, mtime, size)) {
+      g_set_error (error, fbd_error_quark (), FBD_ERROR_FAILED,
+                   "App overlay %s changed", path);
+      return FALSE;
+    }
+    i++;
+  }
+
+  if (overlay_paths && overlay_paths[i]) {
+    g_set_error (error, fbd_error_quark (), FBD_ERROR_FAILED,
+                 "App overlay %s got added", overlay_paths[i]);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+
+static FbdFeedbackProfile *
+new_cached_profile (const char *name, GVariant *exact, GVariant *prefixes, GError **error)
+{
+  g_autoptr (FbdFeedbackProfile) profile = fbd_feedback_profile_new (name);
+  GVariantIter iter;
+  GVariant *entry;
+
+  /* Prefixes are few and needed for any lookup that misses */
+  g_variant_iter_init (&iter, prefixes);
+  while ((entry = g_variant_iter_next_value (&iter))) {
+    g_autoptr (FbdFeedbackBase) feedback = new_cached_feedback (entry, error);
+
+    g_variant_unref (entry);
+    if (feedback == NULL)
+      return NULL;
+    fbd_feedback_profile_add_feedback (profile, feedback);
+  }
+
+  /* The variant keeps the mapped file around */
+  fbd_feedback_profile_set_cached_feedbacks (profile, exact, new_cached_feedback);
+
+  return g_steal_pointer (&profile);
+}
+
+
+/**
+ * fbd_theme_cache_load:
+ * @cache_path: The cache file
+ * @resolve: Function to look up parent themes
+ * @user_data: User data for @resolve
+ * @overlay_paths: (nullable): The sorted app overlay files
+ * @names: (out) (optional): The names the theme files were looked up by
+ * @paths: (out) (optional): The theme files the theme was built from
+ * @error: Return location for an error
+ *
+ * Loads a theme including its app overlays from @cache_path if none
+ * of the theme files it was built from changed and @overlay_paths
+ * match the cached overlays. The first entry of @names is empty as
+ * the top most theme isn't looked up by name.
+ *
+ * Returns: (transfer full) (nullable): The theme
+ */
+FbdFeedbackTheme *
+fbd_theme_cache_load (const char                *cache_path,
+                      FbdThemeCacheResolveFunc   resolve,
+                      gpointer                   user_data,
+                      const char * const        *overlay_paths,
+                      GStrv                     *names,
+                      GStrv                     *paths,
+                      GError                   **error)
+{
+  g_autoptr (GPtrArray) source_names = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr (GPtrArray) source_paths = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr (GMappedFile) file = NULL;
+  g_autoptr (GBytes) bytes = NULL;
+  g_autoptr (GVariant) cache = NULL;
+  g_autoptr (GVariant) sources = NULL;
+  g_autoptr (GVariant) overlays = NULL;
+  g_autoptr (GVariant) profiles = NULL;
+  g_autoptr (FbdFeedbackTheme) theme = NULL;
+  const char *theme_name;
+  GVariantIter iter;
+  GVariant *feedbacks, *prefixes;
+  const char *parent, *path, *app_id, *profile_name;
+  gint64 mtime;
+  guint64 size;
+  guint32 version;
+
+  g_return_val_if_fail (cache_path, NULL);
+  g_return_val_if_fail (resolve, NULL);
+
+  file = g_mapped_file_new (cache_path, FALSE, error);
+  if (file == NULL)
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (file);
+  cache = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (THEME_CACHE_FORMAT),
+                                                        bytes, FALSE));
+
+  g_variant_get (cache, "(u@a(ssxt)@a(sxt)&s@" THEME_CACHE_PROFILES_FORMAT ")",
+                 &version, &sources, &overlays, &theme_name, &profiles);
+  if (version != THEME_CACHE_VERSION) {
+    g_set_error (error, fbd_error_quark (), FBD_ERROR_FAILED,
+                 "Cache version %u doesn't match %u", version, THEME_CACHE_VERSION);
+    return NULL;
+  }
+
+  g_variant_iter_init (&iter, sources);
+  while (g_variant_iter_next (&iter, "(&s&sxt)", &parent, &path, &mtime, &size)) {
+    /* The top most theme is part of the cache's path */
+    if (parent[0] != '\0') {
+      g_autofree char *resolved = resolve (parent, user_data);
+
+      if (g_strcmp0 (resolved, path)) {
+        g_set_error (error, fbd_error_quark (), FBD_ERROR_FAILED,
+                     "Theme %s moved to %s", parent, resolved);
+        return NULL;
+      }
+    }
+
+    if (!source_is_current (path, mtime, size)) {
+      g_set_error (error, fbd_error_quark (), FBD_ERROR_FAILED,
+                   "Theme file %s changed", path);
+      return NULL;
+    }
+
+    g_ptr_array_add (source_names, g_strdup (parent));
+    g_ptr_array_add (source_paths, g_strdup (path));
+  }
+
+  if (!check_overlays (overlays, overlay_paths, error))
+    return NULL;
+
+  /* Make sure all feedback types are registered */
+  g_type_ensure (FBD_TYPE_FEEDBACK_DUMMY);
+  g_type_ensure (FBD_TYPE_FEEDBACK_LED);
+  g_type_ensure (FBD_TYPE_FEEDBACK_VIBRA_PERIODIC);
+  g_type_ensure (FBD_TYPE_FEEDBACK_VIBRA_RUMBLE);
+  g_type_ensure (FBD_TYPE_FEEDBACK_SOUND);
+
+  theme = fbd_feedback_theme_new (theme_name);
+  g_variant_iter_init (&iter, profiles);
+  while (g_variant_iter_next (&iter, "(&s&s@a(ssa{sv})@a(ssa{sv}))",
+                              &app_id, &profile_name, &feedbacks, &prefixes)) {
+    g_autoptr (FbdFeedbackProfile) profile = NULL;
+    g_autoptr (GVariant) exact = g_steal_pointer (&feedbacks);
+    g_autoptr (GVariant) prefix_feedbacks = g_steal_pointer (&prefixes);
+
+    profile = new_cached_profile (profile_name, exact, prefix_feedbacks, error);
+    if (profile == NULL)
+      return NULL;
+
+    if (app_id[0] == '\0')
+      fbd_feedback_theme_add_profile (theme, profile);
+    else
+      fbd_feedback_theme_add_app_profile (theme, app_id, profile);
+  }
+
+  g_ptr_array_add (source_names, NULL);
+  g_ptr_array_add (source_paths, NULL);
+  if (names)
+    *names = (GStrv)g_ptr_array_free (g_steal_pointer (&source_names), FALSE);
+  if (paths)
+    *paths = (GStrv)g_ptr_array_free (g_steal_pointer (&source_paths), FALSE);
+
+  return g_steal_pointer (&theme);
+}
+
+
+typedef struct {
+  char     *cache_path;
+  GStrv     names;
+  GStrv     paths;
+  GStrv     overlay_paths;
+  char     *theme_name;
+  GVariant *profiles;
+} FbdThemeCacheSaveData;
+
+
+static void
+save_data_free (FbdThemeCacheSaveData *data)
+{
+  g_free (data->cache_path);
+  g_strfreev (data->names);
+  g_strfreev (data->paths);
+  g_strfreev (data->overlay_paths);
+  g_free (data->theme_name);
+  g_variant_unref (data->profiles);
+  g_free (data);
+}
+
+
+static gboolean
+add_source (GVariantBuilder *sources, const char *name, const char *path, GError **error)
+{
+  gint64 mtime;
+  guint64 size;
+
+  if (!get_file_stamp (path, &mtime, &size, error))
+    return FALSE;
+
+  if (name)
+    g_variant_builder_add (sources, "(ssxt)", name, path, mtime, size);
+  else
+    g_variant_builder_add (sources, "(sxt)", path, mtime, size);
+
+  return TRUE;
+}
+
+
+static void
+save_thread (GTask        *task,
+             gpointer      source_object,
+             gpointer      task_data,
+             GCancellable *cancellable)
+{
+  FbdThemeCacheSaveData *data = task_data;
+  g_autoptr (GVariant) cache = NULL;
+  g_autofree char *dir = NULL;
+  g_autoptr (GError) err = NULL;
+  GVariantBuilder sources, overlays;
+
+  g_variant_builder_init (&sources, G_VARIANT_TYPE ("a(ssxt)"));
+  for (int i = 0; data->paths[i]; i++) {
+    if (!add_source (&sources, i ? data->names[i] : "", data->paths[i], &err)) {
+      g_variant_builder_clear (&sources);
+      g_task_return_error (task, g_steal_pointer (&err));
+      return;
+    }
+  }
+
+  g_variant_builder_init (&overlays, G_VARIANT_TYPE ("a(sxt)"));
+  for (int i = 0; data->overlay_paths && data->overlay_paths[i]; i++) {
+    if (!add_source (&overlays, NULL, data->overlay_paths[i], &err)) {
+      g_variant_builder_clear (&sources);
+      g_variant_builder_clear (&overlays);
+      g_task_return_error (task, g_steal_pointer (&err));
+      return;
+    }
+  }
+
+  cache = g_variant_ref_sink (g_variant_new ("(ua(ssxt)a(sxt)s@" THEME_CACHE_PROFILES_FORMAT ")",
+                                             THEME_CACHE_VERSION,
+                                             &sources,
+                                             &overlays,
+                                             data->theme_name,
+                                             data->profiles));
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  dir = g_path_get_dirname (data->cache_path);
+  if (g_mkdir_with_parents (dir, 0755) < 0) {
+    int saved_errno = errno;
+
+    g_task_return_new_error (task, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                             "Failed to create %s: %s", dir, g_strerror (saved_errno));
+    return;
+  }
+
+  if (!g_file_set_contents (data->cache_path,
+                            g_variant_get_data (cache),
+                            g_variant_get_size (cache),
+                            &err)) {
+    g_task_return_error (task, g_steal_pointer (&err));
+    return;
+  }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+
+/**
+ * fbd_theme_cache_save_async:
+ * @cache_path: The cache file
+ * @theme: The expanded theme
+ * @names: The names the theme files were looked up by, the first one
+ *   being the top most theme
+ * @paths: The theme files @theme was built from
+ * @overlay_paths: (nullable): The sorted app overlay files
+ * @cancellable: (nullable): A cancellable
+ * @callback: The callback to invoke when done
+ * @user_data: User data for @callback
+ *
+ * Stores @theme including its app overlays in @cache_path. The
+ * feedbacks are serialized right away so @theme can change or go away
+ * while the file gets written.
+ */
+void
+fbd_theme_cache_save_async (const char          *cache_path,
+                            FbdFeedbackTheme    *theme,
+                            const char * const  *names,
+                            const char * const  *paths,
+                            const char * const  *overlay_paths,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
+{
+  g_autoptr (GTask) task = NULL;
+  g_autoptr (GHashTable) profiles = NULL;
+  FbdThemeCacheSaveData *data;
+  GVariantBuilder profiles_builder;
+  GHashTableIter iter;
+  FbdFeedbackProfile *profile;
+
+  g_return_if_fail (cache_path);
+  g_return_if_fail (FBD_IS_FEEDBACK_THEME (theme));
+  g_return_if_fail (g_strv_length ((GStrv)names) == g_strv_length ((GStrv)paths));
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, fbd_theme_cache_save_async);
+
+  /* The feedbacks aren't thread safe so serialize them here */
+  g_object_get (theme, "profiles", &profiles, NULL);
+  g_variant_builder_init (&profiles_builder, G_VARIANT_TYPE (THEME_CACHE_PROFILES_FORMAT));
+  g_hash_table_iter_init (&iter, profiles);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&profile))
+    add_theme_profile (profile, &profiles_builder);
+  fbd_feedback_theme_foreach_app_profile (theme, (GHFunc)add_profile, &profiles_builder);
+
+  data = g_new0 (FbdThemeCacheSaveData, 1);
+  data->cache_path = g_strdup (cache_path);
+  data->names = g_strdupv ((GStrv)names);
+  data->paths = g_strdupv ((GStrv)paths);
+  data->overlay_paths = g_strdupv ((GStrv)overlay_paths);
+  data->theme_name = g_strdup (fbd_feedback_theme_get_name (theme) ?: "");
+  data->profiles = g_variant_ref_sink (g_variant_builder_end (&profiles_builder));
+  g_task_set_task_data (task, data, (GDestroyNotify)save_data_free);
+
+  g_task_run_in_thread (task, save_thread);
+}
+
+
+/**
+ * fbd_theme_cache_save_finish:
+ * @res: The async result
+ * @error: Return location for an error
+ *
+ * Finishes an operation started with fbd_theme_cache_save_async().
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+fbd_theme_cache_save_finish (GAsyncResult *res, GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (res, NULL), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (res), error);
+}
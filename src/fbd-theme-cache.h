@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+#pragma once
+
+#include "fbd-feedback-theme.h"
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/**
+ * FbdThemeCacheResolveFunc:
+ * @theme_name: The name of a parent theme
+ * @user_data: The user data
+ *
+ * Looks up the file of a parent theme.
+ *
+ * Returns: (transfer full) (nullable): The theme file's path
+ */
+typedef char *(*FbdThemeCacheResolveFunc) (const char *theme_name, gpointer user_data);
+
+char             *fbd_theme_cache_get_path (const char *theme_name, const char *theme_file);
+FbdFeedbackTheme *fbd_theme_cache_load (const char                *cache_path,
+                                        FbdThemeCacheResolveFunc   resolve,
+                                        gpointer                   user_data,
+                                        const char * const        *overlay_paths,
+                                        GStrv                     *names,
+                                        GStrv                     *paths,
+                                        GError                   **error);
+void              fbd_theme_cache_save_async (const char          *cache_path,
+                                              FbdFeedbackTheme    *theme,
+                                              const char * const  *names,
+                                              const char * const  *paths,
+                                              const char * const  *overlay_paths,
+                                              GCancellable        *cancellable,
+                                              GAsyncReadyCallback  callback,
+                                              gpointer             user_data);
+gboolean          fbd_theme_cache_save_finish (GAsyncResult        *res,
+                                               GError             **error);
+
+G_END_DECLS
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2022 Guido Günther
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "fbd-theme-dirs"
+
+#include "fbd-theme-dirs.h"
+
+#include <gio/gio.h>
+
+/**
+ * SECTION:fbd-theme-dirs
+ * @short_description: Index of the theme files in the theme folders
+ * @Title: FbdThemeDirs
+ *
+ * #FbdThemeDirs keeps the names of the theme files in each theme
+ * folder so looking up a theme doesn't need to hit the disk for every
+ * folder and theme name. A folder is read once and only read again
+ * when its modification time changed. Use fbd_theme_dirs_invalidate()
+ * to have the folders checked for modifications on their next use.
+ *
+ * The index is meant to be shared between the #FbdThemeExpander s of
+ * a process so it survives full theme loads.
+ */
+
+/* The theme files in a folder */
+typedef struct {
+  gint64      mtime;
+  gboolean    checked;
+  GHashTable *files;
+} FbdThemeDir;
+
+struct _FbdThemeDirs {
+  GObject     parent;
+
+  /* Key: theme folder, value: FbdThemeDir */
+  GHashTable *dirs;
+  guint       n_scans;
+};
+G_DEFINE_TYPE (FbdThemeDirs, fbd_theme_dirs, G_TYPE_OBJECT)
+
+
+static void
+fbd_theme_dir_free (FbdThemeDir *dir)
+{
+  g_clear_pointer (&dir->files, g_hash_table_destroy);
+  g_free (dir);
+}
+
+
+static void
+scan_theme_dir (FbdThemeDirs *self, const char *path, FbdThemeDir *dir)
+{
+  g_autoptr (GFile) file = g_file_new_for_path (path);
+  g_autoptr (GFileInfo) info = NULL;
+  g_autoptr (GDir) gdir = NULL;
+  const char *name;
+  gint64 mtime = -1;
+
+  dir->checked = TRUE;
+
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL,
+                            NULL);
+  if (info) {
+    mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+      g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+  }
+
+  if (dir->files && mtime == dir->mtime)
+    return;
+
+  self->n_scans++;
+  dir->mtime = mtime;
+  g_clear_pointer (&dir->files, g_hash_table_destroy);
+  dir->files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  gdir = g_dir_open (path, 0, NULL);
+  if (gdir == NULL)
+    return;
+
+  while ((name = g_dir_read_name (gdir))) {
+    if (g_str_has_suffix (name, ".json"))
+      g_hash_table_add (dir->files, g_strdup (name));
+  }
+  g_debug ("Found %u theme files in %s", g_hash_table_size (dir->files), path);
+}
+
+
+static void
+fbd_theme_dirs_finalize (GObject *object)
+{
+  FbdThemeDirs *self = FBD_THEME_DIRS (object);
+
+  g_clear_pointer (&self->dirs, g_hash_table_destroy);
+
+  G_OBJECT_CLASS (fbd_theme_dirs_parent_class)->finalize (object);
+}
+
+
+static void
+fbd_theme_dirs_class_init (FbdThemeDirsClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = fbd_theme_dirs_finalize;
+}
+
+
+static void
+fbd_theme_dirs_init (FbdThemeDirs *self)
+{
+  self->dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                      (GDestroyNotify)fbd_theme_dir_free);
+}
+
+
+FbdThemeDirs *
+fbd_theme_dirs_new (void)
+{
+  return FBD_THEME_DIRS (g_object_new (FBD_TYPE_THEME_DIRS, NULL));
+}
+
+/**
+ * fbd_theme_dirs_get_files:
+ * @self: The theme folder index
+ * @path: The theme folder
+ *
+ * Gets the theme files in @path. The folder is only read again when it
+ * changed since the last fbd_theme_dirs_invalidate().
+ *
+ * Returns: (transfer none): The set of theme file names in @path
+ */
+GHashTable *
+fbd_theme_dirs_get_files (FbdThemeDirs *self, const char *path)
+{
+  FbdThemeDir *dir;
+
+  g_return_val_if_fail (FBD_IS_THEME_DIRS (self), NULL);
+  g_return_val_if_fail (path, NULL);
+
+  dir = g_hash_table_lookup (self->dirs, path);
+  if (dir == NULL) {
+    dir = g_new0 (FbdThemeDir, 1);
+    g_hash_table_insert (self->dirs, g_strdup (path), dir);
+  }
+
+  if (!dir->checked)
+    scan_theme_dir (self, path, dir);
+
+  return dir->files;
+}
+
+
+gboolean
+fbd_theme_dirs_has_file (FbdThemeDirs *self, const char *path, const char *file_name)
+{
+  g_return_val_if_fail (FBD_IS_THEME_DIRS (self), FALSE);
+
+  return g_hash_table_contains (fbd_theme_dirs_get_files (self, path), file_name);
+}
+
+/**
+ * fbd_theme_dirs_invalidate:
+ * @self: The theme folder index
+ *
+ * Check the folders for modifications when they're used next.
+ */
+void
+fbd_theme_dirs_invalidate (FbdThemeDirs *self)
+{
+  GHashTableIter iter;
+  FbdThemeDir *dir;
+
+  g_return_if_fail (FBD_IS_THEME_DIRS (self));
+
+  g_hash_table_iter_init (&iter, self->dirs);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&dir))
+    dir->checked = FALSE;
+}
+
+/**
+ * fbd_theme_dirs_get_n_scans:
+ * @self: The theme folder index
+ *
+ * Returns: How often a folder's content got read
+ */
+guint
+fbd_theme_dirs_get_n_scans (FbdThemeDirs *self)
+{
+  g_return_val_if_fail (FBD_IS_THEME_DIRS (self), 0);
+
+  return self->n_scans;
+}
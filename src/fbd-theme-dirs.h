@@ -0,0 +1,25 @@
+/*
+ * Copyright (C) 2022 Guido Günther
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define FBD_TYPE_THEME_DIRS (fbd_theme_dirs_get_type ())
+
+G_DECLARE_FINAL_TYPE (FbdThemeDirs, fbd_theme_dirs, FBD, THEME_DIRS, GObject)
+
+FbdThemeDirs *fbd_theme_dirs_new (void);
+GHashTable   *fbd_theme_dirs_get_files (FbdThemeDirs *self, const char *path);
+gboolean      fbd_theme_dirs_has_file (FbdThemeDirs *self,
+                                       const char   *path,
+                                       const char   *file_name);
+void          fbd_theme_dirs_invalidate (FbdThemeDirs *self);
+guint         fbd_theme_dirs_get_n_scans (FbdThemeDirs *self);
+
+G_END_DECLS
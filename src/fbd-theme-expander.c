@@ -10,20 +10,37 @@
 
 #include "fbd.h"
 #include "fbd-feedback-theme.h"
+#include "fbd-theme-cache.h"
+#include "fbd-theme-dirs.h"
 #include "fbd-theme-expander.h"
 
+#include <gio/gio.h>
+
 #define DEFAULT_THEME_NAME  "default"
 #define DEVICE_THEME_NAME   "$device"
 
 #define MAX_THEME_DEPTH 10
 
+/* Folder below the theme folders holding per application overlays */
+#define APP_OVERLAY_DIR "apps"
+
+/* Editors usually write a file in several steps */
+#define RELOAD_DELAY_MS 250
+
 /**
  * SECTION:theme-expander
  * @short_description: Feedback theme expander
  * @Title: FbdThemeExpander
  *
  * The theme expander reads themes from disks and expands references
- * to other themes
+ * to other themes.
+ *
+ * When watching is enabled via fbd_theme_expander_set_watch() the
+ * expander monitors all files of the expanded theme, the user's
+ * theme folder and the app overlay folders and emits
+ * #FbdThemeExpander::theme-changed once a burst of changes settled.
+ * fbd_theme_expander_reload() then only reparses the theme files that
+ * changed.
  */
 
 enum {
@@ -31,17 +48,48 @@ enum {
   PROP_THEME_NAME,
   PROP_THEME_FILE,
   PROP_COMPATIBLES,
+  PROP_THEME_DIRS,
   PROP_LAST_PROP
 };
 static GParamSpec *props[PROP_LAST_PROP];
 
+enum {
+  SIGNAL_THEME_CHANGED,
+  N_SIGNALS
+};
+static guint signals[N_SIGNALS];
+
+/* A theme file in the chain of parent themes */
+typedef struct {
+  FbdThemeExpander *expander;
+  char             *name;
+  char             *path;
+  FbdFeedbackTheme *theme;
+  GFileMonitor     *monitor;
+} FbdThemeLayer;
+
 struct _FbdThemeExpander {
   GObject    parent;
 
   char      *theme_name;
   char      *theme_file;
+  gboolean   theme_file_resolved;
   gboolean   device_theme_loaded;
   GStrv      compatibles;
+
+  FbdThemeDirs *theme_dirs;
+
+  /* The chain of themes, top most theme first */
+  GPtrArray    *layers;
+  gboolean      watch;
+  GFileMonitor *user_dir_monitor;
+  /* The app overlay folders */
+  GPtrArray    *app_dir_monitors;
+  gboolean      rescan;
+  guint         reload_id;
+
+  /* The pending cache write */
+  GCancellable *cache_cancel;
 };
 G_DEFINE_TYPE (FbdThemeExpander, fbd_theme_expander, G_TYPE_OBJECT)
 
@@ -86,21 +134,28 @@ fbd_theme_expander_set_theme_file (FbdThemeExpander *self, const char *theme_fil
 }
 
 
+static gboolean
+theme_dir_has_file (FbdThemeExpander *self, const char *path, const char *file_name)
+{
+  return fbd_theme_dirs_has_file (self->theme_dirs, path, file_name);
+}
+
+
 static char *
-fbd_theme_expander_find_theme_in_xdg_data (const char *theme_name)
+fbd_theme_expander_find_theme_in_xdg_data (FbdThemeExpander *self, const char *theme_name)
 {
   const char * const *xdg_data_dirs = g_get_system_data_dirs ();
   g_autofree char *theme_file_name = g_strconcat (theme_name, ".json", NULL);
 
   for (int i = 0; xdg_data_dirs[i] != NULL; i++) {
-    g_autofree char *theme_path = NULL;
+    g_autofree char *theme_dir = NULL;
 
-    theme_path = g_build_filename (xdg_data_dirs[i], "feedbackd", "themes",
-                                   theme_file_name, NULL);
-    g_debug ("Looking for theme file at %s", theme_path);
+    theme_dir = g_build_filename (xdg_data_dirs[i], "feedbackd", "themes", NULL);
+    g_debug ("Looking for theme file %s in %s", theme_file_name, theme_dir);
+
+    if (theme_dir_has_file (self, theme_dir, theme_file_name)) {
+      g_autofree char *theme_path = g_build_filename (theme_dir, theme_file_name, NULL);
 
-    /* Check if file exist */
-    if (g_file_test (theme_path, (G_FILE_TEST_EXISTS))) {
       g_info ("Loading theme file at '%s'", theme_path);
       return g_steal_pointer (&theme_path);
     }
@@ -131,7 +186,7 @@ fbd_theme_expander_find_device_theme_path (FbdThemeExpander *self, const char *t
     const char *compatible = self->compatibles[i];
     g_autofree char *theme_path = NULL;
 
-    theme_path = fbd_theme_expander_find_theme_in_xdg_data (compatible);
+    theme_path = fbd_theme_expander_find_theme_in_xdg_data (self, compatible);
     if (theme_path) {
       g_debug ("Loading themefile for compatible '%s' at: %s", compatible, theme_path);
       return g_steal_pointer (&theme_path);
@@ -144,14 +199,21 @@ fbd_theme_expander_find_device_theme_path (FbdThemeExpander *self, const char *t
 
 
 static char *
-fbd_theme_expander_find_user_theme_path (const char *theme_name)
+get_user_theme_dir (void)
+{
+  return g_build_filename (g_get_user_config_dir (), "feedbackd", "themes", NULL);
+}
+
+
+static char *
+fbd_theme_expander_find_user_theme_path (FbdThemeExpander *self, const char *theme_name)
 {
   g_autofree char *filename = g_strdup_printf ("%s.json", theme_name);
-  g_autofree char *user_config_path = NULL;
+  g_autofree char *user_theme_dir = get_user_theme_dir ();
+
+  if (theme_dir_has_file (self, user_theme_dir, filename)) {
+    g_autofree char *user_config_path = g_build_filename (user_theme_dir, filename, NULL);
 
-  user_config_path = g_build_filename (g_get_user_config_dir (), "feedbackd",
-                                       "themes", filename, NULL);
-  if (g_file_test (user_config_path, (G_FILE_TEST_EXISTS))) {
     g_info ("Found theme file at: %s", user_config_path);
     return g_steal_pointer (&user_config_path);
   }
@@ -169,7 +231,7 @@ fbd_theme_expander_find_theme_path (FbdThemeExpander *self, const char *theme_na
 
   g_assert (theme_name);
 
-  theme_path = fbd_theme_expander_find_user_theme_path (theme_name);
+  theme_path = fbd_theme_expander_find_user_theme_path (self, theme_name);
   if (theme_path)
     return theme_path;
 
@@ -180,7 +242,7 @@ fbd_theme_expander_find_theme_path (FbdThemeExpander *self, const char *theme_na
   if (g_str_equal (theme_name, DEFAULT_THEME_NAME) == FALSE)
     g_critical ("Theme '%s' not found, falling back to default theme", theme_name);
 
-  theme_path = fbd_theme_expander_find_theme_in_xdg_data (DEFAULT_THEME_NAME);
+  theme_path = fbd_theme_expander_find_theme_in_xdg_data (self, DEFAULT_THEME_NAME);
   if (theme_path)
     return theme_path;
 
@@ -191,6 +253,13 @@ fbd_theme_expander_find_theme_path (FbdThemeExpander *self, const char *theme_na
 }
 
 
+static char *
+resolve_theme_path (const char *theme_name, gpointer user_data)
+{
+  return fbd_theme_expander_find_theme_path (FBD_THEME_EXPANDER (user_data), theme_name);
+}
+
+
 static void
 fbd_theme_expander_set_property (GObject      *object,
                                  guint         property_id,
@@ -209,6 +278,9 @@ fbd_theme_expander_set_property (GObject      *object,
   case PROP_COMPATIBLES:
     fbd_theme_expander_set_compatibles (self, g_value_get_boxed (value));
     break;
+  case PROP_THEME_DIRS:
+    g_set_object (&self->theme_dirs, g_value_get_object (value));
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -234,6 +306,9 @@ fbd_theme_expander_get_property (GObject    *object,
   case PROP_COMPATIBLES:
     g_value_set_boxed (value, fbd_theme_expander_get_compatibles (self));
     break;
+  case PROP_THEME_DIRS:
+    g_value_set_object (value, self->theme_dirs);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -241,6 +316,33 @@ fbd_theme_expander_get_property (GObject    *object,
 }
 
 
+static void
+fbd_theme_expander_constructed (GObject *object)
+{
+  FbdThemeExpander *self = FBD_THEME_EXPANDER (object);
+
+  G_OBJECT_CLASS (fbd_theme_expander_parent_class)->constructed (object);
+
+  if (self->theme_dirs == NULL)
+    self->theme_dirs = fbd_theme_dirs_new ();
+}
+
+
+static void
+fbd_theme_expander_dispose (GObject *object)
+{
+  FbdThemeExpander *self = FBD_THEME_EXPANDER(object);
+
+  fbd_theme_expander_set_watch (self, FALSE);
+  g_cancellable_cancel (self->cache_cancel);
+  g_clear_object (&self->cache_cancel);
+  g_clear_pointer (&self->layers, g_ptr_array_unref);
+  g_clear_object (&self->theme_dirs);
+
+  G_OBJECT_CLASS (fbd_theme_expander_parent_class)->dispose (object);
+}
+
+
 static void
 fbd_theme_expander_finalize (GObject *object)
 {
@@ -261,6 +363,8 @@ fbd_theme_expander_class_init (FbdThemeExpanderClass *klass)
 
   object_class->get_property = fbd_theme_expander_get_property;
   object_class->set_property = fbd_theme_expander_set_property;
+  object_class->constructed = fbd_theme_expander_constructed;
+  object_class->dispose = fbd_theme_expander_dispose;
   object_class->finalize = fbd_theme_expander_finalize;
 
   /**
@@ -298,8 +402,33 @@ fbd_theme_expander_class_init (FbdThemeExpanderClass *klass)
     g_param_spec_boxed ("compatibles", "", "",
                         G_TYPE_STRV,
                         G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  /**
+   * FbdThemeExpander:theme-dirs:
+   *
+   * The index of the theme folders' files. Share it between expanders
+   * so unchanged folders aren't read again on every full theme
+   * load. When unset the expander uses its own.
+   */
+  props[PROP_THEME_DIRS] =
+    g_param_spec_object ("theme-dirs", "", "",
+                         FBD_TYPE_THEME_DIRS,
+                         G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
   g_object_class_install_properties (object_class, PROP_LAST_PROP, props);
+
+  /**
+   * FbdThemeExpander::theme-changed:
+   *
+   * Emitted when a file of the expanded theme or the user's theme
+   * folder changed. Use fbd_theme_expander_reload() to pick up the
+   * changes.
+   */
+  signals[SIGNAL_THEME_CHANGED] = g_signal_new ("theme-changed",
+                                                G_TYPE_FROM_CLASS (klass),
+                                                G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+                                                NULL,
+                                                G_TYPE_NONE,
+                                                0);
 }
 
 
@@ -335,6 +464,359 @@ update_theme (gpointer data, gpointer user_data)
 }
 
 
+static void
+fbd_theme_layer_free (FbdThemeLayer *layer)
+{
+  if (layer->monitor) {
+    g_signal_handlers_disconnect_by_data (layer->monitor, layer);
+    g_file_monitor_cancel (layer->monitor);
+  }
+  g_clear_object (&layer->monitor);
+  g_clear_object (&layer->theme);
+  g_free (layer->name);
+  g_free (layer->path);
+  g_free (layer);
+}
+
+
+static FbdThemeLayer *
+fbd_theme_layer_new (FbdThemeExpander *expander,
+                     const char       *name,
+                     const char       *path,
+                     FbdFeedbackTheme *theme)
+{
+  FbdThemeLayer *layer = g_new0 (FbdThemeLayer, 1);
+
+  layer->expander = expander;
+  layer->name = g_strdup (name);
+  layer->path = g_strdup (path);
+  layer->theme = theme ? g_object_ref (theme) : NULL;
+
+  return layer;
+}
+
+
+static gboolean
+on_reload_timeout (gpointer user_data)
+{
+  FbdThemeExpander *self = FBD_THEME_EXPANDER (user_data);
+
+  self->reload_id = 0;
+  g_debug ("Theme '%s' changed", self->theme_name);
+  g_signal_emit (self, signals[SIGNAL_THEME_CHANGED], 0);
+
+  return G_SOURCE_REMOVE;
+}
+
+
+static void
+schedule_reload (FbdThemeExpander *self)
+{
+  g_clear_handle_id (&self->reload_id, g_source_remove);
+  self->reload_id = g_timeout_add (RELOAD_DELAY_MS, on_reload_timeout, self);
+}
+
+
+static void
+on_layer_changed (GFileMonitor      *monitor,
+                  GFile             *file,
+                  GFile             *other_file,
+                  GFileMonitorEvent  event,
+                  gpointer           user_data)
+{
+  FbdThemeLayer *layer = user_data;
+
+  if (event == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED ||
+      event == G_FILE_MONITOR_EVENT_PRE_UNMOUNT)
+    return;
+
+  g_debug ("Theme file %s changed: %d", layer->path, event);
+  /* Parse the file again on next reload */
+  g_clear_object (&layer->theme);
+  schedule_reload (layer->expander);
+}
+
+
+static void
+on_user_dir_changed (FbdThemeExpander  *self,
+                     GFile             *file,
+                     GFile             *other_file,
+                     GFileMonitorEvent  event,
+                     GFileMonitor      *monitor)
+{
+  /* Only added or removed themes can change theme lookup */
+  if (event != G_FILE_MONITOR_EVENT_CREATED &&
+      event != G_FILE_MONITOR_EVENT_DELETED &&
+      event != G_FILE_MONITOR_EVENT_MOVED_IN &&
+      event != G_FILE_MONITOR_EVENT_MOVED_OUT &&
+      event != G_FILE_MONITOR_EVENT_RENAMED)
+    return;
+
+  g_debug ("User theme folder changed: %d", event);
+  self->rescan = TRUE;
+  fbd_theme_dirs_invalidate (self->theme_dirs);
+  schedule_reload (self);
+}
+
+
+static void
+on_app_dir_changed (FbdThemeExpander  *self,
+                    GFile             *file,
+                    GFile             *other_file,
+                    GFileMonitorEvent  event,
+                    GFileMonitor      *monitor)
+{
+  if (event == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED ||
+      event == G_FILE_MONITOR_EVENT_PRE_UNMOUNT)
+    return;
+
+  g_debug ("App overlay folder changed: %d", event);
+  fbd_theme_dirs_invalidate (self->theme_dirs);
+  schedule_reload (self);
+}
+
+
+static GStrv
+get_app_overlay_dirs (void)
+{
+  const char * const *xdg_data_dirs = g_get_system_data_dirs ();
+  g_autofree char *user_theme_dir = get_user_theme_dir ();
+  GPtrArray *dirs = g_ptr_array_new ();
+
+  /* Overlays in the user's config take precedence */
+  g_ptr_array_add (dirs, g_build_filename (user_theme_dir, APP_OVERLAY_DIR, NULL));
+  for (int i = 0; xdg_data_dirs[i] != NULL; i++) {
+    g_ptr_array_add (dirs, g_build_filename (xdg_data_dirs[i], "feedbackd", "themes",
+                                             APP_OVERLAY_DIR, NULL));
+  }
+  g_ptr_array_add (dirs, NULL);
+
+  return (GStrv)g_ptr_array_free (dirs, FALSE);
+}
+
+
+static void
+update_app_dir_monitors (FbdThemeExpander *self)
+{
+  g_auto (GStrv) dirs = NULL;
+
+  if (self->app_dir_monitors)
+    return;
+
+  self->app_dir_monitors = g_ptr_array_new_with_free_func (g_object_unref);
+  dirs = get_app_overlay_dirs ();
+  for (int i = 0; dirs[i]; i++) {
+    g_autoptr (GFile) dir = g_file_new_for_path (dirs[i]);
+    g_autoptr (GError) err = NULL;
+    GFileMonitor *monitor;
+
+    monitor = g_file_monitor_directory (dir, G_FILE_MONITOR_NONE, NULL, &err);
+    if (monitor == NULL) {
+      g_warning ("Failed to monitor %s: %s", dirs[i], err->message);
+      continue;
+    }
+    g_signal_connect_object (monitor, "changed",
+                             G_CALLBACK (on_app_dir_changed),
+                             self, G_CONNECT_SWAPPED);
+    g_ptr_array_add (self->app_dir_monitors, monitor);
+  }
+}
+
+
+static void
+update_monitors (FbdThemeExpander *self)
+{
+  if (!self->watch || self->layers == NULL)
+    return;
+
+  update_app_dir_monitors (self);
+
+  if (self->user_dir_monitor == NULL) {
+    g_autofree char *path = get_user_theme_dir ();
+    g_autoptr (GFile) dir = g_file_new_for_path (path);
+    g_autoptr (GError) err = NULL;
+
+    self->user_dir_monitor = g_file_monitor_directory (dir, G_FILE_MONITOR_NONE, NULL, &err);
+    if (self->user_dir_monitor) {
+      g_signal_connect_object (self->user_dir_monitor, "changed",
+                               G_CALLBACK (on_user_dir_changed),
+                               self, G_CONNECT_SWAPPED);
+    } else {
+      g_warning ("Failed to monitor %s: %s", path, err->message);
+    }
+  }
+
+  for (guint i = 0; i < self->layers->len; i++) {
+    FbdThemeLayer *layer = g_ptr_array_index (self->layers, i);
+    g_autoptr (GFile) file = NULL;
+    g_autoptr (GError) err = NULL;
+
+    if (layer->monitor)
+      continue;
+
+    file = g_file_new_for_path (layer->path);
+    layer->monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, &err);
+    if (layer->monitor == NULL) {
+      g_warning ("Failed to monitor %s: %s", layer->path, err->message);
+      continue;
+    }
+    g_signal_connect (layer->monitor, "changed", G_CALLBACK (on_layer_changed), layer);
+  }
+}
+
+
+static gboolean
+check_theme (FbdThemeExpander *self, FbdFeedbackTheme *theme, const char *path, GError **err)
+{
+  const char *theme_name = fbd_feedback_theme_get_name (theme);
+
+  if (theme_name == NULL || theme_name[0] == '\0') {
+    g_set_error (err, fbd_error_quark(), FBD_ERROR_THEME_EXPAND,
+                 "Theme name of %s can't be empty", path);
+    return FALSE;
+  }
+
+  if (fbd_feedback_theme_get_parent_name (theme) &&
+      g_str_equal (theme_name, DEFAULT_THEME_NAME)) {
+    g_set_error (err, fbd_error_quark(), FBD_ERROR_THEME_EXPAND,
+                 "Default theme can't specify a parent");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+
+static FbdFeedbackTheme *
+merge_layers (FbdThemeExpander *self)
+{
+  g_autoptr (FbdFeedbackTheme) merged = fbd_feedback_theme_new ("merged-theme");
+
+  /* Merge themes bottom to top */
+  for (int i = self->layers->len - 1; i >= 0; i--) {
+    FbdThemeLayer *layer = g_ptr_array_index (self->layers, i);
+
+    update_theme (layer->theme, merged);
+  }
+  fbd_feedback_theme_set_name (merged, self->theme_name);
+
+  return g_steal_pointer (&merged);
+}
+
+
+static void
+on_cache_saved (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  g_autofree char *cache_path = user_data;
+  g_autoptr (GError) err = NULL;
+
+  if (!fbd_theme_cache_save_finish (res, &err)) {
+    if (!g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      g_debug ("Failed to write theme cache %s: %s", cache_path, err->message);
+    return;
+  }
+
+  g_debug ("Wrote theme cache %s", cache_path);
+}
+
+
+static void
+save_cache (FbdThemeExpander *self, FbdFeedbackTheme *theme, GStrv overlay_paths)
+{
+  g_autoptr (GPtrArray) names = g_ptr_array_new ();
+  g_autoptr (GPtrArray) paths = g_ptr_array_new ();
+  g_autofree char *cache_path = NULL;
+
+  for (guint i = 0; i < self->layers->len; i++) {
+    FbdThemeLayer *layer = g_ptr_array_index (self->layers, i);
+
+    g_ptr_array_add (names, layer->name);
+    g_ptr_array_add (paths, layer->path);
+  }
+  g_ptr_array_add (names, NULL);
+  g_ptr_array_add (paths, NULL);
+
+  /* A newer theme supersedes the one still being written */
+  g_cancellable_cancel (self->cache_cancel);
+  g_clear_object (&self->cache_cancel);
+  self->cache_cancel = g_cancellable_new ();
+
+  cache_path = fbd_theme_cache_get_path (self->theme_name, self->theme_file);
+  fbd_theme_cache_save_async (cache_path, theme,
+                              (const char * const *)names->pdata,
+                              (const char * const *)paths->pdata,
+                              (const char * const *)overlay_paths,
+                              self->cache_cancel,
+                              on_cache_saved,
+                              g_strdup (cache_path));
+}
+
+
+static int
+compare_paths (gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0 (*(const char **)a, *(const char **)b);
+}
+
+/*
+ * Find the per application overlays in the `apps` folders next to
+ * the theme files. These are named after the munged app id. Returns
+ * the files in use sorted by path.
+ */
+static GStrv
+find_app_overlays (FbdThemeExpander *self)
+{
+  g_autoptr (GHashTable) app_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  g_autoptr (GPtrArray) overlay_paths = g_ptr_array_new ();
+  g_auto (GStrv) dirs = get_app_overlay_dirs ();
+
+  for (int i = 0; dirs[i]; i++) {
+    GHashTable *files = fbd_theme_dirs_get_files (self->theme_dirs, dirs[i]);
+    GHashTableIter iter;
+    const char *file_name;
+
+    g_hash_table_iter_init (&iter, files);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&file_name, NULL)) {
+      /* Overlays from folders earlier in the list take precedence */
+      if (g_hash_table_contains (app_ids, file_name))
+        continue;
+
+      g_hash_table_add (app_ids, g_strdup (file_name));
+
+      g_ptr_array_add (overlay_paths, g_build_filename (dirs[i], file_name, NULL));
+    }
+  }
+
+  g_ptr_array_sort (overlay_paths, compare_paths);
+  g_ptr_array_add (overlay_paths, NULL);
+
+  return (GStrv)g_ptr_array_free (g_steal_pointer (&overlay_paths), FALSE);
+}
+
+
+static void
+load_app_overlays (FbdThemeExpander *self, FbdFeedbackTheme *theme, GStrv overlay_paths)
+{
+  for (int i = 0; overlay_paths[i]; i++) {
+    g_autoptr (FbdFeedbackTheme) overlay = NULL;
+    g_autoptr (GError) err = NULL;
+    g_autofree char *file_name = g_path_get_basename (overlay_paths[i]);
+    g_autofree char *app_id = g_strndup (file_name, strlen (file_name) - strlen (".json"));
+
+    overlay = fbd_feedback_theme_new_from_file (overlay_paths[i], &err);
+    if (overlay == NULL) {
+      g_warning ("Failed to load app overlay %s: %s", overlay_paths[i], err->message);
+      continue;
+    }
+
+    if (fbd_feedback_theme_get_parent_name (overlay))
+      g_warning ("Ignoring parent of app overlay %s", overlay_paths[i]);
+
+    g_debug ("Using overlay %s for app '%s'", overlay_paths[i], app_id);
+    fbd_feedback_theme_add_app_overlay (theme, app_id, overlay);
+  }
+}
+
 /**
  * fbd_theme_expander_load_theme_files:
  * @self: The theme expander
@@ -348,76 +830,207 @@ update_theme (gpointer data, gpointer user_data)
 FbdFeedbackTheme *
 fbd_theme_expander_load_theme_files (FbdThemeExpander *self, GError **err)
 {
-  g_autoqueue (FbdFeedbackTheme) queue = g_queue_new ();
-  g_autoptr (FbdFeedbackTheme) merged = fbd_feedback_theme_new ("merged-theme");
+  g_autoptr (GPtrArray) layers = g_ptr_array_new_with_free_func ((GDestroyNotify)fbd_theme_layer_free);
   g_autoptr (FbdFeedbackTheme) theme = NULL;
+  g_autoptr (GError) cache_err = NULL;
+  g_auto (GStrv) names = NULL;
+  g_auto (GStrv) paths = NULL;
+  g_auto (GStrv) overlay_paths = NULL;
   g_autofree char *theme_file = NULL;
+  g_autofree char *cache_path = NULL;
+  gboolean device_theme_loaded;
   guint len = 0;
 
   g_return_val_if_fail (FBD_IS_THEME_EXPANDER (self), NULL);
   g_return_val_if_fail (err == NULL || *err == NULL, NULL);
 
+  /* Pick up themes added since the last load */
+  fbd_theme_dirs_invalidate (self->theme_dirs);
+
   if (self->theme_file) {
     theme_file = g_strdup (self->theme_file);
   } else {
     theme_file = fbd_theme_expander_find_theme_path (self, self->theme_name);
+    self->theme_file_resolved = TRUE;
     if (g_strcmp0 (self->theme_file, theme_file)) {
       self->theme_file = g_steal_pointer (&theme_file);
       g_object_notify_by_pspec (G_OBJECT (self), props[PROP_THEME_FILE]);
     }
   }
 
+  overlay_paths = find_app_overlays (self);
+
+  /* Resolving parents during cache validation affects device theme lookup */
+  device_theme_loaded = self->device_theme_loaded;
+  cache_path = fbd_theme_cache_get_path (self->theme_name, self->theme_file);
+  theme = fbd_theme_cache_load (cache_path, resolve_theme_path, self,
+                                (const char * const *)overlay_paths,
+                                &names, &paths, &cache_err);
+  if (theme) {
+    g_info ("Loaded theme '%s' from cache %s", self->theme_name, cache_path);
+    /* Theme files get parsed once they change */
+    for (int i = 0; paths[i]; i++) {
+      g_ptr_array_add (layers, fbd_theme_layer_new (self, i ? names[i] : self->theme_name,
+                                                    paths[i], NULL));
+    }
+    g_clear_pointer (&self->layers, g_ptr_array_unref);
+    self->layers = g_steal_pointer (&layers);
+    update_monitors (self);
+    return g_steal_pointer (&theme);
+  }
+  g_debug ("Not using theme cache: %s", cache_err->message);
+  self->device_theme_loaded = device_theme_loaded;
+
   g_info ("Loading theme file at '%s'", self->theme_file);
   theme = fbd_feedback_theme_new_from_file (self->theme_file, err);
   if (theme == NULL)
       return NULL;
 
+  g_ptr_array_add (layers, fbd_theme_layer_new (self, self->theme_name, self->theme_file, theme));
+
   /* Build a list of themes */
   while (TRUE) {
     g_autofree char *parent_path = NULL;
-    const char *parent_name, *theme_name;
+    const char *parent_name;
 
     if (len > MAX_THEME_DEPTH) {
       g_set_error (err, fbd_error_quark(), FBD_ERROR_THEME_EXPAND, "Theme depth exceeded");
       return NULL;
     }
 
-    theme_name = fbd_feedback_theme_get_name (theme);
-    if (theme_name == NULL || theme_name[0] == '\0') {
-      g_set_error (err, fbd_error_quark(), FBD_ERROR_THEME_EXPAND,
-                   "Theme name of %s can't be empty", self->theme_file);
-      return NULL;
-    }
-
-    parent_name = fbd_feedback_theme_get_parent_name (theme);
-
-    if (parent_name &&
-        g_str_equal (fbd_feedback_theme_get_name (theme), DEFAULT_THEME_NAME)) {
-      g_set_error (err, fbd_error_quark(), FBD_ERROR_THEME_EXPAND,
-                   "Default theme can't specify a parent");
+    if (!check_theme (self, theme, self->theme_file, err))
       return NULL;
-    }
 
     parent_name = fbd_feedback_theme_get_parent_name (theme);
-
-    g_queue_push_head (queue, g_steal_pointer (&theme));
-
     if (parent_name == NULL)
       break;
 
     parent_path = fbd_theme_expander_find_theme_path (self, parent_name);
+    g_clear_object (&theme);
     theme = fbd_feedback_theme_new_from_file (parent_path, err);
     if (theme == NULL)
       return NULL;
 
+    g_ptr_array_add (layers, fbd_theme_layer_new (self, parent_name, parent_path, theme));
     len++;
   }
 
-  /* Merge themes bottom to top */
-  g_queue_foreach (queue, update_theme, merged);
+  g_clear_pointer (&self->layers, g_ptr_array_unref);
+  self->layers = g_steal_pointer (&layers);
+  update_monitors (self);
 
-  fbd_feedback_theme_set_name (merged, self->theme_name);
-  return g_steal_pointer (&merged);
+  theme = merge_layers (self);
+  load_app_overlays (self, theme, overlay_paths);
+  save_cache (self, theme, overlay_paths);
+
+  return g_steal_pointer (&theme);
+}
+
+/**
+ * fbd_theme_expander_reload:
+ * @self: The theme expander
+ * @err: return location for error or %NULL
+ *
+ * Expands the theme again after #FbdThemeExpander::theme-changed got
+ * emitted. Only theme files that changed since the last load are
+ * parsed again unless the chain of parent themes changed.
+ *
+ * Returns: (transfer full)(allow-none): The parsed theme or %NULL on error
+ */
+FbdFeedbackTheme *
+fbd_theme_expander_reload (FbdThemeExpander *self, GError **err)
+{
+  g_auto (GStrv) overlay_paths = NULL;
+  FbdFeedbackTheme *theme;
+
+  g_return_val_if_fail (FBD_IS_THEME_EXPANDER (self), NULL);
+  g_return_val_if_fail (err == NULL || *err == NULL, NULL);
+
+  if (self->layers == NULL || self->rescan)
+    goto full_reload;
+
+  for (guint i = 0; i < self->layers->len; i++) {
+    FbdThemeLayer *layer = g_ptr_array_index (self->layers, i);
+    FbdThemeLayer *parent = NULL;
+
+    if (layer->theme)
+      continue;
+
+    g_info ("Reloading theme file at '%s'", layer->path);
+    layer->theme = fbd_feedback_theme_new_from_file (layer->path, err);
+    if (layer->theme == NULL)
+      return NULL;
+
+    if (!check_theme (self, layer->theme, layer->path, err)) {
+      g_clear_object (&layer->theme);
+      return NULL;
+    }
+
+    if (i + 1 < self->layers->len)
+      parent = g_ptr_array_index (self->layers, i + 1);
+
+    /* Resolve the whole chain again when a parent got added, removed or renamed */
+    if (g_strcmp0 (fbd_feedback_theme_get_parent_name (layer->theme),
+                   parent ? parent->name : NULL)) {
+      g_debug ("Parent of theme file %s changed", layer->path);
+      goto full_reload;
+    }
+  }
+
+  overlay_paths = find_app_overlays (self);
+  theme = merge_layers (self);
+  load_app_overlays (self, theme, overlay_paths);
+  save_cache (self, theme, overlay_paths);
+
+  return theme;
+
+ full_reload:
+  self->rescan = FALSE;
+  if (self->theme_file_resolved)
+    g_clear_pointer (&self->theme_file, g_free);
+  self->device_theme_loaded = FALSE;
+
+  return fbd_theme_expander_load_theme_files (self, err);
+}
+
+/**
+ * fbd_theme_expander_set_watch:
+ * @self: The theme expander
+ * @watch: Whether to watch the theme files
+ *
+ * Enables or disables monitoring the theme files for changes.
+ */
+void
+fbd_theme_expander_set_watch (FbdThemeExpander *self, gboolean watch)
+{
+  g_return_if_fail (FBD_IS_THEME_EXPANDER (self));
+
+  if (self->watch == !!watch)
+    return;
+
+  self->watch = !!watch;
+  if (self->watch) {
+    update_monitors (self);
+    return;
+  }
+
+  g_clear_handle_id (&self->reload_id, g_source_remove);
+  if (self->user_dir_monitor)
+    g_file_monitor_cancel (self->user_dir_monitor);
+  g_clear_object (&self->user_dir_monitor);
+  for (guint i = 0; self->app_dir_monitors && i < self->app_dir_monitors->len; i++)
+    g_file_monitor_cancel (g_ptr_array_index (self->app_dir_monitors, i));
+  g_clear_pointer (&self->app_dir_monitors, g_ptr_array_unref);
+  for (guint i = 0; self->layers && i < self->layers->len; i++) {
+    FbdThemeLayer *layer = g_ptr_array_index (self->layers, i);
+
+    if (layer->monitor == NULL)
+      continue;
+
+    g_signal_handlers_disconnect_by_data (layer->monitor, layer);
+    g_file_monitor_cancel (layer->monitor);
+    g_clear_object (&layer->monitor);
+  }
 }
 
 const char *
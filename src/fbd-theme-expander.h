@@ -24,6 +24,9 @@ FbdThemeExpander   *fbd_theme_expander_new (const char * const *compatibles,
                                             const char *theme_file);
 FbdFeedbackTheme   *fbd_theme_expander_load_theme_files (FbdThemeExpander  *self,
                                                          GError           **err);
+FbdFeedbackTheme   *fbd_theme_expander_reload (FbdThemeExpander  *self,
+                                               GError           **err);
+void                fbd_theme_expander_set_watch (FbdThemeExpander *self, gboolean watch);
 const char         *fbd_theme_expander_get_theme_name (FbdThemeExpander *self);
 const char         *fbd_theme_expander_get_theme_file (FbdThemeExpander *self);
 const char * const *fbd_theme_expander_get_compatibles (FbdThemeExpander *self);
@@ -0,0 +1,1013 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#define G_LOG_DOMAIN "fbd-theme-parser"
+
+#include "fbd.h"
+#include "fbd-feedback-dummy.h"
+#include "fbd-feedback-led.h"
+#include "fbd-feedback-sound.h"
+#include "fbd-feedback-vibra-periodic.h"
+#include "fbd-feedback-vibra-rumble.h"
+#include "fbd-theme-parser.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <string.h>
+
+/* Longest number we accept, e.g. `-1.7976931348623157e+308` */
+#define MAX_NUMBER_LEN 32
+/* Deepest nesting of objects and arrays we accept, themes need 5 */
+#define MAX_DEPTH 64
+
+/**
+ * SECTION:fbd-theme-parser
+ * @short_description: Parses feedback themes
+ * @Title: FbdThemeParser
+ *
+ * A parser for the JSON theme format that creates the theme's profiles
+ * and feedbacks while reading the input. Unlike deserializing via
+ * json-glib it doesn't build a tree of the whole document first and
+ * errors point to the line and column of the offending token.
+ *
+ * Besides plain JSON it accepts hexadecimal integers and C style
+ * comments like json-glib does.
+ */
+
+typedef enum {
+  TOKEN_EOF,
+  TOKEN_LBRACE,
+  TOKEN_RBRACE,
+  TOKEN_LBRACKET,
+  TOKEN_RBRACKET,
+  TOKEN_COLON,
+  TOKEN_COMMA,
+  TOKEN_STRING,
+  TOKEN_INT,
+  TOKEN_DOUBLE,
+  TOKEN_TRUE,
+  TOKEN_FALSE,
+  TOKEN_NULL,
+} FbdTokenType;
+
+static const char * const token_names[] = {
+  "end of input", "'{'", "'}'", "'['", "']'", "':'", "','",
+  "string", "integer", "number", "true", "false", "null",
+};
+
+typedef struct {
+  FbdTokenType type;
+  guint        line;
+  guint        column;
+  GString     *str;
+  gint64       i;
+  double       d;
+} FbdToken;
+
+/* A property value of a feedback, kept until the feedback's type is known */
+typedef struct {
+  const char  *name;   /* The property's canonical name, owned by its pspec */
+  FbdTokenType type;
+  char        *str;
+  gint64       i;
+  double       d;
+  guint        line;
+  guint        column;
+} FbdThemeValue;
+
+typedef struct {
+  const char *filename;
+  const char *pos;
+  const char *end;
+  const char *line_start;
+  guint       line;
+  FbdToken    token;
+  /* The number of objects and arrays we're in */
+  guint       depth;
+  /* The name of the current member, valid until the next member */
+  GString    *member;
+  guint       member_line;
+  guint       member_column;
+
+  /* The feedback currently being parsed */
+  gboolean    have_type;
+  char       *type_name;
+  GArray     *values;
+} FbdThemeParser;
+
+typedef gboolean (*FbdMemberFunc) (FbdThemeParser *parser,
+                                   const char     *name,
+                                   gpointer        data,
+                                   GError        **error);
+typedef gboolean (*FbdElementFunc) (FbdThemeParser *parser,
+                                    gpointer        data,
+                                    GError        **error);
+
+static const struct {
+  const char *name;
+  GType     (*get_type) (void);
+} feedback_types[] = {
+  { "Dummy", fbd_feedback_dummy_get_type },
+  { "Led", fbd_feedback_led_get_type },
+  { "Sound", fbd_feedback_sound_get_type },
+  { "VibraPeriodic", fbd_feedback_vibra_periodic_get_type },
+  { "VibraRumble", fbd_feedback_vibra_rumble_get_type },
+};
+
+/**
+ * fbd_theme_parser_lookup_type:
+ * @type_name: The feedback type as used in themes, e.g. `VibraRumble`
+ *
+ * Looks up the type of a feedback. The first letter of @type_name is
+ * case insensitive.
+ *
+ * Returns: The feedback's type or `G_TYPE_INVALID`
+ */
+GType
+fbd_theme_parser_lookup_type (const char *type_name)
+{
+  if (type_name == NULL || type_name[0] == '\0')
+    return G_TYPE_INVALID;
+
+  for (guint i = 0; i < G_N_ELEMENTS (feedback_types); i++) {
+    const char *name = feedback_types[i].name;
+
+    if (g_ascii_toupper (type_name[0]) == name[0] && g_str_equal (type_name + 1, name + 1))
+      return feedback_types[i].get_type ();
+  }
+
+  return G_TYPE_INVALID;
+}
+
+
+static gboolean G_GNUC_PRINTF (5, 6)
+parser_error (FbdThemeParser *parser, guint line, guint column, GError **error,
+              const char *format, ...)
+{
+  g_autofree char *msg = NULL;
+  va_list args;
+
+  va_start (args, format);
+  msg = g_strdup_vprintf (format, args);
+  va_end (args);
+
+  g_set_error (error, fbd_error_quark (), FBD_ERROR_THEME_PARSE, "%s:%u:%u: %s",
+               parser->filename ?: "<data>", line, column, msg);
+  return FALSE;
+}
+
+
+static gboolean
+token_error (FbdThemeParser *parser, const char *expected, GError **error)
+{
+  return parser_error (parser, parser->token.line, parser->token.column, error,
+                       "Expected %s, got %s", expected, token_names[parser->token.type]);
+}
+
+
+static void
+skip_whitespace (FbdThemeParser *parser)
+{
+  while (parser->pos < parser->end) {
+    const char *p = parser->pos;
+
+    if (*p == '\n') {
+      parser->line++;
+      parser->line_start = p + 1;
+      parser->pos++;
+    } else if (*p == ' ' || *p == '\t' || *p == '\r') {
+      parser->pos++;
+    } else if (*p == '/' && p + 1 < parser->end && p[1] == '/') {
+      while (parser->pos < parser->end && *parser->pos != '\n')
+        parser->pos++;
+    } else if (*p == '/' && p + 1 < parser->end && p[1] == '*') {
+      parser->pos += 2;
+      while (parser->pos < parser->end &&
+             !(*parser->pos == '*' && parser->pos + 1 < parser->end && parser->pos[1] == '/')) {
+        if (*parser->pos == '\n') {
+          parser->line++;
+          parser->line_start = parser->pos + 1;
+        }
+        parser->pos++;
+      }
+      parser->pos = MIN (parser->pos + 2, parser->end);
+    } else {
+      break;
+    }
+  }
+}
+
+
+static int
+hex_value (char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+
+static gboolean
+read_unichar (FbdThemeParser *parser, gunichar *c, GError **error)
+{
+  *c = 0;
+
+  if (parser->end - parser->pos < 4)
+    goto invalid;
+
+  for (int i = 0; i < 4; i++) {
+    int v = hex_value (parser->pos[i]);
+
+    if (v < 0)
+      goto invalid;
+    *c = (*c << 4) | v;
+  }
+  parser->pos += 4;
+  return TRUE;
+
+ invalid:
+  return parser_error (parser, parser->line, parser->pos - parser->line_start + 1, error,
+                       "Invalid unicode escape");
+}
+
+
+static gboolean
+read_string (FbdThemeParser *parser, GError **error)
+{
+  GString *str = parser->token.str;
+
+  g_string_truncate (str, 0);
+  /* Skip the opening quote */
+  parser->pos++;
+
+  while (parser->pos < parser->end) {
+    const char *start = parser->pos;
+    char c;
+
+    /* Copy runs of plain characters at once */
+    while (parser->pos < parser->end && *parser->pos != '"' && *parser->pos != '\\' &&
+           (guchar)*parser->pos >= 0x20)
+      parser->pos++;
+    g_string_append_len (str, start, parser->pos - start);
+
+    if (parser->pos >= parser->end)
+      break;
+
+    c = *parser->pos++;
+    if (c == '"')
+      return TRUE;
+
+    if (c != '\\') {
+      return parser_error (parser, parser->line, parser->pos - parser->line_start, error,
+                           "Control character in string");
+    }
+
+    if (parser->pos >= parser->end)
+      break;
+
+    c = *parser->pos++;
+    switch (c) {
+    case '"':
+    case '\\':
+    case '/':
+      g_string_append_c (str, c);
+      break;
+    case 'b':
+      g_string_append_c (str, '\b');
+      break;
+    case 'f':
+      g_string_append_c (str, '\f');
+      break;
+    case 'n':
+      g_string_append_c (str, '\n');
+      break;
+    case 'r':
+      g_string_append_c (str, '\r');
+      break;
+    case 't':
+      g_string_append_c (str, '\t');
+      break;
+    case 'u': {
+      gunichar uc, low;
+
+      if (!read_unichar (parser, &uc, error))
+        return FALSE;
+
+      /* Surrogate pair */
+      if (uc >= 0xd800 && uc < 0xdc00) {
+        if (parser->end - parser->pos < 2 || parser->pos[0] != '\\' || parser->pos[1] != 'u')
+          return parser_error (parser, parser->line, parser->pos - parser->line_start + 1, error,
+                               "Unpaired surrogate in unicode escape");
+        parser->pos += 2;
+        if (!read_unichar (parser, &low, error))
+          return FALSE;
+        if (low < 0xdc00 || low >= 0xe000)
+          return parser_error (parser, parser->line, parser->pos - parser->line_start + 1, error,
+                               "Unpaired surrogate in unicode escape");
+        uc = 0x10000 + ((uc - 0xd800) << 10) + (low - 0xdc00);
+      }
+      g_string_append_unichar (str, uc);
+      break;
+    }
+    default:
+      return parser_error (parser, parser->line, parser->pos - parser->line_start - 1, error,
+                           "Invalid escape '\\%c' in string", c);
+    }
+  }
+
+  return parser_error (parser, parser->token.line, parser->token.column, error,
+                       "Unterminated string");
+}
+
+
+static gboolean
+read_number (FbdThemeParser *parser, GError **error)
+{
+  char buf[MAX_NUMBER_LEN + 1];
+  const char *start = parser->pos;
+  gboolean is_double = FALSE;
+  char *endptr;
+  gsize len;
+
+  while (parser->pos < parser->end &&
+         (g_ascii_isxdigit (*parser->pos) || strchr ("+-.xX", *parser->pos))) {
+    if (strchr (".eE", *parser->pos))
+      is_double = TRUE;
+    parser->pos++;
+  }
+
+  len = parser->pos - start;
+  if (len > MAX_NUMBER_LEN)
+    return parser_error (parser, parser->token.line, parser->token.column, error,
+                         "Number too long");
+  memcpy (buf, start, len);
+  buf[len] = '\0';
+
+  errno = 0;
+  if (g_str_has_prefix (buf, "0x") || g_str_has_prefix (buf, "0X")) {
+    parser->token.type = TOKEN_INT;
+    parser->token.i = g_ascii_strtoll (buf + 2, &endptr, 16);
+  } else if (is_double) {
+    parser->token.type = TOKEN_DOUBLE;
+    parser->token.d = g_ascii_strtod (buf, &endptr);
+  } else {
+    parser->token.type = TOKEN_INT;
+    parser->token.i = g_ascii_strtoll (buf, &endptr, 10);
+  }
+
+  if (errno || *endptr != '\0' || endptr == buf) {
+    return parser_error (parser, parser->token.line, parser->token.column, error,
+                         "Invalid number '%s'", buf);
+  }
+
+  return TRUE;
+}
+
+
+static gboolean
+read_literal (FbdThemeParser *parser, const char *literal, FbdTokenType type, GError **error)
+{
+  gsize len = strlen (literal);
+
+  if ((gsize)(parser->end - parser->pos) < len || strncmp (parser->pos, literal, len) ||
+      (parser->pos + len < parser->end && g_ascii_isalnum (parser->pos[len]))) {
+    return parser_error (parser, parser->token.line, parser->token.column, error,
+                         "Unexpected character '%c'", *parser->pos);
+  }
+
+  parser->pos += len;
+  parser->token.type = type;
+  return TRUE;
+}
+
+
+static gboolean
+next_token (FbdThemeParser *parser, GError **error)
+{
+  FbdToken *token = &parser->token;
+  char c;
+
+  skip_whitespace (parser);
+  token->line = parser->line;
+  token->column = parser->pos - parser->line_start + 1;
+
+  if (parser->pos >= parser->end) {
+    token->type = TOKEN_EOF;
+    return TRUE;
+  }
+
+  c = *parser->pos;
+  switch (c) {
+  case '{':
+    token->type = TOKEN_LBRACE;
+    break;
+  case '}':
+    token->type = TOKEN_RBRACE;
+    break;
+  case '[':
+    token->type = TOKEN_LBRACKET;
+    break;
+  case ']':
+    token->type = TOKEN_RBRACKET;
+    break;
+  case ':':
+    token->type = TOKEN_COLON;
+    break;
+  case ',':
+    token->type = TOKEN_COMMA;
+    break;
+  case '"':
+    token->type = TOKEN_STRING;
+    return read_string (parser, error);
+  case 't':
+    return read_literal (parser, "true", TOKEN_TRUE, error);
+  case 'f':
+    return read_literal (parser, "false", TOKEN_FALSE, error);
+  case 'n':
+    return read_literal (parser, "null", TOKEN_NULL, error);
+  default:
+    if (c == '-' || g_ascii_isdigit (c))
+      return read_number (parser, error);
+    return parser_error (parser, token->line, token->column, error,
+                         "Unexpected character '%c'", c);
+  }
+
+  parser->pos++;
+  return TRUE;
+}
+
+
+static gboolean
+expect (FbdThemeParser *parser, FbdTokenType type, GError **error)
+{
+  if (parser->token.type != type)
+    return token_error (parser, token_names[type], error);
+
+  return next_token (parser, error);
+}
+
+
+static gboolean skip_value (FbdThemeParser *parser, GError **error);
+
+static gboolean
+skip_member (FbdThemeParser *parser, const char *name, gpointer data, GError **error)
+{
+  return skip_value (parser, error);
+}
+
+static gboolean
+skip_element (FbdThemeParser *parser, gpointer data, GError **error)
+{
+  return skip_value (parser, error);
+}
+
+static gboolean
+enter_container (FbdThemeParser *parser, GError **error)
+{
+  if (parser->depth >= MAX_DEPTH) {
+    return parser_error (parser, parser->token.line, parser->token.column, error,
+                         "Nesting deeper than %u levels", MAX_DEPTH);
+  }
+
+  parser->depth++;
+  return next_token (parser, error);
+}
+
+static gboolean
+leave_container (FbdThemeParser *parser, GError **error)
+{
+  parser->depth--;
+  return next_token (parser, error);
+}
+
+static gboolean parse_object (FbdThemeParser *parser, FbdMemberFunc func, gpointer data,
+                              GError **error);
+static gboolean parse_array (FbdThemeParser *parser, FbdElementFunc func, gpointer data,
+                             GError **error);
+
+static gboolean
+skip_value (FbdThemeParser *parser, GError **error)
+{
+  switch (parser->token.type) {
+  case TOKEN_LBRACE:
+    return parse_object (parser, skip_member, NULL, error);
+  case TOKEN_LBRACKET:
+    return parse_array (parser, skip_element, NULL, error);
+  case TOKEN_STRING:
+  case TOKEN_INT:
+  case TOKEN_DOUBLE:
+  case TOKEN_TRUE:
+  case TOKEN_FALSE:
+  case TOKEN_NULL:
+    return next_token (parser, error);
+  default:
+    return token_error (parser, "value", error);
+  }
+}
+
+
+static gboolean
+parse_object (FbdThemeParser *parser, FbdMemberFunc func, gpointer data, GError **error)
+{
+  if (parser->token.type != TOKEN_LBRACE)
+    return token_error (parser, token_names[TOKEN_LBRACE], error);
+
+  if (!enter_container (parser, error))
+    return FALSE;
+
+  if (parser->token.type == TOKEN_RBRACE)
+    return leave_container (parser, error);
+
+  while (TRUE) {
+    if (parser->token.type != TOKEN_STRING)
+      return token_error (parser, "member name", error);
+
+    /* Reuse the buffer, members that need the name later look it up */
+    g_string_assign (parser->member, parser->token.str->str);
+    parser->member_line = parser->token.line;
+    parser->member_column = parser->token.column;
+    if (!next_token (parser, error))
+      return FALSE;
+
+    if (!expect (parser, TOKEN_COLON, error))
+      return FALSE;
+
+    if (!func (parser, parser->member->str, data, error))
+      return FALSE;
+
+    if (parser->token.type == TOKEN_RBRACE)
+      return leave_container (parser, error);
+
+    if (!expect (parser, TOKEN_COMMA, error))
+      return FALSE;
+  }
+}
+
+
+static gboolean
+parse_array (FbdThemeParser *parser, FbdElementFunc func, gpointer data, GError **error)
+{
+  if (parser->token.type != TOKEN_LBRACKET)
+    return token_error (parser, token_names[TOKEN_LBRACKET], error);
+
+  if (!enter_container (parser, error))
+    return FALSE;
+
+  if (parser->token.type == TOKEN_RBRACKET)
+    return leave_container (parser, error);
+
+  while (TRUE) {
+    if (!func (parser, data, error))
+      return FALSE;
+
+    if (parser->token.type == TOKEN_RBRACKET)
+      return leave_container (parser, error);
+
+    if (!expect (parser, TOKEN_COMMA, error))
+      return FALSE;
+  }
+}
+
+
+static gboolean
+parse_string (FbdThemeParser *parser, char **str, GError **error)
+{
+  if (parser->token.type == TOKEN_NULL) {
+    g_clear_pointer (str, g_free);
+    return next_token (parser, error);
+  }
+
+  if (parser->token.type != TOKEN_STRING)
+    return token_error (parser, token_names[TOKEN_STRING], error);
+
+  g_free (*str);
+  *str = g_strdup (parser->token.str->str);
+  return next_token (parser, error);
+}
+
+
+static void
+fbd_theme_value_clear (FbdThemeValue *value)
+{
+  g_clear_pointer (&value->str, g_free);
+}
+
+
+/*
+ * Looks up @name in the properties of all feedback types so unknown
+ * members don't need to be stored. The returned name is owned by the
+ * property's pspec and canonical so duplicates can be compared by
+ * pointer.
+ */
+static const char *
+lookup_property_name (const char *name)
+{
+  for (guint i = 0; i < G_N_ELEMENTS (feedback_types); i++) {
+    GType gtype = feedback_types[i].get_type ();
+    GObjectClass *klass = g_type_class_peek (gtype);
+    GParamSpec *pspec;
+
+    /* Feedback classes are kept around once used */
+    if (klass == NULL)
+      klass = g_type_class_ref (gtype);
+
+    pspec = g_object_class_find_property (klass, name);
+    if (pspec)
+      return pspec->name;
+  }
+
+  return NULL;
+}
+
+
+static gboolean
+parse_feedback_member (FbdThemeParser *parser, const char *name, gpointer data, GError **error)
+{
+  FbdToken *token = &parser->token;
+  FbdThemeValue value = { 0 };
+
+  if (g_str_equal (name, "type")) {
+    if (parser->have_type) {
+      return parser_error (parser, parser->member_line, parser->member_column, error,
+                           "Duplicate member '%s'", name);
+    }
+    parser->have_type = TRUE;
+    return parse_string (parser, &parser->type_name, error);
+  }
+
+  value.name = lookup_property_name (name);
+  /* Like json-glib ignore unknown members */
+  if (value.name == NULL)
+    return skip_value (parser, error);
+
+  for (guint i = 0; i < parser->values->len; i++) {
+    if (g_array_index (parser->values, FbdThemeValue, i).name == value.name) {
+      return parser_error (parser, parser->member_line, parser->member_column, error,
+                           "Duplicate member '%s'", name);
+    }
+  }
+
+  value.type = token->type;
+  value.line = token->line;
+  value.column = token->column;
+
+  switch (token->type) {
+  case TOKEN_STRING:
+    value.str = g_strdup (token->str->str);
+    break;
+  case TOKEN_INT:
+    value.i = token->i;
+    break;
+  case TOKEN_DOUBLE:
+    value.d = token->d;
+    break;
+  case TOKEN_TRUE:
+  case TOKEN_FALSE:
+  case TOKEN_NULL:
+    break;
+  case TOKEN_LBRACE:
+  case TOKEN_LBRACKET:
+    /* Not a valid value for any feedback property, complain if it's known */
+    g_array_append_val (parser->values, value);
+    return skip_value (parser, error);
+  default:
+    return token_error (parser, "value", error);
+  }
+
+  g_array_append_val (parser->values, value);
+  return next_token (parser, error);
+}
+
+
+static gboolean
+value_to_gvalue (FbdThemeValue *value, GParamSpec *pspec, GValue *gvalue)
+{
+  GType type = G_PARAM_SPEC_VALUE_TYPE (pspec);
+
+  g_value_init (gvalue, type);
+
+  switch (G_TYPE_FUNDAMENTAL (type)) {
+  case G_TYPE_STRING:
+    if (value->type == TOKEN_NULL)
+      return TRUE;
+    if (value->type != TOKEN_STRING)
+      return FALSE;
+    g_value_set_string (gvalue, value->str);
+    return TRUE;
+  case G_TYPE_BOOLEAN:
+    if (value->type != TOKEN_TRUE && value->type != TOKEN_FALSE)
+      return FALSE;
+    g_value_set_boolean (gvalue, value->type == TOKEN_TRUE);
+    return TRUE;
+  case G_TYPE_INT:
+    if (value->type != TOKEN_INT || value->i < G_MININT || value->i > G_MAXINT)
+      return FALSE;
+    g_value_set_int (gvalue, value->i);
+    return TRUE;
+  case G_TYPE_UINT:
+    if (value->type != TOKEN_INT || value->i < 0 || value->i > G_MAXUINT)
+      return FALSE;
+    g_value_set_uint (gvalue, value->i);
+    return TRUE;
+  case G_TYPE_INT64:
+    if (value->type != TOKEN_INT)
+      return FALSE;
+    g_value_set_int64 (gvalue, value->i);
+    return TRUE;
+  case G_TYPE_UINT64:
+    if (value->type != TOKEN_INT || value->i < 0)
+      return FALSE;
+    g_value_set_uint64 (gvalue, value->i);
+    return TRUE;
+  case G_TYPE_DOUBLE:
+    if (value->type == TOKEN_INT)
+      g_value_set_double (gvalue, value->i);
+    else if (value->type == TOKEN_DOUBLE)
+      g_value_set_double (gvalue, value->d);
+    else
+      return FALSE;
+    return TRUE;
+  case G_TYPE_ENUM:
+    if (value->type == TOKEN_INT) {
+      g_value_set_enum (gvalue, value->i);
+    } else if (value->type == TOKEN_STRING) {
+      g_autoptr (GEnumClass) klass = g_type_class_ref (type);
+      GEnumValue *enum_value = g_enum_get_value_by_nick (klass, value->str);
+
+      if (enum_value == NULL)
+        enum_value = g_enum_get_value_by_name (klass, value->str);
+      if (enum_value == NULL)
+        return FALSE;
+      g_value_set_enum (gvalue, enum_value->value);
+    } else {
+      return FALSE;
+    }
+    return TRUE;
+  case G_TYPE_FLAGS:
+    if (value->type != TOKEN_INT)
+      return FALSE;
+    g_value_set_flags (gvalue, value->i);
+    return TRUE;
+  default:
+    return FALSE;
+  }
+}
+
+
+static FbdFeedbackBase *
+build_feedback (FbdThemeParser *parser, guint line, guint column, GError **error)
+{
+  g_autofree const char **names = NULL;
+  g_autofree GValue *gvalues = NULL;
+  g_autoptr (GTypeClass) klass = NULL;
+  FbdFeedbackBase *feedback = NULL;
+  GType gtype;
+  guint n = 0;
+
+  if (parser->type_name == NULL) {
+    parser_error (parser, line, column, error, "Feedback without type");
+    return NULL;
+  }
+
+  gtype = fbd_theme_parser_lookup_type (parser->type_name);
+  if (gtype == G_TYPE_INVALID) {
+    g_warning ("%s:%u:%u: Unknown feedback type '%s', using a dummy feedback",
+               parser->filename ?: "<data>", line, column, parser->type_name);
+    gtype = FBD_TYPE_FEEDBACK_DUMMY;
+  }
+
+  klass = g_type_class_ref (gtype);
+  names = g_new (const char *, parser->values->len);
+  gvalues = g_new0 (GValue, parser->values->len);
+
+  for (guint i = 0; i < parser->values->len; i++) {
+    FbdThemeValue *value = &g_array_index (parser->values, FbdThemeValue, i);
+    GParamSpec *pspec = g_object_class_find_property (G_OBJECT_CLASS (klass), value->name);
+    GValue copy = G_VALUE_INIT;
+    gboolean invalid;
+
+    /* Like json-glib ignore members of other feedback types */
+    if (pspec == NULL || !(pspec->flags & G_PARAM_WRITABLE))
+      continue;
+
+    if (!value_to_gvalue (value, pspec, &gvalues[n])) {
+      parser_error (parser, value->line, value->column, error,
+                    "Invalid value for property '%s' of %s", value->name, g_type_name (gtype));
+      g_value_unset (&gvalues[n]);
+      goto out;
+    }
+
+    g_value_init (&copy, G_VALUE_TYPE (&gvalues[n]));
+    g_value_copy (&gvalues[n], &copy);
+    invalid = g_param_value_validate (pspec, &copy);
+    g_value_unset (&copy);
+    if (invalid) {
+      parser_error (parser, value->line, value->column, error,
+                    "Value of property '%s' of %s out of range", value->name, g_type_name (gtype));
+      g_value_unset (&gvalues[n]);
+      goto out;
+    }
+
+    names[n++] = value->name;
+  }
+
+  feedback = FBD_FEEDBACK_BASE (g_object_new_with_properties (gtype, n, names, gvalues));
+  if (fbd_feedback_get_event_name (feedback) == NULL) {
+    parser_error (parser, line, column, error, "Feedback without event name");
+    g_clear_object (&feedback);
+  }
+
+ out:
+  for (guint i = 0; i < n; i++)
+    g_value_unset (&gvalues[i]);
+
+  return feedback;
+}
+
+
+static gboolean
+parse_feedback (FbdThemeParser *parser, gpointer data, GError **error)
+{
+  GPtrArray *feedbacks = data;
+  FbdFeedbackBase *feedback;
+  guint line = parser->token.line, column = parser->token.column;
+
+  parser->have_type = FALSE;
+  g_clear_pointer (&parser->type_name, g_free);
+  g_array_set_size (parser->values, 0);
+
+  if (!parse_object (parser, parse_feedback_member, NULL, error))
+    return FALSE;
+
+  feedback = build_feedback (parser, line, column, error);
+  if (feedback == NULL)
+    return FALSE;
+
+  g_ptr_array_add (feedbacks, feedback);
+  return TRUE;
+}
+
+
+typedef struct {
+  char      *name;
+  GPtrArray *feedbacks;
+} FbdProfileData;
+
+static gboolean
+parse_profile_member (FbdThemeParser *parser, const char *name, gpointer data, GError **error)
+{
+  FbdProfileData *profile_data = data;
+
+  if (g_str_equal (name, "name"))
+    return parse_string (parser, &profile_data->name, error);
+
+  if (g_str_equal (name, "feedbacks")) {
+    if (parser->token.type == TOKEN_NULL)
+      return next_token (parser, error);
+    return parse_array (parser, parse_feedback, profile_data->feedbacks, error);
+  }
+
+  return skip_value (parser, error);
+}
+
+
+static gboolean
+parse_profile (FbdThemeParser *parser, gpointer data, GError **error)
+{
+  FbdFeedbackTheme *theme = FBD_FEEDBACK_THEME (data);
+  g_autoptr (FbdFeedbackProfile) profile = NULL;
+  g_autoptr (GPtrArray) feedbacks = g_ptr_array_new_with_free_func (g_object_unref);
+  g_autofree char *name = NULL;
+  guint line = parser->token.line, column = parser->token.column;
+  FbdProfileData profile_data = { NULL, feedbacks };
+  gboolean success;
+
+  /* The name might come after the feedbacks so collect them first */
+  success = parse_object (parser, parse_profile_member, &profile_data, error);
+  name = profile_data.name;
+  if (!success)
+    return FALSE;
+
+  if (name == NULL)
+    return parser_error (parser, line, column, error, "Profile without name");
+
+  profile = fbd_feedback_profile_new (name);
+  for (guint i = 0; i < feedbacks->len; i++)
+    fbd_feedback_profile_add_feedback (profile, g_ptr_array_index (feedbacks, i));
+  fbd_feedback_theme_add_profile (theme, profile);
+
+  return TRUE;
+}
+
+
+static gboolean
+parse_theme_member (FbdThemeParser *parser, const char *name, gpointer data, GError **error)
+{
+  FbdFeedbackTheme *theme = FBD_FEEDBACK_THEME (data);
+
+  if (g_str_equal (name, "name")) {
+    g_autofree char *theme_name = NULL;
+
+    if (!parse_string (parser, &theme_name, error))
+      return FALSE;
+    fbd_feedback_theme_set_name (theme, theme_name);
+    return TRUE;
+  }
+
+  if (g_str_equal (name, "parent-name")) {
+    g_autofree char *parent_name = NULL;
+
+    if (!parse_string (parser, &parent_name, error))
+      return FALSE;
+    fbd_feedback_theme_set_parent_name (theme, parent_name);
+    return TRUE;
+  }
+
+  if (g_str_equal (name, "profiles")) {
+    if (parser->token.type == TOKEN_NULL)
+      return next_token (parser, error);
+    return parse_array (parser, parse_profile, theme, error);
+  }
+
+  return skip_value (parser, error);
+}
+
+/**
+ * fbd_theme_parser_parse:
+ * @data: The theme in JSON format
+ * @length: The length of @data or `-1` if it's NUL terminated
+ * @filename: (nullable): The file @data was read from, used in errors
+ * @error: Return location for an error
+ *
+ * Parses a single theme file. Parent themes aren't taken into account.
+ *
+ * Returns: (transfer full) (nullable): The theme
+ */
+FbdFeedbackTheme *
+fbd_theme_parser_parse (const char  *data,
+                        gssize       length,
+                        const char  *filename,
+                        GError     **error)
+{
+  g_autoptr (FbdFeedbackTheme) theme = NULL;
+  FbdThemeParser parser = { 0 };
+  const char *invalid;
+  gboolean success = FALSE;
+
+  g_return_val_if_fail (data, NULL);
+
+  if (length < 0)
+    length = strlen (data);
+
+  parser.filename = filename;
+  parser.pos = data;
+  parser.end = data + length;
+  parser.line_start = data;
+  parser.line = 1;
+
+  if (!g_utf8_validate (data, length, &invalid)) {
+    /* Count lines for the error */
+    for (const char *p = data; p < invalid; p++) {
+      if (*p == '\n') {
+        parser.line++;
+        parser.line_start = p + 1;
+      }
+    }
+    parser_error (&parser, parser.line, invalid - parser.line_start + 1, error, "Invalid UTF-8");
+    return NULL;
+  }
+
+  parser.token.str = g_string_new (NULL);
+  parser.member = g_string_new (NULL);
+  parser.values = g_array_new (FALSE, FALSE, sizeof (FbdThemeValue));
+  g_array_set_clear_func (parser.values, (GDestroyNotify)fbd_theme_value_clear);
+
+  theme = fbd_feedback_theme_new (NULL);
+
+  if (!next_token (&parser, error))
+    goto out;
+
+  if (!parse_object (&parser, parse_theme_member, theme, error))
+    goto out;
+
+  if (parser.token.type != TOKEN_EOF) {
+    token_error (&parser, token_names[TOKEN_EOF], error);
+    goto out;
+  }
+
+  success = TRUE;
+
+ out:
+  g_string_free (parser.token.str, TRUE);
+  g_string_free (parser.member, TRUE);
+  g_array_unref (parser.values);
+  g_free (parser.type_name);
+
+  return success ? g_steal_pointer (&theme) : NULL;
+}
@@ -0,0 +1,20 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+#pragma once
+
+#include "fbd-feedback-theme.h"
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+FbdFeedbackTheme *fbd_theme_parser_parse (const char  *data,
+                                          gssize       length,
+                                          const char  *filename,
+                                          GError     **error);
+GType             fbd_theme_parser_lookup_type (const char *type_name);
+
+G_END_DECLS
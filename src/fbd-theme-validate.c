@@ -6,12 +6,31 @@
 
 #define G_LOG_DOMAIN "fbd"
 
+#include "fbd-feedback-theme.h"
 #include "fbd-theme-expander.h"
 
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 
 #define BLURP "- A validator for feedback themes"
 
+#define THEME_SUFFIX ".json"
+#define APP_OVERLAY_DIR "apps"
+
+/* A theme file in the data dir validated in bulk mode */
+typedef struct {
+  char             *path;
+  FbdFeedbackTheme *theme; /* NULL if the file failed to parse */
+  gint64            parse_time;
+} FbdThemeFile;
+
+typedef struct {
+  GHashTable *files; /* key: theme name, value: FbdThemeFile */
+  gint64      max_time;
+  gsize       max_size;
+  gboolean    verbose;
+} FbdBulkRun;
+
 static void
 print_version (void)
 {
@@ -29,6 +48,417 @@ log_handler (const gchar   *log_domain,
 }
 
 
+static void
+fbd_theme_file_free (FbdThemeFile *file)
+{
+  g_free (file->path);
+  g_clear_object (&file->theme);
+  g_free (file);
+}
+
+
+static double
+to_ms (gint64 usec)
+{
+  return usec / 1000.0;
+}
+
+
+static const char *
+feedback_type_name (FbdFeedbackBase *feedback)
+{
+  return G_OBJECT_TYPE_NAME (feedback) + strlen ("FbdFeedback");
+}
+
+
+static int
+compare_names (gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0 (*(const char **)a, *(const char **)b);
+}
+
+
+static GHashTable *
+get_profiles (FbdFeedbackTheme *theme)
+{
+  GHashTable *profiles = NULL;
+
+  g_object_get (theme, "profiles", &profiles, NULL);
+  return profiles;
+}
+
+
+static void
+remove_tree (const char *path)
+{
+  g_autoptr (GDir) dir = g_dir_open (path, 0, NULL);
+  const char *name;
+
+  while (dir && (name = g_dir_read_name (dir))) {
+    g_autofree char *child = g_build_filename (path, name, NULL);
+
+    if (g_file_test (child, G_FILE_TEST_IS_DIR))
+      remove_tree (child);
+    else
+      g_unlink (child);
+  }
+  g_rmdir (path);
+}
+
+
+/* Parse each theme file on its own to get per file timings */
+static GHashTable *
+parse_theme_files (const char *themes_dir, gboolean *success)
+{
+  g_autoptr (GHashTable) files = NULL;
+  g_autoptr (GError) err = NULL;
+  g_autoptr (GDir) dir = NULL;
+  g_autoptr (GPtrArray) names = g_ptr_array_new_with_free_func (g_free);
+  const char *name;
+
+  dir = g_dir_open (themes_dir, 0, &err);
+  if (dir == NULL) {
+    g_printerr ("error: %s\n", err->message);
+    *success = FALSE;
+    return NULL;
+  }
+
+  while ((name = g_dir_read_name (dir))) {
+    if (g_str_has_suffix (name, THEME_SUFFIX))
+      g_ptr_array_add (names, g_strndup (name, strlen (name) - strlen (THEME_SUFFIX)));
+  }
+  g_ptr_array_sort (names, compare_names);
+
+  files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                 (GDestroyNotify)fbd_theme_file_free);
+  for (guint i = 0; i < names->len; i++) {
+    g_autofree char *file_name = g_strconcat (g_ptr_array_index (names, i), THEME_SUFFIX, NULL);
+    FbdThemeFile *file = g_new0 (FbdThemeFile, 1);
+    gint64 start;
+
+    file->path = g_build_filename (themes_dir, file_name, NULL);
+    start = g_get_monotonic_time ();
+    file->theme = fbd_feedback_theme_new_from_file (file->path, &err);
+    file->parse_time = g_get_monotonic_time () - start;
+
+    if (file->theme) {
+      g_print ("Parsed %s in %.3f ms\n", file->path, to_ms (file->parse_time));
+    } else {
+      g_printerr ("Parsing %s failed: %s\n", file->path, err->message);
+      g_clear_error (&err);
+      *success = FALSE;
+    }
+
+    g_hash_table_insert (files, g_strdup (g_ptr_array_index (names, i)), file);
+  }
+
+  return g_steal_pointer (&files);
+}
+
+
+/* The parsed theme files the theme with @name is built from, top most first */
+static GPtrArray *
+get_theme_chain (FbdBulkRun *run, const char *name)
+{
+  g_autoptr (GPtrArray) chain = g_ptr_array_new ();
+
+  while (name) {
+    FbdThemeFile *file = g_hash_table_lookup (run->files, name);
+
+    if (file == NULL || file->theme == NULL) {
+      g_print ("  Theme '%s' not in data dir, skipping merge statistics\n", name);
+      return NULL;
+    }
+
+    /* The expander already failed on overly deep or looping chains */
+    if (g_ptr_array_find (chain, file, NULL))
+      return NULL;
+
+    g_ptr_array_add (chain, file);
+    name = fbd_feedback_theme_get_parent_name (file->theme);
+  }
+
+  return g_steal_pointer (&chain);
+}
+
+
+static gint64
+time_merge (GPtrArray *chain)
+{
+  g_autoptr (FbdFeedbackTheme) merged = fbd_feedback_theme_new (NULL);
+  gint64 start = g_get_monotonic_time ();
+
+  for (int i = chain->len - 1; i >= 0; i--) {
+    FbdThemeFile *file = g_ptr_array_index (chain, i);
+
+    fbd_feedback_theme_update (merged, file->theme);
+  }
+
+  return g_get_monotonic_time () - start;
+}
+
+static void
+collect_feedback (FbdFeedbackBase *feedback, GPtrArray *feedbacks)
+{
+  g_ptr_array_add (feedbacks, feedback);
+}
+
+/*
+ * Report feedbacks of parent themes that are replaced by a child theme
+ * and feedbacks in profiles the daemon never looks at.
+ */
+static void
+report_unused (GPtrArray *chain)
+{
+  for (guint i = 0; i < chain->len; i++) {
+    FbdThemeFile *file = g_ptr_array_index (chain, i);
+    g_autoptr (GHashTable) profiles = get_profiles (file->theme);
+    GHashTableIter iter;
+    const char *profile_name;
+    FbdFeedbackProfile *profile;
+
+    g_hash_table_iter_init (&iter, profiles);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&profile_name, (gpointer *)&profile)) {
+      g_autoptr (GPtrArray) feedbacks = g_ptr_array_new ();
+
+      if (fbd_feedback_profile_level (profile_name) == FBD_FEEDBACK_PROFILE_LEVEL_UNKNOWN) {
+        g_print ("  Unused: profile '%s' in %s\n", profile_name, file->path);
+        continue;
+      }
+
+      fbd_feedback_profile_foreach_feedback (profile, (GFunc)collect_feedback, feedbacks);
+      for (guint j = 0; j < feedbacks->len; j++) {
+        const char *event_name = fbd_feedback_get_event_name (g_ptr_array_index (feedbacks, j));
+
+        for (guint k = 0; k < i; k++) {
+          FbdThemeFile *child = g_ptr_array_index (chain, k);
+          FbdFeedbackProfile *child_profile;
+          FbdFeedbackBase *fb;
+
+          child_profile = fbd_feedback_theme_get_profile (child->theme, profile_name);
+          if (child_profile == NULL)
+            continue;
+
+          fb = fbd_feedback_profile_get_feedback (child_profile, event_name);
+          if (fb && g_str_equal (fbd_feedback_get_event_name (fb), event_name)) {
+            g_print ("  Shadowed: %s/%s in %s by %s\n", profile_name, event_name,
+                     file->path, child->path);
+            break;
+          }
+        }
+      }
+    }
+  }
+}
+
+
+static void
+collect_event_name (FbdFeedbackBase *feedback, GHashTable *event_names)
+{
+  g_hash_table_add (event_names, (gpointer)fbd_feedback_get_event_name (feedback));
+}
+
+/* Print the feedbacks triggered for each event at each profile level */
+static void
+report_resolution (FbdFeedbackTheme *theme)
+{
+  g_autoptr (GHashTable) event_names = g_hash_table_new (g_str_hash, g_str_equal);
+  g_autofree const char **names = NULL;
+  guint n_names;
+
+  for (int i = FBD_FEEDBACK_PROFILE_LEVEL_SILENT; i < FBD_FEEDBACK_PROFILE_N_PROFILES; i++) {
+    FbdFeedbackProfile *profile;
+
+    profile = fbd_feedback_theme_get_profile (theme, fbd_feedback_profile_level_to_string (i));
+    if (profile)
+      fbd_feedback_profile_foreach_feedback (profile, (GFunc)collect_event_name, event_names);
+  }
+
+  names = (const char **)g_hash_table_get_keys_as_array (event_names, &n_names);
+  qsort (names, n_names, sizeof (char *), compare_names);
+  for (guint i = 0; i < n_names; i++) {
+    g_autoptr (GString) line = g_string_new (NULL);
+
+    g_string_append_printf (line, "  %s:", names[i]);
+    for (int level = FBD_FEEDBACK_PROFILE_LEVEL_FULL; level >= FBD_FEEDBACK_PROFILE_LEVEL_SILENT; level--) {
+      gboolean found = FALSE;
+
+      g_string_append_printf (line, " %s: ", fbd_feedback_profile_level_to_string (level));
+      /* Like the daemon use the feedbacks of all less noisy profiles too */
+      for (int l = level; l >= FBD_FEEDBACK_PROFILE_LEVEL_SILENT; l--) {
+        FbdFeedbackProfile *profile;
+        FbdFeedbackBase *fb;
+
+        profile = fbd_feedback_theme_get_profile (theme, fbd_feedback_profile_level_to_string (l));
+        if (profile == NULL)
+          continue;
+
+        fb = fbd_feedback_profile_get_feedback (profile, names[i]);
+        if (fb == NULL)
+          continue;
+
+        g_string_append_printf (line, "%s%s", found ? "+" : "", feedback_type_name (fb));
+        found = TRUE;
+      }
+      if (!found)
+        g_string_append (line, "-");
+    }
+    g_print ("%s\n", line->str);
+  }
+}
+
+
+static gboolean
+validate_compatible (FbdBulkRun *run, const char *compatible)
+{
+  g_autoptr (FbdThemeExpander) expander = NULL;
+  g_autoptr (FbdFeedbackTheme) theme = NULL;
+  g_autoptr (GPtrArray) chain = NULL;
+  g_autoptr (GError) err = NULL;
+  const char *compatibles[] = { compatible, NULL };
+  gboolean success = TRUE;
+  gint64 start, expand_time;
+  gsize size;
+
+  expander = fbd_theme_expander_new (compatibles, NULL, NULL);
+  start = g_get_monotonic_time ();
+  theme = fbd_theme_expander_load_theme_files (expander, &err);
+  expand_time = g_get_monotonic_time () - start;
+  if (theme == NULL) {
+    g_printerr ("%s: Validation failed: %s\n", compatible, err->message);
+    return FALSE;
+  }
+
+  size = fbd_feedback_theme_get_size (theme);
+  g_print ("%s: expanded in %.3f ms, %" G_GSIZE_FORMAT " bytes\n", compatible,
+           to_ms (expand_time), size);
+
+  chain = get_theme_chain (run, compatible);
+  if (chain) {
+    gint64 parse_time = 0;
+
+    for (guint i = 0; i < chain->len; i++) {
+      FbdThemeFile *file = g_ptr_array_index (chain, i);
+
+      g_print ("  parse %8.3f ms %s\n", to_ms (file->parse_time), file->path);
+      parse_time += file->parse_time;
+    }
+    g_print ("  merge %8.3f ms\n", to_ms (time_merge (chain)));
+
+    g_print ("  parsing took %.3f ms in total\n", to_ms (parse_time));
+
+    report_unused (chain);
+  }
+
+  if (run->max_time && expand_time > run->max_time) {
+    g_printerr ("%s: Expanding took %.3f ms, limit is %.3f ms\n", compatible,
+                to_ms (expand_time), to_ms (run->max_time));
+    success = FALSE;
+  }
+
+  if (run->max_size && size > run->max_size) {
+    g_printerr ("%s: Theme uses %" G_GSIZE_FORMAT " bytes, limit is %" G_GSIZE_FORMAT "\n",
+                compatible, size, run->max_size);
+    success = FALSE;
+  }
+
+  if (run->verbose)
+    report_resolution (theme);
+
+  return success;
+}
+
+/*
+ * Validate the per application overlays. These are applied on top of
+ * whatever theme the device uses so check them once per app.
+ */
+static gboolean
+validate_app_overlays (FbdBulkRun *run, const char *apps_dir)
+{
+  g_autoptr (GHashTable) files = NULL;
+  g_autofree const char **names = NULL;
+  gboolean success = TRUE;
+  guint n_names;
+
+  files = parse_theme_files (apps_dir, &success);
+  if (files == NULL)
+    return FALSE;
+
+  names = (const char **)g_hash_table_get_keys_as_array (files, &n_names);
+  qsort (names, n_names, sizeof (char *), compare_names);
+  for (guint i = 0; i < n_names; i++) {
+    FbdThemeFile *file = g_hash_table_lookup (files, names[i]);
+    g_autoptr (GHashTable) profiles = NULL;
+    GHashTableIter iter;
+    const char *profile_name;
+    gsize size;
+
+    if (file->theme == NULL)
+      continue;
+
+    size = fbd_feedback_theme_get_size (file->theme);
+    g_print ("%s: app overlay, %" G_GSIZE_FORMAT " bytes\n", names[i], size);
+
+    if (fbd_feedback_theme_get_parent_name (file->theme)) {
+      g_print ("  Unused: parent '%s' in %s\n", fbd_feedback_theme_get_parent_name (file->theme),
+               file->path);
+    }
+
+    profiles = get_profiles (file->theme);
+    g_hash_table_iter_init (&iter, profiles);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&profile_name, NULL)) {
+      if (fbd_feedback_profile_level (profile_name) == FBD_FEEDBACK_PROFILE_LEVEL_UNKNOWN)
+        g_print ("  Unused: profile '%s' in %s\n", profile_name, file->path);
+    }
+
+    if (run->max_size && size > run->max_size) {
+      g_printerr ("%s: App overlay uses %" G_GSIZE_FORMAT " bytes, limit is %" G_GSIZE_FORMAT "\n",
+                  names[i], size, run->max_size);
+      success = FALSE;
+    }
+  }
+
+  return success;
+}
+
+/*
+ * Validate the themes of all device compatibles in @data_dir the way the
+ * daemon would load them on such a device.
+ */
+static gboolean
+validate_data_dir (FbdBulkRun *run, const char *data_dir)
+{
+  g_autofree char *themes_dir = g_build_filename (data_dir, "feedbackd", "themes", NULL);
+  g_autofree char *apps_dir = g_build_filename (themes_dir, APP_OVERLAY_DIR, NULL);
+  g_autofree const char **names = NULL;
+  gboolean success = TRUE;
+  guint n_names;
+
+  run->files = parse_theme_files (themes_dir, &success);
+  if (run->files == NULL)
+    return FALSE;
+
+  names = (const char **)g_hash_table_get_keys_as_array (run->files, &n_names);
+  qsort (names, n_names, sizeof (char *), compare_names);
+  for (guint i = 0; i < n_names; i++) {
+    FbdThemeFile *file = g_hash_table_lookup (run->files, names[i]);
+
+    if (file->theme == NULL)
+      continue;
+
+    if (!validate_compatible (run, names[i]))
+      success = FALSE;
+  }
+
+  g_clear_pointer (&run->files, g_hash_table_destroy);
+
+  if (g_file_test (apps_dir, G_FILE_TEST_IS_DIR) && !validate_app_overlays (run, apps_dir))
+    success = FALSE;
+
+  return success;
+}
+
+
 int main(int argc, char *argv[])
 {
   g_autoptr (GError) err = NULL;
@@ -40,6 +470,10 @@ int main(int argc, char *argv[])
   gboolean version = FALSE;
   GStrv args = NULL;
   const char *compatibles[] = { NULL, NULL };
+  g_autofree char *data_dir = NULL;
+  double max_time = 0;
+  gint64 max_size = 0;
+  gboolean verbose = FALSE;
   int ret = EXIT_FAILURE;
 
   const GOptionEntry options [] = {
@@ -47,11 +481,19 @@ int main(int argc, char *argv[])
      "Show version information", NULL},
     {"compatible", 0, 0, G_OPTION_ARG_STRING, &compatible,
      "The device compatible", NULL},
+    {"data-dir", 0, 0, G_OPTION_ARG_FILENAME, &data_dir,
+     "Validate the themes of all device compatibles in DIR", "DIR"},
+    {"max-time", 0, 0, G_OPTION_ARG_DOUBLE, &max_time,
+     "Fail if expanding a theme takes longer than MS milliseconds", "MS"},
+    {"max-size", 0, 0, G_OPTION_ARG_INT64, &max_size,
+     "Fail if an expanded theme uses more than BYTES bytes", "BYTES"},
+    {"verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose,
+     "Show the feedbacks of each event and profile", NULL},
     { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &args, NULL, NULL },
     G_OPTION_ENTRY_NULL,
   };
 
-  opt_context = g_option_context_new ("THEME-FILE " BLURP);
+  opt_context = g_option_context_new ("[THEME-FILE] " BLURP);
   g_option_context_add_main_entries (opt_context, options, NULL);
   if (!g_option_context_parse (opt_context, &argc, &argv, &err)) {
     g_warning ("%s", err->message);
@@ -63,6 +505,41 @@ int main(int argc, char *argv[])
     print_version ();
   }
 
+  if (data_dir) {
+    FbdBulkRun run = { 0 };
+    g_autofree char *tmp_dir = NULL;
+    g_autofree char *cache_dir = NULL;
+    g_autofree char *config_dir = NULL;
+
+    /* Only look at the given data dir and don't use or update any cache */
+    tmp_dir = g_dir_make_tmp ("fbd-theme-validate-XXXXXX", &err);
+    if (tmp_dir == NULL) {
+      g_printerr ("error: %s\n", err->message);
+      return 1;
+    }
+    cache_dir = g_build_filename (tmp_dir, "cache", NULL);
+    config_dir = g_build_filename (tmp_dir, "config", NULL);
+    g_setenv ("XDG_DATA_DIRS", data_dir, TRUE);
+    g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+    g_setenv ("XDG_CONFIG_HOME", config_dir, TRUE);
+
+    if (verbose) {
+      g_log_set_handler ("fbd-theme-expander", G_LOG_LEVEL_INFO | G_LOG_FLAG_RECURSION,
+                         log_handler, NULL);
+    }
+
+    run.max_time = max_time * 1000;
+    run.max_size = max_size;
+    run.verbose = verbose;
+    if (validate_data_dir (&run, data_dir)) {
+      g_print ("Validation successful.\n");
+      ret = EXIT_SUCCESS;
+    }
+
+    remove_tree (tmp_dir);
+    return ret;
+  }
+
   g_log_set_handler ("fbd-theme-expander", G_LOG_LEVEL_INFO | G_LOG_FLAG_RECURSION,
                      log_handler, NULL);
 
@@ -16,6 +16,7 @@
 
 
 static GMainLoop *loop;
+static LfbGdbusFeedbackDebug *debug;
 
 static gboolean
 quit_cb (gpointer user_data)
@@ -43,12 +44,120 @@ reload_cb (gpointer user_data)
   return TRUE;
 }
 
+static void
+dump_themes (FbdFeedbackManager *manager)
+{
+  g_autoptr (GVariant) sizes = NULL;
+  const char *current, *name;
+  GVariantIter iter;
+  guint64 size, total = 0;
+
+  sizes = g_variant_ref_sink (fbd_feedback_manager_get_theme_sizes (manager, &current));
+  g_variant_iter_init (&iter, sizes);
+  while (g_variant_iter_next (&iter, "{&st}", &name, &size)) {
+    g_message ("Preloaded theme '%s'%s: %" G_GUINT64_FORMAT " bytes", name,
+               g_strcmp0 (name, current) == 0 ? " (current)" : "", size);
+    total += size;
+  }
+
+  g_message ("Preloaded themes: %" G_GSIZE_FORMAT ", %" G_GUINT64_FORMAT " bytes",
+             g_variant_n_children (sizes), total);
+}
+
+static gboolean
+dump_stats_cb (gpointer user_data)
+{
+  FbdFeedbackManager *manager = fbd_feedback_manager_get_default();
+  FbdDevSound *sound;
+  FbdLatency *latency;
+  const FbdDevSoundCounters *counters;
+
+  g_return_val_if_fail (FBD_IS_FEEDBACK_MANAGER (manager), FALSE);
+
+  latency = fbd_feedback_manager_get_latency (manager);
+  if (latency) {
+    g_message ("Latencies: vibra: %u µs, sound: %u µs, leds: %u µs",
+               fbd_latency_get (latency, FBD_ARBITER_DEVICE_VIBRA),
+               fbd_latency_get (latency, FBD_ARBITER_DEVICE_SOUND),
+               fbd_latency_get (latency, FBD_ARBITER_DEVICE_LEDS));
+  }
+
+  dump_themes (manager);
+
+  sound = fbd_feedback_manager_get_dev_sound (manager);
+  if (sound == NULL)
+    return TRUE;
+
+  counters = fbd_dev_sound_get_counters (sound);
+  g_message ("Sound voices: started: %u, coalesced: %u, stolen: %u, dropped: %u, peak: %u",
+             counters->started, counters->coalesced, counters->stolen,
+             counters->dropped, counters->peak);
+
+  return TRUE;
+}
+
+static gboolean
+handle_get_latencies (LfbGdbusFeedbackDebug *object,
+                      GDBusMethodInvocation *invocation,
+                      gpointer               user_data)
+{
+  FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
+  g_autoptr (FbdLatency) latency = NULL;
+  FbdLatency *current = fbd_feedback_manager_get_latency (manager);
+
+  /* No latencies loaded yet, all devices are assumed to be equally fast */
+  latency = current ? g_object_ref (current) : g_object_new (FBD_TYPE_LATENCY, NULL);
+  lfb_gdbus_feedback_debug_complete_get_latencies (object, invocation,
+                                                   fbd_latency_to_variant (latency));
+  return TRUE;
+}
+
+static gboolean
+handle_get_sound_voices (LfbGdbusFeedbackDebug *object,
+                         GDBusMethodInvocation *invocation,
+                         gpointer               user_data)
+{
+  FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
+  FbdDevSound *sound = fbd_feedback_manager_get_dev_sound (manager);
+  const FbdDevSoundCounters *counters;
+  GVariantBuilder builder;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{su}"));
+  if (sound) {
+    counters = fbd_dev_sound_get_counters (sound);
+    g_variant_builder_add (&builder, "{su}", "started", counters->started);
+    g_variant_builder_add (&builder, "{su}", "coalesced", counters->coalesced);
+    g_variant_builder_add (&builder, "{su}", "stolen", counters->stolen);
+    g_variant_builder_add (&builder, "{su}", "dropped", counters->dropped);
+    g_variant_builder_add (&builder, "{su}", "peak", counters->peak);
+  }
+
+  lfb_gdbus_feedback_debug_complete_get_sound_voices (object, invocation,
+                                                      g_variant_builder_end (&builder));
+  return TRUE;
+}
+
+static gboolean
+handle_get_theme_sizes (LfbGdbusFeedbackDebug *object,
+                        GDBusMethodInvocation *invocation,
+                        gpointer               user_data)
+{
+  FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
+  const char *current;
+  GVariant *sizes;
+
+  sizes = fbd_feedback_manager_get_theme_sizes (manager, &current);
+  lfb_gdbus_feedback_debug_complete_get_theme_sizes (object, invocation, sizes, current ?: "");
+  return TRUE;
+}
+
 static void
 bus_acquired_cb (GDBusConnection *connection,
                  const gchar *name,
                  gpointer user_data)
 {
   FbdFeedbackManager *manager = fbd_feedback_manager_get_default ();
+  g_autoptr (GError) err = NULL;
 
   g_debug ("Bus acquired, creating manager...");
 
@@ -56,6 +165,17 @@ bus_acquired_cb (GDBusConnection *connection,
                                     connection,
                                     FB_DBUS_PATH,
                                     NULL);
+
+  debug = lfb_gdbus_feedback_debug_skeleton_new ();
+  g_signal_connect (debug, "handle-get-latencies", G_CALLBACK (handle_get_latencies), NULL);
+  g_signal_connect (debug, "handle-get-sound-voices", G_CALLBACK (handle_get_sound_voices), NULL);
+  g_signal_connect (debug, "handle-get-theme-sizes", G_CALLBACK (handle_get_theme_sizes), NULL);
+  if (!g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (debug),
+                                         connection,
+                                         FB_DBUS_PATH,
+                                         &err)) {
+    g_warning ("Failed to export debug interface: %s", err->message);
+  }
 }
 
 
@@ -107,6 +227,7 @@ int main(int argc, char *argv[])
   g_unix_signal_add (SIGTERM, quit_cb, NULL);
   g_unix_signal_add (SIGINT, quit_cb, NULL);
   g_unix_signal_add (SIGHUP, reload_cb, NULL);
+  g_unix_signal_add (SIGUSR1, dump_stats_cb, NULL);
 
   loop = g_main_loop_new (NULL, FALSE);
 
@@ -121,4 +242,5 @@ int main(int argc, char *argv[])
 
   g_main_loop_run (loop);
   g_main_loop_unref (loop);
+  g_clear_object (&debug);
 }
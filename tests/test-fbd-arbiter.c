@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#include "fbd-arbiter.h"
+#include "fbd-feedback-dummy.h"
+
+/* Long enough to not end during the test */
+#define DUMMY_DURATION_MS (60 * 1000)
+
+
+static FbdFeedbackBase *
+new_dummy (FbdArbiterDevice device)
+{
+  return g_object_new (FBD_TYPE_FEEDBACK_DUMMY,
+                       "event-name", "test-dummy-0",
+                       "duration", DUMMY_DURATION_MS,
+                       "device", device,
+                       NULL);
+}
+
+/* What FbdFeedbackBase does with the result of a claim */
+static gboolean
+claim (FbdArbiter *arbiter, guint event_id, FbdFeedbackBase *feedback, guint priority)
+{
+  if (fbd_arbiter_claim (arbiter, event_id, feedback, priority))
+    return TRUE;
+
+  fbd_feedback_suspend (feedback);
+  return FALSE;
+}
+
+
+static void
+test_fbd_arbiter_device (void)
+{
+  g_autoptr (FbdFeedbackBase) none = new_dummy (FBD_ARBITER_DEVICE_NONE);
+  g_autoptr (FbdFeedbackBase) leds = new_dummy (FBD_ARBITER_DEVICE_LEDS);
+  g_autoptr (FbdArbiter) arbiter = fbd_arbiter_new ();
+
+  g_assert_cmpint (fbd_arbiter_get_device (none), ==, FBD_ARBITER_DEVICE_NONE);
+  g_assert_cmpint (fbd_arbiter_get_device (leds), ==, FBD_ARBITER_DEVICE_LEDS);
+
+  /* Neither is arbitrated */
+  g_assert_true (claim (arbiter, 1, none, 0));
+  g_assert_true (claim (arbiter, 2, leds, 0));
+  g_assert_cmpuint (fbd_arbiter_get_n_claims (arbiter, FBD_ARBITER_DEVICE_LEDS), ==, 0);
+}
+
+
+static void
+test_fbd_arbiter_preempt (void)
+{
+  g_autoptr (FbdFeedbackBase) low = new_dummy (FBD_ARBITER_DEVICE_VIBRA);
+  g_autoptr (FbdFeedbackBase) high = new_dummy (FBD_ARBITER_DEVICE_VIBRA);
+  g_autoptr (FbdFeedbackBase) sound = new_dummy (FBD_ARBITER_DEVICE_SOUND);
+  g_autoptr (FbdArbiter) arbiter = fbd_arbiter_new ();
+
+  g_assert_true (claim (arbiter, 1, low, 10));
+  g_assert_true (claim (arbiter, 2, high, 20));
+  g_assert_true (fbd_feedback_get_suspended (low));
+  g_assert_false (fbd_feedback_get_suspended (high));
+  g_assert_cmpuint (fbd_arbiter_get_n_claims (arbiter, FBD_ARBITER_DEVICE_VIBRA), ==, 2);
+
+  /* Other devices aren't affected */
+  g_assert_true (claim (arbiter, 3, sound, 0));
+  g_assert_false (fbd_feedback_get_suspended (sound));
+  g_assert_false (fbd_feedback_get_suspended (high));
+  g_assert_cmpuint (fbd_arbiter_get_n_claims (arbiter, FBD_ARBITER_DEVICE_SOUND), ==, 1);
+
+  fbd_arbiter_release (arbiter, 2, high);
+  fbd_arbiter_release (arbiter, 1, low);
+  fbd_arbiter_release (arbiter, 3, sound);
+  g_assert_cmpuint (fbd_arbiter_get_n_claims (arbiter, FBD_ARBITER_DEVICE_VIBRA), ==, 0);
+  g_assert_cmpuint (fbd_arbiter_get_n_claims (arbiter, FBD_ARBITER_DEVICE_SOUND), ==, 0);
+}
+
+
+static void
+test_fbd_arbiter_share (void)
+{
+  g_autoptr (FbdFeedbackBase) first = new_dummy (FBD_ARBITER_DEVICE_SOUND);
+  g_autoptr (FbdFeedbackBase) second = new_dummy (FBD_ARBITER_DEVICE_SOUND);
+  g_autoptr (FbdArbiter) arbiter = fbd_arbiter_new ();
+
+  g_assert_true (claim (arbiter, 1, first, 10));
+  g_assert_true (claim (arbiter, 2, second, 10));
+  g_assert_false (fbd_feedback_get_suspended (first));
+  g_assert_false (fbd_feedback_get_suspended (second));
+
+  /* The same feedback in another event is another claim */
+  g_assert_true (claim (arbiter, 3, first, 10));
+  g_assert_cmpuint (fbd_arbiter_get_n_claims (arbiter, FBD_ARBITER_DEVICE_SOUND), ==, 3);
+
+  /* Claiming again just updates the claim */
+  g_assert_true (claim (arbiter, 3, first, 10));
+  g_assert_cmpuint (fbd_arbiter_get_n_claims (arbiter, FBD_ARBITER_DEVICE_SOUND), ==, 3);
+
+  fbd_arbiter_release (arbiter, 1, first);
+  fbd_arbiter_release (arbiter, 2, second);
+  fbd_arbiter_release (arbiter, 3, first);
+  g_assert_cmpuint (fbd_arbiter_get_n_claims (arbiter, FBD_ARBITER_DEVICE_SOUND), ==, 0);
+}
+
+
+static void
+test_fbd_arbiter_defer (void)
+{
+  g_autoptr (FbdFeedbackBase) high = new_dummy (FBD_ARBITER_DEVICE_VIBRA);
+  g_autoptr (FbdFeedbackBase) low = new_dummy (FBD_ARBITER_DEVICE_VIBRA);
+  g_autoptr (FbdArbiter) arbiter = fbd_arbiter_new ();
+
+  g_assert_true (claim (arbiter, 1, high, 20));
+  g_assert_false (claim (arbiter, 2, low, 10));
+  g_assert_true (fbd_feedback_get_suspended (low));
+  g_assert_false (fbd_feedback_get_suspended (high));
+  g_assert_cmpuint (fbd_arbiter_get_n_claims (arbiter, FBD_ARBITER_DEVICE_VIBRA), ==, 2);
+
+  /* Dropping a pending claim doesn't affect the active one */
+  fbd_arbiter_release (arbiter, 2, low);
+  g_assert_false (fbd_feedback_get_suspended (high));
+  g_assert_cmpuint (fbd_arbiter_get_n_claims (arbiter, FBD_ARBITER_DEVICE_VIBRA), ==, 1);
+
+  fbd_arbiter_release (arbiter, 1, high);
+  g_assert_cmpuint (fbd_arbiter_get_n_claims (arbiter, FBD_ARBITER_DEVICE_VIBRA), ==, 0);
+}
+
+
+static void
+test_fbd_arbiter_resume (void)
+{
+  g_autoptr (FbdFeedbackBase) low1 = new_dummy (FBD_ARBITER_DEVICE_VIBRA);
+  g_autoptr (FbdFeedbackBase) low2 = new_dummy (FBD_ARBITER_DEVICE_VIBRA);
+  g_autoptr (FbdFeedbackBase) mid = new_dummy (FBD_ARBITER_DEVICE_VIBRA);
+  g_autoptr (FbdFeedbackBase) high = new_dummy (FBD_ARBITER_DEVICE_VIBRA);
+  g_autoptr (FbdArbiter) arbiter = fbd_arbiter_new ();
+
+  g_assert_true (claim (arbiter, 1, low1, 10));
+  g_assert_true (claim (arbiter, 2, low2, 10));
+  g_assert_true (claim (arbiter, 3, high, 30));
+  g_assert_false (claim (arbiter, 4, mid, 20));
+  g_assert_true (fbd_feedback_get_suspended (low1));
+  g_assert_true (fbd_feedback_get_suspended (low2));
+  g_assert_true (fbd_feedback_get_suspended (mid));
+
+  /* Only the highest pending claim resumes */
+  fbd_arbiter_release (arbiter, 3, high);
+  g_assert_false (fbd_feedback_get_suspended (mid));
+  g_assert_true (fbd_feedback_get_suspended (low1));
+  g_assert_true (fbd_feedback_get_suspended (low2));
+
+  /* Claims of equal priority resume together */
+  fbd_arbiter_release (arbiter, 4, mid);
+  g_assert_false (fbd_feedback_get_suspended (low1));
+  g_assert_false (fbd_feedback_get_suspended (low2));
+
+  fbd_arbiter_release (arbiter, 1, low1);
+  fbd_arbiter_release (arbiter, 2, low2);
+  g_assert_cmpuint (fbd_arbiter_get_n_claims (arbiter, FBD_ARBITER_DEVICE_VIBRA), ==, 0);
+}
+
+
+gint
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/feedbackd/fbd/arbiter/device", test_fbd_arbiter_device);
+  g_test_add_func ("/feedbackd/fbd/arbiter/preempt", test_fbd_arbiter_preempt);
+  g_test_add_func ("/feedbackd/fbd/arbiter/share", test_fbd_arbiter_share);
+  g_test_add_func ("/feedbackd/fbd/arbiter/defer", test_fbd_arbiter_defer);
+  g_test_add_func ("/feedbackd/fbd/arbiter/resume", test_fbd_arbiter_resume);
+
+  return g_test_run ();
+}
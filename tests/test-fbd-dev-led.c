@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2023 Purism SPC
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#include "fbd-dev-led-priv.h"
+#include "fbd-feedback-led.h"
+
+/* An LED that records the sysfs writes */
+#define TEST_TYPE_DEV_LED (test_dev_led_get_type ())
+G_DECLARE_FINAL_TYPE (TestDevLed, test_dev_led, TEST, DEV_LED, FbdDevLed)
+
+struct _TestDevLed {
+  FbdDevLed   parent;
+
+  GHashTable *attrs;
+  guint       n_writes;
+};
+G_DEFINE_TYPE (TestDevLed, test_dev_led, FBD_TYPE_DEV_LED)
+
+
+static gboolean
+test_dev_led_probe (FbdDevLed *led, GError **error)
+{
+  fbd_dev_led_set_max_brightness (led, 255);
+  fbd_dev_led_set_color (led, FBD_FEEDBACK_LED_COLOR_WHITE);
+
+  return TRUE;
+}
+
+
+static gboolean
+test_dev_led_write_attr (FbdDevLed *led, const char *attr, const char *value, GError **error)
+{
+  TestDevLed *self = TEST_DEV_LED (led);
+
+  g_hash_table_insert (self->attrs, g_strdup (attr), g_strdup (value));
+  self->n_writes++;
+
+  return TRUE;
+}
+
+
+static void
+test_dev_led_finalize (GObject *object)
+{
+  TestDevLed *self = TEST_DEV_LED (object);
+
+  g_hash_table_destroy (self->attrs);
+
+  G_OBJECT_CLASS (test_dev_led_parent_class)->finalize (object);
+}
+
+
+static void
+test_dev_led_class_init (TestDevLedClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  FbdDevLedClass *fbd_dev_led_class = FBD_DEV_LED_CLASS (klass);
+
+  object_class->finalize = test_dev_led_finalize;
+
+  fbd_dev_led_class->probe = test_dev_led_probe;
+  fbd_dev_led_class->write_attr = test_dev_led_write_attr;
+}
+
+
+static void
+test_dev_led_init (TestDevLed *self)
+{
+  self->attrs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+
+static TestDevLed *
+test_dev_led_new (void)
+{
+  g_autoptr (GError) err = NULL;
+  TestDevLed *led;
+
+  led = g_initable_new (TEST_TYPE_DEV_LED, NULL, &err, NULL);
+  g_assert_no_error (err);
+
+  return led;
+}
+
+
+static FbdFeedbackLed *
+new_blink (guint frequency)
+{
+  FbdFeedbackLed *feedback = g_object_new (FBD_TYPE_FEEDBACK_LED,
+                                           "event-name", "test-led",
+                                           "frequency", frequency,
+                                           NULL);
+
+  /* Never run so disposing it doesn't need to stop it via the manager */
+  fbd_feedback_base_done (FBD_FEEDBACK_BASE (feedback));
+
+  return feedback;
+}
+
+
+static void
+test_fbd_dev_led_pattern_single (void)
+{
+  g_autoptr (FbdFeedbackLed) feedback = new_blink (1000);
+  g_autoptr (TestDevLed) led = test_dev_led_new ();
+  g_autoptr (GList) feedbacks = g_list_append (NULL, feedback);
+  g_autofree char *pattern = NULL;
+
+  /* A single feedback is just its pattern */
+  pattern = fbd_dev_led_build_pattern (FBD_DEV_LED (led), feedbacks);
+  g_assert_cmpstr (pattern, ==, "0 500 255 500\n");
+
+  g_assert_true (fbd_dev_led_start_periodic (FBD_DEV_LED (led), feedback));
+  g_assert_cmpstr (g_hash_table_lookup (led->attrs, "pattern"), ==, "0 500 255 500\n");
+}
+
+
+static void
+test_fbd_dev_led_pattern_two (void)
+{
+  g_autoptr (FbdFeedbackLed) slow = new_blink (1000);
+  g_autoptr (FbdFeedbackLed) fast = new_blink (2000);
+  g_autoptr (TestDevLed) led = test_dev_led_new ();
+
+  g_assert_true (fbd_dev_led_start_periodic (FBD_DEV_LED (led), slow));
+  g_assert_true (fbd_dev_led_start_periodic (FBD_DEV_LED (led), fast));
+  /* Each feedback's pattern runs once per cycle in start order */
+  g_assert_cmpstr (g_hash_table_lookup (led->attrs, "pattern"), ==,
+                   "0 500 255 500 0 250 255 250\n");
+}
+
+
+static void
+test_fbd_dev_led_pattern_remove (void)
+{
+  g_autoptr (FbdFeedbackLed) slow = new_blink (1000);
+  g_autoptr (FbdFeedbackLed) fast = new_blink (2000);
+  g_autoptr (TestDevLed) led = test_dev_led_new ();
+
+  g_assert_true (fbd_dev_led_start_periodic (FBD_DEV_LED (led), slow));
+  g_assert_true (fbd_dev_led_start_periodic (FBD_DEV_LED (led), fast));
+
+  g_assert_true (fbd_dev_led_stop (FBD_DEV_LED (led), slow));
+  g_assert_cmpstr (g_hash_table_lookup (led->attrs, "pattern"), ==, "0 250 255 250\n");
+
+  /* The last one turns the LED off */
+  g_assert_true (fbd_dev_led_stop (FBD_DEV_LED (led), fast));
+  g_assert_cmpstr (g_hash_table_lookup (led->attrs, "brightness"), ==, "0");
+  g_assert_null (fbd_dev_led_get_attr (FBD_DEV_LED (led), "pattern"));
+
+  /* Stopping a feedback that isn't shown does nothing */
+  g_assert_true (fbd_dev_led_stop (FBD_DEV_LED (led), fast));
+}
+
+
+static void
+test_fbd_dev_led_pattern_cached (void)
+{
+  g_autoptr (FbdFeedbackLed) feedback = new_blink (1000);
+  g_autoptr (TestDevLed) led = test_dev_led_new ();
+  g_autoptr (GError) err = NULL;
+  guint n_writes;
+
+  g_assert_true (fbd_dev_led_start_periodic (FBD_DEV_LED (led), feedback));
+  n_writes = led->n_writes;
+  g_assert_cmpuint (n_writes, >, 0);
+
+  /* Unchanged attributes aren't written again */
+  g_assert_true (fbd_dev_led_start_periodic (FBD_DEV_LED (led), feedback));
+  g_assert_cmpuint (led->n_writes, ==, n_writes);
+  g_assert_true (fbd_dev_led_write_attr (FBD_DEV_LED (led), "pattern", "0 500 255 500\n", &err));
+  g_assert_no_error (err);
+  g_assert_cmpuint (led->n_writes, ==, n_writes);
+
+  /* Turning the LED off forgets them */
+  g_assert_true (fbd_dev_led_stop (FBD_DEV_LED (led), feedback));
+  n_writes = led->n_writes;
+  g_assert_true (fbd_dev_led_start_periodic (FBD_DEV_LED (led), feedback));
+  g_assert_cmpuint (led->n_writes, >, n_writes);
+}
+
+
+gint
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/feedbackd/fbd/dev-led/pattern/single", test_fbd_dev_led_pattern_single);
+  g_test_add_func ("/feedbackd/fbd/dev-led/pattern/two", test_fbd_dev_led_pattern_two);
+  g_test_add_func ("/feedbackd/fbd/dev-led/pattern/remove", test_fbd_dev_led_pattern_remove);
+  g_test_add_func ("/feedbackd/fbd/dev-led/pattern/cached", test_fbd_dev_led_pattern_cached);
+
+  return g_test_run ();
+}
@@ -17,6 +17,7 @@ test_fbd_event (void)
   g_autofree gchar *name = NULL;
   g_autofree gchar *sender = NULL;
   FbdEventEndReason reason;
+  FbdFeedbackProfileLevel level;
   gint timeout;
 
   event = fbd_event_new (1, TEST_APP_ID, TEST_EVENT, 2, "sender-id");
@@ -44,6 +45,11 @@ test_fbd_event (void)
 
   g_assert_cmpint (fbd_event_get_end_reason (event), ==, FBD_EVENT_END_REASON_NATURAL);
   g_assert_cmpint (reason, ==, FBD_EVENT_END_REASON_NATURAL);
+
+  g_assert_cmpint (fbd_event_get_level (event), ==, FBD_FEEDBACK_PROFILE_LEVEL_UNKNOWN);
+  fbd_event_set_level (event, FBD_FEEDBACK_PROFILE_LEVEL_QUIET);
+  g_object_get (event, "level", &level, NULL);
+  g_assert_cmpint (level, ==, FBD_FEEDBACK_PROFILE_LEVEL_QUIET);
 }
 
 static void
@@ -158,6 +164,323 @@ test_fbd_event_feedback_timeout (void)
   g_assert_true (ended);
 }
 
+static void
+on_feedbacks_ended_quit (FbdEvent *event, GMainLoop *loop)
+{
+  g_main_loop_quit (loop);
+}
+
+static gboolean
+on_deadline_missed (gpointer unused)
+{
+  g_assert_not_reached ();
+  return G_SOURCE_REMOVE;
+}
+
+static void
+test_fbd_event_feedback_timeout_ms (void)
+{
+  g_autoptr(FbdEvent) event = NULL;
+  g_autoptr(FbdFeedbackDummy) feedback1 = NULL;
+  g_autoptr(GMainLoop) loop = NULL;
+  guint missed_id;
+  gint64 start, elapsed;
+
+  event = fbd_event_new (1, TEST_APP_ID, TEST_EVENT, FBD_EVENT_TIMEOUT_LOOP, NULL);
+  fbd_event_set_timeout_ms (event, 100);
+  g_assert_cmpuint (fbd_event_get_timeout_ms (event), ==, 100);
+  /* Rounded up to full seconds */
+  g_assert_cmpint (fbd_event_get_timeout (event), ==, 1);
+  /* Clearing it goes back to the event's own timeout */
+  fbd_event_set_timeout_ms (event, 0);
+  g_assert_cmpint (fbd_event_get_timeout (event), ==, FBD_EVENT_TIMEOUT_LOOP);
+  fbd_event_set_timeout_ms (event, 100);
+
+  /* Feedback runs way longer than the deadline */
+  feedback1 = g_object_new (FBD_TYPE_FEEDBACK_DUMMY, "duration", 5000, NULL);
+  fbd_event_add_feedback (event, FBD_FEEDBACK_BASE(feedback1));
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_signal_connect (event, "feedbacks-ended",
+                    (GCallback)on_feedbacks_ended_quit, loop);
+  missed_id = g_timeout_add (2000, on_deadline_missed, NULL);
+
+  start = g_get_monotonic_time ();
+  fbd_event_run_feedbacks (event);
+  /* Feedbacks know when they'll be ended */
+  g_assert_cmpint (fbd_feedback_get_deadline (FBD_FEEDBACK_BASE (feedback1)), >=, start + 100 * 1000);
+  g_assert_true (fbd_feedback_get_looping (FBD_FEEDBACK_BASE (feedback1)));
+  g_main_loop_run (loop);
+  elapsed = g_get_monotonic_time () - start;
+  g_source_remove (missed_id);
+
+  g_assert_true (fbd_event_get_feedbacks_ended (event));
+  g_assert_cmpint (fbd_event_get_end_reason (event), ==, FBD_EVENT_END_REASON_EXPIRED);
+  g_assert_cmpint (elapsed, >=, 100 * 1000);
+  g_assert_cmpint (elapsed, <, 1000 * 1000);
+}
+
+static void
+on_feedback_ended_count (FbdFeedbackBase *feedback, guint *count)
+{
+  (*count)++;
+}
+
+static void
+on_feedback_ended_start (FbdFeedbackBase *feedback, GArray *starts)
+{
+  gint64 start = fbd_feedback_get_start_time (feedback);
+
+  g_array_append_val (starts, start);
+}
+
+/*
+ * Check that iterations start in consecutive slots of the loop grid.
+ * Slots can be skipped when the main loop is slow, so only the lower
+ * bound is exact.
+ */
+static void
+assert_on_grid (GArray *starts, gint64 loop_start, gint64 period)
+{
+  for (guint i = 0; i < starts->len; i++) {
+    gint64 offset = g_array_index (starts, gint64, i) - loop_start;
+
+    g_assert_cmpint (offset, >=, i * period);
+    /* Iterations start early in their slot */
+    g_assert_cmpint (offset % period, <, period / 2);
+  }
+}
+
+static void
+test_fbd_event_feedback_loop_phase (void)
+{
+  g_autoptr(FbdEvent) event = NULL;
+  g_autoptr(FbdFeedbackDummy) feedback1 = NULL;
+  g_autoptr(FbdFeedbackDummy) feedback2 = NULL;
+  g_autoptr(GMainLoop) loop = NULL;
+  g_autoptr(GArray) starts1 = g_array_new (FALSE, FALSE, sizeof (gint64));
+  g_autoptr(GArray) starts2 = g_array_new (FALSE, FALSE, sizeof (gint64));
+  gint64 start, loop_start, period;
+
+  event = fbd_event_new (1, TEST_APP_ID, TEST_EVENT, FBD_EVENT_TIMEOUT_LOOP, NULL);
+  fbd_event_set_timeout_ms (event, 500);
+
+  feedback1 = g_object_new (FBD_TYPE_FEEDBACK_DUMMY, "duration", 10, NULL);
+  fbd_event_add_feedback (event, FBD_FEEDBACK_BASE(feedback1));
+  feedback2 = g_object_new (FBD_TYPE_FEEDBACK_DUMMY, "duration", 50, NULL);
+  fbd_event_add_feedback (event, FBD_FEEDBACK_BASE(feedback2));
+  g_signal_connect (feedback1, "ended", (GCallback)on_feedback_ended_start, starts1);
+  g_signal_connect (feedback2, "ended", (GCallback)on_feedback_ended_start, starts2);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_signal_connect (event, "feedbacks-ended",
+                    (GCallback)on_feedbacks_ended_quit, loop);
+
+  start = g_get_monotonic_time ();
+  fbd_event_run_feedbacks (event);
+  /* Both feedbacks record when they got started */
+  period = fbd_event_get_loop_period (event, &loop_start);
+  g_assert_cmpint (period, ==, 0);
+  g_assert_cmpint (loop_start, >=, start);
+  g_assert_cmpint (fbd_feedback_get_start_time (FBD_FEEDBACK_BASE (feedback1)), >=, loop_start);
+  g_assert_cmpint (fbd_feedback_get_start_time (FBD_FEEDBACK_BASE (feedback2)), >=, loop_start);
+  g_main_loop_run (loop);
+
+  g_assert_cmpint (fbd_event_get_end_reason (event), ==, FBD_EVENT_END_REASON_EXPIRED);
+  /* The long feedback sets the period */
+  period = fbd_event_get_loop_period (event, NULL);
+  g_assert_cmpint (period, >=, 50 * 1000);
+  g_assert_cmpint (period, <, 500 * 1000);
+  g_assert_cmpuint (starts2->len, >=, 2);
+  assert_on_grid (starts2, loop_start, period);
+
+  /* The short feedback waits for the next slot rather than restarting right away */
+  g_assert_cmpuint (starts1->len, >=, 2);
+  assert_on_grid (starts1, loop_start, period);
+}
+
+static void
+test_fbd_event_feedback_loop_self (void)
+{
+  g_autoptr(FbdEvent) event = NULL;
+  g_autoptr(FbdFeedbackDummy) feedback1 = NULL;
+  g_autoptr(FbdFeedbackDummy) feedback2 = NULL;
+  g_autoptr(GMainLoop) loop = NULL;
+  g_autoptr(GArray) starts2 = g_array_new (FALSE, FALSE, sizeof (gint64));
+  guint count1 = 0, iterations1 = 0;
+  gint64 loop_start, period;
+
+  event = fbd_event_new (1, TEST_APP_ID, TEST_EVENT, FBD_EVENT_TIMEOUT_LOOP, NULL);
+  fbd_event_set_timeout_ms (event, 500);
+
+  /* Keeps running like a looping sound */
+  feedback1 = g_object_new (FBD_TYPE_FEEDBACK_DUMMY, "duration", 200, "loops-itself", TRUE, NULL);
+  fbd_event_add_feedback (event, FBD_FEEDBACK_BASE(feedback1));
+  feedback2 = g_object_new (FBD_TYPE_FEEDBACK_DUMMY, "duration", 20, NULL);
+  fbd_event_add_feedback (event, FBD_FEEDBACK_BASE(feedback2));
+  g_signal_connect (feedback1, "ended", (GCallback)on_feedback_ended_count, &count1);
+  g_signal_connect (feedback1, "iteration-ended", (GCallback)on_feedback_ended_count, &iterations1);
+  g_signal_connect (feedback2, "ended", (GCallback)on_feedback_ended_start, starts2);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_signal_connect (event, "feedbacks-ended",
+                    (GCallback)on_feedbacks_ended_quit, loop);
+
+  fbd_event_run_feedbacks (event);
+  g_assert_true (fbd_feedback_get_loops_itself (FBD_FEEDBACK_BASE (feedback1)));
+  g_assert_false (fbd_feedback_get_loops_itself (FBD_FEEDBACK_BASE (feedback2)));
+  g_main_loop_run (loop);
+
+  g_assert_cmpint (fbd_event_get_end_reason (event), ==, FBD_EVENT_END_REASON_EXPIRED);
+  /* The self looping feedback only ends with the event */
+  g_assert_cmpuint (count1, ==, 1);
+  g_assert_cmpuint (iterations1, >=, 1);
+  /* and doesn't set the period of the other one */
+  period = fbd_event_get_loop_period (event, &loop_start);
+  g_assert_cmpint (period, >=, 20 * 1000);
+  g_assert_cmpint (period, <, 200 * 1000);
+  g_assert_cmpuint (starts2->len, >=, 2);
+  assert_on_grid (starts2, loop_start, period);
+}
+
+static void
+test_fbd_event_feedback_delayed (void)
+{
+  g_autoptr(FbdEvent) event = NULL;
+  g_autoptr(FbdFeedbackDummy) feedback1 = NULL;
+  g_autoptr(FbdFeedbackDummy) feedback2 = NULL;
+  g_autoptr(GMainLoop) loop = NULL;
+  guint count1 = 0;
+  gint64 start, elapsed;
+
+  event = fbd_event_new (1, TEST_APP_ID, TEST_EVENT, FBD_EVENT_TIMEOUT_ONESHOT, NULL);
+
+  /* Gets held back for 50ms to line up with the slower one */
+  feedback1 = g_object_new (FBD_TYPE_FEEDBACK_DUMMY, "duration", 10, NULL);
+  fbd_event_add_feedback (event, FBD_FEEDBACK_BASE(feedback1));
+  feedback2 = g_object_new (FBD_TYPE_FEEDBACK_DUMMY, "duration", 10, "latency", 50, NULL);
+  fbd_event_add_feedback (event, FBD_FEEDBACK_BASE(feedback2));
+
+  /* Feedbacks are shared between events so this one ended before */
+  fbd_feedback_run (FBD_FEEDBACK_BASE (feedback1));
+  fbd_feedback_end (FBD_FEEDBACK_BASE (feedback1));
+  g_assert_true (fbd_feedback_get_ended (FBD_FEEDBACK_BASE (feedback1)));
+  g_signal_connect (feedback1, "ended", (GCallback)on_feedback_ended_count, &count1);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_signal_connect (event, "feedbacks-ended",
+                    (GCallback)on_feedbacks_ended_quit, loop);
+
+  start = g_get_monotonic_time ();
+  fbd_event_run_feedbacks (event);
+  g_assert_false (fbd_event_get_feedbacks_ended (event));
+  g_main_loop_run (loop);
+  elapsed = g_get_monotonic_time () - start;
+
+  /* The event waited for the held back feedback to run */
+  g_assert_cmpuint (count1, ==, 1);
+  g_assert_cmpint (fbd_event_get_end_reason (event), ==, FBD_EVENT_END_REASON_NATURAL);
+  g_assert_cmpint (elapsed, >=, 60 * 1000);
+}
+
+static void
+test_fbd_event_feedback_migrate (void)
+{
+  g_autoptr(FbdEvent) event = NULL;
+  g_autoptr(FbdFeedbackDummy) feedback1 = NULL;
+  g_autoptr(FbdFeedbackDummy) feedback2 = NULL;
+  g_autoptr(FbdFeedbackDummy) copy = NULL;
+  g_autoptr(GMainLoop) loop = NULL;
+  GSList *feedbacks;
+  guint count1 = 0, count2 = 0;
+
+  event = fbd_event_new (1, TEST_APP_ID, TEST_EVENT, FBD_EVENT_TIMEOUT_LOOP, NULL);
+  fbd_event_set_timeout_ms (event, 300);
+  g_assert_cmpuint (fbd_event_get_generation (event), ==, 0);
+
+  feedback1 = g_object_new (FBD_TYPE_FEEDBACK_DUMMY, "duration", 20, NULL);
+  fbd_event_add_feedback (event, FBD_FEEDBACK_BASE(feedback1));
+  copy = g_object_new (FBD_TYPE_FEEDBACK_DUMMY, "duration", 20, NULL);
+  feedback2 = g_object_new (FBD_TYPE_FEEDBACK_DUMMY, "duration", 30, NULL);
+  g_assert_true (fbd_feedback_equal (FBD_FEEDBACK_BASE (feedback1), FBD_FEEDBACK_BASE (copy)));
+  g_assert_false (fbd_feedback_equal (FBD_FEEDBACK_BASE (feedback1), FBD_FEEDBACK_BASE (feedback2)));
+  g_signal_connect (feedback1, "ended", (GCallback)on_feedback_ended_count, &count1);
+  g_signal_connect (feedback2, "ended", (GCallback)on_feedback_ended_count, &count2);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_signal_connect (event, "feedbacks-ended",
+                    (GCallback)on_feedbacks_ended_quit, loop);
+
+  fbd_event_run_feedbacks (event);
+
+  /* Equal feedbacks in the new generation as after a full reload, nothing to swap */
+  feedbacks = g_slist_append (NULL, copy);
+  fbd_event_migrate (event, feedbacks, 1);
+  g_slist_free (feedbacks);
+  g_assert_cmpuint (fbd_event_get_generation (event), ==, 1);
+  feedbacks = fbd_event_get_feedbacks (event);
+  g_assert_true (feedbacks->data == feedback1);
+
+  /* The running iteration finishes before the new feedback starts */
+  feedbacks = g_slist_append (NULL, feedback2);
+  fbd_event_migrate (event, feedbacks, 2);
+  g_slist_free (feedbacks);
+  g_assert_cmpuint (fbd_event_get_generation (event), ==, 1);
+  g_assert_false (fbd_feedback_get_ended (FBD_FEEDBACK_BASE (feedback1)));
+
+  g_main_loop_run (loop);
+
+  g_assert_cmpint (fbd_event_get_end_reason (event), ==, FBD_EVENT_END_REASON_EXPIRED);
+  g_assert_cmpuint (fbd_event_get_generation (event), ==, 2);
+  g_assert_cmpuint (count1, ==, 1);
+  g_assert_cmpuint (count2, >, 1);
+  feedbacks = fbd_event_get_feedbacks (event);
+  g_assert_cmpint (g_slist_length (feedbacks), ==, 1);
+  g_assert_true (feedbacks->data == feedback2);
+}
+
+static void
+test_fbd_event_feedback_migrate_loop_self (void)
+{
+  g_autoptr(FbdEvent) event = NULL;
+  g_autoptr(FbdFeedbackDummy) feedback1 = NULL;
+  g_autoptr(FbdFeedbackDummy) feedback2 = NULL;
+  g_autoptr(GMainLoop) loop = NULL;
+  GSList *feedbacks;
+  guint count1 = 0, count2 = 0;
+
+  event = fbd_event_new (1, TEST_APP_ID, TEST_EVENT, FBD_EVENT_TIMEOUT_LOOP, NULL);
+  fbd_event_set_timeout_ms (event, 400);
+
+  /* Like an event with just a looping sound, e.g. a ringtone */
+  feedback1 = g_object_new (FBD_TYPE_FEEDBACK_DUMMY, "duration", 100, "loops-itself", TRUE, NULL);
+  fbd_event_add_feedback (event, FBD_FEEDBACK_BASE(feedback1));
+  feedback2 = g_object_new (FBD_TYPE_FEEDBACK_DUMMY, "duration", 20, NULL);
+  g_signal_connect (feedback1, "ended", (GCallback)on_feedback_ended_count, &count1);
+  g_signal_connect (feedback2, "ended", (GCallback)on_feedback_ended_count, &count2);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_signal_connect (event, "feedbacks-ended",
+                    (GCallback)on_feedbacks_ended_quit, loop);
+
+  fbd_event_run_feedbacks (event);
+
+  feedbacks = g_slist_append (NULL, feedback2);
+  fbd_event_migrate (event, feedbacks, 1);
+  g_slist_free (feedbacks);
+  g_assert_cmpuint (fbd_event_get_generation (event), ==, 0);
+
+  g_main_loop_run (loop);
+
+  /* The old feedback got stopped at the end of its first iteration */
+  g_assert_cmpuint (fbd_event_get_generation (event), ==, 1);
+  g_assert_cmpuint (count1, ==, 1);
+  g_assert_cmpuint (count2, >, 1);
+  feedbacks = fbd_event_get_feedbacks (event);
+  g_assert_cmpint (g_slist_length (feedbacks), ==, 1);
+  g_assert_true (feedbacks->data == feedback2);
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -168,6 +491,13 @@ main (gint argc, gchar *argv[])
   g_test_add_func("/feedbackd/fbd/event/feedbacks/ended", test_fbd_event_feedback_ended);
   g_test_add_func("/feedbackd/fbd/event/feedbacks/loop", test_fbd_event_feedback_loop);
   g_test_add_func("/feedbackd/fbd/event/feedbacks/timeout", test_fbd_event_feedback_timeout);
+  g_test_add_func("/feedbackd/fbd/event/feedbacks/timeout-ms", test_fbd_event_feedback_timeout_ms);
+  g_test_add_func("/feedbackd/fbd/event/feedbacks/loop-phase", test_fbd_event_feedback_loop_phase);
+  g_test_add_func("/feedbackd/fbd/event/feedbacks/loop-self", test_fbd_event_feedback_loop_self);
+  g_test_add_func("/feedbackd/fbd/event/feedbacks/delayed", test_fbd_event_feedback_delayed);
+  g_test_add_func("/feedbackd/fbd/event/feedbacks/migrate", test_fbd_event_feedback_migrate);
+  g_test_add_func("/feedbackd/fbd/event/feedbacks/migrate-loop-self",
+                  test_fbd_event_feedback_migrate_loop_self);
 
   return g_test_run();
 }
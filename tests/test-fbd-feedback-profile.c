@@ -6,6 +6,7 @@
 
 #include "fbd-feedback-profile.h"
 #include "fbd-feedback-dummy.h"
+#include "fbd-feedback-led.h"
 #include "fbd-feedback-vibra.h"
 
 #include <json-glib/json-glib.h>
@@ -82,6 +83,86 @@ test_fbd_feedback_profile_parse (void)
 }
 
 
+static void
+test_fbd_feedback_profile_parse_led_rgb (void)
+{
+  const char *json ="                             "
+        "    {                                    "
+        "      \"name\" : \"full\",               "
+        "      \"feedbacks\" : [                  "
+        "        {                                "
+        "          \"type\" : \"led\",            "
+        "          \"event-name\" : \"event1\",   "
+        "          \"rgb\" : \"#ff8000\",         "
+        "          \"max-brightness\" : 50      "
+        "        }                                "
+        "      ]                                  "
+        "    }                                    ";
+  g_autoptr (GError) err = NULL;
+  g_autoptr (FbdFeedbackProfile) profile = NULL;
+  g_autoptr (JsonNode) node = NULL;
+  FbdFeedbackBase *fb;
+  const gdouble *intensity;
+
+  node = json_from_string(json, &err);
+  g_assert_no_error (err);
+  profile = FBD_FEEDBACK_PROFILE (json_gobject_deserialize (FBD_TYPE_FEEDBACK_PROFILE, node));
+  g_assert_nonnull (profile);
+  fb = fbd_feedback_profile_get_feedback (profile, "event1");
+  g_assert_true (FBD_IS_FEEDBACK_LED (fb));
+
+  g_assert_cmpint (fbd_feedback_led_get_color (FBD_FEEDBACK_LED (fb)), ==,
+                   FBD_FEEDBACK_LED_COLOR_RGB);
+  intensity = fbd_feedback_led_get_intensity (FBD_FEEDBACK_LED (fb));
+  g_assert_cmpfloat_with_epsilon (intensity[0], 1.0, 0.001);
+  g_assert_cmpfloat (intensity[1], >, 0.0);
+  g_assert_cmpfloat (intensity[1], <, 0.5);
+  g_assert_cmpfloat (intensity[2], ==, 0.0);
+  g_assert_cmphex (fbd_feedback_led_get_argb (FBD_FEEDBACK_LED (fb)), ==, 0xff801c00);
+}
+
+
+static void
+test_fbd_feedback_profile_parse_led_shape (void)
+{
+  const char *json ="                             "
+        "    {                                    "
+        "      \"name\" : \"full\",               "
+        "      \"feedbacks\" : [                  "
+        "        {                                "
+        "          \"type\" : \"led\",            "
+        "          \"event-name\" : \"event1\",   "
+        "          \"frequency\" : 1000,          "
+        "          \"shape\" : \"breathe\",       "
+        "          \"steps\" : 4                  "
+        "        }                                "
+        "      ]                                  "
+        "    }                                    ";
+  g_autoptr (GError) err = NULL;
+  g_autoptr (FbdFeedbackProfile) profile = NULL;
+  g_autoptr (JsonNode) node = NULL;
+  const FbdFeedbackLedStep *steps;
+  FbdFeedbackBase *fb;
+  guint n_steps;
+
+  node = json_from_string(json, &err);
+  g_assert_no_error (err);
+  profile = FBD_FEEDBACK_PROFILE (json_gobject_deserialize (FBD_TYPE_FEEDBACK_PROFILE, node));
+  g_assert_nonnull (profile);
+  fb = fbd_feedback_profile_get_feedback (profile, "event1");
+  g_assert_true (FBD_IS_FEEDBACK_LED (fb));
+
+  steps = fbd_feedback_led_get_steps (FBD_FEEDBACK_LED (fb), &n_steps);
+  g_assert_cmpuint (n_steps, ==, 4);
+  g_assert_cmpuint (fbd_feedback_led_get_period (FBD_FEEDBACK_LED (fb)), ==, 1000);
+  g_assert_cmpfloat_with_epsilon (steps[0].level, 0.0, 0.001);
+  g_assert_cmpfloat_with_epsilon (steps[1].level, 0.5, 0.001);
+  g_assert_cmpfloat_with_epsilon (steps[2].level, 1.0, 0.001);
+  g_assert_cmpfloat_with_epsilon (steps[3].level, 0.5, 0.001);
+  g_assert_cmpuint (steps[0].duration, ==, 250);
+}
+
+
 static void
 test_fbd_feedback_profile_update (void)
 {
@@ -124,6 +205,150 @@ test_fbd_feedback_profile_update (void)
 }
 
 
+static void
+test_fbd_feedback_profile_prefix (void)
+{
+  g_autoptr (FbdFeedbackProfile) profile = fbd_feedback_profile_new (PROFILE_NAME);
+  g_autoptr (FbdFeedbackDummy) fb_any = g_object_new (FBD_TYPE_FEEDBACK_DUMMY,
+                                                      "event-name", "*",
+                                                      NULL);
+  g_autoptr (FbdFeedbackDummy) fb_message = g_object_new (FBD_TYPE_FEEDBACK_DUMMY,
+                                                          "event-name", "message-*",
+                                                          NULL);
+  g_autoptr (FbdFeedbackDummy) fb_message_new = g_object_new (FBD_TYPE_FEEDBACK_DUMMY,
+                                                              "event-name", "message-new-*",
+                                                              NULL);
+  g_autoptr (FbdFeedbackDummy) fb_email = g_object_new (FBD_TYPE_FEEDBACK_DUMMY,
+                                                        "event-name", "message-new-email",
+                                                        NULL);
+  FbdFeedbackBase *fb;
+
+  fbd_feedback_profile_add_feedback (profile, FBD_FEEDBACK_BASE (fb_message_new));
+  fbd_feedback_profile_add_feedback (profile, FBD_FEEDBACK_BASE (fb_message));
+  fbd_feedback_profile_add_feedback (profile, FBD_FEEDBACK_BASE (fb_email));
+
+  /* Exact match wins */
+  fb = fbd_feedback_profile_get_feedback (profile, "message-new-email");
+  g_assert_true (fb == FBD_FEEDBACK_BASE (fb_email));
+
+  /* Longest prefix wins */
+  fb = fbd_feedback_profile_get_feedback (profile, "message-new-instant");
+  g_assert_true (fb == FBD_FEEDBACK_BASE (fb_message_new));
+  fb = fbd_feedback_profile_get_feedback (profile, "message-missed-email");
+  g_assert_true (fb == FBD_FEEDBACK_BASE (fb_message));
+  fb = fbd_feedback_profile_get_feedback (profile, "message-new");
+  g_assert_true (fb == FBD_FEEDBACK_BASE (fb_message));
+
+  fb = fbd_feedback_profile_get_feedback (profile, "phone-incoming-call");
+  g_assert_null (fb);
+
+  fbd_feedback_profile_add_feedback (profile, FBD_FEEDBACK_BASE (fb_any));
+  fb = fbd_feedback_profile_get_feedback (profile, "phone-incoming-call");
+  g_assert_true (fb == FBD_FEEDBACK_BASE (fb_any));
+  fb = fbd_feedback_profile_get_feedback (profile, "message-new-instant");
+  g_assert_true (fb == FBD_FEEDBACK_BASE (fb_message_new));
+}
+
+
+static void
+test_fbd_feedback_profile_prefix_update (void)
+{
+  g_autoptr (FbdFeedbackProfile) a = fbd_feedback_profile_new (PROFILE_NAME);
+  g_autoptr (FbdFeedbackProfile) b = fbd_feedback_profile_new (PROFILE_NAME);
+  g_autoptr (FbdFeedbackDummy) fb_a = g_object_new (FBD_TYPE_FEEDBACK_DUMMY,
+                                                    "event-name", "message-new-*",
+                                                    NULL);
+  g_autoptr (FbdFeedbackDummy) fb_b = g_object_new (FBD_TYPE_FEEDBACK_VIBRA,
+                                                    "event-name", "message-new-*",
+                                                    NULL);
+  FbdFeedbackBase *fb;
+
+  fbd_feedback_profile_add_feedback (a, FBD_FEEDBACK_BASE (fb_a));
+  fbd_feedback_profile_add_feedback (b, FBD_FEEDBACK_BASE (fb_b));
+
+  fb = fbd_feedback_profile_get_feedback (a, "message-new-email");
+  g_assert_true (FBD_IS_FEEDBACK_DUMMY (fb));
+
+  /* Overriding a prefix in a child theme replaces the parent's */
+  fbd_feedback_profile_update (a, b);
+  fb = fbd_feedback_profile_get_feedback (a, "message-new-email");
+  g_assert_true (FBD_IS_FEEDBACK_VIBRA (fb));
+}
+
+
+static guint n_created;
+
+static FbdFeedbackBase *
+new_cached_dummy (GVariant *entry, GError **error)
+{
+  const char *event_name;
+
+  g_variant_get (entry, "(&s&sa{sv})", &event_name, NULL, NULL);
+  n_created++;
+
+  return g_object_new (FBD_TYPE_FEEDBACK_DUMMY, "event-name", event_name, NULL);
+}
+
+
+static void
+count_feedback (FbdFeedbackBase *feedback, guint *count)
+{
+  (*count)++;
+}
+
+
+static void
+test_fbd_feedback_profile_cached (void)
+{
+  g_autoptr (FbdFeedbackProfile) profile = fbd_feedback_profile_new (PROFILE_NAME);
+  g_autoptr (GHashTable) seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+  g_autoptr (FbdFeedbackDummy) added = g_object_new (FBD_TYPE_FEEDBACK_DUMMY,
+                                                     "event-name", "event4",
+                                                     NULL);
+  GVariantBuilder builder;
+  FbdFeedbackBase *fb;
+  guint count = 0;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ssa{sv})"));
+  /* Sorted by event name */
+  g_variant_builder_add (&builder, "(ssa{sv})", "event1", "FbdFeedbackDummy", NULL);
+  g_variant_builder_add (&builder, "(ssa{sv})", "event2", "FbdFeedbackDummy", NULL);
+  g_variant_builder_add (&builder, "(ssa{sv})", "event3", "FbdFeedbackDummy", NULL);
+  g_type_ensure (FBD_TYPE_FEEDBACK_DUMMY);
+
+  n_created = 0;
+  fbd_feedback_profile_set_cached_feedbacks (profile, g_variant_builder_end (&builder),
+                                             new_cached_dummy);
+  g_assert_cmpuint (n_created, ==, 0);
+  g_assert_cmpuint (fbd_feedback_profile_get_size (profile, seen), >, 0);
+
+  /* Feedbacks are created on lookup, once */
+  fb = fbd_feedback_profile_get_feedback (profile, "event2");
+  g_assert_true (FBD_IS_FEEDBACK_DUMMY (fb));
+  g_assert_cmpstr (fbd_feedback_get_event_name (fb), ==, "event2");
+  g_assert_cmpuint (n_created, ==, 1);
+  g_assert_true (fbd_feedback_profile_get_feedback (profile, "event2") == fb);
+  g_assert_cmpuint (n_created, ==, 1);
+
+  g_assert_null (fbd_feedback_profile_get_feedback (profile, "event0"));
+  g_assert_null (fbd_feedback_profile_get_feedback (profile, "event4"));
+  g_assert_cmpuint (n_created, ==, 1);
+  /* Remembered misses don't hide feedbacks added later */
+  g_assert_null (fbd_feedback_profile_get_feedback (profile, "event4"));
+  fbd_feedback_profile_add_feedback (profile, FBD_FEEDBACK_BASE (added));
+  g_assert_true (fbd_feedback_profile_get_feedback (profile, "event4") == FBD_FEEDBACK_BASE (added));
+
+  /* Only feedbacks of the given type get created */
+  fbd_feedback_profile_foreach_feedback_of_type (profile, FBD_TYPE_FEEDBACK_VIBRA,
+                                                 (GFunc)count_feedback, &count);
+  g_assert_cmpuint (count, ==, 0);
+  g_assert_cmpuint (n_created, ==, 1);
+
+  fbd_feedback_profile_foreach_feedback (profile, (GFunc)count_feedback, &count);
+  g_assert_cmpuint (count, ==, 4);
+  g_assert_cmpuint (n_created, ==, 3);
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -132,7 +357,13 @@ main (gint argc, gchar *argv[])
   g_test_add_func("/feedbackd/fbd/feedback-profile/name", test_fbd_feedback_profile_name);
   g_test_add_func("/feedbackd/fbd/feedback-profile/feedbacks", test_fbd_feedback_profile_feedbacks);
   g_test_add_func("/feedbackd/fbd/feedback-profile/parse", test_fbd_feedback_profile_parse);
+  g_test_add_func("/feedbackd/fbd/feedback-profile/parse-led-rgb", test_fbd_feedback_profile_parse_led_rgb);
+  g_test_add_func("/feedbackd/fbd/feedback-profile/parse-led-shape", test_fbd_feedback_profile_parse_led_shape);
   g_test_add_func("/feedbackd/fbd/feedback-profile/update", test_fbd_feedback_profile_update);
+  g_test_add_func("/feedbackd/fbd/feedback-profile/prefix", test_fbd_feedback_profile_prefix);
+  g_test_add_func("/feedbackd/fbd/feedback-profile/prefix-update",
+                  test_fbd_feedback_profile_prefix_update);
+  g_test_add_func("/feedbackd/fbd/feedback-profile/cached", test_fbd_feedback_profile_cached);
 
   return g_test_run();
 }
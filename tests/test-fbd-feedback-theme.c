@@ -4,8 +4,10 @@
  * Author: Guido Günther <agx@sigxcpu.org>
  */
 
+#include "fbd.h"
 #include "fbd-feedback-dummy.h"
 #include "fbd-feedback-theme.h"
+#include "fbd-feedback-vibra-rumble.h"
 
 #include <json-glib/json-glib.h>
 
@@ -21,6 +23,13 @@ test_fbd_feedback_theme_name (void)
   g_assert_cmpstr (fbd_feedback_theme_get_name (theme), ==, THEME_NAME);
 }
 
+static void
+count_feedback (FbdFeedbackBase *feedback, guint *count)
+{
+  g_assert_true (FBD_IS_FEEDBACK_BASE (feedback));
+  (*count)++;
+}
+
 static void
 test_fbd_feedback_theme_profiles (void)
 {
@@ -41,6 +50,7 @@ test_fbd_feedback_theme_profiles (void)
   FbdFeedbackProfile *profile_quiet = fbd_feedback_profile_new ("quiet");
   FbdFeedbackProfile *profile;
   g_autofree char *json = NULL;
+  guint count = 0;
 
   fbd_feedback_profile_add_feedback (profile_quiet, FBD_FEEDBACK_BASE(quiet_fb1));
   fbd_feedback_profile_add_feedback (profile_quiet, FBD_FEEDBACK_BASE(quiet_fb2));
@@ -55,6 +65,9 @@ test_fbd_feedback_theme_profiles (void)
   profile = fbd_feedback_theme_get_profile (theme, "full");
   g_assert_true (FBD_IS_FEEDBACK_PROFILE (profile));
 
+  fbd_feedback_theme_foreach_feedback (theme, (GFunc)count_feedback, &count);
+  g_assert_cmpuint (count, ==, 4);
+
   json = json_gobject_to_data (G_OBJECT(theme), NULL);
   g_print ("%s\n", json);
 
@@ -190,6 +203,190 @@ test_fbd_feedback_theme_update (void)
 }
 
 
+static void
+test_fbd_feedback_theme_parse_properties (void)
+{
+  const char *json =
+    "{\n"
+    "  \"name\" : \"test\",\n"
+    "  /* A comment */\n"
+    "  \"profiles\" : [\n"
+    "    {\n"
+    "      \"feedbacks\" : [\n"
+    "        {\n"
+    "          \"type\" : \"VibraRumble\",\n"
+    "          \"event-name\" : \"ev\\u00e9nt\",\n"
+    "          \"duration\" : 0x10,\n"
+    "          \"count\" : 3,\n"
+    "          \"unknown\" : [ 1, { \"a\" : null } ]\n"
+    "        }\n"
+    "      ],\n"
+    "      \"name\" : \"full\"\n"
+    "    }\n"
+    "  ]\n"
+    "}\n";
+  g_autoptr (GError) err = NULL;
+  g_autoptr (FbdFeedbackTheme) theme = NULL;
+  FbdFeedbackProfile *profile;
+  FbdFeedbackBase *feedback;
+  guint duration, count;
+
+  theme = fbd_feedback_theme_new_from_data (json, &err);
+  g_assert_no_error (err);
+  g_assert_nonnull (theme);
+
+  profile = fbd_feedback_theme_get_profile (theme, "full");
+  g_assert_true (FBD_IS_FEEDBACK_PROFILE (profile));
+
+  feedback = fbd_feedback_profile_get_feedback (profile, "ev\u00e9nt");
+  g_assert_true (FBD_IS_FEEDBACK_VIBRA_RUMBLE (feedback));
+  g_object_get (feedback, "duration", &duration, "count", &count, NULL);
+  g_assert_cmpuint (duration, ==, 16);
+  g_assert_cmpuint (count, ==, 3);
+}
+
+
+static void
+test_fbd_feedback_theme_parse_errors (void)
+{
+  const struct {
+    const char *json;
+    const char *location;
+  } tests[] = {
+    { "{\n  \"name\" : \"test\"\n  \"profiles\" : []\n}", "<data>:3:3:" },
+    { "{ \"name\" : \"test\", }", "<data>:1:20:" },
+    { "{ \"name\" : \"te\\qst\" }", "<data>:1:15:" },
+    { "{ \"profiles\" : [ { \"feedbacks\" : [ { \"type\" : \"Dummy\" } ] } ] }", "<data>:1:36:" },
+    { "{ \"profiles\" : [ { \"name\" : \"full\", \"feedbacks\" : [\n"
+      "  { \"type\" : \"VibraRumble\", \"event-name\" : \"ev\", \"count\" : -1 } ] } ] }",
+      "<data>:2:60:" },
+    { "{ \"profiles\" : [ { \"name\" : \"full\", \"feedbacks\" : [\n"
+      "  { \"type\" : \"Dummy\", \"event-name\" : 1 } ] } ] }",
+      "<data>:2:38:" },
+    { "{ \"name\" : \"test\" } []", "<data>:1:21:" },
+    { "{ \"profiles\" : [ { \"name\" : \"full\", \"feedbacks\" : [\n"
+      "  { \"type\" : \"Dummy\", \"event-name\" : \"ev\", \"event_name\" : \"ev\" } ] } ] }",
+      "<data>:2:44:" },
+    { "{ \"profiles\" : [ { \"name\" : \"full\", \"feedbacks\" : [\n"
+      "  { \"type\" : \"Dummy\", \"type\" : \"Sound\", \"event-name\" : \"ev\" } ] } ] }",
+      "<data>:2:23:" },
+    { "{ \"profiles\" : [ { \"name\" : \"full\", \"feedbacks\" : [\n"
+      "  { \"event-name\" : \"ev\" } ] } ] }",
+      "<data>:2:3:" },
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS (tests); i++) {
+    g_autoptr (GError) err = NULL;
+    g_autoptr (FbdFeedbackTheme) theme = NULL;
+
+    theme = fbd_feedback_theme_new_from_data (tests[i].json, &err);
+    g_assert_error (err, fbd_error_quark (), FBD_ERROR_THEME_PARSE);
+    g_assert_null (theme);
+    g_test_message ("%s", err->message);
+    g_assert_true (g_str_has_prefix (err->message, tests[i].location));
+  }
+}
+
+
+static void
+test_fbd_feedback_theme_parse_depth (void)
+{
+  g_autoptr (GError) err = NULL;
+  g_autoptr (FbdFeedbackTheme) theme = NULL;
+  g_autoptr (GString) json = g_string_new ("{ \"x\" : ");
+
+  /* Unknown members can nest, but not without bound */
+  for (guint i = 0; i < 1000; i++)
+    g_string_append_c (json, '[');
+  for (guint i = 0; i < 1000; i++)
+    g_string_append_c (json, ']');
+  g_string_append (json, " }");
+
+  theme = fbd_feedback_theme_new_from_data (json->str, &err);
+  g_assert_error (err, fbd_error_quark (), FBD_ERROR_THEME_PARSE);
+  g_assert_null (theme);
+  /* The outer object and 63 arrays are fine */
+  g_assert_true (g_str_has_prefix (err->message, "<data>:1:72:"));
+}
+
+
+static void
+test_fbd_feedback_theme_size (void)
+{
+  g_autoptr (FbdFeedbackTheme) theme = fbd_feedback_theme_new (THEME_NAME);
+  g_autoptr (FbdFeedbackProfile) profile = fbd_feedback_profile_new ("full");
+  g_autoptr (FbdFeedbackDummy) feedback = g_object_new (FBD_TYPE_FEEDBACK_DUMMY,
+                                                        "event-name", "event1",
+                                                        NULL);
+  gsize size, empty_size;
+
+  empty_size = fbd_feedback_theme_get_size (theme);
+  g_assert_cmpuint (empty_size, >, 0);
+
+  fbd_feedback_theme_add_profile (theme, profile);
+  size = fbd_feedback_theme_get_size (theme);
+  g_assert_cmpuint (size, >, empty_size);
+
+  fbd_feedback_profile_add_feedback (profile, FBD_FEEDBACK_BASE (feedback));
+  g_assert_cmpuint (fbd_feedback_theme_get_size (theme), >, size);
+}
+
+static char *
+create_large_theme (guint n_feedbacks)
+{
+  const char *profiles[] = { "full", "quiet", "silent" };
+  GString *json = g_string_new ("{ \"name\" : \"perf\", \"profiles\" : [");
+
+  for (guint i = 0; i < G_N_ELEMENTS (profiles); i++) {
+    g_string_append_printf (json, "%s{ \"name\" : \"%s\", \"feedbacks\" : [",
+                            i ? ", " : "", profiles[i]);
+    for (guint j = 0; j < n_feedbacks; j++) {
+      g_string_append_printf (json,
+                              "%s{ \"type\" : \"VibraRumble\", \"event-name\" : \"event-%u\", "
+                              "\"duration\" : %u, \"count\" : 2, \"pause\" : 50 }",
+                              j ? ", " : "", j, 10 + j % 100);
+    }
+    g_string_append (json, "] }");
+  }
+  g_string_append (json, "] }");
+
+  return g_string_free (json, FALSE);
+}
+
+
+static void
+test_fbd_feedback_theme_parse_perf (void)
+{
+  g_autofree char *json = create_large_theme (5000);
+  g_autoptr (GTimer) timer = g_timer_new ();
+  g_autoptr (GError) err = NULL;
+  double parser_time, json_glib_time;
+
+  for (guint i = 0; i < 10; i++) {
+    g_autoptr (FbdFeedbackTheme) theme = fbd_feedback_theme_new_from_data (json, &err);
+
+    g_assert_no_error (err);
+    g_assert_nonnull (theme);
+  }
+  parser_time = g_timer_elapsed (timer, NULL);
+
+  g_timer_start (timer);
+  for (guint i = 0; i < 10; i++) {
+    g_autoptr (JsonNode) node = json_from_string (json, &err);
+    g_autoptr (GObject) theme = NULL;
+
+    g_assert_no_error (err);
+    theme = json_gobject_deserialize (FBD_TYPE_FEEDBACK_THEME, node);
+    g_assert_nonnull (theme);
+  }
+  json_glib_time = g_timer_elapsed (timer, NULL);
+
+  g_test_message ("Theme parser: %.3fs, json-glib: %.3fs", parser_time, json_glib_time);
+  g_test_minimized_result (parser_time, "Parsing %zu bytes 10 times took %.3fs",
+                           strlen (json), parser_time);
+}
+
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -198,7 +395,14 @@ main (gint argc, gchar *argv[])
   g_test_add_func("/feedbackd/fbd/feedback-theme/name", test_fbd_feedback_theme_name);
   g_test_add_func("/feedbackd/fbd/feedback-theme/profiles", test_fbd_feedback_theme_profiles);
   g_test_add_func("/feedbackd/fbd/feedback-theme/parse", test_fbd_feedback_theme_parse);
+  g_test_add_func("/feedbackd/fbd/feedback-theme/parse/properties",
+                  test_fbd_feedback_theme_parse_properties);
+  g_test_add_func("/feedbackd/fbd/feedback-theme/parse/errors", test_fbd_feedback_theme_parse_errors);
+  g_test_add_func("/feedbackd/fbd/feedback-theme/parse/depth", test_fbd_feedback_theme_parse_depth);
   g_test_add_func("/feedbackd/fbd/feedback-theme/update", test_fbd_feedback_theme_update);
+  g_test_add_func("/feedbackd/fbd/feedback-theme/size", test_fbd_feedback_theme_size);
+  if (g_test_perf ())
+    g_test_add_func("/feedbackd/fbd/feedback-theme/parse/perf", test_fbd_feedback_theme_parse_perf);
 
   return g_test_run();
 }
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#include "fbd-latency.h"
+
+
+static void
+test_fbd_latency_device (void)
+{
+  const char *compatibles[] = { "doesnotexist", "test,device", NULL };
+  g_autoptr (FbdLatency) latency = fbd_latency_new (compatibles);
+
+  g_assert_true (FBD_IS_LATENCY (latency));
+  g_assert_cmpuint (fbd_latency_get (latency, FBD_ARBITER_DEVICE_SOUND), ==, 40 * 1000);
+  /* Overridden by the user's config */
+  g_assert_cmpuint (fbd_latency_get (latency, FBD_ARBITER_DEVICE_VIBRA), ==, 5 * 1000);
+  g_assert_cmpuint (fbd_latency_get (latency, FBD_ARBITER_DEVICE_LEDS), ==, 0);
+  g_assert_cmpuint (fbd_latency_get (latency, FBD_ARBITER_DEVICE_NONE), ==, 0);
+
+  fbd_latency_set (latency, FBD_ARBITER_DEVICE_LEDS, 1000);
+  g_assert_cmpuint (fbd_latency_get (latency, FBD_ARBITER_DEVICE_LEDS), ==, 1000);
+}
+
+static void
+test_fbd_latency_no_device (void)
+{
+  g_autoptr (FbdLatency) latency = fbd_latency_new (NULL);
+
+  g_assert_cmpuint (fbd_latency_get (latency, FBD_ARBITER_DEVICE_SOUND), ==, 0);
+  g_assert_cmpuint (fbd_latency_get (latency, FBD_ARBITER_DEVICE_VIBRA), ==, 5 * 1000);
+}
+
+gint
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func("/feedbackd/fbd/latency/device", test_fbd_latency_device);
+  g_test_add_func("/feedbackd/fbd/latency/no-device", test_fbd_latency_no_device);
+
+  return g_test_run();
+}
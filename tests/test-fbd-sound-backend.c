@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2020 Purism SPC
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#include "fbd-dev-sound.h"
+#include "fbd-sound-backend.h"
+#include "fbd-sound-file.h"
+
+#include <glib/gstdio.h>
+
+#include <string.h>
+
+#define TEST_SOUND_DURATION 100
+#define TEST_SOUND_RATE 8000
+
+typedef struct {
+  GMainLoop *loop;
+  GError    *err;
+  gboolean   success;
+} TestPlayData;
+
+static char *sound_data_dir;
+
+static GMainLoop *played_loop;
+static guint n_played;
+
+/* 100ms of 8 bit mono silence */
+static void
+write_test_sound (const char *data_dir, const char *effect)
+{
+  g_autofree char *dir = g_build_filename (data_dir, "sounds", "freedesktop", "stereo", NULL);
+  g_autofree char *name = g_strconcat (effect, ".wav", NULL);
+  g_autofree char *path = g_build_filename (dir, name, NULL);
+  guint32 data_size = TEST_SOUND_RATE * TEST_SOUND_DURATION / 1000;
+  g_autofree guint8 *wav = g_malloc0 (44 + data_size);
+  g_autoptr (GError) err = NULL;
+
+  memcpy (wav, "RIFF", 4);
+  wav[4] = (36 + data_size) & 0xff;
+  wav[5] = (36 + data_size) >> 8;
+  memcpy (wav + 8, "WAVEfmt ", 8);
+  wav[16] = 16;
+  wav[20] = 1;
+  wav[22] = 1;
+  wav[24] = TEST_SOUND_RATE & 0xff;
+  wav[25] = TEST_SOUND_RATE >> 8;
+  wav[28] = TEST_SOUND_RATE & 0xff;
+  wav[29] = TEST_SOUND_RATE >> 8;
+  wav[32] = 1;
+  wav[34] = 8;
+  memcpy (wav + 36, "data", 4);
+  wav[40] = data_size & 0xff;
+  wav[41] = data_size >> 8;
+  memset (wav + 44, 0x80, data_size);
+
+  g_assert_cmpint (g_mkdir_with_parents (dir, 0755), ==, 0);
+  g_file_set_contents (path, (char *)wav, 44 + data_size, &err);
+  g_assert_no_error (err);
+}
+
+static void
+on_play_finished (FbdSoundBackend *backend, GAsyncResult *res, TestPlayData *data)
+{
+  data->success = fbd_sound_backend_play_finish (backend, res, &data->err);
+  g_main_loop_quit (data->loop);
+}
+
+static gboolean
+play_sync (FbdSoundBackend *backend, const char *effect, GCancellable *cancel, GError **error)
+{
+  TestPlayData data = { g_main_loop_new (NULL, FALSE), NULL, FALSE };
+
+  fbd_sound_backend_play (backend, effect, FALSE, cancel,
+                          (GAsyncReadyCallback)on_play_finished, &data);
+  if (cancel)
+    g_cancellable_cancel (cancel);
+  g_main_loop_run (data.loop);
+  g_main_loop_unref (data.loop);
+
+  g_propagate_error (error, data.err);
+  return data.success;
+}
+
+static void
+on_preload_finished (FbdSoundBackend *backend, GAsyncResult *res, TestPlayData *data)
+{
+  data->success = fbd_sound_backend_preload_finish (backend, res, &data->err);
+  g_main_loop_quit (data->loop);
+}
+
+static gboolean
+preload_sync (FbdSoundBackend *backend, const char *effect, GCancellable *cancel, GError **error)
+{
+  TestPlayData data = { g_main_loop_new (NULL, FALSE), NULL, FALSE };
+
+  fbd_sound_backend_preload (backend, effect, cancel,
+                             (GAsyncReadyCallback)on_preload_finished, &data);
+  if (cancel)
+    g_cancellable_cancel (cancel);
+  g_main_loop_run (data.loop);
+  g_main_loop_unref (data.loop);
+
+  g_propagate_error (error, data.err);
+  return data.success;
+}
+
+typedef struct {
+  GMainLoop    *loop;
+  GCancellable *cancel;
+  GError       *err;
+  guint         iterations;
+  gint64        start;
+  gint64        last;
+} TestLoopData;
+
+static void
+on_loop_iteration (TestLoopData *data)
+{
+  data->iterations++;
+  data->last = g_get_monotonic_time ();
+  if (data->iterations == 3)
+    g_cancellable_cancel (data->cancel);
+}
+
+static void
+on_loop_finished (FbdSoundBackend *backend, GAsyncResult *res, TestLoopData *data)
+{
+  g_assert_false (fbd_sound_backend_play_repeat_finish (backend, res, &data->err));
+  g_main_loop_quit (data->loop);
+}
+
+static void
+test_fbd_sound_file_info (void)
+{
+  g_autofree char *path = fbd_sound_file_lookup (NULL, "test-sound");
+  g_autoptr (GError) err = NULL;
+  FbdSoundFileInfo info;
+
+  g_assert_nonnull (path);
+  g_assert_true (fbd_sound_file_get_info (path, &info, &err));
+  g_assert_no_error (err);
+  g_assert_cmpuint (info.duration, ==, TEST_SOUND_DURATION);
+  g_assert_cmpuint (info.rate, ==, TEST_SOUND_RATE);
+  g_assert_cmpuint (info.channels, ==, 1);
+  g_assert_cmpuint (info.bits, ==, 8);
+
+  g_assert_null (fbd_sound_file_lookup ("doesnotexist", "doesnotexist"));
+}
+
+static void
+test_fbd_sound_backend_null (void)
+{
+  g_autoptr (GError) err = NULL;
+  g_autoptr (FbdSoundBackend) backend = fbd_sound_backend_new ("null", &err);
+  g_autoptr (GCancellable) cancel = g_cancellable_new ();
+  gint64 start;
+
+  g_assert_no_error (err);
+  g_assert_true (FBD_IS_SOUND_BACKEND (backend));
+
+  /* Completes after the sound's duration */
+  start = g_get_monotonic_time ();
+  g_assert_true (play_sync (backend, "test-sound", NULL, &err));
+  g_assert_no_error (err);
+  g_assert_cmpint (g_get_monotonic_time () - start, >=, TEST_SOUND_DURATION * 1000);
+
+  /* Stopping cancels right away */
+  g_assert_false (play_sync (backend, "test-sound", cancel, &err));
+  g_assert_error (err, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_clear_error (&err);
+
+  g_assert_false (play_sync (backend, "doesnotexist", NULL, &err));
+  g_assert_error (err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+  g_clear_error (&err);
+
+  g_assert_true (preload_sync (backend, "test-sound", NULL, &err));
+  g_assert_no_error (err);
+
+  g_assert_false (preload_sync (backend, "doesnotexist", NULL, &err));
+  g_assert_error (err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+}
+
+static void
+test_fbd_sound_backend_repeat (void)
+{
+  g_autoptr (GError) err = NULL;
+  g_autoptr (FbdSoundBackend) backend = fbd_sound_backend_new ("null", &err);
+  TestLoopData data = { 0 };
+  guint duration;
+
+  g_assert_no_error (err);
+  g_assert_true (fbd_sound_backend_get_duration (backend, "test-sound", &duration, &err));
+  g_assert_no_error (err);
+  g_assert_cmpuint (duration, ==, TEST_SOUND_DURATION);
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  data.cancel = g_cancellable_new ();
+  data.start = g_get_monotonic_time ();
+  fbd_sound_backend_play_repeat (backend, "test-sound",
+                                 (FbdSoundBackendIterationFunc)on_loop_iteration,
+                                 data.cancel,
+                                 (GAsyncReadyCallback)on_loop_finished,
+                                 &data);
+  g_main_loop_run (data.loop);
+
+  /* Cancelling from the iteration callback ends playback right away */
+  g_assert_error (data.err, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert_cmpuint (data.iterations, ==, 3);
+  /* Each iteration starts once the previous one finished */
+  g_assert_cmpint (data.last - data.start, >=, 3 * TEST_SOUND_DURATION * 1000);
+
+  g_clear_error (&data.err);
+  g_main_loop_unref (data.loop);
+  g_object_unref (data.cancel);
+}
+
+static void
+test_fbd_sound_backend_file (void)
+{
+  g_autoptr (GError) err = NULL;
+  g_autoptr (FbdSoundBackend) backend = NULL;
+  g_autofree char *out_dir = g_build_filename (sound_data_dir, "out", NULL);
+  g_autoptr (GDir) dir = NULL;
+  const char *name;
+
+  g_setenv ("FEEDBACKD_SOUND_FILE_DIR", out_dir, TRUE);
+  backend = fbd_sound_backend_new ("file", &err);
+  g_assert_no_error (err);
+  g_assert_true (FBD_IS_SOUND_BACKEND (backend));
+
+  g_assert_true (play_sync (backend, "test-sound", NULL, &err));
+  g_assert_no_error (err);
+
+  dir = g_dir_open (out_dir, 0, &err);
+  g_assert_no_error (err);
+  name = g_dir_read_name (dir);
+  g_assert_nonnull (name);
+  g_assert_true (g_str_has_suffix (name, "-test-sound.wav"));
+  g_assert_null (g_dir_read_name (dir));
+}
+
+static void
+on_sound_played (FbdFeedbackSound *feedback)
+{
+  if (--n_played == 0)
+    g_main_loop_quit (played_loop);
+}
+
+static FbdFeedbackSound *
+new_sound_feedback (const char *effect, guint priority)
+{
+  return g_object_new (FBD_TYPE_FEEDBACK_SOUND,
+                       "effect", effect,
+                       "priority", priority,
+                       NULL);
+}
+
+static void
+test_fbd_dev_sound_voices (void)
+{
+  g_autoptr (GError) err = NULL;
+  g_autoptr (FbdDevSound) sound = NULL;
+  g_autoptr (FbdFeedbackSound) low = new_sound_feedback ("test-sound", 0);
+  g_autoptr (FbdFeedbackSound) high = new_sound_feedback ("test-sound-2", 10);
+  g_autoptr (FbdFeedbackSound) same = new_sound_feedback ("test-sound-2", 0);
+  g_autoptr (FbdFeedbackSound) dropped = new_sound_feedback ("test-sound", 0);
+  const FbdDevSoundCounters *counters;
+
+  g_setenv ("FEEDBACKD_SOUND_BACKEND", "null", TRUE);
+  sound = fbd_dev_sound_new (&err);
+  g_assert_no_error (err);
+  g_object_set (sound, "max-voices", 1, NULL);
+
+  played_loop = g_main_loop_new (NULL, FALSE);
+  n_played = 4;
+
+  g_assert_true (fbd_dev_sound_play (sound, low, on_sound_played));
+  /* Higher priority steals the only voice */
+  g_assert_true (fbd_dev_sound_play (sound, high, on_sound_played));
+  /* Same effect joins the running sound */
+  g_assert_true (fbd_dev_sound_play (sound, same, on_sound_played));
+  /* Lower priority than the running sound */
+  g_assert_false (fbd_dev_sound_play (sound, dropped, on_sound_played));
+
+  g_main_loop_run (played_loop);
+  g_clear_pointer (&played_loop, g_main_loop_unref);
+
+  counters = fbd_dev_sound_get_counters (sound);
+  g_assert_cmpuint (counters->started, ==, 2);
+  g_assert_cmpuint (counters->stolen, ==, 1);
+  g_assert_cmpuint (counters->coalesced, ==, 1);
+  g_assert_cmpuint (counters->dropped, ==, 1);
+  g_assert_cmpuint (counters->peak, ==, 1);
+}
+
+gint
+main (int argc, char *argv[])
+{
+  int ret;
+
+  g_test_init (&argc, &argv, NULL);
+
+  sound_data_dir = g_dir_make_tmp ("fbd-sound-backend-XXXXXX", NULL);
+  g_assert_nonnull (sound_data_dir);
+  g_setenv ("XDG_DATA_HOME", sound_data_dir, TRUE);
+  write_test_sound (sound_data_dir, "test-sound");
+  write_test_sound (sound_data_dir, "test-sound-2");
+
+  g_test_add_func("/feedbackd/fbd/sound-backend/file-info", test_fbd_sound_file_info);
+  g_test_add_func("/feedbackd/fbd/sound-backend/null", test_fbd_sound_backend_null);
+  g_test_add_func("/feedbackd/fbd/sound-backend/repeat", test_fbd_sound_backend_repeat);
+  g_test_add_func("/feedbackd/fbd/sound-backend/file", test_fbd_sound_backend_file);
+  g_test_add_func("/feedbackd/fbd/sound-backend/voices", test_fbd_dev_sound_voices);
+
+  ret = g_test_run();
+
+  g_free (sound_data_dir);
+  return ret;
+}
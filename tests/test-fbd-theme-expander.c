@@ -4,9 +4,14 @@
  * SPDX-License-Identifier: GPL-3.0+
  */
 
+#include "fbd.h"
+#include "fbd-event.h"
 #include "fbd-feedback-dummy.h"
+#include "fbd-theme-cache.h"
+#include "fbd-theme-dirs.h"
 #include "fbd-theme-expander.h"
 
+#include <glib/gstdio.h>
 #include <json-glib/json-glib.h>
 
 
@@ -119,6 +124,290 @@ test_fbd_theme_expander_custom (void)
   g_assert_finalize_object (expander);
 }
 
+static guint
+get_dummy_duration (FbdFeedbackTheme *theme, const char *event_name)
+{
+  FbdFeedbackProfile *profile;
+  FbdFeedbackBase *fb;
+
+  profile = fbd_feedback_theme_get_profile (theme, "full");
+  g_assert_true (FBD_IS_FEEDBACK_PROFILE (profile));
+  fb = fbd_feedback_profile_get_feedback (profile, event_name);
+  g_assert_true (FBD_IS_FEEDBACK_DUMMY (fb));
+  g_assert_cmpstr (event_name, ==, fbd_feedback_get_event_name (fb));
+
+  return fbd_feedback_dummy_get_duration (FBD_FEEDBACK_DUMMY (fb));
+}
+
+/* Duration of the full profile's dummy feedback for an app's event */
+static guint
+lookup_dummy_duration (FbdFeedbackTheme *theme, const char *app_id, const char *event_name)
+{
+  g_autoptr (FbdEvent) event = fbd_event_new (0, app_id, event_name, 0, NULL);
+  GSList *feedbacks;
+  FbdFeedbackBase *fb;
+  guint duration;
+
+  feedbacks = fbd_feedback_theme_lookup_feedback (theme, FBD_FEEDBACK_PROFILE_LEVEL_FULL, event);
+  g_assert_nonnull (feedbacks);
+  /* Ordered from silent to full */
+  fb = g_slist_last (feedbacks)->data;
+  g_assert_true (FBD_IS_FEEDBACK_DUMMY (fb));
+  g_assert_cmpstr (event_name, ==, fbd_feedback_get_event_name (fb));
+  duration = fbd_feedback_dummy_get_duration (FBD_FEEDBACK_DUMMY (fb));
+
+  g_slist_free_full (feedbacks, g_object_unref);
+  return duration;
+}
+
+/* The cache gets written from a thread */
+static void
+wait_for_cache (const char *cache_path)
+{
+  while (!g_file_test (cache_path, G_FILE_TEST_EXISTS))
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static char *
+resolve_elsewhere (const char *theme_name, gpointer user_data)
+{
+  return g_strdup_printf ("/nonexistent/%s.json", theme_name);
+}
+
+static void
+test_fbd_theme_expander_cache (void)
+{
+  g_autoptr (GError) err = NULL;
+  g_autofree char *dir = NULL;
+  g_autofree char *theme_file = NULL;
+  g_autofree char *cache_path = NULL;
+  const char *json = "{ \"name\": \"cached\", \"parent-name\": \"default\","
+    " \"profiles\": [ { \"name\": \"full\", \"feedbacks\": ["
+    " { \"event-name\": \"test-dummy-0\", \"type\": \"Dummy\", \"duration\": %u },"
+    " { \"event-name\": \"test-prefix-*\", \"type\": \"Dummy\", \"duration\": 9 } ] } ] }";
+  g_autofree char *contents = NULL;
+  FbdThemeExpander *expander;
+  FbdFeedbackTheme *theme;
+  FbdFeedbackBase *fb;
+
+  dir = g_dir_make_tmp ("fbd-theme-cache-XXXXXX", &err);
+  g_assert_no_error (err);
+  theme_file = g_build_filename (dir, "cached.json", NULL);
+  contents = g_strdup_printf (json, 7);
+  g_file_set_contents (theme_file, contents, -1, &err);
+  g_assert_no_error (err);
+
+  cache_path = fbd_theme_cache_get_path ("cached", theme_file);
+  g_assert_false (g_file_test (cache_path, G_FILE_TEST_EXISTS));
+
+  /* Parsing the theme fills the cache */
+  expander = fbd_theme_expander_new (NULL, "cached", theme_file);
+  theme = fbd_theme_expander_load_theme_files (expander, &err);
+  g_assert_no_error (err);
+  g_assert_cmpint (get_dummy_duration (theme, "test-dummy-0"), ==, 7);
+  wait_for_cache (cache_path);
+  g_assert_finalize_object (theme);
+  g_assert_finalize_object (expander);
+
+  /* Load from the cache */
+  expander = fbd_theme_expander_new (NULL, "cached", theme_file);
+  theme = fbd_theme_expander_load_theme_files (expander, &err);
+  g_assert_no_error (err);
+  g_assert_cmpstr (fbd_feedback_theme_get_name (theme), ==, "cached");
+  g_assert_cmpint (get_dummy_duration (theme, "test-dummy-0"), ==, 7);
+  fb = fbd_feedback_profile_get_feedback (fbd_feedback_theme_get_profile (theme, "full"),
+                                          "test-prefix-event");
+  g_assert_true (FBD_IS_FEEDBACK_DUMMY (fb));
+  g_assert_cmpint (fbd_feedback_dummy_get_duration (FBD_FEEDBACK_DUMMY (fb)), ==, 9);
+  /* Feedbacks from the parent theme are there too */
+  g_assert_nonnull (fbd_feedback_theme_get_profile (theme, "quiet"));
+  g_assert_finalize_object (theme);
+
+  theme = fbd_theme_cache_load (cache_path, resolve_elsewhere, NULL, NULL, NULL, NULL, &err);
+  /* Parent theme resolves to a different file */
+  g_assert_null (theme);
+  g_assert_error (err, fbd_error_quark (), FBD_ERROR_FAILED);
+  g_clear_error (&err);
+
+  /* Changing the theme file invalidates the cache */
+  g_free (contents);
+  contents = g_strdup_printf (json, 1234);
+  g_file_set_contents (theme_file, contents, -1, &err);
+  g_assert_no_error (err);
+  theme = fbd_theme_expander_load_theme_files (expander, &err);
+  g_assert_no_error (err);
+  g_assert_cmpint (get_dummy_duration (theme, "test-dummy-0"), ==, 1234);
+  g_assert_finalize_object (theme);
+  g_assert_finalize_object (expander);
+
+  g_unlink (cache_path);
+  g_unlink (theme_file);
+  g_rmdir (dir);
+}
+
+static void
+on_theme_changed (FbdThemeExpander *expander, GMainLoop *loop)
+{
+  g_main_loop_quit (loop);
+}
+
+static gboolean
+on_timeout (gpointer user_data)
+{
+  g_assert_not_reached ();
+  return G_SOURCE_REMOVE;
+}
+
+static void
+test_fbd_theme_expander_watch (void)
+{
+  g_autoptr (GMainLoop) loop = g_main_loop_new (NULL, FALSE);
+  g_autoptr (GError) err = NULL;
+  g_autofree char *dir = NULL;
+  g_autofree char *theme_file = NULL;
+  g_autofree char *cache_path = NULL;
+  g_autofree char *contents = NULL;
+  const char *json = "{ \"name\": \"watched\", \"parent-name\": \"default\","
+    " \"profiles\": [ { \"name\": \"full\", \"feedbacks\": ["
+    " { \"event-name\": \"test-dummy-0\", \"type\": \"Dummy\", \"duration\": %u },"
+    " { \"event-name\": \"test-prefix-*\", \"type\": \"Dummy\", \"duration\": 9 } ] } ] }";
+  FbdThemeExpander *expander;
+  FbdFeedbackTheme *theme, *reloaded;
+  FbdFeedbackProfile *profile;
+  FbdFeedbackBase *fb;
+  guint timeout_id;
+
+  dir = g_dir_make_tmp ("fbd-theme-watch-XXXXXX", &err);
+  g_assert_no_error (err);
+  theme_file = g_build_filename (dir, "watched.json", NULL);
+  contents = g_strdup_printf (json, 7);
+  g_file_set_contents (theme_file, contents, -1, &err);
+  g_assert_no_error (err);
+
+  expander = fbd_theme_expander_new (NULL, "watched", theme_file);
+  fbd_theme_expander_set_watch (expander, TRUE);
+  g_signal_connect (expander, "theme-changed", G_CALLBACK (on_theme_changed), loop);
+  theme = fbd_theme_expander_load_theme_files (expander, &err);
+  g_assert_no_error (err);
+  g_assert_cmpint (get_dummy_duration (theme, "test-dummy-0"), ==, 7);
+
+  g_free (contents);
+  contents = g_strdup_printf (json, 1234);
+  g_file_set_contents (theme_file, contents, -1, &err);
+  g_assert_no_error (err);
+
+  timeout_id = g_timeout_add_seconds (10, on_timeout, NULL);
+  g_main_loop_run (loop);
+  g_source_remove (timeout_id);
+
+  reloaded = fbd_theme_expander_reload (expander, &err);
+  g_assert_no_error (err);
+  g_assert_cmpstr (fbd_feedback_theme_get_name (reloaded), ==, "watched");
+  g_assert_cmpint (get_dummy_duration (reloaded, "test-dummy-0"), ==, 1234);
+
+  /* The unchanged parent theme wasn't parsed again */
+  profile = fbd_feedback_theme_get_profile (theme, "quiet");
+  g_assert_true (FBD_IS_FEEDBACK_PROFILE (profile));
+  fb = fbd_feedback_profile_get_feedback (profile, "test-dummy-1");
+  g_assert_true (FBD_IS_FEEDBACK_BASE (fb));
+  profile = fbd_feedback_theme_get_profile (reloaded, "quiet");
+  g_assert_true (fb == fbd_feedback_profile_get_feedback (profile, "test-dummy-1"));
+
+  g_assert_finalize_object (theme);
+  g_assert_finalize_object (reloaded);
+  g_assert_finalize_object (expander);
+
+  cache_path = fbd_theme_cache_get_path ("watched", theme_file);
+  g_unlink (cache_path);
+  g_unlink (theme_file);
+  g_rmdir (dir);
+}
+static void
+test_fbd_theme_expander_app_overlay (void)
+{
+  g_autoptr (GError) err = NULL;
+  const char *compatibles[] = { "doesnotexist", NULL };
+  g_autofree char *theme_name = NULL;
+  g_autofree char *theme_file = NULL;
+  g_autofree char *cache_path = NULL;
+  FbdThemeExpander *expander;
+  FbdFeedbackTheme *theme;
+
+  expander = fbd_theme_expander_new (compatibles, NULL, NULL);
+  theme = fbd_theme_expander_load_theme_files (expander, &err);
+  g_assert_no_error (err);
+  g_assert_cmpuint (get_dummy_duration (theme, "test-dummy-1"), ==, 0);
+  g_object_get (expander, "theme-name", &theme_name, "theme-file", &theme_file, NULL);
+  cache_path = fbd_theme_cache_get_path (theme_name, theme_file);
+
+  /* The user's overlay wins over the system one */
+  g_assert_true (fbd_feedback_theme_has_app_overlay (theme, TEST_APP_ID));
+  g_assert_cmpuint (lookup_dummy_duration (theme, TEST_APP_ID, "test-dummy-1"), ==, 0x60);
+  /* Events not in the overlay come from the main theme */
+  g_assert_cmpuint (lookup_dummy_duration (theme, TEST_APP_ID, "test-dummy-0"), ==, 0);
+
+  g_assert_true (fbd_feedback_theme_has_app_overlay (theme, "org.example.App"));
+  g_assert_cmpuint (lookup_dummy_duration (theme, "org.example.App", "test-dummy-1"), ==, 0x50);
+
+  /* Other apps and events without an app id use the main theme */
+  g_assert_false (fbd_feedback_theme_has_app_overlay (theme, "org.example.Other"));
+  g_assert_cmpuint (lookup_dummy_duration (theme, "org.example.Other", "test-dummy-1"), ==, 0);
+  g_assert_cmpuint (lookup_dummy_duration (theme, NULL, "test-dummy-1"), ==, 0);
+  /* The overlay doesn't touch the main theme's profiles */
+  g_assert_cmpuint (get_dummy_duration (theme, "test-dummy-1"), ==, 0);
+  g_assert_finalize_object (theme);
+
+  /* The overlays are part of the cached theme */
+  wait_for_cache (cache_path);
+  theme = fbd_theme_expander_load_theme_files (expander, &err);
+  g_assert_no_error (err);
+  g_assert_true (fbd_feedback_theme_has_app_overlay (theme, TEST_APP_ID));
+  g_assert_cmpuint (lookup_dummy_duration (theme, TEST_APP_ID, "test-dummy-1"), ==, 0x60);
+  g_assert_cmpuint (lookup_dummy_duration (theme, "org.example.App", "test-dummy-1"), ==, 0x50);
+  g_assert_false (fbd_feedback_theme_has_app_overlay (theme, "org.example.Other"));
+
+  g_assert_finalize_object (theme);
+  g_assert_finalize_object (expander);
+}
+
+static FbdFeedbackTheme *
+load_with_dirs (FbdThemeDirs *dirs)
+{
+  g_autoptr (GError) err = NULL;
+  const char *compatibles[] = { "doesnotexist", NULL };
+  g_autoptr (FbdThemeExpander) expander = NULL;
+  FbdFeedbackTheme *theme;
+
+  expander = g_object_new (FBD_TYPE_THEME_EXPANDER,
+                           "compatibles", compatibles,
+                           "theme-dirs", dirs,
+                           NULL);
+  theme = fbd_theme_expander_load_theme_files (expander, &err);
+  g_assert_no_error (err);
+  g_assert_true (FBD_IS_FEEDBACK_THEME (theme));
+
+  return theme;
+}
+
+static void
+test_fbd_theme_expander_theme_dirs (void)
+{
+  g_autoptr (FbdThemeDirs) dirs = fbd_theme_dirs_new ();
+  FbdFeedbackTheme *theme;
+  guint n_scans;
+
+  theme = load_with_dirs (dirs);
+  n_scans = fbd_theme_dirs_get_n_scans (dirs);
+  g_assert_cmpuint (n_scans, >, 0);
+  g_assert_finalize_object (theme);
+
+  /* A full load with a new expander doesn't read unchanged folders again */
+  theme = load_with_dirs (dirs);
+  g_assert_cmpuint (fbd_theme_dirs_get_n_scans (dirs), ==, n_scans);
+  g_assert_cmpuint (get_dummy_duration (theme, "test-dummy-1"), ==, 0);
+  g_assert_finalize_object (theme);
+}
+
 gint
 main (int argc, char *argv[])
 {
@@ -127,6 +416,10 @@ main (int argc, char *argv[])
   g_test_add_func("/feedbackd/fbd/theme-expander/object", test_fbd_theme_expander_object);
   g_test_add_func("/feedbackd/fbd/theme-expander/device", test_fbd_theme_expander_device);
   g_test_add_func("/feedbackd/fbd/theme-expander/custom", test_fbd_theme_expander_custom);
+  g_test_add_func("/feedbackd/fbd/theme-expander/cache", test_fbd_theme_expander_cache);
+  g_test_add_func("/feedbackd/fbd/theme-expander/watch", test_fbd_theme_expander_watch);
+  g_test_add_func("/feedbackd/fbd/theme-expander/app-overlay", test_fbd_theme_expander_app_overlay);
+  g_test_add_func("/feedbackd/fbd/theme-expander/theme-dirs", test_fbd_theme_expander_theme_dirs);
 
   return g_test_run();
 }
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2022 Guido Günther
+ *
+ * SPDX-License-Identifier: GPL-3.0+
+ */
+
+#include <gio/gio.h>
+
+#define THEMES_DIR TEST_DATA_DIR "/validate/feedbackd/themes"
+
+
+static gboolean
+run_validate (const char *args[], char **out, char **err)
+{
+  g_autoptr (GSubprocessLauncher) launcher = NULL;
+  g_autoptr (GSubprocess) proc = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GPtrArray) argv = g_ptr_array_new ();
+
+  g_ptr_array_add (argv, FBD_THEME_VALIDATE);
+  g_ptr_array_add (argv, "--data-dir");
+  g_ptr_array_add (argv, TEST_DATA_DIR "/validate");
+  for (guint i = 0; args && args[i]; i++)
+    g_ptr_array_add (argv, (gpointer)args[i]);
+  g_ptr_array_add (argv, NULL);
+
+  launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE |
+                                        G_SUBPROCESS_FLAGS_STDERR_PIPE);
+  /* The test data triggers the warnings of the theme loading code */
+  g_subprocess_launcher_unsetenv (launcher, "G_DEBUG");
+  proc = g_subprocess_launcher_spawnv (launcher, (const char * const *)argv->pdata, &error);
+  g_assert_no_error (error);
+
+  g_subprocess_communicate_utf8 (proc, NULL, NULL, out, err, &error);
+  g_assert_no_error (error);
+  g_test_message ("stdout: %s", *out);
+  g_test_message ("stderr: %s", *err);
+
+  return g_subprocess_get_if_exited (proc) && g_subprocess_get_exit_status (proc) == 0;
+}
+
+
+static void
+test_fbd_theme_validate_report (void)
+{
+  g_autofree char *out = NULL;
+  g_autofree char *err = NULL;
+
+  g_assert_true (run_validate (NULL, &out, &err));
+
+  g_assert_nonnull (strstr (out, "Shadowed: full/test-dummy-0 in " THEMES_DIR "/default.json "
+                                 "by " THEMES_DIR "/device.json\n"));
+  /* Only the device's own feedback replaces the parent's */
+  g_assert_null (strstr (out, "Shadowed: full/test-dummy-1"));
+  g_assert_nonnull (strstr (out, "Unused: profile 'loud' in " THEMES_DIR "/default.json\n"));
+
+  g_assert_nonnull (strstr (out, "org-example-app: app overlay"));
+  g_assert_nonnull (strstr (out, "Unused: parent 'default' in "
+                                 THEMES_DIR "/apps/org-example-app.json\n"));
+  g_assert_nonnull (strstr (out, "Unused: profile 'loud' in "
+                                 THEMES_DIR "/apps/org-example-app.json\n"));
+
+  g_assert_nonnull (strstr (out, "Validation successful."));
+}
+
+
+static void
+test_fbd_theme_validate_max_size (void)
+{
+  const char *args[] = { "--max-size", "1", NULL };
+  g_autofree char *out = NULL;
+  g_autofree char *err = NULL;
+
+  g_assert_false (run_validate (args, &out, &err));
+  g_assert_nonnull (strstr (err, "device: Theme uses "));
+  g_assert_nonnull (strstr (err, "org-example-app: App overlay uses "));
+  g_assert_null (strstr (out, "Validation successful."));
+}
+
+
+static void
+test_fbd_theme_validate_max_time (void)
+{
+  /* Reading and merging the files takes longer than a microsecond */
+  const char *args[] = { "--max-time", "0.001", NULL };
+  g_autofree char *out = NULL;
+  g_autofree char *err = NULL;
+
+  g_assert_false (run_validate (args, &out, &err));
+  g_assert_nonnull (strstr (err, "device: Expanding took "));
+  g_assert_null (strstr (out, "Validation successful."));
+}
+
+
+gint
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/feedbackd/fbd/theme-validate/report", test_fbd_theme_validate_report);
+  g_test_add_func ("/feedbackd/fbd/theme-validate/max-size", test_fbd_theme_validate_max_size);
+  g_test_add_func ("/feedbackd/fbd/theme-validate/max-time", test_fbd_theme_validate_max_time);
+
+  return g_test_run ();
+}
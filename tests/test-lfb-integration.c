@@ -30,6 +30,7 @@ fixture_setup (TestFixture *fixture, gconstpointer unused)
   g_free (servicesdir);
   g_setenv ("FEEDBACK_THEME", TEST_DATA_DIR "/test.json", TRUE);
   g_setenv ("GSETTINGS_BACKEND", "memory", TRUE);
+  g_setenv ("FEEDBACKD_SOUND_BACKEND", "null", TRUE);
   g_test_dbus_up (fixture->dbus);
 
   g_assert_null (mainloop);
@@ -330,6 +331,78 @@ test_lfb_integration_profile (void)
   g_assert_cmpstr (cmp, ==, "quiet");
 }
 
+static LfbGdbusFeedbackDebug *
+get_debug_proxy (void)
+{
+  g_autoptr (GError) err = NULL;
+  GDBusProxy *proxy = G_DBUS_PROXY (lfb_get_proxy ());
+  LfbGdbusFeedbackDebug *debug;
+
+  debug = lfb_gdbus_feedback_debug_proxy_new_sync (g_dbus_proxy_get_connection (proxy),
+                                                   G_DBUS_PROXY_FLAGS_NONE,
+                                                   g_dbus_proxy_get_name (proxy),
+                                                   g_dbus_proxy_get_object_path (proxy),
+                                                   NULL,
+                                                   &err);
+  g_assert_no_error (err);
+  g_assert_nonnull (debug);
+
+  return debug;
+}
+
+static void
+test_lfb_integration_debug_latencies (void)
+{
+  g_autoptr (LfbGdbusFeedbackDebug) debug = get_debug_proxy ();
+  g_autoptr (GVariant) latencies = NULL;
+  g_autoptr (GError) err = NULL;
+  guint latency;
+
+  lfb_gdbus_feedback_debug_call_get_latencies_sync (debug, &latencies, NULL, &err);
+  g_assert_no_error (err);
+  g_assert_true (g_variant_lookup (latencies, "vibra", "u", &latency));
+  g_assert_true (g_variant_lookup (latencies, "sound", "u", &latency));
+  g_assert_true (g_variant_lookup (latencies, "leds", "u", &latency));
+}
+
+static void
+test_lfb_integration_debug_sound_voices (void)
+{
+  g_autoptr (LfbGdbusFeedbackDebug) debug = get_debug_proxy ();
+  g_autoptr (GVariant) counters = NULL;
+  g_autoptr (GError) err = NULL;
+  const char *keys[] = { "started", "coalesced", "stolen", "dropped", "peak" };
+
+  lfb_gdbus_feedback_debug_call_get_sound_voices_sync (debug, &counters, NULL, &err);
+  g_assert_no_error (err);
+  for (guint i = 0; i < G_N_ELEMENTS (keys); i++) {
+    guint value;
+
+    g_assert_true (g_variant_lookup (counters, keys[i], "u", &value));
+  }
+}
+
+static void
+test_lfb_integration_debug_theme_sizes (void)
+{
+  g_autoptr (LfbGdbusFeedbackDebug) debug = get_debug_proxy ();
+  g_autoptr (GVariant) sizes = NULL;
+  g_autofree char *current = NULL;
+  g_autoptr (GError) err = NULL;
+
+  lfb_gdbus_feedback_debug_call_get_theme_sizes_sync (debug, &sizes, &current, NULL, &err);
+  g_assert_no_error (err);
+  g_assert_true (g_variant_is_of_type (sizes, G_VARIANT_TYPE ("a{st}")));
+  g_assert_nonnull (current);
+  /* The theme in use is among the preloaded ones */
+  if (current[0] != '\0') {
+    guint64 size;
+
+    g_assert_true (g_variant_lookup (sizes, current, "t", &size));
+    g_assert_cmpuint (size, >, 0);
+  }
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -365,5 +438,20 @@ main (gint argc, gchar *argv[])
              (gpointer)test_lfb_integration_profile,
              (gpointer)fixture_teardown);
 
+  g_test_add("/feedbackd/lfb-integration/debug/latencies", TestFixture, NULL,
+             (gpointer)fixture_setup,
+             (gpointer)test_lfb_integration_debug_latencies,
+             (gpointer)fixture_teardown);
+
+  g_test_add("/feedbackd/lfb-integration/debug/sound-voices", TestFixture, NULL,
+             (gpointer)fixture_setup,
+             (gpointer)test_lfb_integration_debug_sound_voices,
+             (gpointer)fixture_teardown);
+
+  g_test_add("/feedbackd/lfb-integration/debug/theme-sizes", TestFixture, NULL,
+             (gpointer)fixture_setup,
+             (gpointer)test_lfb_integration_debug_theme_sizes,
+             (gpointer)fixture_teardown);
+
   return g_test_run();
 }